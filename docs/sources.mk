@@ -8,5 +8,17 @@ SRCS= main.cpp \
 	Response.cpp \
 	Request.cpp \
 	DataStore.cpp \
+	ByteScan.cpp \
+	Arena.cpp \
+	HeaderTable.cpp \
 	CGIManager.cpp \
+	CgiWorkerPool.cpp \
+	FastCgiClient.cpp \
+	FileCache.cpp \
+	FileMapCache.cpp \
+	Deflater.cpp \
+	OpenFileCache.cpp \
+	TimerWheel.cpp \
+	ConnectionPool.cpp \
+	WorkerMaster.cpp \
 	Connection.cpp
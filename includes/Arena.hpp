@@ -0,0 +1,65 @@
+/**
+ * @file Arena.hpp
+ * @brief Bump allocator for the short-lived bytes of one request (header names, values, cookies).
+ * Allocation is a pointer bump inside the current block; reset() rewinds to the first block in O(1)
+ * without freeing anything, so once a connection's arena has grown to its usual header size,
+ * parsing the next request does no malloc at all.
+ */
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+#define ARENA_BLOCK_SIZE 4096
+
+class Arena
+{
+	public:
+		Arena();
+		explicit Arena(size_t blockSize);
+		~Arena();
+
+		/**
+		 * @brief Returns n bytes of storage, valid until the next reset() or release().
+		 * Byte-aligned only: the arena holds character data.
+		 */
+		char*	allocate(size_t n);
+
+		/**
+		 * @brief Copies n bytes into the arena and returns the copy.
+		 */
+		char*	copy(const char* src, size_t n);
+
+		/**
+		 * @brief Invalidates every allocation and rewinds to the first block. Blocks are kept.
+		 */
+		void	reset();
+
+		/**
+		 * @brief reset() that also frees every block but the first, after an oversized request.
+		 */
+		void	release();
+
+		size_t	used() const;		// bytes handed out since the last reset
+		size_t	capacity() const;	// bytes held in blocks
+		size_t	blockCount() const;
+
+	private:
+		struct Block
+		{
+			char*	data;
+			size_t	size;
+		};
+
+		std::vector<Block>	_blocks;
+		size_t				_blockSize;
+		size_t				_current;	// block being bumped into
+		size_t				_offset;	// first free byte in it
+		size_t				_used;
+
+		void	_nextBlock(size_t n);
+
+		// Non-copyable: handed-out pointers belong to this arena, so owners re-copy into their own.
+		Arena(const Arena&);
+		Arena& operator=(const Arena&);
+};
@@ -0,0 +1,53 @@
+/**
+ * @file ByteScan.hpp
+ * @brief Delimiter search kernels for the HTTP and CGI parsers.
+ * Each search runs 16 (SSE2) or 32 (AVX2) bytes per step on x86, picked once at startup from
+ * what the CPU supports, with a portable scalar fallback everywhere else. All functions take a
+ * half-open range [p, end) and return end when nothing is found, so callers never deal with npos.
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+namespace byte_scan
+{
+	/**
+	 * @brief One line of a header block, as offsets from the block start. The CRLF is excluded.
+	 */
+	struct Line
+	{
+		size_t	start;
+		size_t	end;
+		size_t	colon;		// first ':' in the line, or end
+		bool	control;	// holds a byte findControl() would stop at
+	};
+
+	const char*	findByte(const char* p, const char* end, char c);
+	const char*	findCrlf(const char* p, const char* end);			// first "\r\n"
+	const char*	findHeaderEnd(const char* p, const char* end);		// first "\r\n\r\n"
+
+	/**
+	 * @brief First byte not allowed in a header field: a control character other than HTAB, or DEL.
+	 */
+	const char*	findControl(const char* p, const char* end);
+
+	/**
+	 * @brief Splits [p, end) on "\r\n" in a single pass, also locating each line's first colon and
+	 * flagging control bytes. Header lines are short, so one vector pass over the whole block
+	 * beats a search per line and per delimiter. lines is cleared first; its capacity is reused.
+	 */
+	void		splitLines(const char* p, const char* end, std::vector<Line>& lines);
+
+	/**
+	 * @brief Name of the kernels in use: "avx2", "sse2" or "scalar".
+	 */
+	const char*	implementation();
+
+	/**
+	 * @brief Forces a kernel set by name (tests and benchmarks).
+	 * @return false, leaving the current one, if the name is unknown or the CPU lacks it.
+	 */
+	bool		useImplementation(const std::string& name);
+}
@@ -7,7 +7,6 @@
 #include <vector>
 #include <string>
 #include <map>
-#include <set>
 #include <unistd.h>
 #include <sys/types.h>
 class Request;
@@ -26,6 +25,14 @@ class CGIManager
 		 * @return returns read end of the outpipe to add to epoll.
 		 */
 		int getOutputFd() const;
+		/**
+		 * @return write end of the stdin pipe (non-blocking) after executePiped(), -1 otherwise.
+		 */
+		int getInputFd() const;
+		/**
+		 * @return pidfd of the running script, readable once it exits (ServerManager watches it), -1 otherwise.
+		 */
+		int getPidFd() const;
 
 		//Behavior
 		/**
@@ -37,33 +44,68 @@ class CGIManager
 		void prepare(const Request& request, const std::string& scriptPath, const std::string& interpreterOverride = "");
 
 		/**
-		 * @brief Forks, redirs input file and outpipe, and executes the CGI script.
+		 * @brief Spawns the CGI script with posix_spawn(), its stdin on the input file and its stdout on the outpipe.
+		 * @throws ClientException 502 if the interpreter or script cannot be executed, 503 at the child limit.
 		 * @param inputFd the fd of the temp file(data store) containing the fully received request body.
 		 * @warning this implementation requires that the request body is fully received before executing the CGI script,
 		 * we handle large request bodies by writing them to a temp file and passing the fd to the CGI script,
 		 * but this also means that we can't start executing the CGI script until we've fully received the request body,
-		 * which is a tradeoff  we made for simplicity.
+		 * which is a tradeoff  we made for simplicity. executePiped() lifts it for Content-Length bodies.
 		 */
 		 void execute(int inputFd);
 
 		 /**
-		 * @brief Checks if the child process has finished executing (Non-blocking); waitpid with WNOHANG.
+		 * @brief execute(), with stdin connected to a pipe the server feeds while the request body
+		 * is still arriving (see getInputFd()). The script sees EOF on stdin after closeInput().
+		 */
+		 void executePiped();
+
+		 /**
+		 * @brief Closes the write end of the stdin pipe, if open.
+		 */
+		 void closeInput();
+
+		 /**
+		 * @brief Checks if the child process has finished executing (Non-blocking). An exit already
+		 * delivered through reapChild() answers without a syscall.
 		 * @return true if the process exited, false if it is still running.
 		 */
 		 bool isDone();
 
+		 /**
+		 * @brief Reaps the child behind a pidfd that turned readable and closes the pidfd.
+		 * The CGIManager that spawned it, if still alive, sees isDone() from then on; a child
+		 * whose CGIManager is already gone is reaped all the same.
+		 */
+		 static void reapChild(int pidFd);
+
+		 /**
+		 * @brief Records that pidFd is in the server's epoll set, so its event (and reapChild()) is
+		 * what closes it. A pidfd nobody watches is closed by the next spawn once its child is reaped.
+		 */
+		 static void watchChild(int pidFd);
+
 		 /**
 		 * @brief Cleans up all active CGI processes on server shutdown.
-		 * Sends SIGTERM to all processes, waits for them to finish, then sends SIGKILL
-		 * to any that remain. Prevents zombie processes.
+		 * Sends SIGTERM to all processes and waits on their pidfds for them to exit, then sends
+		 * SIGKILL to any still running after the grace period. Prevents zombie processes.
 		 */
 		 static void cleanupAllProcesses();
 
+		 /**
+		 * @brief Fills env with the CGI/1.1 meta-variables for a request (RFC 3875 section 4.1).
+		 * Shared with FastCgiClient, which sends the same variables as FCGI_PARAMS.
+		 */
+		 static void buildEnvironment(const Request& request, const std::string& scriptPath,
+									 std::map<std::string, std::string>& env);
+
 	private:
 	//Identity
 		pid_t	_pId;
+		int		_pidFd;		// key of the child in _children, -1 once reapChild() forgot it
 		//Data
 		int									_outPipe[2];
+		int									_inPipe[2];		// only used by executePiped()
 		std::string							_query;
 		std::vector<std::string>			_scriptArgv;
 		std::map<std::string, std::string>	_env;
@@ -75,10 +117,18 @@ class CGIManager
 		void	_prepExecveArrays();
 		void	_freeExecveArrays();
 		void	_closePipes();
-		static void _reapFinishedActivePids();
+		void	_spawn(int inputFd);
 		static bool _isSpawnLimitReached();
 
-	static std::set<pid_t> _activePids;
-	static void _registerPid(pid_t pid);
-	static void _unregisterPid(pid_t pid);
+	// every spawned child not reaped yet, by pidfd. owner is NULL once its CGIManager is destroyed.
+	struct Child
+	{
+		pid_t		pid;
+		CGIManager*	owner;
+		bool		reaped;		// waited for through isDone(), the pidfd event is still due
+		bool		watched;	// the pidfd is registered with epoll
+	};
+	static std::map<int, Child> _children;
+	void	_watchChild();
+	void	_forgetOwner();
 };
\ No newline at end of file
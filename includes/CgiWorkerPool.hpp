@@ -0,0 +1,84 @@
+/**
+ * @file CgiWorkerPool.hpp
+ * @brief Pre-forked Python interpreters for locations with cgi_pool set.
+ * A plain CGI request pays for fork(), execve() and the interpreter's start-up before the script
+ * runs a line. A pooled location keeps long-lived interpreters instead, each running a small harness
+ * on its end of a socketpair: the request's environment and body reach an idle worker as FastCGI
+ * records, the worker runs the script in-process with stdin, stdout and os.environ swapped, and its
+ * output comes back as FCGI_STDOUT — so the server side is a FastCgiClient on an already connected fd.
+ * A worker is replaced after cgi_pool_max_requests requests, and whenever a request ends unclean
+ * (timeout, crash, client gone), since its state can no longer be trusted.
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <cstddef>
+#include <sys/types.h>
+
+class LocationConf;
+
+class CgiWorkerPool
+{
+	public:
+		// Canonical Form
+		CgiWorkerPool();
+		CgiWorkerPool(const CgiWorkerPool& other);
+		CgiWorkerPool& operator=(const CgiWorkerPool& other);
+		~CgiWorkerPool();
+
+		/**
+		 * @brief Process-wide pool, filled per server process once its configuration is known.
+		 */
+		static CgiWorkerPool& shared();
+
+		/**
+		 * @brief Spawns the location's cgi_pool workers with its .py interpreter. A location
+		 * started twice keeps its running workers.
+		 */
+		void start(const LocationConf& loc);
+
+		/**
+		 * @brief Takes an idle worker of the location. A worker found dead is replaced first.
+		 * @return The worker's socket (non-blocking), or -1 if every worker is busy: the caller
+		 * then forks a plain CGI process instead of queueing behind the pool.
+		 */
+		int acquire(const LocationConf& loc);
+
+		/**
+		 * @brief Hands a worker back. It is replaced rather than reused once it served
+		 * cgi_pool_max_requests requests, or when reusable is false.
+		 */
+		void release(int fd, bool reusable);
+
+		size_t getWorkerCount(const LocationConf& loc) const;
+		size_t getIdleCount(const LocationConf& loc) const;
+
+		/**
+		 * @brief Kills and reaps every worker (server shutdown).
+		 */
+		void shutdown();
+
+	private:
+		struct Worker
+		{
+			pid_t	pid;
+			int		fd;			// server end of the socketpair, -1 if the spawn failed
+			size_t	served;
+			bool	busy;
+		};
+
+		struct Pool
+		{
+			std::string			interpreter;
+			size_t				maxRequests;
+			std::vector<Worker>	workers;
+		};
+
+		std::map<const LocationConf*, Pool>	_pools;
+
+		static void	_spawn(const std::string& interpreter, Worker& worker);
+		static void	_retire(Worker& worker);
+		static bool	_isAlive(const Worker& worker);
+};
@@ -41,10 +41,29 @@ public:
 	 */
 	std::vector<ServerConf> parse();
 
+	/**
+	 * @brief Value of the top-level worker_processes directive ("auto" is already resolved
+	 * to the online CPU count). 1 when absent, meaning no master/worker split.
+	 */
+	size_t getWorkerProcesses() const;
+
+	/**
+	 * @brief Value of the top-level epoll_edge_triggered directive (off when absent).
+	 */
+	bool getEdgeTriggered() const;
+
+	/**
+	 * @brief Value of the top-level connection_pool_size directive (0, no pooling, when absent).
+	 */
+	size_t getConnectionPoolSize() const;
+
 private:
 	std::string              _filePath;
 	std::vector<std::string> _tokens;
 	size_t                   _pos;
+	size_t                   _workerProcesses;
+	bool                     _edgeTriggered;
+	size_t                   _connectionPoolSize;
 
 	// Tokenizer
 
@@ -62,12 +81,30 @@ private:
 	ServerConf   _parseServerBlock();
 	LocationConf _parseLocationBlock(const std::string& path);
 
+	// Top-level directive handlers
+
+	void _parseWorkerProcesses();
+	void _parseEdgeTriggered();
+	void _parseConnectionPoolSize();
+
 	// Server-level directive handlers
 
 	void _parseListen(ServerConf& conf);
 	void _parseServerName(ServerConf& conf);
 	void _parseMaxBodySize(ServerConf& conf);
 	void _parseErrorPage(ServerConf& conf);
+	void _parseKeepAliveTimeout(ServerConf& conf);
+	void _parseKeepAliveRequests(ServerConf& conf);
+	void _parseFileCacheEntries(ServerConf& conf);
+	void _parseFileCacheMaxSize(ServerConf& conf);
+	void _parseFileCacheValid(ServerConf& conf);
+	void _parseOpenFileCacheEntries(ServerConf& conf);
+	void _parseOpenFileCacheValid(ServerConf& conf);
+	void _parseOpenFileCacheInactive(ServerConf& conf);
+	void _parseFileMapMaxSize(ServerConf& conf);
+	void _parseClientHeaderTimeout(ServerConf& conf);
+	void _parseClientBodyTimeout(ServerConf& conf);
+	void _parseSendTimeout(ServerConf& conf);
 
 	// Location-level directive handlers
 
@@ -78,11 +115,24 @@ private:
 	void _parseUploadStore(LocationConf& loc);
 	void _parseReturn(LocationConf& loc);
 	void _parseCgiInterpreter(LocationConf& loc);
+	void _parseFastCgiPass(LocationConf& loc);
+	void _parseCgiPool(LocationConf& loc);
+	void _parseCgiPoolMaxRequests(LocationConf& loc);
+	void _parseCgiPoolTimeout(LocationConf& loc);
+	void _parseGzip(LocationConf& loc);
+	void _parseGzipCompLevel(LocationConf& loc);
+	void _parseGzipMinLength(LocationConf& loc);
+	void _parseGzipTypes(LocationConf& loc);
+	void _parseGzipStatic(LocationConf& loc);
+	void _parseExpires(LocationConf& loc);
+	void _parseCacheControl(LocationConf& loc);
 
 	// Validators / converters
 
 	struct sockaddr_in _parseSockAddr(const std::string& listenValue);
-	size_t             _parseBodySize(const std::string& value);
+	size_t             _parseBodySize(const std::string& value, const std::string& directive = "client_max_body_size");
+	size_t             _parseCount(const std::string& directive, const std::string& value);
+	size_t             _parseTimeout(const std::string& directive, const std::string& value);
 	HTTPMethod         _parseMethodToken(const std::string& token);
 
 	// Non-copyable
@@ -6,6 +6,8 @@
 #pragma once
 
 #define MAX_HEADER_SIZE 8192
+#define PROCESSING_TIMEOUT_S 60
+#define RECYCLE_KEEP_BYTES (16 * 1024) // buffers a pooled connection may keep allocated
 
 #include <string>
 #include <ctime>
@@ -26,7 +28,7 @@ enum ConnectionState
 	READING,			// Waiting for POLLIN on client socket. Accumulating request.
 	WRITING,			// Waiting for POLLOUT on client socket. Draining the write buffer.
 	PROCESSING,			// CPU-bound phase. Parsing, routing, checking permissions.
-	WAITING_FOR_CGI,	// The socket is idle. We are waiting for the CGI pipe to give us data.
+	WAITING_FOR_CGI,	// The socket is idle until the CGI's header block is in; its body is relayed while WRITING.
 	FINISHED,			// Transaction complete. Ready to close socket.
 };
 
@@ -40,12 +42,27 @@ class Connection
 		Connection& operator=(const Connection& other);
 		~Connection();
 
+		// Pooling
+		/**
+		 * @brief Drops everything tied to the current client (open files, CGI, temp files, buffers
+		 * larger than RECYCLE_KEEP_BYTES) so the object can wait in a ConnectionPool. The socket is not closed.
+		 */
+		void recycle();
+
+		/**
+		 * @brief Hands a recycled connection to a new client: afterwards it is in the same state as
+		 * Connection(fd, ipa, defaultConfig), without allocating its Request and Response again.
+		 */
+		void reopen(int fd, const struct sockaddr_in& ipa, const ServerConf* defaultConfig);
+
 		// State Machine Actions
 		/**
 		 * @brief Reads data from the client socket using recv() into _readBuffer.
 		 * Transitions state to PROCESSING if the request is fully received.
+		 * @param drain keep reading until EAGAIN or a full request (edge-triggered epoll);
+		 * otherwise a single recv() per call.
 		 */
-		void handleRead();
+		void handleRead(bool drain = false);
 
 		/**
 		 * @brief Executes routing logic, instantiates the Response, and prepares data for sending.
@@ -55,9 +72,20 @@ class Connection
 
 		/**
 		 * @brief Writes data from the _writeBuffer (or Response) to the client socket using send().
-		 * Transitions state to FINISHED when the transaction is completely sent.
+		 * When the transaction is completely sent, a persistent connection is reset in place
+		 * and goes back to READING (or straight to PROCESSING if a pipelined request is
+		 * already buffered); otherwise the state becomes FINISHED.
+		 * @param drain keep sending until EAGAIN or the response is done (edge-triggered epoll);
+		 * otherwise a single slice per call.
 		 */
-		void handleWrite();
+		void handleWrite(bool drain = false);
+
+		/**
+		 * @brief Reads what the CGI pipe has into the response. Relayed output counts as
+		 * activity on the client, whose send_timeout is paused while it waits for more.
+		 * @return true once the pipe reached EOF.
+		 */
+		bool readCgiOutput();
 
 		// Error & Timeout Management
 		/**
@@ -67,6 +95,26 @@ class Connection
 		 */
 		bool hasTimedOut(int timeoutSeconds) const;
 
+		/**
+		 * @brief True while a persistent connection sits between requests with nothing buffered.
+		 * Such connections are closed silently on keepalive_timeout instead of getting a 408.
+		 */
+		bool isIdleKeepAlive() const;
+
+		/**
+		 * @brief When this connection times out in its current state, measured from its last activity:
+		 * keepalive_timeout between requests, client_header_timeout / client_body_timeout while reading,
+		 * send_timeout while writing. 0 while it waits on CGI (for its headers, for more of a relayed
+		 * body, or to take more of a streamed request body), whose pipe carries its own timer.
+		 */
+		time_t getDeadline() const;
+
+		/**
+		 * @brief True while a body streamed to a CGI has CGI_STDIN_HIGH_WATER bytes queued
+		 * for its stdin: the socket isn't read until the script catches up.
+		 */
+		bool isUploadStalled() const;
+
 		/**
 		 * @brief Forces the connection into an error state, bypassing normal processing.
 		 * @param statusCode The HTTP status code to generate (e.g., 400, 408, 500).
@@ -116,6 +164,7 @@ class Connection
 		//  Dynamic Data
 		ConnectionState	_state;
 		size_t			_totalBytesRead;
+		size_t			_requestsServed;
 
 		//  Private Helpers
 		/**
@@ -123,8 +172,29 @@ class Connection
 		 */
 		void _updateActivityTimer();
 
+		/**
+		 * @brief Decides whether the current response may leave the connection open,
+		 * based on the client's wishes and the server's keepalive limits.
+		 */
+		bool _shouldKeepAlive() const;
+
+		/**
+		 * @brief Reuses the Request/Response pair for the next request on this socket.
+		 */
+		void _resetForNextRequest();
+
+		/**
+		 * @brief Moves to PROCESSING once the current request is fully buffered.
+		 */
+		void _beginProcessing();
+
 		//  handleRead sub-routines
 		void _readHeaders(const char* buf, size_t n);
+		/**
+		 * @brief Parses the next request out of _readBuffer, which may hold several
+		 * pipelined requests. Only the bytes belonging to the current request are consumed.
+		 */
+		void _parseBuffered();
 		void _readBody(const char* buf, size_t n);
 		void _readChunked(const char* buf, size_t n);
 };
\ No newline at end of file
@@ -0,0 +1,55 @@
+/**
+ * @file ConnectionPool.hpp
+ * @brief Recycles Connection objects (with their Request and Response) across clients.
+ * A Connection costs three heap objects plus their strings, maps and DataStores; under a storm of
+ * short-lived clients, allocating and freeing them per accept() dominates. Released connections
+ * are recycled and kept, up to the pool size, for the next accept() to reuse.
+ */
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <netinet/in.h>
+#include "Connection.hpp"
+
+class ConnectionPool
+{
+	public:
+		// Canonical Form
+		ConnectionPool();
+		explicit ConnectionPool(size_t maxIdle);
+		ConnectionPool(const ConnectionPool& other);
+		ConnectionPool& operator=(const ConnectionPool& other);
+		~ConnectionPool();
+
+		/**
+		 * @brief Sets how many idle connections are kept, and pre-constructs that many
+		 * so the first burst of clients is served from the pool too. 0 disables pooling.
+		 */
+		void warm(size_t maxIdle);
+
+		/**
+		 * @brief Returns a connection for a freshly accepted client: a recycled one (hit)
+		 * or a newly allocated one (miss).
+		 */
+		Connection* acquire(int fd, const struct sockaddr_in& ipa, const ServerConf* defaultConfig);
+
+		/**
+		 * @brief Takes back a connection whose socket was closed. It is recycled and kept
+		 * if the pool has room, deleted otherwise.
+		 */
+		void release(Connection* conn);
+
+		size_t getIdle() const;
+		size_t getMaxIdle() const;
+		size_t getHits() const;
+		size_t getMisses() const;
+
+	private:
+		std::vector<Connection*>	_idle;
+		size_t						_maxIdle;
+		size_t						_hits;
+		size_t						_misses;
+
+		void _clear();
+};
@@ -59,6 +59,12 @@ public:
      */
     void clear();
 
+    /**
+     * @brief clear(), and also frees the RAM buffer if it grew past keepBytes,
+     * so a recycled object doesn't pin the memory of the largest body it ever held.
+     */
+    void shrink(size_t keepBytes);
+
     //  Getters
 
     /**
@@ -98,6 +104,17 @@ public:
      */
     size_t read(char* buffer, size_t length);
 
+    /**
+     * @brief Sends stored bytes straight to a socket, without touching the read position.
+     * RAM data goes out with a single non-blocking send(); FILE_MODE data is handed to
+     * sendfile() so it never passes through a userspace buffer.
+     * @param sockFd Destination socket.
+     * @param offset Offset into the stored data to start from.
+     * @param length Maximum number of bytes to send.
+     * @return Bytes sent, 0 if offset is past the end, or -1 on error (errno is set).
+     */
+    ssize_t sendTo(int sockFd, size_t offset, size_t length) const;
+
     /**
      * @brief Resets the internal read position to the beginning of the data.
      */
@@ -0,0 +1,96 @@
+/**
+ * @file Deflater.hpp
+ * @brief Streaming DEFLATE (RFC 1951) encoder with gzip (RFC 1952) and zlib (RFC 1950) framing,
+ * used to compress response bodies for clients that send Accept-Encoding.
+ * Input is fed slice by slice; matches are searched over a 32 KB window with hash chains, and every
+ * block is emitted with whichever of dynamic Huffman, fixed Huffman or stored codes is smallest.
+ * The level (1-9) only trades search effort for ratio, as in zlib.
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+enum DeflateFormat
+{
+	DEFLATE_RAW,	// bare RFC 1951 stream
+	DEFLATE_ZLIB,	// "Content-Encoding: deflate" is the zlib wrapper, despite the name
+	DEFLATE_GZIP
+};
+
+class Deflater
+{
+	public:
+		// Canonical Form
+		Deflater();
+		Deflater(const Deflater& other);
+		Deflater& operator=(const Deflater& other);
+		~Deflater();
+
+		/**
+		 * @brief Starts a new stream, dropping whatever the previous one left.
+		 * @param level 1 (fastest) to 9 (smallest); clamped into that range.
+		 */
+		void start(DeflateFormat format, int level);
+
+		/**
+		 * @brief Compresses n more input bytes. Output is appended to out whenever a block fills up,
+		 * so a small write often appends nothing.
+		 */
+		void write(const char* data, size_t n, std::string& out);
+
+		/**
+		 * @brief Encodes the remaining input, the final block and the format's trailer.
+		 */
+		void finish(std::string& out);
+
+		bool isFinished() const;
+
+		/**
+		 * @brief One-shot helper: the whole of data as one stream.
+		 */
+		static std::string compress(DeflateFormat format, int level, const char* data, size_t n);
+
+	private:
+		struct Symbol
+		{
+			unsigned short	litLen;	// literal byte, or match length when dist > 0
+			unsigned short	dist;
+		};
+
+		DeflateFormat			_format;
+		int						_level;
+		size_t					_maxChain;		// hash chain entries tried per position
+		size_t					_niceLength;	// a match this long is taken without looking further
+		bool					_lazy;			// defer a match by one byte when the next one is longer
+		bool					_started;		// the format header is written
+		bool					_finished;
+
+		std::string				_window;		// encoded bytes still in reach (32 KB), then pending input
+		size_t					_base;			// stream offset of _window[0]
+		size_t					_pos;			// stream offset of the next byte to encode
+		size_t					_blockStart;	// stream offset where the current block's input begins
+		std::vector<unsigned int> _head;		// hash -> latest stream offset + 1 (mod 2^32), 0 if none
+		std::vector<unsigned int> _prev;		// offset & window mask -> previous offset + 1 with the same hash
+		std::vector<Symbol>		_symbols;		// current block, not encoded yet
+
+		unsigned long			_crc;
+		unsigned long			_adler;
+		unsigned long			_inSize;
+		unsigned long			_bitBuf;
+		int						_bitCount;
+
+		void	_writeHeader(std::string& out);
+		void	_encode(std::string& out, bool flush);
+		size_t	_longestMatch(size_t pos, size_t limit, size_t& dist) const;
+		void	_insert(size_t pos, size_t end);
+		void	_flushBlock(std::string& out, bool last);
+		void	_writeStored(std::string& out, bool last);
+		void	_writeSymbols(std::string& out, const std::vector<unsigned char>& litLens,
+							  const std::vector<unsigned short>& litCodes,
+							  const std::vector<unsigned char>& distLens,
+							  const std::vector<unsigned short>& distCodes);
+		void	_putBits(std::string& out, unsigned long bits, int count);
+		void	_alignToByte(std::string& out);
+};
@@ -0,0 +1,97 @@
+/**
+ * @file FastCgiClient.hpp
+ * @brief Client side of the FastCGI protocol, for locations with a fastcgi_pass backend.
+ * Where CGI forks and execs an interpreter per request, a FastCGI backend is a long-running process:
+ * the request's environment and body are sent to it as records over a socket, and its answer comes
+ * back as FCGI_STDOUT records carrying the same output a CGI script would write. The socket runs
+ * non-blocking in the server's event loop, and a finished request hands its connection back to a
+ * per-backend idle pool (FCGI_KEEP_CONN), so the next request skips connect().
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <cstddef>
+
+#define FCGI_MAX_IDLE_PER_BACKEND	8		// idle connections kept per backend address
+#define FCGI_STDIN_RECORD_SIZE		32768	// body bytes per FCGI_STDIN record
+
+class Request;
+class DataStore;
+
+class FastCgiClient
+{
+	public:
+		// Canonical Form
+		FastCgiClient();
+		FastCgiClient(const FastCgiClient& other);
+		FastCgiClient& operator=(const FastCgiClient& other);
+		~FastCgiClient();
+
+		/**
+		 * @brief Takes an idle connection to the backend, or opens one, and queues the request:
+		 * FCGI_BEGIN_REQUEST, the CGI environment as FCGI_PARAMS, then the stored body as FCGI_STDIN.
+		 * @param address "unix:<path>" or "<ip>:<port>", as normalized by the config parser.
+		 * @throws ClientException(502) if the backend can't be reached.
+		 */
+		void start(Request& request, const std::string& scriptPath, const std::string& address);
+
+		/**
+		 * @brief Queues the request like start(), on a socket that is already connected and stays
+		 * owned by the caller (a CgiWorkerPool worker): it is never pooled nor closed here.
+		 */
+		void attach(int fd, Request& request, const std::string& scriptPath);
+
+		/**
+		 * @brief Sends queued records until the socket would block.
+		 * @return true once the whole request, body included, is sent.
+		 * @throws ClientException(502) on a write error.
+		 */
+		bool flush();
+
+		/**
+		 * @brief Reads what the socket has and decodes the complete records in it. FCGI_STDOUT content
+		 * is appended to out; FCGI_STDERR content goes to the server log.
+		 * @return true once the request is over: FCGI_END_REQUEST, or the backend closed the connection.
+		 */
+		bool receive(std::string& out);
+
+		int		getFd() const;
+		bool	wantsWrite() const;		// request records are still queued for the socket
+		bool	isReusable() const;		// the request ended cleanly, leaving the socket ready for the next
+
+		/**
+		 * @brief Idle connections currently pooled for a backend address.
+		 */
+		static size_t getIdleCount(const std::string& address);
+
+		/**
+		 * @brief Closes every pooled connection (server shutdown).
+		 */
+		static void closeIdleConnections();
+
+	private:
+		int				_fd;
+		std::string		_address;
+		std::string		_out;			// encoded records not sent yet
+		size_t			_outPos;
+		DataStore*		_body;			// the request's stored body, framed into _out as the socket drains
+		size_t			_bodyLeft;
+		bool			_stdinSent;		// the empty FCGI_STDIN record ending the body is queued
+		std::string		_in;			// received bytes of a record not complete yet
+		bool			_ended;
+		bool			_attached;		// the socket belongs to the caller of attach()
+
+		void	_queueRequest(Request& request, const std::string& scriptPath);
+		void	_acquire();
+		void	_connect();
+		void	_fillStdin();
+		void	_release();
+		void	_close();
+
+		static void	_appendRecord(std::string& out, unsigned char type, const char* data, size_t n);
+		static void	_appendParam(std::string& out, const std::string& name, const std::string& value);
+
+		static std::map<std::string, std::vector<int> > _idle;
+};
@@ -0,0 +1,82 @@
+/**
+ * @file FileCache.hpp
+ * @brief Bounded LRU cache of small static files, kept in memory together with their precomputed headers.
+ * A hit is served without touching the filesystem; entries are re-stat()ed at most once per validity window.
+ */
+#pragma once
+
+#include <string>
+#include <map>
+#include <list>
+#include <ctime>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+/**
+ * @struct CachedFile
+ * @brief One cached file: its bytes, the headers derived from them, and the stat() identity they were read under.
+ */
+struct CachedFile
+{
+	std::string	body;
+	std::string	contentType;
+	std::string	contentLength;
+	std::string	lastModified;
+	time_t		mtime;
+	off_t		size;
+	ino_t		inode;
+	time_t		validatedAt;
+	mutable std::string	gzipBody;	// body gzip-compressed at gzipLevel, filled by the first response that needs it
+	mutable int			gzipLevel;
+};
+
+class FileCache
+{
+	public:
+		// Canonical Form
+		FileCache();
+		FileCache(const FileCache& other);
+		FileCache& operator=(const FileCache& other);
+		~FileCache();
+
+		/**
+		 * @brief Process-wide cache shared by every server block.
+		 */
+		static FileCache& shared();
+
+		/**
+		 * @brief Looks a path up and promotes it to most-recently-used.
+		 * Once validSeconds have passed since the last check the file is stat()ed again,
+		 * and an entry whose mtime, size or inode changed (or that vanished) is dropped.
+		 * @return The entry, or NULL on a miss.
+		 */
+		const CachedFile* lookup(const std::string& path, size_t validSeconds, time_t now);
+
+		/**
+		 * @brief Inserts (or replaces) a file, evicting least-recently-used entries beyond maxEntries.
+		 * @param body File contents; swapped into the cache, so the caller's string is left empty.
+		 * @return The stored entry, or NULL when maxEntries is 0.
+		 */
+		const CachedFile* store(const std::string& path, const struct stat& st, std::string& body,
+								const std::string& contentType, const std::string& lastModified,
+								size_t maxEntries, time_t now);
+
+		/**
+		 * @brief Drops a path, e.g. after the server itself deleted or rewrote the file.
+		 */
+		void invalidate(const std::string& path);
+		void clear();
+		size_t size() const;
+
+	private:
+		struct Entry
+		{
+			CachedFile							file;
+			std::list<std::string>::iterator	lruPos;
+		};
+
+		std::map<std::string, Entry>	_entries;
+		std::list<std::string>			_lru;	// front = most recently used
+
+		void _erase(std::map<std::string, Entry>::iterator it);
+};
@@ -0,0 +1,82 @@
+/**
+ * @file FileMapCache.hpp
+ * @brief Read-only mmap()s of static files, shared by every Response reading the same file version.
+ * Bodies compressed on the fly hand their slices to the deflater straight from the mapping, with no
+ * pread() into a buffer first, and concurrent downloads of a popular file share one set of page-cache pages.
+ * A file truncated while mapped raises SIGBUS on the missing pages: feed() catches that for its own
+ * read, so only the response reading it fails.
+ */
+#pragma once
+
+#include <map>
+#include <string>
+#include <cstddef>
+#include <ctime>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+class Deflater;
+
+class FileMapCache
+{
+	public:
+		// Canonical Form
+		FileMapCache();
+		FileMapCache(const FileMapCache& other);
+		FileMapCache& operator=(const FileMapCache& other);
+		~FileMapCache();
+
+		/**
+		 * @brief Process-wide cache shared by every server block.
+		 */
+		static FileMapCache& shared();
+
+		/**
+		 * @brief Maps the whole of fd's file, whose stat() is st, and takes a reference on the mapping.
+		 * A file with the same device, inode, size and mtime reuses the mapping already made, so a
+		 * rewritten file gets a fresh one while readers of the old version keep theirs.
+		 * The caller must hand it back with release(), never munmap() it.
+		 * @return The mapped bytes, or NULL for an empty or non-regular file, or if mmap() fails.
+		 */
+		const char* acquire(int fd, const struct stat& st);
+
+		/**
+		 * @brief Drops a reference taken by acquire(); the file is unmapped with its last reference.
+		 */
+		void release(const char* data);
+
+		/**
+		 * @brief Deflates n bytes of an acquired mapping, appending what comes out to out.
+		 * @return false if part of the range is gone because the file shrank; deflater and out are then
+		 * unusable and the stream must be dropped.
+		 */
+		static bool feed(Deflater& deflater, const char* src, size_t n, std::string& out);
+
+		/**
+		 * @brief Number of files currently mapped.
+		 */
+		size_t size() const;
+
+	private:
+		struct Key
+		{
+			dev_t	dev;
+			ino_t	ino;
+			off_t	size;
+			time_t	mtime;
+
+			bool operator<(const Key& other) const;
+		};
+
+		typedef std::map<Key, const char*> KeyMap;
+
+		struct Mapping
+		{
+			KeyMap::iterator	pos;		// its entry in _maps
+			size_t				length;
+			size_t				refs;
+		};
+
+		KeyMap								_maps;
+		std::map<const char*, Mapping>		_byData;
+};
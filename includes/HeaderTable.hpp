@@ -0,0 +1,73 @@
+/**
+ * @file HeaderTable.hpp
+ * @brief Flat table of name/value slices for request headers and cookies.
+ * The bytes live in the owning request's Arena (or inside another field's value), so adding a field
+ * copies nothing but two pointers and two lengths. A request carries a few dozen fields at most,
+ * where a linear scan of one contiguous vector beats a tree of separately allocated strings;
+ * each field carries a hash of its name so the scan compares integers, not bytes.
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include "Arena.hpp"
+
+struct HeaderField
+{
+	const char*	name;
+	size_t		nameLen;
+	const char*	value;
+	size_t		valueLen;
+	unsigned	hash;		// HeaderTable::hashName(name, nameLen)
+
+	std::string	getName() const;
+	std::string	getValue() const;
+};
+
+class HeaderTable
+{
+	public:
+		// Canonical Form
+		HeaderTable();
+		HeaderTable(const HeaderTable& other);	// shallow: the slices still point into other's storage
+		HeaderTable& operator=(const HeaderTable& other);
+		~HeaderTable();
+
+		/**
+		 * @brief FNV-1a over the name bytes. Callers looking up a fixed name compute it once.
+		 */
+		static unsigned	hashName(const char* name, size_t nameLen);
+
+		/**
+		 * @brief Adds a field, or replaces the value of the field with the same (exact) name.
+		 * The slices are stored as given and must outlive the table's contents.
+		 * @return the field's index, stable until clear().
+		 */
+		size_t	set(const char* name, size_t nameLen, const char* value, size_t valueLen);
+		size_t	set(const char* name, size_t nameLen, unsigned hash, const char* value, size_t valueLen);
+
+		/**
+		 * @brief Exact-match lookup. NULL when absent.
+		 */
+		const HeaderField*	find(const char* name, size_t nameLen) const;
+		const HeaderField*	find(const char* name, size_t nameLen, unsigned hash) const;
+		const HeaderField*	find(const std::string& name) const;
+
+		/**
+		 * @brief Replaces the contents with a deep copy of other, with the bytes copied into arena.
+		 */
+		void	copyFrom(const HeaderTable& other, Arena& arena);
+
+		/**
+		 * @brief Empties the table, keeping its capacity.
+		 */
+		void	clear();
+
+		size_t				size() const;
+		bool				empty() const;
+		const HeaderField&	operator[](size_t index) const;
+
+	private:
+		std::vector<HeaderField>	_fields;
+};
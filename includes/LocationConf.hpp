@@ -9,8 +9,19 @@
 
 #include <string>
 #include <map>
+#include <set>
+#include <cstddef>
 #include "AllowedMethods.hpp"
 
+#define DEFAULT_CGI_POOL_MAX_REQUESTS 1000
+#define DEFAULT_CGI_POOL_TIMEOUT_S 10
+#define MAX_CGI_POOL_SIZE 256
+#define DEFAULT_GZIP_COMP_LEVEL 1
+#define DEFAULT_GZIP_MIN_LENGTH 20
+#define EXPIRES_OFF -1			// no Expires / Cache-Control from "expires"
+#define EXPIRES_EPOCH -2		// "expires epoch": already expired, revalidate every time
+#define EXPIRES_MAX 315360000	// "expires max": ten years
+
 class LocationConf
 {
 	public:
@@ -31,6 +42,16 @@ class LocationConf
 		const std::string&		getDefaultPage() const;
 		const std::string&		getStorageLocation() const;
 		std::string				getCgiInterpreter(const std::string& ext) const;
+		const std::string&		getFastCgiPass() const;
+		size_t					getCgiPoolSize() const;
+		size_t					getCgiPoolMaxRequests() const;
+		size_t					getCgiPoolTimeout() const;
+		bool					getGzip() const;
+		int						getGzipCompLevel() const;
+		size_t					getGzipMinLength() const;
+		bool					getGzipStatic() const;
+		long					getExpires() const;
+		const std::string&		getCacheControl() const;
 
 		//  Setters
 
@@ -43,6 +64,17 @@ class LocationConf
 		void setDefaultPage(const std::string& defaultPage);
 		void setStorageLocation(const std::string& storageLocation);
 		void addCgiInterpreter(const std::string& ext, const std::string& interpreterPath);
+		void setFastCgiPass(const std::string& address);
+		void setCgiPoolSize(size_t workers);
+		void setCgiPoolMaxRequests(size_t requests);
+		void setCgiPoolTimeout(size_t seconds);
+		void setGzip(bool gzip);
+		void setGzipCompLevel(int level);
+		void setGzipMinLength(size_t length);
+		void addGzipType(const std::string& mimeType);
+		void setGzipStatic(bool gzipStatic);
+		void setExpires(long seconds);
+		void setCacheControl(const std::string& value);
 
 		// Utility
 
@@ -60,6 +92,12 @@ class LocationConf
 		 */
 		bool isCgiExtension(const std::string& ext) const;
 
+		/**
+		 * @brief Checks if responses of this MIME type may be compressed (text/html always may).
+		 * @param mimeType A Content-Type value; parameters such as "; charset=" are ignored.
+		 */
+		bool isGzipType(const std::string& mimeType) const;
+
 	private:
 		//  Identity
 		std::string	_path;
@@ -72,4 +110,15 @@ class LocationConf
 		std::string		 _defaultPage;		// Default file to serve (e.g., "index.html")
 		std::string		 _storageLocation;	// Directory where uploaded files are saved
 		std::map<std::string, std::string>	_cgiInterpreters;	// Extension -> interpreter path (e.g., ".py" -> "/usr/bin/python3")
+		std::string		 _fastCgiPass;		// FastCGI backend ("unix:/path" or "ip:port"); empty if none
+		size_t			_cgiPoolSize;		// pre-forked interpreters for .py scripts; 0 forks one per request
+		size_t			_cgiPoolMaxRequests;	// requests a pooled interpreter serves before it is replaced
+		size_t			_cgiPoolTimeout;	// seconds a pooled script may stay quiet before its worker is replaced
+		bool			_gzip;				// compress responses for clients that accept gzip or deflate
+		int				_gzipCompLevel;		// 1 (fastest) to 9 (smallest)
+		size_t			_gzipMinLength;		// smaller bodies are sent as they are
+		std::set<std::string>	_gzipTypes;	// MIME types compressed besides text/html; "*" for any
+		bool			_gzipStatic;		// serve "<file>.gz" when it exists and the client accepts gzip
+		long			_expires;			// freshness of static files in seconds, or EXPIRES_OFF / EXPIRES_EPOCH
+		std::string		 _cacheControl;		// literal Cache-Control value; overrides the one "expires" implies
 };
\ No newline at end of file
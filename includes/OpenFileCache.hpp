@@ -0,0 +1,88 @@
+/**
+ * @file OpenFileCache.hpp
+ * @brief Cache of stat() results and open read-only descriptors for static files, in the spirit of nginx's open_file_cache.
+ * Files too large for the content cache still skip the repeated open/stat/close under load: every Response
+ * serving the same path shares one descriptor, which is safe because sendfile() is always given its own offset.
+ */
+#pragma once
+
+#include <string>
+#include <map>
+#include <list>
+#include <set>
+#include <ctime>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+class OpenFileCache
+{
+	public:
+		// Canonical Form
+		OpenFileCache();
+		OpenFileCache(const OpenFileCache& other);
+		OpenFileCache& operator=(const OpenFileCache& other);
+		~OpenFileCache();
+
+		/**
+		 * @brief Process-wide cache shared by every server block.
+		 */
+		static OpenFileCache& shared();
+
+		/**
+		 * @brief stat() through the cache. Regular files are opened as they are cached, so a following
+		 * acquire() on the same path costs no syscall. Failed lookups are never cached, and with
+		 * maxEntries 0 this is a plain stat().
+		 * @param validSeconds how long a cached result is trusted before the path is stat()ed again.
+		 * @param inactiveSeconds entries unused for this long are closed by sweep().
+		 * @return false if the path does not exist (errno is set).
+		 */
+		bool stat(const std::string& path, struct stat& st, size_t maxEntries,
+				  size_t validSeconds, size_t inactiveSeconds, time_t now);
+
+		/**
+		 * @brief Returns a shared read-only fd for a regular file and takes a reference on it.
+		 * The caller must hand it back with release(), never close() it.
+		 * @return The fd, or -1 if the path is missing, not a regular file, unreadable, or maxEntries is 0.
+		 */
+		int acquire(const std::string& path, struct stat& st, size_t maxEntries,
+					size_t validSeconds, size_t inactiveSeconds, time_t now);
+
+		/**
+		 * @brief Drops a reference taken by acquire(); the fd is closed once it is both evicted and unused.
+		 */
+		void release(int fd);
+
+		/**
+		 * @brief Forgets a path, e.g. after the server itself deleted or rewrote the file.
+		 */
+		void invalidate(const std::string& path);
+
+		/**
+		 * @brief Closes entries that went unused for longer than their inactive timeout.
+		 */
+		void sweep(time_t now);
+
+		void clear();
+		size_t size() const;
+
+	private:
+		struct Entry
+		{
+			int									fd;		// -1 for directories and other non-regular paths
+			struct stat							st;
+			time_t								validatedAt;
+			time_t								lastUsed;
+			size_t								inactive;
+			std::list<std::string>::iterator	lruPos;
+		};
+
+		std::map<std::string, Entry>	_entries;
+		std::list<std::string>			_lru;		// front = most recently used
+		std::map<int, size_t>			_refs;		// outstanding acquire() references per fd
+		std::set<int>					_orphans;	// evicted fds that stay open until their last release()
+
+		Entry*	_lookup(const std::string& path, size_t maxEntries, size_t validSeconds,
+						size_t inactiveSeconds, time_t now);
+		void	_erase(std::map<std::string, Entry>::iterator it);
+		void	_closeFd(int fd);
+};
@@ -6,17 +6,20 @@
 #pragma once
 
 #include <string>
-#include <map>
 #include <sys/types.h>
 #include <netinet/in.h>
 #include "AllowedMethods.hpp"
 #include "DataStore.hpp"
+#include "Arena.hpp"
+#include "HeaderTable.hpp"
+#include "ByteScan.hpp"
 
-//like a time slice per parse iter, but in bytes 🤯😲
-#define PARSE_BYTE_SLICE 8192
+// bound on a chunk-size line with its extensions, and on the whole trailer section.
+#define MAX_CHUNK_LINE_SIZE 8192
 namespace req_utils
 {
 	std::string trim(const std::string& s);
+	void trimSlice(const char*& start, const char*& end);	// trim() on [start, end) in place
 	std::string ipv4ToString(const struct ::sockaddr_in& addr);
 }
 /**
@@ -27,11 +30,44 @@ enum ReqState
 {
 	REQ_HEADERS,	// Waiting for "\r\n\r\n" and parsing Request-Line & Headers
 	REQ_BODY,	 	// Headers parsed, waiting for Content-Length bytes
-	REQ_CHUNKED,	// Headers parsed, accumulating raw chunks until "\r\n\r\n"
+	REQ_CHUNKED,	// Headers parsed, decoding chunks until the last one's trailer section ends
 	REQ_DONE,		// The entire request has been successfully received from the socket(often times for HTTP/0.9)
 	REQ_ERROR		// A parsing error occurred
 };
 
+/**
+ * @enum WellKnownHeader
+ * @brief Headers the server itself consults. Their table index is recorded while parsing,
+ * so looking one up is an array read rather than a scan.
+ */
+enum WellKnownHeader
+{
+	HDR_HOST,
+	HDR_CONTENT_LENGTH,
+	HDR_TRANSFER_ENCODING,
+	HDR_COOKIE,
+	HDR_CONNECTION,
+	HDR_WELL_KNOWN_COUNT
+};
+
+/**
+ * @enum ChunkState
+ * @brief Where the chunked decoder stands in the byte stream, so any read boundary can be resumed.
+ */
+enum ChunkState
+{
+	CHUNK_SIZE,			// hex digits of a chunk-size line
+	CHUNK_EXT,			// ";name=value" extensions, skipped
+	CHUNK_SIZE_LF,		// LF ending the size line
+	CHUNK_DATA,			// payload bytes
+	CHUNK_DATA_CR,		// CRLF after the payload
+	CHUNK_DATA_LF,
+	CHUNK_TRAILER,		// start of a trailer line, or of the final empty line
+	CHUNK_TRAILER_LINE,	// trailer field, skipped
+	CHUNK_TRAILER_LF,
+	CHUNK_END_LF		// LF of the final empty line
+};
+
 class Request {
 public:
 	// Canonical Form
@@ -46,27 +82,46 @@ public:
 	/**
 	 * @brief Parses the raw buffer containing the HTTP Request-Line and Headers.
 	 * Transitions state to REQ_BODY, REQ_CHUNKED, or REQ_DONE upon finding "\r\n\r\n".
+	 * Incremental: while the headers are incomplete, each call only scans the bytes appended
+	 * since the previous one, so the buffer must only grow between calls until it returns non-zero.
 	 * @param rawBuffer The string buffer accumulated by the Connection.
-	 * @return size_t The index at which the headers end (after "\r\n\r\n").
+	 * @return size_t The index at which the headers end (after "\r\n\r\n"), 0 while incomplete.
 	 * Useful for slicing leftover body data that recv() accidentally grabbed.
 	 */
 	size_t parseHeaders(const std::string& rawBuffer);
 
 	/**
-	 * @brief Checks if the incoming chunked data contains the terminal "\r\n\r\n".
-	 * Used to transition from REQ_CHUNKED to REQ_DONE.
-	 * @param newData The latest chunk of data received from the socket.
-	 * @return true if the terminal chunk is found, false otherwise.
+	 * @brief Decodes chunked body bytes straight from a recv() buffer into the body store.
+	 * The decoder's position is kept between calls, so the stream may be split anywhere,
+	 * including inside a size line, an extension or a trailer. Extensions and trailer fields are skipped.
+	 * Moves to REQ_DONE once the trailer section ends, or to REQ_ERROR (400 malformed, 413 too large).
+	 * @return Bytes of buf that belonged to the body; the rest is the next pipelined request.
 	 */
-	bool isChunkedDone(const std::string& newData) const;
+	size_t feedChunked(const char* buf, size_t n);
 
 	/**
-	 * @brief Unified method to prepare the body for the Response/CGI phase.
-	 * For Content-Length bodies, this does nothing and returns true immediately.
-	 * For Chunked bodies, it decodes PARSE_BYTE_SLICE bytes per call to prevent blocking.
-	 * @return true if the body is fully clean and ready, false if it needs more processing loops.
+	 * @brief Returns the request to its freshly constructed state so a persistent
+	 * connection can parse its next request without reallocating the object.
+	 * The configured max body size is kept.
 	 */
-	bool processBodySlice();
+	void reset();
+
+	/**
+	 * @brief reset() that also frees body buffers larger than keepBytes, and arena blocks
+	 * beyond the first (pooled connections).
+	 */
+	void recycle(size_t keepBytes);
+
+	/**
+	 * @brief Max body size of the server a pooled connection was handed to.
+	 */
+	void setMaxBodySize(long long maxBodySize);
+
+	/**
+	 * @brief Whether the client asked for the connection to stay open after this request.
+	 * HTTP/1.1 is persistent unless "Connection: close"; HTTP/1.0 only with "Connection: keep-alive".
+	 */
+	bool wantsKeepAlive() const;
 
 	//  Getters
 
@@ -75,13 +130,20 @@ public:
 	const std::string&							getURL() const;
 	const std::string&							getProtocol() const;
 	const std::string&							getQuery() const;
-	const std::map<std::string, std::string>&	getHeaders() const;
-	const std::map<std::string, std::string>&	getCookies() const;
+	/**
+	 * @brief Parsed headers, names lowercased. The slices live until the next reset().
+	 */
+	const HeaderTable&							getHeaders() const;
+	const HeaderTable&							getCookies() const;
 	/**
 	 * @brief Gets a specific header value.
 	 * @return The value, or empty string if not found.
 	 */
 	std::string									getHeader(const std::string& key) const;
+	/**
+	 * @brief The field of a well-known header, or NULL if the request did not send it.
+	 */
+	const HeaderField*							getWellKnownHeader(WellKnownHeader id) const;
 	/**
 	 * @brief Gets a specific cookie value.
 	 * @return The value, or empty string if not found.
@@ -108,10 +170,13 @@ private:
 	std::string						_query;
 	long	long					_contentLength; // -1 for chunked requests.
 	//  Data
-	DataStore						 	_body;
-	DataStore						 	_decodedBody;
-	std::map<std::string, std::string>	_headers;
-	std::map<std::string, std::string>	_cookies;
+	DataStore						 	_body;		// decoded as it arrives for chunked requests
+	Arena								_arena;		// header and cookie bytes, rewound per request
+	HeaderTable							_headers;	// slices into _arena
+	HeaderTable							_cookies;	// slices into the cookie header's value
+	int									_wellKnown[HDR_WELL_KNOWN_COUNT];	// index in _headers, -1 if absent
+	size_t								_headerScanPos;	// bytes already searched for "\r\n\r\n"
+	std::vector<byte_scan::Line>		_lines;			// parser scratch, capacity reused
 
 	//  State Management
 	ReqState						 _reqState;
@@ -119,17 +184,19 @@ private:
 	size_t							 _maxBodySize; // filled from server config.
 	size_t							 _totalBytesRead;// used to track against _contentLength and _maxBodySize
 
-	//  Chunk Decoding State (filled per chunk)
-	size_t							  _chunkSize;
-	size_t							  _chunkDecodeOffset;
-	bool							  _isBodyProcessed;   //set on "\r\n\r\n"
-	std::string						  _chunkBuffer; // accumulates raw chunked data until we can decode a full chunk.
-	size_t							  _ramParsePos;
+	//  Chunk Decoding State (kept across reads)
+	ChunkState						  _chunkState;
+	size_t							  _chunkSize;		// payload bytes left in the current chunk
+	size_t							  _chunkLineLen;	// bytes of the current size line, or of the trailer section
+	bool							  _chunkHasDigits;
 
 	//  Private Parsing Helpers
-	void _parseRequestLine(const std::string& line);// parses the  METHOD  URI PROTOCOL line.
-	void _parseHeaderLine(const std::string& line);// parses the key value
-	void _parseCookies(const std::string& cookieHeader);// parses the Cookie header into key-value pairs.
+	void _parseRequestLine(const char* line, size_t len);// parses the  METHOD  URI PROTOCOL line.
+	void _parseHeaderLine(char* block, const byte_scan::Line& line);// parses the key value, lowercasing the name in place
+	void _parseCookies(const HeaderField& cookieHeader);// parses the Cookie header into key-value pairs.
 	void _typeOfReq();// know what type of request is it, chenked or content length
 	void _extractQueryFromURL();
+	void _clearWellKnown();
+	void _chunkError(const char* statusCode);
+	void _finishChunked();// publishes the decoded size as content-length
 };
\ No newline at end of file
@@ -8,6 +8,7 @@
 
 #include <string>
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <map>
 #include <vector>
 
@@ -15,6 +16,26 @@
 #include "ServerConf.hpp"
 #include "Request.hpp"
 #include "CGIManager.hpp"
+#include "FastCgiClient.hpp"
+#include "FileCache.hpp"
+#include "Deflater.hpp"
+
+#define CGI_RELAY_HIGH_WATER (64 * 1024)	// the CGI pipe isn't read while this much waits for the client
+#define CGI_MAX_HEADER_SIZE 8192
+#define CGI_STDIN_HIGH_WATER (64 * 1024)	// the client's body isn't read while this much waits for the script
+#define ACCEPT_GZIP 1
+#define ACCEPT_DEFLATE 2
+#define MAX_BYTE_RANGES 16	// a Range with more parts than this is answered with the whole file
+
+/**
+ * @struct ByteRange
+ * @brief One satisfiable range of a Range request, both ends inclusive.
+ */
+struct ByteRange
+{
+	size_t	first;
+	size_t	last;
+};
 
 /**
  * @enum ResponseState
@@ -24,7 +45,7 @@ enum ResponseState
 {
 	SENDING_RES_HEAD,		// Sending the Status-Line and Headers
 	SENDING_BODY_STATIC,	// Sending a static file from the DataStore
-	SENDING_BODY_CHUNKED	// Sending CGI output using Chunked Transfer Coding
+	SENDING_BODY_CHUNKED	// Relaying CGI output as it arrives, chunked unless the script gave a length
 };
 
 /**
@@ -70,6 +91,12 @@ public:
 	 */
 	bool sendSlice(int fd);
 
+	/**
+	 * @brief true if the last sendSlice() stopped because the socket buffer was full (EAGAIN).
+	 * Lets an edge-triggered caller keep sending until then, and no further.
+	 */
+	bool wouldBlock() const;
+
 	const std::string&	getStatusCode() const;
 	const std::string&	getVersion() const;
 	const std::string&	getResponsePhrase() const;
@@ -78,18 +105,88 @@ public:
 	CGIManager*			getCgiInstance() const;
 
 	/**
-	 * @brief Returns the CGI output pipe fd for epoll registration.
+	 * @brief Returns the CGI output pipe fd (or the FastCGI backend socket) for epoll registration.
 	 * @return The fd, or -1 if no CGI is active.
 	 */
 	int					getCgiOutputFd() const;
 
 	/**
-	 * @brief Called by ServerManager when the CGI pipe is readable.
-	 * Reads available data into _responseDataStore.
+	 * @brief Called by ServerManager when the FastCGI backend socket is writable: sends more of the request.
+	 */
+	void				writeCgiRequest();
+
+	/**
+	 * @brief Whether request records are still queued for a FastCGI backend (EPOLLOUT on its socket).
+	 */
+	bool				wantsCgiWrite() const;
+
+	/**
+	 * @brief How long the running script may go without output, in seconds: the location's
+	 * cgi_pool_timeout for a pooled worker, 0 to use the server's CGI timeout.
+	 */
+	size_t				getCgiTimeout() const;
+
+	/**
+	 * @brief Called by ServerManager when the CGI pipe (or FastCGI socket) is readable.
+	 * Collects the script's header block; once it is complete the response head is built from it
+	 * and every later read is framed straight into the relay buffer.
 	 * @return true if CGI output is fully consumed (EOF reached), false if more data expected.
 	 */
 	bool				readCgiOutput();
 
+	/**
+	 * @brief true once the CGI header block has produced the response head: the client can be
+	 * written to while the script still runs.
+	 */
+	bool				isCgiStreaming() const;
+
+	/**
+	 * @brief Whether the CGI pipe should be read: false while CGI_RELAY_HIGH_WATER bytes
+	 * are still waiting for the client (backpressure).
+	 */
+	bool				wantsCgiOutput() const;
+
+	/**
+	 * @brief true when everything relayed so far was sent and the script hasn't finished:
+	 * the next progress comes from the pipe, not the socket.
+	 */
+	bool				isWaitingOnCgi() const;
+
+	/**
+	 * @brief Starts the CGI script as soon as the request headers are in, when they route a
+	 * Content-Length body to one; the body is then fed to its stdin pipe as it arrives
+	 * instead of being stored first.
+	 * @return true if the script was started that way. Otherwise nothing was done, or an error
+	 * page was built, and the request takes the normal path.
+	 */
+	bool				startCgiUpload(Request& req, const ServerConf& config);
+
+	/**
+	 * @brief Queues body bytes for the script's stdin. Bytes past the announced length are left
+	 * (pipelined data); once the script stopped reading, they are counted and dropped.
+	 * @return How many bytes of data belonged to the body.
+	 */
+	size_t				feedCgiInput(const char* data, size_t n);
+
+	/**
+	 * @brief Writes queued body bytes to the stdin pipe, until it would block.
+	 * A script that closed its stdin early makes the rest of the body be discarded.
+	 */
+	void				writeCgiInput();
+
+	/**
+	 * @brief Closes the stdin pipe and drops whatever was queued for it.
+	 */
+	void				closeCgiInput();
+
+	int					getCgiInputFd() const;			// -1 unless the stdin pipe is open
+	int					getCgiPidFd() const;			// pidfd of the running script, -1 if none
+	bool				isCgiUpload() const;			// the body goes to the script as it arrives
+	size_t				getCgiInputLeft() const;		// body bytes the client still has to send
+	bool				hasCgiInput() const;			// queued bytes waiting for the pipe
+	bool				isCgiInputFull() const;			// CGI_STDIN_HIGH_WATER queued: stop reading the client
+	bool				isCgiInputDone() const;			// nothing more will be written: the pipe can close
+
 	/**
 	 * @brief Called by ServerManager when the CGI process times out.
 	 * Kills the process and builds a 504 error page.
@@ -98,13 +195,32 @@ public:
 
 	/**
 	 * @brief Finalizes the CGI response after all output has been read.
-	 * Parses CGI output headers, builds the HTTP response, transitions to sendable state.
+	 * Output that ended before its header block was relayed is answered whole, with a Content-Length;
+	 * a streamed one gets its last chunk.
 	 */
 	void				finalizeCgiResponse();
 
 	void				setStatusCode(const std::string& code);
 	void				setResponsePhrase(const std::string& phrase);
 
+	/**
+	 * @brief Chooses between "Connection: keep-alive" and "Connection: close".
+	 * Must be set before the response is built; a failed send forces it back off.
+	 */
+	void				setKeepAlive(bool keepAlive);
+	bool				isKeepAlive() const;
+
+	/**
+	 * @brief Releases any open file/CGI state and returns the response to its
+	 * freshly constructed state, so a persistent connection can reuse it.
+	 */
+	void				reset();
+
+	/**
+	 * @brief reset() that also frees a response body buffer larger than keepBytes (pooled connections).
+	 */
+	void				recycle(size_t keepBytes);
+
 	/**
 	* @brief Adds a header to the response (e.g., "Content-Type", "text/html").
 	*/
@@ -123,12 +239,44 @@ private:
 	std::map<std::string, std::string>	_headers;
 	std::vector<std::string>				_setCookies;
 	int									_fileFd;		  // Open FD for the file being streamed; -1 when not in use
+	bool								_fileFdShared;	// _fileFd is borrowed from the OpenFileCache and must be released, not closed
 	size_t								_fileSize;		// Total byte count from stat(); used for Content-Length and end detection
-	std::vector<char>					_streamBuf;	   // Holds the latest chunk read from _fileFd, retained across EAGAIN
-	size_t								_streamBufLen;	// How many bytes are currently valid in _streamBuf
-	size_t								_streamBufSent;  // How many of those bytes have been sent to the socket so far
+	off_t								_fileOffset;	  // Next byte of _fileFd to hand to sendfile(); advanced by the kernel
+	size_t								_fileEnd;		// One past the last byte of _fileFd to send (the file size unless a range)
+	std::vector<ByteRange>				_ranges;		// parts of a multipart/byteranges body, empty otherwise
+	size_t								_rangeIndex;	// next part whose head is queued; ranges.size() + 1 once the closing boundary is
+	std::string							_boundary;
+	std::string							_rangeType;		// Content-Type repeated in every part
+	Deflater*							_deflater;		// compresses _fileFd into chunks of _relay; NULL when sent as is
+	const char*							_fileMap;		// _fileFd's bytes from the FileMapCache for the deflater, or NULL to pread() them
+
+	// static file responses: validators and content coding (gzip / deflate)
+	const LocationConf*					_location;		// location serving the GET, NULL otherwise
+	std::string							_etag;			// validators of the file being served
+	std::string							_lastModified;
+	std::string							_range;			// the request's Range, if If-Range allows it
+	int									_acceptCodings;	// ACCEPT_* bits of the request's Accept-Encoding
+	bool								_acceptsChunked;	// the client speaks HTTP/1.1
 	CGIManager*							_cgiInstance;
-	size_t								_currentChunkSize;
+	FastCgiClient*						_fastCgi;		// set instead of _cgiInstance for a fastcgi_pass location
+	int									_cgiWorkerFd;	// CgiWorkerPool worker _fastCgi is attached to, -1 if none
+	size_t								_cgiTimeout;	// seconds the script may stay quiet, 0 for the server default
+
+	// streamed CGI output
+	std::string							_cgiHead;		// script output until its header block is complete
+	std::string							_relay;			// framed body bytes waiting for the socket
+	size_t								_relayPos;		// first byte of _relay not sent yet
+	long long							_cgiBodyLeft;	// bytes still owed under the script's Content-Length, -1 if none
+	bool								_cgiChunked;	// the client speaks HTTP/1.1
+	bool								_cgiStreaming;
+	bool								_cgiEof;
+
+	// request body streamed to the CGI's stdin
+	std::string							_cgiInput;		// body bytes waiting for the stdin pipe
+	size_t								_cgiInputPos;
+	size_t								_cgiInputLeft;	// body bytes not received from the client yet
+	bool								_cgiUpload;
+	bool								_cgiInputClosed;	// pipe closed, or the script stopped reading
 
 	// concurrent POST state.
 	BuildPhase							_buildPhase;
@@ -138,6 +286,8 @@ private:
 	std::string							_postFilename;
 
 	ResponseState	_responseState;
+	bool			_keepAlive;
+	bool			_wouldBlock;
 
 	//  Private Helpers
 	std::string _generateHeaderString();
@@ -148,19 +298,43 @@ private:
 	bool _continuePostWrite(Request& req);
 	void _handleDelete(const Request& req, const LocationConf& loc, const ServerConf& config);
 	bool _handleCGI(Request& req, const LocationConf& loc, const ServerConf& config);
+	bool _handleFastCgi(Request& req, const LocationConf& loc, const ServerConf& config);
+	bool _handlePooledCgi(Request& req, int workerFd, const std::string& scriptPath, const LocationConf& loc,
+						  const ServerConf& config);
+	void _releaseCgi();
 
+	void _addConnectionHeader();
 	void _finalizeSuccess(const std::string& contentType);
-	void _serveFile(const std::string& path, const ServerConf& config);
+	void _serveFile(const Request& req, const std::string& path, const struct stat& fileStat,
+					const ServerConf& config);
+	void _serveCached(const CachedFile& file, const std::string& encoding);
+	bool _notModified(const Request& req, ino_t inode, off_t size, time_t mtime, bool encoded);
+	void _addCacheHeaders();
+	void _takeRange(const Request& req, bool encoded);
+	bool _selectRanges(size_t size, std::vector<ByteRange>& ranges);
+	void _startPartial(const std::vector<ByteRange>& ranges, size_t size, const std::string& contentType);
+	bool _negotiateEncoding(const std::string& contentType, size_t size, DeflateFormat& format);
+	bool _statPath(const std::string& path, struct stat& st, const ServerConf& config);
+	void _closeFile();
 
-	std::string _drainDataStore();
 	void _splitCgiOutput(const std::string& raw, std::string& headers, std::string& body);
 	bool _parseCgiHeaders(const std::string& headerBlock, std::string& contentType);
+	void _takeCgiOutput(const char* data, size_t n);
+	void _collectCgiHead(const char* data, size_t n);
+	void _startCgiStream(const std::string& headerBlock, const std::string& body);
+	void _relayCgiBody(const char* data, size_t n);
+	void _clearCgiStream();
+	void _clearCgiInput();
 
+	bool _abortSend();
+	bool _sendFailed(ssize_t sent);
 	bool _sendHeader(int fd);
 	bool _sendBodyStatic(int fd);
 	bool _sendBodyFile(int fd);
 	bool _sendBodyDataStore(int fd);
 	bool _sendBodyChunked(int fd);
+	bool _sendBodyCompressed(int fd);
+	bool _sendBodyRanges(int fd);
 
 	//  Serialized header line (Status-Line + Headers + blank line) cached after build
 	std::string _headerBuffer;
@@ -16,6 +16,23 @@
 #include <arpa/inet.h>
 #include "Request.hpp"
 
+#define DEFAULT_KEEPALIVE_TIMEOUT_S 15
+#define DEFAULT_KEEPALIVE_REQUESTS 100
+#define DEFAULT_FILE_CACHE_ENTRIES 0
+#define DEFAULT_FILE_CACHE_MAX_SIZE (64 * 1024)
+#define DEFAULT_FILE_CACHE_VALID_S 5
+#define DEFAULT_OPEN_FILE_CACHE_ENTRIES 0
+#define DEFAULT_OPEN_FILE_CACHE_VALID_S 5
+#define DEFAULT_OPEN_FILE_CACHE_INACTIVE_S 20
+#define DEFAULT_FILE_MAP_MAX_SIZE 0
+#define DEFAULT_CLIENT_HEADER_TIMEOUT_S 60
+#define DEFAULT_CLIENT_BODY_TIMEOUT_S 60
+#define DEFAULT_SEND_TIMEOUT_S 60
+#define DEFAULT_WORKER_PROCESSES 1
+#define MAX_WORKER_PROCESSES 64
+#define DEFAULT_CONNECTION_POOL_SIZE 0
+#define MAX_CONNECTION_POOL_SIZE 65536
+
 class ServerConf
 {
 	public:
@@ -32,11 +49,71 @@ class ServerConf
 		size_t										getMaxBodySize() const;
 		const std::vector<LocationConf>&			getLocations() const;
 		const std::map<std::string, std::string>&	getErrorPages() const;
+		size_t										getKeepAliveTimeout() const;
+		size_t										getKeepAliveRequests() const;
+		size_t										getFileCacheEntries() const;
+		size_t										getFileCacheMaxSize() const;
+		size_t										getFileCacheValid() const;
+		size_t										getOpenFileCacheEntries() const;
+		size_t										getOpenFileCacheValid() const;
+		size_t										getOpenFileCacheInactive() const;
+		size_t										getFileMapMaxSize() const;
+		size_t										getClientHeaderTimeout() const;
+		size_t										getClientBodyTimeout() const;
+		size_t										getSendTimeout() const;
 
 		//  Setters
 		void setServerName(const std::string& name);
 		void setInterfacePortPair(const struct sockaddr_in& address);
 		void setMaxBodySize(size_t size);
+		/**
+		 * @brief Idle seconds a persistent connection may wait for its next request; 0 disables keep-alive.
+		 */
+		void setKeepAliveTimeout(size_t seconds);
+		/**
+		 * @brief Maximum number of requests served over one connection before it is closed.
+		 */
+		void setKeepAliveRequests(size_t count);
+		/**
+		 * @brief Number of files this server may keep in the shared in-memory cache; 0 disables caching.
+		 */
+		void setFileCacheEntries(size_t entries);
+		/**
+		 * @brief Largest file, in bytes, that is eligible for the in-memory cache.
+		 */
+		void setFileCacheMaxSize(size_t bytes);
+		/**
+		 * @brief Seconds a cached file is trusted before it is stat()ed again.
+		 */
+		void setFileCacheValid(size_t seconds);
+		/**
+		 * @brief Number of open descriptors / stat() results kept in the shared open file cache; 0 disables it.
+		 */
+		void setOpenFileCacheEntries(size_t entries);
+		/**
+		 * @brief Seconds a cached descriptor is trusted before its path is stat()ed again.
+		 */
+		void setOpenFileCacheValid(size_t seconds);
+		/**
+		 * @brief Seconds without a hit after which a cached descriptor is closed.
+		 */
+		void setOpenFileCacheInactive(size_t seconds);
+		/**
+		 * @brief Largest file compressed on the fly out of a shared mmap() rather than pread() slices; 0 is off.
+		 */
+		void setFileMapMaxSize(size_t bytes);
+		/**
+		 * @brief Seconds a client may take between two reads while its request headers are incomplete.
+		 */
+		void setClientHeaderTimeout(size_t seconds);
+		/**
+		 * @brief Seconds a client may take between two reads of its request body.
+		 */
+		void setClientBodyTimeout(size_t seconds);
+		/**
+		 * @brief Seconds a client may leave the response unread before the connection is closed.
+		 */
+		void setSendTimeout(size_t seconds);
 
 		/**
 		 * @brief Adds a parsed LocationConf block to this server.
@@ -80,4 +157,16 @@ class ServerConf
 		size_t								_maxBodySize;
 		std::vector<LocationConf>			_locations;
 		std::map<std::string, std::string>	_errorPages;
+		size_t								_keepAliveTimeout;
+		size_t								_keepAliveRequests;
+		size_t								_fileCacheEntries;
+		size_t								_fileCacheMaxSize;
+		size_t								_fileCacheValid;
+		size_t								_openFileCacheEntries;
+		size_t								_openFileCacheValid;
+		size_t								_openFileCacheInactive;
+		size_t								_fileMapMaxSize;
+		size_t								_clientHeaderTimeout;
+		size_t								_clientBodyTimeout;
+		size_t								_sendTimeout;
 };
\ No newline at end of file
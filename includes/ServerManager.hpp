@@ -16,11 +16,12 @@
 #include <sys/epoll.h>
 #include "ServerConf.hpp"
 #include "Connection.hpp"
+#include "TimerWheel.hpp"
+#include "ConnectionPool.hpp"
 
 #define BACKLOG 128
 #define RECV_BUFFER_SIZE 4096// keep this smaller than read buffer size in Connection.!
 #define EPOLL_TIMEOUT_MS 2500
-#define CONNECTION_TIMEOUT_S 60
 #define CGI_TIMEOUT_S 10
 
 /**
@@ -37,11 +38,46 @@ struct SockAddrCompare
 	}
 };
 
+/**
+ * @enum FdKind
+ * @brief What an fd registered with epoll stands for, so an event is dispatched without a lookup.
+ */
+enum FdKind
+{
+	FD_NONE,		// unused slot
+	FD_LISTEN,		// listening socket; conf is the server block it accepts for
+	FD_CLIENT,		// accepted client socket; conn owns it
+	FD_CGI_PIPE,	// CGI stdout pipe or FastCGI backend socket; conn is the connection waiting on it
+	FD_CGI_INPUT,	// CGI stdin pipe; conn is the connection whose request body feeds it
+	FD_CGI_CHILD,	// pidfd of a CGI script, readable once it exits; owned by CGIManager, conn unused
+};
+
+/**
+ * @struct FdSlot
+ * @brief One entry of the fd-indexed table: fds are small dense integers, so a vector
+ * indexed by fd gives O(1), cache-friendly dispatch where per-kind std::maps needed several tree walks.
+ */
+struct FdSlot
+{
+	FdKind				kind;
+	bool				registered;	// added to the epoll set
+	uint32_t			events;		// mask last given to epoll_ctl()
+	Connection*			conn;
+	const ServerConf*	conf;
+
+	FdSlot() : kind(FD_NONE), registered(false), events(0), conn(NULL), conf(NULL) {}
+};
+
 class ServerManager {
 public:
 	// Canonical Form
 	ServerManager();
 	ServerManager(std::vector<ServerConf> confs);// this will be the main constructer to use once we have parsing up and ready!
+	/**
+	 * @brief Same as above, but with reusePort every listening socket gets SO_REUSEPORT so
+	 * that several worker processes can bind the same address (see WorkerMaster).
+	 */
+	ServerManager(std::vector<ServerConf> confs, bool reusePort);
 	ServerManager(const ServerManager& other);
 	ServerManager& operator=(const ServerManager& other);
 	~ServerManager();
@@ -60,6 +96,19 @@ public:
 	 */
 	void addListenPort(int port);
 
+	/**
+	 * @brief Switches client sockets to edge-triggered epoll (EPOLLET). Each client is then
+	 * registered once for EPOLLIN | EPOLLOUT and every wakeup drains the socket until EAGAIN,
+	 * so no epoll_ctl() is issued on state changes. Must be called before run().
+	 */
+	void setEdgeTriggered(bool edgeTriggered);
+
+	/**
+	 * @brief Keeps up to poolSize closed connections for reuse by later accept()s, and pre-allocates
+	 * them. 0 (the default) allocates and frees one Connection per client. Must be called before run().
+	 */
+	void setConnectionPoolSize(size_t poolSize);
+
 	/**
 	 * @brief Enters the main epoll() event loop. Blocks until g_running becomes false.
 	 */
@@ -87,21 +136,36 @@ private:
 	// Round-robin processing scheduler
 	std::deque<Connection*>		_processingQueue;
 	std::set<Connection*>		_processingSet;
-	//connection to fd mapping on epoll events.
-	std::map<int, Connection*>	_connections;
-	// CGI pipe fd -> owning Connection
-	std::map<int, Connection*>	_cgiPipeToConn;
-	std::map<int, time_t>		_cgiStartTimes;
+	// per-state client deadlines and CGI timeouts, keyed by fd
+	TimerWheel					_timers;
+	// recycled Connection objects handed out on accept()
+	ConnectionPool				_pool;
 	// Event loop state
 	int									_epollFd;
 	std::vector<struct epoll_event>		_eventBuffer;
-	std::map<int, uint32_t>				_fdEvents;
-	std::set<int>						_listenFds;
-	std::map<int, const ServerConf*>		_listenFdToServerConf;
+	std::vector<FdSlot>					_slots;			// indexed by fd
+	bool								_reusePort;
+	bool								_edgeTriggered;
 
 	// Private helpers
 	/**
-	 * @brief Creates, binds, listens, and sets O_NONBLOCK on a socket.
+	 * @brief Shared constructor body: creates the epoll instance and one listener per conf.
+	 */
+	void _init(const std::vector<ServerConf>& confs);
+
+	/**
+	 * @brief Slot for an fd, growing the table when needed.
+	 */
+	FdSlot& _slot(int fd);
+
+	/**
+	 * @brief Copy helper: registers the other manager's listening fds in this epoll set.
+	 * Client connections are never shared between managers.
+	 */
+	void _copyListeners(const ServerManager& other);
+
+	/**
+	 * @brief Creates, binds, listens, and sets O_NONBLOCK on a socket (plus SO_REUSEPORT in worker mode).
 	 * @return The listening fd.
 	 * @throws FatalException if any socket operation fails, with the error message.
 	 */
@@ -125,6 +189,27 @@ private:
 	 */
 	void _handleConnection(Connection* conn, uint32_t events);
 
+	/**
+	 * @brief One read/write pass for a connection, turning exceptions into error responses.
+	 */
+	void _dispatchIo(Connection* conn, uint32_t events);
+
+	/**
+	 * @brief addPollFd() for a client fd in level-triggered mode; a no-op when edge-triggered.
+	 */
+	void _setInterest(int fd, uint32_t events);
+
+	/**
+	 * @brief Called when a connection enters WRITING outside of its own I/O event:
+	 * arms EPOLLOUT (level-triggered) or starts sending right away (edge-triggered).
+	 */
+	void _resumeWriting(Connection* conn);
+
+	/**
+	 * @brief Counterpart of _resumeWriting() for a client whose reads were paused (a stalled CGI upload).
+	 */
+	void _resumeReading(Connection* conn);
+
 	/**
 	 * @brief Runs a budgeted round-robin pass over _processingQueue.
 	 * Calls process() once per connection, re-enqueues if still PROCESSING,
@@ -134,7 +219,7 @@ private:
 	void _runRoundRobin();
 
 	/**
-	 * @brief Closes a client fd and removes it from epoll and _connections.
+	 * @brief Closes a client fd and removes it from epoll and the slot table.
 	 */
 	void _dropConnection(int fd);
 
@@ -154,9 +239,25 @@ private:
 	void _finalizeProcessed(Connection* conn);
 
 	/**
-	 * @brief Scans all connections and drops any that have been idle too long.
+	 * @brief Fires every timer due by now (client and CGI timeouts) and runs the periodic cache sweep.
+	 */
+	void _expireTimers();
+
+	/**
+	 * @brief Timeout of a client in its current state: idle keep-alive and stalled writers are closed,
+	 * anything else gets a 408. Re-arms instead if the connection saw activity since it was armed.
+	 */
+	void _expireConnection(Connection* conn, time_t now);
+
+	/**
+	 * @brief (Re)arms a client's timer from its state-dependent deadline. Call on every state change.
 	 */
-	void _sweepTimeouts();
+	void _armTimer(Connection* conn);
+
+	/**
+	 * @brief epoll_wait() timeout: 0 with queued work, else until the next timer (capped at EPOLL_TIMEOUT_MS).
+	 */
+	int _epollTimeout() const;
 
 	/**
 	 * @brief Registers a CGI pipe fd in epoll and maps it to its Connection.
@@ -169,14 +270,63 @@ private:
 	void _unregisterCgiPipe(int pipeFd);
 
 	/**
-	 * @brief Handles an epoll event on a CGI pipe fd.
+	 * @brief Handles an epoll event on a CGI pipe fd. The client starts writing as soon as the
+	 * CGI header block is in, and is woken again for every later read.
 	 */
 	void _handleCgiPipeEvent(int pipeFd, uint32_t events);
 
 	/**
-	 * @brief Sweeps CGI processes for timeout.
+	 * @brief Backpressure: takes the CGI pipe out of epoll while the relay buffer is full,
+	 * and puts it back once the client has drained it. A FastCGI socket also keeps EPOLLOUT
+	 * while request records are queued.
+	 */
+	void _syncCgiPipe(Connection* conn);
+
+	/**
+	 * @brief Handles EPOLLOUT on a CGI stdin pipe: writes queued body bytes, and resumes reading
+	 * the client once the queue is below CGI_STDIN_HIGH_WATER again.
+	 */
+	void _handleCgiInputEvent(int inputFd, uint32_t events);
+
+	/**
+	 * @brief Keeps a CGI stdin pipe in epoll only while body bytes wait for it, and closes it once the
+	 * whole body went through (or the script stopped reading). Also registers the stdout pipe as soon as
+	 * the upload starts, since a script may answer before it has read everything.
+	 */
+	void _syncCgiInput(Connection* conn);
+
+	/**
+	 * @brief Takes a CGI stdin pipe out of epoll and closes it. Must run before the CGI is torn down.
+	 */
+	void _closeCgiInput(Connection* conn);
+
+	/**
+	 * @brief Restarts the CGI timeout on the stdout pipe: a script making progress on its stdin isn't idle.
+	 */
+	void _touchCgiTimer(Connection* conn);
+
+	/**
+	 * @brief When the running script times out if it stays quiet: CGI_TIMEOUT_S from now,
+	 * or the location's cgi_pool_timeout for a pooled worker.
+	 */
+	time_t _cgiDeadline(Connection* conn) const;
+
+	/**
+	 * @brief A script's pidfd turned readable: reaps it through CGIManager, whose instance
+	 * (if the connection still holds it) sees the exit from then on.
+	 */
+	void _handleCgiExit(int pidFd);
+
+	/**
+	 * @brief Adds the running script's pidfd to epoll, once. Done with its pipe, and again when
+	 * the connection is dropped first, so the exit of a script nobody reads from is still reaped.
+	 */
+	void _watchCgiChild(Connection* conn);
+
+	/**
+	 * @brief The CGI timeout passed without output on a pipe: answers 504 (or cuts a streamed body short) and resumes the client.
 	 */
-	void _sweepCgiTimeouts();
+	void _expireCgi(int pipeFd);
 
 	/**
 	 * need to rename this.
@@ -0,0 +1,69 @@
+/**
+ * @file TimerWheel.hpp
+ * @brief Hashed timing wheel of per-fd deadlines, one second per slot.
+ * Replaces periodic full scans of every connection: arming, re-arming and cancelling are O(1)
+ * (an unlink/link in an intrusive list indexed by fd), and expiry only visits the slots of the
+ * seconds that actually elapsed. A deadline further out than one turn of the wheel simply stays
+ * in its slot until its round comes up.
+ */
+#pragma once
+
+#include <vector>
+#include <ctime>
+#include <cstddef>
+
+#define TIMER_WHEEL_SLOTS 256
+
+class TimerWheel
+{
+	public:
+		// Canonical Form
+		TimerWheel();
+		explicit TimerWheel(size_t slots);
+		TimerWheel(const TimerWheel& other);
+		TimerWheel& operator=(const TimerWheel& other);
+		~TimerWheel();
+
+		/**
+		 * @brief Sets (or moves) the deadline of an fd. Deadlines already in the past fire on the next expire().
+		 */
+		void arm(int fd, time_t deadline);
+
+		/**
+		 * @brief Removes the fd's timer, if any. Must be called before the fd number is reused.
+		 */
+		void cancel(int fd);
+
+		bool	isArmed(int fd) const;
+		time_t	deadlineOf(int fd) const;	// 0 when not armed
+		size_t	size() const;
+
+		/**
+		 * @brief Disarms and collects every fd whose deadline is <= now.
+		 */
+		void expire(time_t now, std::vector<int>& expired);
+
+		/**
+		 * @brief Earliest deadline within one turn of the wheel from now, or 0 if there is none.
+		 * Bounded by the slot count, so it is cheap enough to run before every epoll_wait().
+		 */
+		time_t nextDeadline(time_t now) const;
+
+	private:
+		struct Node
+		{
+			time_t	deadline;
+			size_t	slot;		// where it is filed; differs from the deadline's slot once clamped
+			int		prev;		// -1 = head of its slot
+			int		next;		// -1 = tail
+			bool	armed;
+		};
+
+		std::vector<Node>	_nodes;		// indexed by fd
+		std::vector<int>	_heads;		// first fd of each slot, -1 if empty
+		time_t				_cursor;	// last second expire() has processed; 0 before the first call
+		size_t				_count;
+
+		size_t	_slotOf(time_t deadline) const;
+		void	_unlink(int fd);
+};
@@ -0,0 +1,80 @@
+/**
+ * @file WorkerMaster.hpp
+ * @brief Master process of the multi-process model (worker_processes > 1).
+ * Forks one worker per slot; each worker runs its own ServerManager event loop on its own
+ * SO_REUSEPORT listening sockets, so the kernel spreads incoming connections across them.
+ * The master only supervises: it respawns crashed workers, with a growing delay while they keep
+ * crashing, and forwards shutdown signals.
+ */
+#pragma once
+
+#include <vector>
+#include <sys/types.h>
+#include "ServerConf.hpp"
+
+// a worker failing faster than this is treated as a startup error (bad bind, ...), not a crash.
+#define WORKER_MIN_UPTIME_S 1
+#define WORKER_SHUTDOWN_GRACE_S 5
+// a worker that lived this long is healthy again: its slot's crash count starts over.
+#define WORKER_STABLE_UPTIME_S 10
+// respawn delay doubles with each quick crash of a slot, from 1 s up to this.
+#define WORKER_RESPAWN_MAX_DELAY_S 30
+// quick crashes in a row of one slot after which the master gives up and shuts down.
+#define WORKER_MAX_CRASHES 8
+#define WORKER_RESPAWN_POLL_US 100000
+
+class WorkerMaster
+{
+	public:
+		WorkerMaster(const std::vector<ServerConf>& confs, size_t workerCount, bool edgeTriggered,
+					 size_t connectionPoolSize);
+		~WorkerMaster();
+
+		/**
+		 * @brief Forks the workers and supervises them until g_running becomes false,
+		 * then sends SIGTERM to every worker and reaps them (SIGKILL after WORKER_SHUTDOWN_GRACE_S).
+		 * @return the process exit status: 0 on a clean shutdown, 1 if workers could not start.
+		 */
+		int run();
+
+	private:
+		std::vector<ServerConf>	_confs;
+		std::vector<pid_t>		_workers;		// one pid per slot, -1 when the slot is empty
+		std::vector<time_t>		_startedAt;
+		std::vector<size_t>		_crashes;		// quick crashes in a row, per slot
+		std::vector<time_t>		_respawnAt;		// when an empty slot is refilled, 0 if it isn't due to be
+		bool					_edgeTriggered;
+		size_t					_connectionPoolSize;
+
+		/**
+		 * @brief Forks the worker for a slot. The child never returns from this call.
+		 */
+		void	_spawn(size_t slot);
+
+		/**
+		 * @brief Schedules the respawn of a slot whose worker died after uptime seconds.
+		 * @return false once the slot crashed WORKER_MAX_CRASHES times in a row.
+		 */
+		bool	_scheduleRespawn(size_t slot, pid_t pid, int status, time_t uptime);
+
+		/**
+		 * @brief Refills the slots whose respawn delay has passed.
+		 * @return true while some slot is still waiting for its respawn.
+		 */
+		bool	_respawnDue();
+
+		/**
+		 * @brief Child side: builds a ServerManager with reuse-port listeners and runs it to completion.
+		 */
+		void	_runWorker();
+
+		/**
+		 * @brief Maps a reaped pid back to its slot, or -1 if it is not one of ours.
+		 */
+		int		_slotOf(pid_t pid) const;
+		void	_stopAll();
+
+		// Non-copyable: the child pids belong to exactly one master.
+		WorkerMaster(const WorkerMaster&);
+		WorkerMaster& operator=(const WorkerMaster&);
+};
@@ -0,0 +1,98 @@
+#include "../includes/Arena.hpp"
+#include <cstring>
+
+// Canonical Form
+
+Arena::Arena()
+	: _blocks(), _blockSize(ARENA_BLOCK_SIZE), _current(0), _offset(0), _used(0) {}
+
+Arena::Arena(size_t blockSize)
+	: _blocks(), _blockSize(blockSize ? blockSize : 1), _current(0), _offset(0), _used(0) {}
+
+Arena::~Arena()
+{
+	for (size_t i = 0; i < _blocks.size(); ++i)
+		delete[] _blocks[i].data;
+}
+
+// Behavior
+
+char* Arena::allocate(size_t n)
+{
+	if (_blocks.empty() || _offset + n > _blocks[_current].size)
+		_nextBlock(n);
+	char* p = _blocks[_current].data + _offset;
+	_offset += n;
+	_used += n;
+	return p;
+}
+
+char* Arena::copy(const char* src, size_t n)
+{
+	char* p = allocate(n);
+	if (n)
+		std::memcpy(p, src, n);
+	return p;
+}
+
+void Arena::reset()
+{
+	_current = 0;
+	_offset = 0;
+	_used = 0;
+}
+
+void Arena::release()
+{
+	for (size_t i = 1; i < _blocks.size(); ++i)
+		delete[] _blocks[i].data;
+	if (_blocks.size() > 1)
+		_blocks.resize(1);
+	// an oversized first block (one huge header) is not worth keeping either.
+	if (!_blocks.empty() && _blocks[0].size > _blockSize)
+	{
+		delete[] _blocks[0].data;
+		_blocks.clear();
+	}
+	reset();
+}
+
+size_t Arena::used() const
+{
+	return _used;
+}
+
+size_t Arena::capacity() const
+{
+	size_t total = 0;
+	for (size_t i = 0; i < _blocks.size(); ++i)
+		total += _blocks[i].size;
+	return total;
+}
+
+size_t Arena::blockCount() const
+{
+	return _blocks.size();
+}
+
+// Private Helpers
+
+void Arena::_nextBlock(size_t n)
+{
+	size_t next = _blocks.empty() ? 0 : _current + 1;
+	// blocks kept from earlier requests are reused in order; one too small for n is replaced.
+	if (next < _blocks.size() && _blocks[next].size < n)
+	{
+		delete[] _blocks[next].data;
+		_blocks.erase(_blocks.begin() + next);
+	}
+	if (next >= _blocks.size() || _blocks[next].size < n)
+	{
+		Block block;
+		block.size = n > _blockSize ? n : _blockSize;
+		block.data = new char[block.size];
+		_blocks.insert(_blocks.begin() + next, block);
+	}
+	_current = next;
+	_offset = 0;
+}
@@ -0,0 +1,455 @@
+#include "../includes/ByteScan.hpp"
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__) && defined(__GNUC__)
+# define BYTE_SCAN_X86 1
+# include <immintrin.h>
+#endif
+
+namespace
+{
+	// one bit per byte of a block of up to LINE_BLOCK bytes, bit i <=> p[i].
+	const size_t LINE_BLOCK = 32;
+
+	struct Masks
+	{
+		unsigned	crlf;		// '\r' followed by '\n'
+		unsigned	colon;
+		unsigned	control;
+	};
+
+	struct Kernels
+	{
+		const char*	name;
+		const char*	(*findByte)(const char*, const char*, char);
+		const char*	(*findCrlf)(const char*, const char*);
+		const char*	(*findHeaderEnd)(const char*, const char*);
+		const char*	(*findControl)(const char*, const char*);
+		void		(*splitLines)(const char*, const char*, std::vector<byte_scan::Line>&);
+	};
+
+	const size_t NO_COLON = static_cast<size_t>(-1);
+
+	// line splitting state carried from one block to the next.
+	struct LineWalk
+	{
+		size_t	lineStart;
+		size_t	colon;
+		bool	control;
+	};
+
+	// bits [from, to) of a block mask; to <= LINE_BLOCK.
+	inline unsigned rangeMask(size_t from, size_t to)
+	{
+		return static_cast<unsigned>(((1ULL << to) - 1) & ~((1ULL << from) - 1));
+	}
+
+	// consumes the masks of the width-byte block at off, emitting every line whose CRLF is in it.
+	inline void walkBlock(const Masks& m, size_t off, size_t width, LineWalk& w,
+						  std::vector<byte_scan::Line>& lines)
+	{
+		unsigned crlf = m.crlf;
+		// the common block: mid-line, colon already found, nothing but printable bytes.
+		unsigned control = m.control & ~(crlf | crlf << 1);
+		if (!crlf && !control && (w.colon != NO_COLON || !m.colon))
+			return;
+		for (;;)
+		{
+			// the current line's bytes in this block: from its start (or the block's) up to the CR.
+			size_t from = w.lineStart > off ? w.lineStart - off : 0;
+			size_t to = crlf ? static_cast<size_t>(__builtin_ctz(crlf)) : width;
+			if (from < to)
+			{
+				unsigned range = rangeMask(from, to);
+				if (w.colon == NO_COLON && (m.colon & range))
+					w.colon = off + __builtin_ctz(m.colon & range);
+				if (control & range)
+					w.control = true;
+			}
+			if (!crlf)
+				return;
+			byte_scan::Line line = { w.lineStart, off + to, w.colon == NO_COLON ? off + to : w.colon, w.control };
+			lines.push_back(line);
+			w.lineStart = off + to + 2;
+			w.colon = NO_COLON;
+			w.control = false;
+			crlf &= crlf - 1;
+		}
+	}
+
+	// the last line has no CRLF of its own: it ends with the range.
+	inline void finishLines(size_t n, const LineWalk& w, std::vector<byte_scan::Line>& lines)
+	{
+		if (w.lineStart < n)
+		{
+			byte_scan::Line last = { w.lineStart, n, w.colon == NO_COLON ? n : w.colon, w.control };
+			lines.push_back(last);
+		}
+	}
+
+	inline bool isControl(unsigned char c)
+	{
+		return (c < 0x20 && c != '\t') || c == 0x7f;
+	}
+
+	// --- Scalar: memchr (itself vectorised by most libcs) for the anchor byte, then a compare ---
+
+	const char* scalarByte(const char* p, const char* end, char c)
+	{
+		const void* hit = p < end ? std::memchr(p, c, end - p) : NULL;
+		return hit ? static_cast<const char*>(hit) : end;
+	}
+
+	const char* scalarCrlf(const char* p, const char* end)
+	{
+		while ((p = scalarByte(p, end, '\r')) < end)
+		{
+			if (p + 1 < end && p[1] == '\n')
+				return p;
+			++p;
+		}
+		return end;
+	}
+
+	const char* scalarHeaderEnd(const char* p, const char* end)
+	{
+		while ((p = scalarByte(p, end, '\r')) < end)
+		{
+			if (end - p >= 4 && p[1] == '\n' && p[2] == '\r' && p[3] == '\n')
+				return p;
+			++p;
+		}
+		return end;
+	}
+
+	const char* scalarControl(const char* p, const char* end)
+	{
+		for (; p < end; ++p)
+		{
+			if (isControl(static_cast<unsigned char>(*p)))
+				return p;
+		}
+		return end;
+	}
+
+	// also the tail of the vector versions: looks at most LINE_BLOCK bytes (+1 for a trailing '\n').
+	inline void scalarLineMasks(const char* p, const char* end, Masks& m)
+	{
+		size_t n = static_cast<size_t>(end - p) < LINE_BLOCK ? end - p : LINE_BLOCK;
+		m.crlf = 0;
+		m.colon = 0;
+		m.control = 0;
+		for (size_t i = 0; i < n; ++i)
+		{
+			unsigned char c = static_cast<unsigned char>(p[i]);
+			if (c == ':')
+				m.colon |= 1u << i;
+			else if (isControl(c))
+			{
+				m.control |= 1u << i;
+				if (c == '\r' && p + i + 1 < end && p[i + 1] == '\n')
+					m.crlf |= 1u << i;
+			}
+		}
+	}
+
+	// without vectors, a memchr per line and delimiter beats building masks byte by byte.
+	void scalarSplitLines(const char* p, const char* end, std::vector<byte_scan::Line>& lines)
+	{
+		for (const char* line = p; line < end; )
+		{
+			const char* lineEnd = scalarCrlf(line, end);
+			byte_scan::Line l = { static_cast<size_t>(line - p), static_cast<size_t>(lineEnd - p),
+								  static_cast<size_t>(scalarByte(line, lineEnd, ':') - p),
+								  scalarControl(line, lineEnd) != lineEnd };
+			lines.push_back(l);
+			line = lineEnd + 2;
+		}
+	}
+
+	const Kernels kScalar = { "scalar", scalarByte, scalarCrlf, scalarHeaderEnd, scalarControl, scalarSplitLines };
+
+#ifdef BYTE_SCAN_X86
+
+	// --- SSE2: 16 bytes per step, one movemask bit per byte ---
+
+	inline unsigned sse2Eq(const char* p, __m128i needle)
+	{
+		__m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+		return static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, needle)));
+	}
+
+	const char* sse2Byte(const char* p, const char* end, char c)
+	{
+		const __m128i needle = _mm_set1_epi8(c);
+		for (; end - p >= 16; p += 16)
+		{
+			unsigned mask = sse2Eq(p, needle);
+			if (mask)
+				return p + __builtin_ctz(mask);
+		}
+		return scalarByte(p, end, c);
+	}
+
+	const char* sse2Crlf(const char* p, const char* end)
+	{
+		const __m128i cr = _mm_set1_epi8('\r');
+		const __m128i lf = _mm_set1_epi8('\n');
+		// the '\n' load is one byte ahead, so it needs 17 readable bytes.
+		for (; end - p >= 17; p += 16)
+		{
+			unsigned mask = sse2Eq(p, cr);
+			if (mask && (mask &= sse2Eq(p + 1, lf)))
+				return p + __builtin_ctz(mask);
+		}
+		return scalarCrlf(p, end);
+	}
+
+	const char* sse2HeaderEnd(const char* p, const char* end)
+	{
+		const __m128i cr = _mm_set1_epi8('\r');
+		const __m128i lf = _mm_set1_epi8('\n');
+		for (; end - p >= 19; p += 16)
+		{
+			// most blocks hold at most one '\r': the other three loads are rarely needed.
+			unsigned mask = sse2Eq(p, cr);
+			if (mask && (mask &= sse2Eq(p + 1, lf) & sse2Eq(p + 2, cr) & sse2Eq(p + 3, lf)))
+				return p + __builtin_ctz(mask);
+		}
+		return scalarHeaderEnd(p, end);
+	}
+
+	const char* sse2Control(const char* p, const char* end)
+	{
+		const __m128i below = _mm_set1_epi8(0x1f);
+		const __m128i tab = _mm_set1_epi8('\t');
+		const __m128i del = _mm_set1_epi8(0x7f);
+		for (; end - p >= 16; p += 16)
+		{
+			__m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+			// unsigned block <= 0x1f  <=>  min(block, 0x1f) == block
+			__m128i ctl = _mm_cmpeq_epi8(_mm_min_epu8(block, below), block);
+			ctl = _mm_andnot_si128(_mm_cmpeq_epi8(block, tab), ctl);
+			ctl = _mm_or_si128(ctl, _mm_cmpeq_epi8(block, del));
+			unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(ctl));
+			if (mask)
+				return p + __builtin_ctz(mask);
+		}
+		return scalarControl(p, end);
+	}
+
+	inline unsigned sse2ControlMask(__m128i block)
+	{
+		__m128i ctl = _mm_cmpeq_epi8(_mm_min_epu8(block, _mm_set1_epi8(0x1f)), block);
+		ctl = _mm_andnot_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8('\t')), ctl);
+		ctl = _mm_or_si128(ctl, _mm_cmpeq_epi8(block, _mm_set1_epi8(0x7f)));
+		return static_cast<unsigned>(_mm_movemask_epi8(ctl));
+	}
+
+	inline void sse2LineMasks(const char* p, const char* end, Masks& m)
+	{
+		if (end - p <= static_cast<long>(LINE_BLOCK))
+			return scalarLineMasks(p, end, m);
+		m.crlf = 0;
+		m.colon = 0;
+		m.control = 0;
+		for (int half = 0; half < 2; ++half)
+		{
+			const char* q = p + 16 * half;
+			__m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(q));
+			unsigned crlf = sse2Eq(q, _mm_set1_epi8('\r'));
+			if (crlf)
+				crlf &= sse2Eq(q + 1, _mm_set1_epi8('\n'));
+			m.crlf |= crlf << (16 * half);
+			m.colon |= static_cast<unsigned>(_mm_movemask_epi8(
+				_mm_cmpeq_epi8(block, _mm_set1_epi8(':')))) << (16 * half);
+			m.control |= sse2ControlMask(block) << (16 * half);
+		}
+	}
+
+	void sse2SplitLines(const char* p, const char* end, std::vector<byte_scan::Line>& lines)
+	{
+		const size_t n = end - p;
+		LineWalk w = { 0, NO_COLON, false };
+		for (size_t off = 0; off < n; off += LINE_BLOCK)
+		{
+			Masks m;
+			sse2LineMasks(p + off, end, m);
+			walkBlock(m, off, n - off < LINE_BLOCK ? n - off : LINE_BLOCK, w, lines);
+		}
+		finishLines(n, w, lines);
+	}
+
+	const Kernels kSse2 = { "sse2", sse2Byte, sse2Crlf, sse2HeaderEnd, sse2Control, sse2SplitLines };
+
+	// --- AVX2: same kernels, 32 bytes per step; compiled for AVX2 only inside these functions ---
+
+	__attribute__((target("avx2")))
+	inline unsigned avx2Eq(const char* p, __m256i needle)
+	{
+		__m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+		return static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, needle)));
+	}
+
+	__attribute__((target("avx2")))
+	const char* avx2Byte(const char* p, const char* end, char c)
+	{
+		const __m256i needle = _mm256_set1_epi8(c);
+		for (; end - p >= 32; p += 32)
+		{
+			unsigned mask = avx2Eq(p, needle);
+			if (mask)
+				return p + __builtin_ctz(mask);
+		}
+		return sse2Byte(p, end, c);
+	}
+
+	__attribute__((target("avx2")))
+	const char* avx2Crlf(const char* p, const char* end)
+	{
+		const __m256i cr = _mm256_set1_epi8('\r');
+		const __m256i lf = _mm256_set1_epi8('\n');
+		for (; end - p >= 33; p += 32)
+		{
+			unsigned mask = avx2Eq(p, cr);
+			if (mask && (mask &= avx2Eq(p + 1, lf)))
+				return p + __builtin_ctz(mask);
+		}
+		return sse2Crlf(p, end);
+	}
+
+	__attribute__((target("avx2")))
+	const char* avx2HeaderEnd(const char* p, const char* end)
+	{
+		const __m256i cr = _mm256_set1_epi8('\r');
+		const __m256i lf = _mm256_set1_epi8('\n');
+		for (; end - p >= 35; p += 32)
+		{
+			unsigned mask = avx2Eq(p, cr);
+			if (mask && (mask &= avx2Eq(p + 1, lf) & avx2Eq(p + 2, cr) & avx2Eq(p + 3, lf)))
+				return p + __builtin_ctz(mask);
+		}
+		return sse2HeaderEnd(p, end);
+	}
+
+	__attribute__((target("avx2")))
+	const char* avx2Control(const char* p, const char* end)
+	{
+		const __m256i below = _mm256_set1_epi8(0x1f);
+		const __m256i tab = _mm256_set1_epi8('\t');
+		const __m256i del = _mm256_set1_epi8(0x7f);
+		for (; end - p >= 32; p += 32)
+		{
+			__m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+			__m256i ctl = _mm256_cmpeq_epi8(_mm256_min_epu8(block, below), block);
+			ctl = _mm256_andnot_si256(_mm256_cmpeq_epi8(block, tab), ctl);
+			ctl = _mm256_or_si256(ctl, _mm256_cmpeq_epi8(block, del));
+			unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(ctl));
+			if (mask)
+				return p + __builtin_ctz(mask);
+		}
+		return sse2Control(p, end);
+	}
+
+	__attribute__((target("avx2")))
+	inline void avx2LineMasks(const char* p, const char* end, Masks& m)
+	{
+		if (end - p <= static_cast<long>(LINE_BLOCK))
+			return scalarLineMasks(p, end, m);
+		__m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+		m.crlf = avx2Eq(p, _mm256_set1_epi8('\r'));
+		if (m.crlf)
+			m.crlf &= avx2Eq(p + 1, _mm256_set1_epi8('\n'));
+		m.colon = static_cast<unsigned>(_mm256_movemask_epi8(
+			_mm256_cmpeq_epi8(block, _mm256_set1_epi8(':'))));
+		__m256i ctl = _mm256_cmpeq_epi8(_mm256_min_epu8(block, _mm256_set1_epi8(0x1f)), block);
+		ctl = _mm256_andnot_si256(_mm256_cmpeq_epi8(block, _mm256_set1_epi8('\t')), ctl);
+		ctl = _mm256_or_si256(ctl, _mm256_cmpeq_epi8(block, _mm256_set1_epi8(0x7f)));
+		m.control = static_cast<unsigned>(_mm256_movemask_epi8(ctl));
+	}
+
+	__attribute__((target("avx2")))
+	void avx2SplitLines(const char* p, const char* end, std::vector<byte_scan::Line>& lines)
+	{
+		const size_t n = end - p;
+		LineWalk w = { 0, NO_COLON, false };
+		for (size_t off = 0; off < n; off += LINE_BLOCK)
+		{
+			Masks m;
+			avx2LineMasks(p + off, end, m);
+			walkBlock(m, off, n - off < LINE_BLOCK ? n - off : LINE_BLOCK, w, lines);
+		}
+		finishLines(n, w, lines);
+	}
+
+	const Kernels kAvx2 = { "avx2", avx2Byte, avx2Crlf, avx2HeaderEnd, avx2Control, avx2SplitLines };
+
+	bool cpuHasAvx2()
+	{
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2");
+	}
+
+#endif // BYTE_SCAN_X86
+
+	const Kernels* detect()
+	{
+#ifdef BYTE_SCAN_X86
+		return cpuHasAvx2() ? &kAvx2 : &kSse2;
+#else
+		return &kScalar;
+#endif
+	}
+
+	// picked during static initialisation (nothing parses before main()), so calls need no guard.
+	const Kernels* g_kernels = detect();
+}
+
+namespace byte_scan
+{
+	const char* findByte(const char* p, const char* end, char c)
+	{
+		return g_kernels->findByte(p, end, c);
+	}
+
+	const char* findCrlf(const char* p, const char* end)
+	{
+		return g_kernels->findCrlf(p, end);
+	}
+
+	const char* findHeaderEnd(const char* p, const char* end)
+	{
+		return g_kernels->findHeaderEnd(p, end);
+	}
+
+	const char* findControl(const char* p, const char* end)
+	{
+		return g_kernels->findControl(p, end);
+	}
+
+	void splitLines(const char* p, const char* end, std::vector<Line>& lines)
+	{
+		lines.clear();
+		g_kernels->splitLines(p, end, lines);
+	}
+
+	const char* implementation()
+	{
+		return g_kernels->name;
+	}
+
+	bool useImplementation(const std::string& name)
+	{
+		if (name == kScalar.name)
+			g_kernels = &kScalar;
+#ifdef BYTE_SCAN_X86
+		else if (name == kSse2.name)
+			g_kernels = &kSse2;
+		else if (name == kAvx2.name && cpuHasAvx2())
+			g_kernels = &kAvx2;
+#endif
+		else
+			return false;
+		return true;
+	}
+}
@@ -7,21 +7,40 @@
 #include <csignal>
 #include <ctime>
 #include <cerrno>
+#include <fcntl.h>
+#include <spawn.h>
+#include <cstring>
+#include <poll.h>
+#include <sys/syscall.h>
 
 
 //There's a zombie on your lawn...
-std::set<pid_t> CGIManager::_activePids;
+std::map<int, CGIManager::Child> CGIManager::_children;
 #ifndef MAX_ACTIVE_CGI_CHILDREN
-# define MAX_ACTIVE_CGI_CHILDREN  64;
+# define MAX_ACTIVE_CGI_CHILDREN  64
 #endif
 
 namespace cgi_utils
 {
-    void closeInheritedFds()
+    // a pidfd names one process for good: unlike a pid, it can't be recycled under us.
+    int pidfdOpen(pid_t pid)
     {
-        // 3 to skip the standard fds.(in,out,err)
-        for (int fd = 3; fd < 1024; ++fd)
-            close(fd);
+        return static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+    }
+
+    void pidfdSignal(int pidFd, int sig)
+    {
+        syscall(SYS_pidfd_send_signal, pidFd, sig, NULL, 0);
+    }
+
+    // true once the child is gone: reaped now, or earlier (ECHILD).
+    bool pidfdReap(int pidFd, bool block)
+    {
+        siginfo_t info;
+        std::memset(&info, 0, sizeof(info));
+        if (waitid(P_PIDFD, static_cast<id_t>(pidFd), &info, WEXITED | (block ? 0 : WNOHANG)) < 0)
+            return errno != EINTR;
+        return info.si_pid != 0;
     }
 
     std::string resolveScriptDirectory(const std::string& scriptPath)
@@ -45,36 +64,38 @@ namespace cgi_utils
         return scriptPath.substr(slashPos + 1);
     }
 
-    void prepareChildExecutionContext(const std::vector<std::string>& scriptArgv, char** execveArgv)
+    // The script runs from its own directory, so the path handed to execve() becomes relative to it.
+    std::string prepareExecutionContext(const std::vector<std::string>& scriptArgv, char** execveArgv)
     {
         if (scriptArgv.empty())
-            throw FatalException("CGI child fatal: missing script path");
+            throw ClientException(500, "CGIManager::execute: missing script path");
 
         const std::string& scriptPath = scriptArgv.back();
-        std::string scriptDir = resolveScriptDirectory(scriptPath);
-        if (chdir(scriptDir.c_str()) == -1)
-            throw FatalException("CGI child fatal: chdir() failed");
-
         std::string scriptExecArg = resolveScriptExecArg(scriptPath);
         if (scriptArgv.size() > 1)
             std::strcpy(execveArgv[1], scriptExecArg.c_str());
         else
             std::strcpy(execveArgv[0], scriptExecArg.c_str());
+        return resolveScriptDirectory(scriptPath);
     }
 }
 
 // Canonical Form
 
-CGIManager::CGIManager() : _pId(-1), _execveEnvp(NULL), _execveArgv(NULL)
+CGIManager::CGIManager() : _pId(-1), _pidFd(-1), _execveEnvp(NULL), _execveArgv(NULL)
 {
     _outPipe[0] = -1;
     _outPipe[1] = -1;
+    _inPipe[0] = -1;
+    _inPipe[1] = -1;
 }
 
-CGIManager::CGIManager(const CGIManager& other): _pId(other._pId),  _query(other._query),  _scriptArgv(other._scriptArgv),  _env(other._env),  _execveEnvp(NULL),  _execveArgv(NULL)
+CGIManager::CGIManager(const CGIManager& other): _pId(other._pId),  _pidFd(-1),  _query(other._query),  _scriptArgv(other._scriptArgv),  _env(other._env),  _execveEnvp(NULL),  _execveArgv(NULL)
 {
     _outPipe[0] = -1;
     _outPipe[1] = -1;
+    _inPipe[0] = -1;
+    _inPipe[1] = -1;
 }
 
 CGIManager& CGIManager::operator=(const CGIManager& other)
@@ -83,6 +104,7 @@ CGIManager& CGIManager::operator=(const CGIManager& other)
     {
         _freeExecveArrays();
         _closePipes();
+        _forgetOwner();
         _pId        = other._pId;
         _query      = other._query;
         _scriptArgv = other._scriptArgv;
@@ -91,6 +113,8 @@ CGIManager& CGIManager::operator=(const CGIManager& other)
         _execveArgv = NULL;
         _outPipe[0] = -1;
         _outPipe[1] = -1;
+        _inPipe[0] = -1;
+        _inPipe[1] = -1;
     }
     return *this;
 }
@@ -99,6 +123,7 @@ CGIManager::~CGIManager()
 {
     _freeExecveArrays();
     _closePipes();
+    _forgetOwner();
 }
 
 // Getters
@@ -113,6 +138,16 @@ int CGIManager::getOutputFd() const
     return _outPipe[0];
 }
 
+int CGIManager::getInputFd() const
+{
+    return _inPipe[1];
+}
+
+int CGIManager::getPidFd() const
+{
+    return _pidFd;
+}
+
 // Public Behaviour
 
 void CGIManager::prepare(const Request& request, const std::string& scriptPath, const std::string& interpreterOverride)
@@ -132,43 +167,81 @@ void CGIManager::prepare(const Request& request, const std::string& scriptPath,
 
 void CGIManager::execute(int inputFd)
 {
-    if (_isSpawnLimitReached())
-        throw ClientException(503, "CGIManager::execute: max active CGI children reached");
+    _spawn(inputFd);
+}
 
-    if (pipe(_outPipe) == -1)
-        throw ClientException(500, "CGIManager::execute: pipe() failed");
+void CGIManager::executePiped()
+{
+    if (pipe2(_inPipe, O_CLOEXEC) == -1)
+        throw ClientException(500, "CGIManager::executePiped: pipe() failed");
+    // a script that is slow to read must never block the event loop.
+    if (fcntl(_inPipe[1], F_SETFL, O_NONBLOCK) == -1)
+    {
+        _closePipes();
+        throw ClientException(500, "CGIManager::executePiped: fcntl() failed");
+    }
 
-    _pId = fork();
-    if (_pId < 0)
+    try
+    {
+        _spawn(_inPipe[0]);
+    }
+    catch (const ClientException&)
     {
         _closePipes();
-        throw ClientException(500, "CGIManager::execute: fork() failed");
+        throw;
     }
+    close(_inPipe[0]);
+    _inPipe[0] = -1;
+}
 
-    if (_pId == 0)
+void CGIManager::closeInput()
+{
+    if (_inPipe[1] != -1)
     {
-        cgi_utils::prepareChildExecutionContext(_scriptArgv, _execveArgv);
-        if (inputFd >= 0)
-        {
-            if (dup2(inputFd, STDIN_FILENO) == -1)
-                throw FatalException("CGI child fatal: dup2(stdin) failed");
-        }
-        close(_outPipe[0]);
-        if (dup2(_outPipe[1], STDOUT_FILENO) == -1)
-            throw FatalException("CGI child fatal: dup2(stdout) failed");
-        close(_outPipe[1]);
+        close(_inPipe[1]);
+        _inPipe[1] = -1;
+    }
+}
 
-		cgi_utils::closeInheritedFds();
+void CGIManager::_spawn(int inputFd)
+{
+    if (_isSpawnLimitReached())
+        throw ClientException(503, "CGIManager::execute: max active CGI children reached");
 
-        execve(_execveArgv[0], _execveArgv, _execveEnvp);
-        throw FatalException("CGI child fatal: execve() failed");
+    if (pipe2(_outPipe, O_CLOEXEC) == -1)
+        throw ClientException(500, "CGIManager::execute: pipe() failed");
+
+    // posix_spawn() runs the child on the parent's pages until execve() (vfork semantics), so
+    // spawning costs the same however large the server grows. Every fd the server opens is
+    // O_CLOEXEC: the script only inherits the standard fds set up here.
+    std::string scriptDir = cgi_utils::prepareExecutionContext(_scriptArgv, _execveArgv);
+    posix_spawn_file_actions_t actions;
+    if (posix_spawn_file_actions_init(&actions) != 0)
+    {
+        _closePipes();
+        throw ClientException(500, "CGIManager::execute: posix_spawn_file_actions_init() failed");
     }
-    else
+    int err = posix_spawn_file_actions_addchdir_np(&actions, scriptDir.c_str());
+    if (!err && inputFd >= 0)
+        err = posix_spawn_file_actions_adddup2(&actions, inputFd, STDIN_FILENO);
+    if (!err)
+        err = posix_spawn_file_actions_adddup2(&actions, _outPipe[1], STDOUT_FILENO);
+    if (!err)
+        err = posix_spawn(&_pId, _execveArgv[0], &actions, NULL, _execveArgv, _execveEnvp);
+    posix_spawn_file_actions_destroy(&actions);
+
+    close(_outPipe[1]);
+    _outPipe[1] = -1;
+    if (err)
     {
-        _registerPid(_pId);
-        close(_outPipe[1]);
-        _outPipe[1] = -1;
+        _pId = -1;
+        _closePipes();
+        // the interpreter (or script) could not be run: the gateway failed, not the server.
+        if (err == ENOENT || err == EACCES || err == ENOEXEC || err == ENOTDIR)
+            throw ClientException(502, std::string("CGIManager::execute: posix_spawn(): ") + strerror(err));
+        throw ClientException(500, std::string("CGIManager::execute: posix_spawn(): ") + strerror(err));
     }
+    _watchChild();
 }
 
 bool CGIManager::isDone()
@@ -176,45 +249,76 @@ bool CGIManager::isDone()
     if (_pId <= 0)
         return true;
 
+    // a copy shares the pid but not the pidfd.
     int status = 0;
-    pid_t result = waitpid(_pId, &status, WNOHANG);
-    if (result == 0)
+    bool exited = _pidFd >= 0 ? cgi_utils::pidfdReap(_pidFd, false) : waitpid(_pId, &status, WNOHANG) != 0;
+    if (!exited)
         return false; // still running
 
-    // Process has finished - unregister it
-    _unregisterPid(_pId);
+    std::map<int, Child>::iterator it = _children.find(_pidFd);
+    if (it != _children.end())
+        it->second.reaped = true;
     _pId = -1;
     return true;
 }
 
+void CGIManager::reapChild(int pidFd)
+{
+    std::map<int, Child>::iterator it = _children.find(pidFd);
+    if (it == _children.end())
+        return;
+    // readable means exited: this never waits.
+    if (!it->second.reaped)
+        cgi_utils::pidfdReap(pidFd, false);
+    if (it->second.owner)
+    {
+        it->second.owner->_pId = -1;
+        it->second.owner->_pidFd = -1;
+    }
+    close(pidFd);
+    _children.erase(it);
+}
+
+void CGIManager::watchChild(int pidFd)
+{
+    std::map<int, Child>::iterator it = _children.find(pidFd);
+    if (it != _children.end())
+        it->second.watched = true;
+}
+
 // ─── Private Helpers ───────────────────────────────────────────────────────
 
 void CGIManager::_buildEnvMap(const Request& request, const std::string& scriptPath)
 {
-    _env.clear();
+    buildEnvironment(request, scriptPath, _env);
+}
+
+void CGIManager::buildEnvironment(const Request& request, const std::string& scriptPath,
+                                  std::map<std::string, std::string>& env)
+{
+    env.clear();
 
-    _env["REQUEST_METHOD"]  = AllowedMethods::methodToString(request.getMethod());
-    _env["QUERY_STRING"]    = request.getQuery();
-    _env["SCRIPT_FILENAME"] = scriptPath;
-    _env["SCRIPT_NAME"]     = request.getURL();
-    _env["PATH_INFO"]       = request.getURL();
-    _env["SERVER_PROTOCOL"] = request.getProtocol();
-    _env["GATEWAY_INTERFACE"] = "CGI/1.1";
-    _env["REDIRECT_STATUS"] = "200";
+    env["REQUEST_METHOD"]  = AllowedMethods::methodToString(request.getMethod());
+    env["QUERY_STRING"]    = request.getQuery();
+    env["SCRIPT_FILENAME"] = scriptPath;
+    env["SCRIPT_NAME"]     = request.getURL();
+    env["PATH_INFO"]       = request.getURL();
+    env["SERVER_PROTOCOL"] = request.getProtocol();
+    env["GATEWAY_INTERFACE"] = "CGI/1.1";
+    env["REDIRECT_STATUS"] = "200";
 
     // Content headers (only meaningful for POST)
     std::string ct = request.getHeader("content-type");
     if (!ct.empty())
-        _env["CONTENT_TYPE"] = ct;
+        env["CONTENT_TYPE"] = ct;
 
     std::string cl = request.getHeader("content-length");
-    _env["CONTENT_LENGTH"] = (cl.empty()? _env["CONTENT_LENGTH"] = "0" : _env["CONTENT_LENGTH"] = cl);
+    env["CONTENT_LENGTH"] = (cl.empty()? env["CONTENT_LENGTH"] = "0" : env["CONTENT_LENGTH"] = cl);
 
-    const std::map<std::string, std::string>& headers = request.getHeaders();
-    for (std::map<std::string, std::string>::const_iterator it = headers.begin();
-         it != headers.end(); ++it)
+    const HeaderTable& headers = request.getHeaders();
+    for (size_t h = 0; h < headers.size(); ++h)
     {
-        std::string key = it->first;
+        std::string key = headers[h].getName();
         for (size_t i = 0; i < key.size(); ++i)
         {
             if (key[i] == '-')
@@ -222,7 +326,7 @@ void CGIManager::_buildEnvMap(const Request& request, const std::string& scriptP
             else
                 key[i] = std::toupper(key[i]);
         }
-        _env["HTTP_" + key] = it->second;
+        env["HTTP_" + key] = headers[h].getValue();
     }
 }
 
@@ -279,84 +383,108 @@ void CGIManager::_closePipes()
         close(_outPipe[1]);
         _outPipe[1] = -1;
     }
+    for (int i = 0; i < 2; ++i)
+    {
+        if (_inPipe[i] != -1)
+        {
+            close(_inPipe[i]);
+            _inPipe[i] = -1;
+        }
+    }
 }
 
 
-void CGIManager::_registerPid(pid_t pid)
+void CGIManager::_watchChild()
 {
-    if (pid > 0)
-        _activePids.insert(pid);
-}
-
-void CGIManager::_reapFinishedActivePids()
-{
-    if (_activePids.empty())
-        return;
-
-    std::set<pid_t> stillRunning;
-    for (std::set<pid_t>::iterator it = _activePids.begin(); it != _activePids.end(); ++it)
+    _pidFd = cgi_utils::pidfdOpen(_pId);
+    if (_pidFd < 0)
     {
-        int status = 0;
-        pid_t result = waitpid(*it, &status, WNOHANG);
-        if (result == 0 || (result < 0 && errno == EINTR))
-            stillRunning.insert(*it);
+        // its exit could never be delivered: don't leave a child nobody reaps.
+        kill(_pId, SIGKILL);
+        waitpid(_pId, NULL, 0);
+        _pId = -1;
+        _closePipes();
+        throw ClientException(500, std::string("CGIManager::execute: pidfd_open(): ") + strerror(errno));
     }
-    _activePids = stillRunning;
+    Child child = { _pId, this, false, false };
+    _children[_pidFd] = child;
 }
 
-bool CGIManager::_isSpawnLimitReached()
+void CGIManager::_forgetOwner()
 {
-    _reapFinishedActivePids();
-    return _activePids.size() >= MAX_ACTIVE_CGI_CHILDREN;
+    // the child outlives this CGIManager until its exit is reaped.
+    std::map<int, Child>::iterator it = _children.find(_pidFd);
+    if (_pidFd >= 0 && it != _children.end())
+        it->second.owner = NULL;
+    _pidFd = -1;
 }
 
-void CGIManager::_unregisterPid(pid_t pid)
+bool CGIManager::_isSpawnLimitReached()
 {
-    CGIManager::_activePids.erase(pid);
+    if (_children.size() < MAX_ACTIVE_CGI_CHILDREN)
+        return false;
+    // children isDone() already waited for stay listed until their pidfd event: count the running ones.
+    // One whose pidfd never made it into epoll gets no event, so it is forgotten here instead.
+    size_t running = 0;
+    std::map<int, Child>::iterator it = _children.begin();
+    while (it != _children.end())
+    {
+        if (!it->second.reaped)
+            it->second.reaped = cgi_utils::pidfdReap(it->first, false);
+        if (!it->second.reaped)
+            ++running;
+        else if (!it->second.watched)
+        {
+            if (it->second.owner)
+            {
+                it->second.owner->_pId = -1;
+                it->second.owner->_pidFd = -1;
+            }
+            close(it->first);
+            _children.erase(it++);
+            continue;
+        }
+        ++it;
+    }
+    return running >= MAX_ACTIVE_CGI_CHILDREN;
 }
 
 void CGIManager::cleanupAllProcesses()
 {
-    if (CGIManager::_activePids.empty())
+    if (_children.empty())
         return;
 
-    for (std::set<pid_t>::iterator it = CGIManager::_activePids.begin(); it != CGIManager::_activePids.end(); ++it)
-    {
-        kill(*it, SIGTERM);
-    }
+    for (std::map<int, Child>::iterator it = _children.begin(); it != _children.end(); ++it)
+        cgi_utils::pidfdSignal(it->first, SIGTERM);
 
+    // sleep on the pidfds themselves: each exit wakes the drain right away.
     time_t startTime = time(NULL);
     const int GRACE_PERIOD = 5;
-
-    while (!CGIManager::_activePids.empty() && (time(NULL) - startTime) < GRACE_PERIOD)
+    std::vector<struct pollfd> fds;
+    while (!_children.empty() && (time(NULL) - startTime) < GRACE_PERIOD)
     {
-        std::set<pid_t> remaining;
-        for (std::set<pid_t>::iterator it = CGIManager::_activePids.begin(); it != CGIManager::_activePids.end(); ++it)
+        fds.clear();
+        for (std::map<int, Child>::iterator it = _children.begin(); it != _children.end(); ++it)
         {
-            int status;
-            pid_t result = waitpid(*it, &status, WNOHANG);
-            if (result == 0)
-                remaining.insert(*it);
+            struct pollfd pfd = { it->first, POLLIN, 0 };
+            fds.push_back(pfd);
         }
-        CGIManager::_activePids = remaining;
-
-        if (!CGIManager::_activePids.empty())
-            usleep(100000);
-    }
-
-    if (!CGIManager::_activePids.empty())
-    {
-        for (std::set<pid_t>::iterator it = CGIManager::_activePids.begin(); it != CGIManager::_activePids.end(); ++it)
+        int left = GRACE_PERIOD - static_cast<int>(time(NULL) - startTime);
+        if (poll(&fds[0], fds.size(), left * 1000) < 0 && errno != EINTR)
+            break;
+        for (size_t i = 0; i < fds.size(); ++i)
         {
-            kill(*it, SIGKILL);
+            if (fds[i].revents)
+                reapChild(fds[i].fd);
         }
     }
 
-    for (std::set<pid_t>::iterator it = CGIManager::_activePids.begin(); it != CGIManager::_activePids.end(); ++it)
+    while (!_children.empty())
     {
-        int status;
-        waitpid(*it, &status, 0);
+        int pidFd = _children.begin()->first;
+        cgi_utils::pidfdSignal(pidFd, SIGKILL);
+        cgi_utils::pidfdReap(pidFd, true);
+        _children.begin()->second.reaped = true;
+        reapChild(pidFd);
     }
-
-    CGIManager::_activePids.clear();
 }
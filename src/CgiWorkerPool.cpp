@@ -0,0 +1,276 @@
+#include "../includes/CgiWorkerPool.hpp"
+#include "../includes/LocationConf.hpp"
+
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+// The worker side: a FastCGI responder for one request at a time on fd 0, running each script
+// with runpy in a fresh __main__ so modules the scripts import stay loaded between requests.
+static const char* const HARNESS =
+	"import io, os, sys, socket, runpy, traceback\n"
+	"home = os.getcwd()\n"
+	"conn = socket.socket(fileno=0)\n"
+	"inp = conn.makefile('rb')\n"
+	"def record():\n"
+	"    head = inp.read(8)\n"
+	"    if len(head) < 8:\n"
+	"        sys.exit(0)\n"
+	"    length = (head[4] << 8) | head[5]\n"
+	"    return head[1], inp.read(length + head[6])[:length]\n"
+	"def send(kind, data):\n"
+	"    for pos in range(0, max(len(data), 1), 65535):\n"
+	"        part = data[pos:pos + 65535]\n"
+	"        conn.sendall(bytes([1, kind, 0, 1, len(part) >> 8, len(part) & 255, 0, 0]) + part)\n"
+	"class Output(io.RawIOBase):\n"
+	"    def writable(self):\n"
+	"        return True\n"
+	"    def write(self, data):\n"
+	"        data = bytes(data)\n"
+	"        if data:\n"
+	"            send(6, data)\n"
+	"        return len(data)\n"
+	"def environment(data):\n"
+	"    env, pos = {}, 0\n"
+	"    while pos < len(data):\n"
+	"        sizes = []\n"
+	"        for _ in range(2):\n"
+	"            if data[pos] < 128:\n"
+	"                sizes.append(data[pos])\n"
+	"                pos += 1\n"
+	"            else:\n"
+	"                sizes.append(int.from_bytes(data[pos:pos + 4], 'big') & 0x7fffffff)\n"
+	"                pos += 4\n"
+	"        name = data[pos:pos + sizes[0]].decode('utf-8', 'surrogateescape')\n"
+	"        pos += sizes[0]\n"
+	"        env[name] = data[pos:pos + sizes[1]].decode('utf-8', 'surrogateescape')\n"
+	"        pos += sizes[1]\n"
+	"    return env\n"
+	"while True:\n"
+	"    params, body = b'', b''\n"
+	"    while True:\n"
+	"        kind, content = record()\n"
+	"        if kind == 4:\n"
+	"            params += content\n"
+	"        elif kind == 5 and not content:\n"
+	"            break\n"
+	"        elif kind == 5:\n"
+	"            body += content\n"
+	"    env = environment(params)\n"
+	"    os.chdir(home)\n"
+	"    script = os.path.abspath(env.get('SCRIPT_FILENAME', ''))\n"
+	"    os.environ.clear()\n"
+	"    os.environ.update(env)\n"
+	"    sys.argv = [script]\n"
+	"    sys.stdin = io.TextIOWrapper(io.BufferedReader(io.BytesIO(body)), encoding='utf-8')\n"
+	"    sys.stdout = io.TextIOWrapper(io.BufferedWriter(Output(), 65536), encoding='utf-8')\n"
+	"    try:\n"
+	"        os.chdir(os.path.dirname(script))\n"
+	"        runpy.run_path(script, run_name='__main__')\n"
+	"    except SystemExit:\n"
+	"        pass\n"
+	"    except BaseException:\n"
+	"        traceback.print_exc()\n"
+	"    try:\n"
+	"        sys.stdout.flush()\n"
+	"    except BaseException:\n"
+	"        pass\n"
+	"    send(6, b'')\n"
+	"    send(3, bytes(8))\n";
+
+// Canonical Form
+
+CgiWorkerPool::CgiWorkerPool() : _pools() {}
+
+// workers are processes tied to one pool: a copy starts empty.
+CgiWorkerPool::CgiWorkerPool(const CgiWorkerPool&) : _pools() {}
+
+CgiWorkerPool& CgiWorkerPool::operator=(const CgiWorkerPool& other)
+{
+	if (this != &other)
+		shutdown();
+	return *this;
+}
+
+CgiWorkerPool::~CgiWorkerPool()
+{
+	shutdown();
+}
+
+CgiWorkerPool& CgiWorkerPool::shared()
+{
+	static CgiWorkerPool instance;
+	return instance;
+}
+
+// Behavior
+
+void CgiWorkerPool::start(const LocationConf& loc)
+{
+	if (loc.getCgiPoolSize() == 0 || _pools.count(&loc))
+		return;
+
+	Pool& pool = _pools[&loc];
+	pool.interpreter = loc.getCgiInterpreter(".py");
+	pool.maxRequests = loc.getCgiPoolMaxRequests();
+	pool.workers.resize(loc.getCgiPoolSize());
+	for (size_t i = 0; i < pool.workers.size(); ++i)
+		_spawn(pool.interpreter, pool.workers[i]);
+}
+
+int CgiWorkerPool::acquire(const LocationConf& loc)
+{
+	std::map<const LocationConf*, Pool>::iterator it = _pools.find(&loc);
+	if (it == _pools.end())
+		return -1;
+
+	Pool& pool = it->second;
+	for (size_t i = 0; i < pool.workers.size(); ++i)
+	{
+		Worker& worker = pool.workers[i];
+		if (worker.busy)
+			continue;
+		if (!_isAlive(worker))
+		{
+			_retire(worker);
+			_spawn(pool.interpreter, worker);
+			if (worker.fd < 0)
+				continue;
+		}
+		worker.busy = true;
+		return worker.fd;
+	}
+	return -1;
+}
+
+void CgiWorkerPool::release(int fd, bool reusable)
+{
+	if (fd < 0)
+		return;
+	for (std::map<const LocationConf*, Pool>::iterator it = _pools.begin(); it != _pools.end(); ++it)
+	{
+		Pool& pool = it->second;
+		for (size_t i = 0; i < pool.workers.size(); ++i)
+		{
+			Worker& worker = pool.workers[i];
+			if (worker.fd != fd || !worker.busy)
+				continue;
+			worker.busy = false;
+			// an unfinished request leaves the worker mid-script, with records in flight: start over.
+			if (!reusable || ++worker.served >= pool.maxRequests)
+			{
+				_retire(worker);
+				_spawn(pool.interpreter, worker);
+			}
+			return;
+		}
+	}
+}
+
+size_t CgiWorkerPool::getWorkerCount(const LocationConf& loc) const
+{
+	std::map<const LocationConf*, Pool>::const_iterator it = _pools.find(&loc);
+	if (it == _pools.end())
+		return 0;
+	size_t count = 0;
+	for (size_t i = 0; i < it->second.workers.size(); ++i)
+		count += it->second.workers[i].fd >= 0;
+	return count;
+}
+
+size_t CgiWorkerPool::getIdleCount(const LocationConf& loc) const
+{
+	std::map<const LocationConf*, Pool>::const_iterator it = _pools.find(&loc);
+	if (it == _pools.end())
+		return 0;
+	size_t count = 0;
+	for (size_t i = 0; i < it->second.workers.size(); ++i)
+		count += it->second.workers[i].fd >= 0 && !it->second.workers[i].busy;
+	return count;
+}
+
+void CgiWorkerPool::shutdown()
+{
+	for (std::map<const LocationConf*, Pool>::iterator it = _pools.begin(); it != _pools.end(); ++it)
+	{
+		for (size_t i = 0; i < it->second.workers.size(); ++i)
+			_retire(it->second.workers[i]);
+	}
+	_pools.clear();
+}
+
+// Private Helpers
+
+void CgiWorkerPool::_spawn(const std::string& interpreter, Worker& worker)
+{
+	worker.pid = -1;
+	worker.fd = -1;
+	worker.served = 0;
+	worker.busy = false;
+
+	int sv[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) < 0)
+	{
+		std::cerr << "cgi_pool: socketpair(): " << strerror(errno) << std::endl;
+		return;
+	}
+	if (fcntl(sv[0], F_SETFL, O_NONBLOCK) < 0)
+	{
+		std::cerr << "cgi_pool: fcntl(): " << strerror(errno) << std::endl;
+		close(sv[0]);
+		close(sv[1]);
+		return;
+	}
+	// the socket becomes the harness's stdin; stdout and stderr stay the server's.
+	char* argv[] = { const_cast<char*>(interpreter.c_str()), const_cast<char*>("-c"),
+		const_cast<char*>(HARNESS), NULL };
+	char* envp[] = { NULL };
+	pid_t pid = -1;
+	posix_spawn_file_actions_t actions;
+	int err = posix_spawn_file_actions_init(&actions);
+	if (!err)
+	{
+		err = posix_spawn_file_actions_adddup2(&actions, sv[1], STDIN_FILENO);
+		if (!err)
+			err = posix_spawn(&pid, argv[0], &actions, NULL, argv, envp);
+		posix_spawn_file_actions_destroy(&actions);
+	}
+	close(sv[1]);
+	if (err)
+	{
+		std::cerr << "cgi_pool: posix_spawn(" << interpreter << "): " << strerror(err) << std::endl;
+		close(sv[0]);
+		return;
+	}
+	worker.pid = pid;
+	worker.fd = sv[0];
+}
+
+void CgiWorkerPool::_retire(Worker& worker)
+{
+	if (worker.fd >= 0)
+		close(worker.fd);
+	if (worker.pid > 0)
+	{
+		kill(worker.pid, SIGKILL);
+		waitpid(worker.pid, NULL, 0);
+	}
+	worker.fd = -1;
+	worker.pid = -1;
+	worker.busy = false;
+}
+
+bool CgiWorkerPool::_isAlive(const Worker& worker)
+{
+	if (worker.fd < 0)
+		return false;
+	// an idle worker has nothing to say: readable means it exited (EOF) or broke the protocol.
+	char probe;
+	return ::recv(worker.fd, &probe, 1, MSG_PEEK | MSG_DONTWAIT) < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+}
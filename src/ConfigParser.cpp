@@ -5,6 +5,8 @@
 #include <cctype>
 #include <arpa/inet.h>
 #include <netdb.h>
+#include <unistd.h>
+#include <sys/un.h>
 #include "../includes/ConfigParser.hpp"
 
 // ConfigException
@@ -17,7 +19,8 @@ ConfigParser::ConfigException::~ConfigException() throw() {}
 // Canonical form
 
 ConfigParser::ConfigParser(const std::string& filePath)
-	: _filePath(filePath), _pos(0) {}
+	: _filePath(filePath), _pos(0), _workerProcesses(DEFAULT_WORKER_PROCESSES),
+	  _edgeTriggered(false), _connectionPoolSize(DEFAULT_CONNECTION_POOL_SIZE) {}
 
 ConfigParser::~ConfigParser() {}
 
@@ -39,6 +42,24 @@ std::vector<ServerConf> ConfigParser::parse()
 	std::vector<ServerConf> servers;
 	while (!_atEnd())
 	{
+		if (_peek() == "worker_processes")
+		{
+			_consume();
+			_parseWorkerProcesses();
+			continue;
+		}
+		if (_peek() == "epoll_edge_triggered")
+		{
+			_consume();
+			_parseEdgeTriggered();
+			continue;
+		}
+		if (_peek() == "connection_pool_size")
+		{
+			_consume();
+			_parseConnectionPoolSize();
+			continue;
+		}
 		if (_peek() != "server")
 			throw ConfigException("expected 'server' block, got: '" + _peek() + "'");
 		_consume();
@@ -52,6 +73,21 @@ std::vector<ServerConf> ConfigParser::parse()
 	return servers;
 }
 
+size_t ConfigParser::getWorkerProcesses() const
+{
+	return _workerProcesses;
+}
+
+bool ConfigParser::getEdgeTriggered() const
+{
+	return _edgeTriggered;
+}
+
+size_t ConfigParser::getConnectionPoolSize() const
+{
+	return _connectionPoolSize;
+}
+
 
 void ConfigParser::_tokenize(const std::string& content)
 {
@@ -137,6 +173,30 @@ ServerConf ConfigParser::_parseServerBlock()
 		_parseMaxBodySize(conf);
 		else if (directive == "error_page")
 		_parseErrorPage(conf);
+		else if (directive == "keepalive_timeout")
+		_parseKeepAliveTimeout(conf);
+		else if (directive == "keepalive_requests")
+		_parseKeepAliveRequests(conf);
+		else if (directive == "file_cache_entries")
+		_parseFileCacheEntries(conf);
+		else if (directive == "file_cache_max_size")
+		_parseFileCacheMaxSize(conf);
+		else if (directive == "file_cache_valid")
+		_parseFileCacheValid(conf);
+		else if (directive == "open_file_cache_entries")
+		_parseOpenFileCacheEntries(conf);
+		else if (directive == "open_file_cache_valid")
+		_parseOpenFileCacheValid(conf);
+		else if (directive == "open_file_cache_inactive")
+		_parseOpenFileCacheInactive(conf);
+		else if (directive == "file_map_max_size")
+		_parseFileMapMaxSize(conf);
+		else if (directive == "client_header_timeout")
+		_parseClientHeaderTimeout(conf);
+		else if (directive == "client_body_timeout")
+		_parseClientBodyTimeout(conf);
+		else if (directive == "send_timeout")
+		_parseSendTimeout(conf);
 		else if (directive == "location")
 		{
 			const std::string path = _consume();
@@ -173,10 +233,35 @@ LocationConf ConfigParser::_parseLocationBlock(const std::string& path)
 		_parseReturn(loc);
 		else if (directive == "cgi_interpreter")
 		_parseCgiInterpreter(loc);
+		else if (directive == "fastcgi_pass")
+		_parseFastCgiPass(loc);
+		else if (directive == "cgi_pool")
+		_parseCgiPool(loc);
+		else if (directive == "cgi_pool_max_requests")
+		_parseCgiPoolMaxRequests(loc);
+		else if (directive == "cgi_pool_timeout")
+		_parseCgiPoolTimeout(loc);
+		else if (directive == "gzip")
+		_parseGzip(loc);
+		else if (directive == "gzip_comp_level")
+		_parseGzipCompLevel(loc);
+		else if (directive == "gzip_min_length")
+		_parseGzipMinLength(loc);
+		else if (directive == "gzip_types")
+		_parseGzipTypes(loc);
+		else if (directive == "gzip_static")
+		_parseGzipStatic(loc);
+		else if (directive == "expires")
+		_parseExpires(loc);
+		else if (directive == "cache_control")
+		_parseCacheControl(loc);
 		else
 			throw ConfigException("unknown location directive: '" + directive + "'");
 	}
 	_expect("}");
+	// the pooled harness is a Python program: it can only run the location's .py scripts.
+	if (loc.getCgiPoolSize() > 0 && loc.getCgiInterpreter(".py").empty())
+		throw ConfigException("cgi_pool needs a cgi_interpreter for .py in location '" + path + "'");
 	return loc;
 }
 
@@ -214,6 +299,93 @@ void ConfigParser::_parseErrorPage(ServerConf& conf)
 	conf.addErrorPage(code, path);
 }
 
+void ConfigParser::_parseKeepAliveTimeout(ServerConf& conf)
+{
+	const std::string value = _consume();
+	_expect(";");
+	conf.setKeepAliveTimeout(_parseCount("keepalive_timeout", value));
+}
+
+void ConfigParser::_parseKeepAliveRequests(ServerConf& conf)
+{
+	const std::string value = _consume();
+	_expect(";");
+	const size_t count = _parseCount("keepalive_requests", value);
+	if (count == 0)
+		throw ConfigException("keepalive_requests must be at least 1");
+	conf.setKeepAliveRequests(count);
+}
+
+void ConfigParser::_parseFileCacheEntries(ServerConf& conf)
+{
+	const std::string value = _consume();
+	_expect(";");
+	conf.setFileCacheEntries(_parseCount("file_cache_entries", value));
+}
+
+void ConfigParser::_parseFileCacheMaxSize(ServerConf& conf)
+{
+	const std::string value = _consume();
+	_expect(";");
+	conf.setFileCacheMaxSize(_parseBodySize(value, "file_cache_max_size"));
+}
+
+void ConfigParser::_parseFileCacheValid(ServerConf& conf)
+{
+	const std::string value = _consume();
+	_expect(";");
+	conf.setFileCacheValid(_parseCount("file_cache_valid", value));
+}
+
+void ConfigParser::_parseOpenFileCacheEntries(ServerConf& conf)
+{
+	const std::string value = _consume();
+	_expect(";");
+	conf.setOpenFileCacheEntries(_parseCount("open_file_cache_entries", value));
+}
+
+void ConfigParser::_parseOpenFileCacheValid(ServerConf& conf)
+{
+	const std::string value = _consume();
+	_expect(";");
+	conf.setOpenFileCacheValid(_parseCount("open_file_cache_valid", value));
+}
+
+void ConfigParser::_parseOpenFileCacheInactive(ServerConf& conf)
+{
+	const std::string value = _consume();
+	_expect(";");
+	conf.setOpenFileCacheInactive(_parseCount("open_file_cache_inactive", value));
+}
+
+void ConfigParser::_parseFileMapMaxSize(ServerConf& conf)
+{
+	const std::string value = _consume();
+	_expect(";");
+	conf.setFileMapMaxSize(_parseBodySize(value, "file_map_max_size"));
+}
+
+void ConfigParser::_parseClientHeaderTimeout(ServerConf& conf)
+{
+	const std::string value = _consume();
+	_expect(";");
+	conf.setClientHeaderTimeout(_parseTimeout("client_header_timeout", value));
+}
+
+void ConfigParser::_parseClientBodyTimeout(ServerConf& conf)
+{
+	const std::string value = _consume();
+	_expect(";");
+	conf.setClientBodyTimeout(_parseTimeout("client_body_timeout", value));
+}
+
+void ConfigParser::_parseSendTimeout(ServerConf& conf)
+{
+	const std::string value = _consume();
+	_expect(";");
+	conf.setSendTimeout(_parseTimeout("send_timeout", value));
+}
+
 void ConfigParser::_parseRoot(LocationConf& loc)
 {
 	const std::string root = _consume();
@@ -280,6 +452,155 @@ void ConfigParser::_parseCgiInterpreter(LocationConf& loc)
 	loc.addCgiInterpreter(ext, path);
 }
 
+void ConfigParser::_parseFastCgiPass(LocationConf& loc)
+{
+	const std::string value = _consume();
+	_expect(";");
+
+	if (value.compare(0, 5, "unix:") == 0)
+	{
+		struct sockaddr_un un;
+		if (value.size() == 5 || value.size() - 5 >= sizeof(un.sun_path))
+			throw ConfigException("invalid unix socket path in fastcgi_pass: '" + value + "'");
+		loc.setFastCgiPass(value);
+		return;
+	}
+	if (value.find(':') == std::string::npos)
+		throw ConfigException("fastcgi_pass expects unix:<path> or <host>:<port>: '" + value + "'");
+
+	// resolved once here, so a request never waits on a name lookup.
+	struct sockaddr_in addr = _parseSockAddr(value);
+	std::ostringstream oss;
+	oss << inet_ntoa(addr.sin_addr) << ':' << ntohs(addr.sin_port);
+	loc.setFastCgiPass(oss.str());
+}
+
+void ConfigParser::_parseCgiPool(LocationConf& loc)
+{
+	const std::string value = _consume();
+	_expect(";");
+	const size_t workers = _parseCount("cgi_pool", value);
+	if (workers > MAX_CGI_POOL_SIZE)
+		throw ConfigException("invalid cgi_pool value: '" + value + "'");
+	loc.setCgiPoolSize(workers);
+}
+
+void ConfigParser::_parseCgiPoolMaxRequests(LocationConf& loc)
+{
+	const std::string value = _consume();
+	_expect(";");
+	const size_t count = _parseCount("cgi_pool_max_requests", value);
+	if (count == 0)
+		throw ConfigException("cgi_pool_max_requests must be at least 1");
+	loc.setCgiPoolMaxRequests(count);
+}
+
+void ConfigParser::_parseCgiPoolTimeout(LocationConf& loc)
+{
+	const std::string value = _consume();
+	_expect(";");
+	loc.setCgiPoolTimeout(_parseTimeout("cgi_pool_timeout", value));
+}
+
+void ConfigParser::_parseGzip(LocationConf& loc)
+{
+	const std::string value = _consume();
+	_expect(";");
+
+	if (value == "on")
+		loc.setGzip(true);
+	else if (value == "off")
+		loc.setGzip(false);
+	else
+		throw ConfigException("gzip must be 'on' or 'off', got: '" + value + "'");
+}
+
+void ConfigParser::_parseGzipCompLevel(LocationConf& loc)
+{
+	const std::string value = _consume();
+	_expect(";");
+	const size_t level = _parseCount("gzip_comp_level", value);
+	if (level < 1 || level > 9)
+		throw ConfigException("gzip_comp_level must be between 1 and 9, got: '" + value + "'");
+	loc.setGzipCompLevel(static_cast<int>(level));
+}
+
+void ConfigParser::_parseGzipMinLength(LocationConf& loc)
+{
+	const std::string value = _consume();
+	_expect(";");
+	loc.setGzipMinLength(_parseBodySize(value, "gzip_min_length"));
+}
+
+void ConfigParser::_parseGzipTypes(LocationConf& loc)
+{
+	if (_peek() == ";")
+		throw ConfigException("'gzip_types' directive requires at least one MIME type");
+
+	while (!_atEnd() && _peek() != ";")
+		loc.addGzipType(_consume());
+
+	_expect(";");
+}
+
+void ConfigParser::_parseGzipStatic(LocationConf& loc)
+{
+	const std::string value = _consume();
+	_expect(";");
+
+	if (value == "on")
+		loc.setGzipStatic(true);
+	else if (value == "off")
+		loc.setGzipStatic(false);
+	else
+		throw ConfigException("gzip_static must be 'on' or 'off', got: '" + value + "'");
+}
+
+void ConfigParser::_parseExpires(LocationConf& loc)
+{
+	const std::string value = _consume();
+	_expect(";");
+
+	if (value == "off")
+		loc.setExpires(EXPIRES_OFF);
+	else if (value == "epoch")
+		loc.setExpires(EXPIRES_EPOCH);
+	else if (value == "max")
+		loc.setExpires(EXPIRES_MAX);
+	else
+	{
+		// <n>, <n>s, <n>m, <n>h or <n>d
+		const char suffix = value.empty() ? '\0' : value[value.size() - 1];
+		long unit = 1;
+		std::string numStr = value;
+		if (suffix == 's' || suffix == 'm' || suffix == 'h' || suffix == 'd')
+		{
+			unit = (suffix == 'm') ? 60 : (suffix == 'h') ? 3600 : (suffix == 'd') ? 86400 : 1;
+			numStr = value.substr(0, value.size() - 1);
+		}
+		const size_t count = _parseCount("expires", numStr);
+		if (count > static_cast<size_t>(EXPIRES_MAX / unit))
+			throw ConfigException("invalid expires value: '" + value + "'");
+		loc.setExpires(static_cast<long>(count) * unit);
+	}
+}
+
+void ConfigParser::_parseCacheControl(LocationConf& loc)
+{
+	if (_peek() == ";")
+		throw ConfigException("'cache_control' directive requires a value");
+
+	std::string value;
+	while (!_atEnd() && _peek() != ";")
+	{
+		if (!value.empty())
+			value += ", ";
+		value += _consume();
+	}
+	_expect(";");
+	loc.setCacheControl(value);
+}
+
 struct sockaddr_in ConfigParser::_parseSockAddr(const std::string& listenValue)
 {
 	struct sockaddr_in addr;
@@ -334,10 +655,10 @@ struct sockaddr_in ConfigParser::_parseSockAddr(const std::string& listenValue)
 	return addr;
 }
 
-size_t ConfigParser::_parseBodySize(const std::string& value)
+size_t ConfigParser::_parseBodySize(const std::string& value, const std::string& directive)
 {
 	if (value.empty())
-		throw ConfigException("empty client_max_body_size value");
+		throw ConfigException("empty " + directive + " value");
 	const char   suffix = value[value.size() - 1];
 	size_t	 multiplier = 1;
 	std::string  numStr = value;
@@ -359,11 +680,66 @@ size_t ConfigParser::_parseBodySize(const std::string& value)
 	}
 
 	if (numStr.empty() || numStr.find_first_not_of("0123456789") != std::string::npos)
-		throw ConfigException("invalid client_max_body_size value: '" + value + "'");
+		throw ConfigException("invalid " + directive + " value: '" + value + "'");
 
 	return static_cast<size_t>(std::atol(numStr.c_str())) * multiplier;
 }
 
+void ConfigParser::_parseWorkerProcesses()
+{
+	const std::string value = _consume();
+	_expect(";");
+	if (value == "auto")
+	{
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		_workerProcesses = cpus > 0 ? static_cast<size_t>(cpus) : DEFAULT_WORKER_PROCESSES;
+		return;
+	}
+	size_t n = _parseCount("worker_processes", value);
+	if (n == 0 || n > MAX_WORKER_PROCESSES)
+		throw ConfigException("invalid worker_processes value: '" + value + "'");
+	_workerProcesses = n;
+}
+
+void ConfigParser::_parseEdgeTriggered()
+{
+	const std::string value = _consume();
+	_expect(";");
+
+	if (value == "on")
+		_edgeTriggered = true;
+	else if (value == "off")
+		_edgeTriggered = false;
+	else
+		throw ConfigException("epoll_edge_triggered must be 'on' or 'off', got: '" + value + "'");
+}
+
+void ConfigParser::_parseConnectionPoolSize()
+{
+	const std::string value = _consume();
+	_expect(";");
+	size_t n = _parseCount("connection_pool_size", value);
+	if (n > MAX_CONNECTION_POOL_SIZE)
+		throw ConfigException("invalid connection_pool_size value: '" + value + "'");
+	_connectionPoolSize = n;
+}
+
+size_t ConfigParser::_parseCount(const std::string& directive, const std::string& value)
+{
+	if (value.empty() || value.size() > 9 || value.find_first_not_of("0123456789") != std::string::npos)
+		throw ConfigException("invalid " + directive + " value: '" + value + "'");
+	return static_cast<size_t>(std::atol(value.c_str()));
+}
+
+size_t ConfigParser::_parseTimeout(const std::string& directive, const std::string& value)
+{
+	// 0 would expire a connection the moment it is armed.
+	size_t seconds = _parseCount(directive, value);
+	if (seconds == 0)
+		throw ConfigException("invalid " + directive + " value: '" + value + "'");
+	return seconds;
+}
+
 HTTPMethod ConfigParser::_parseMethodToken(const std::string& token)
 {
 	if (token == "GET")
@@ -7,6 +7,7 @@
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <sstream>
+#include <algorithm>
 #include "../includes/FatalExceptions.hpp"
 
 // --- Canonical Form ---
@@ -21,7 +22,8 @@ Connection::Connection()
 	  _response(NULL),
 	  _writeBufferSize(0),
 	  _state(READING),
-	  _totalBytesRead(0)
+	  _totalBytesRead(0),
+	  _requestsServed(0)
 {
 	std::memset(&_IPA, 0, sizeof(_IPA));
 	_request = new Request(0);
@@ -39,7 +41,8 @@ Connection::Connection(int fd, const struct sockaddr_in& ipa, const ServerConf*
 	  _response(NULL),
 	  _writeBufferSize(0),
 	  _state(READING),
-	  _totalBytesRead(0)
+	  _totalBytesRead(0),
+	  _requestsServed(0)
 {
 	long long maxBody = 0;
 	if (_serverConf)
@@ -61,7 +64,8 @@ Connection::Connection(const Connection& other)
 	  _writeBufferSize(other._writeBufferSize),
 	  _writeBuffer(other._writeBuffer),
 	  _state(other._state),
-	  _totalBytesRead(other._totalBytesRead)
+	  _totalBytesRead(other._totalBytesRead),
+	  _requestsServed(other._requestsServed)
 {
 	_request = new Request(*other._request);
 	_response = new Response(*other._response);
@@ -82,6 +86,7 @@ Connection& Connection::operator=(const Connection& other)
 		_writeBuffer = other._writeBuffer;
 		_state = other._state;
 		_totalBytesRead = other._totalBytesRead;
+		_requestsServed = other._requestsServed;
 
 		*_request = *other._request;
 		*_response = *other._response;
@@ -95,6 +100,34 @@ Connection::~Connection()
 	delete _response;
 }
 
+// --- Pooling ---
+
+void Connection::recycle()
+{
+	_request->recycle(RECYCLE_KEEP_BYTES);
+	_response->recycle(RECYCLE_KEEP_BYTES);
+	_acceptFD = -1;
+	_serverConf = NULL;
+	_locationConf = NULL;
+	_readBuffer.clear();
+	if (_readBuffer.capacity() > RECYCLE_KEEP_BYTES)
+		std::string().swap(_readBuffer);
+	std::string().swap(_writeBuffer);
+	_writeBufferSize = 0;
+	_state = READING;
+	_totalBytesRead = 0;
+	_requestsServed = 0;
+}
+
+void Connection::reopen(int fd, const struct sockaddr_in& ipa, const ServerConf* defaultConfig)
+{
+	_acceptFD = fd;
+	_IPA = ipa;
+	_lastActivity = time(NULL);
+	_serverConf = defaultConfig;
+	_request->setMaxBodySize(_serverConf ? static_cast<long long>(_serverConf->getMaxBodySize()) : 0);
+}
+
 // --- Getters & Setters ---
 int Connection::getFd() const { return _acceptFD; }
 ConnectionState Connection::getState() const { return _state; }
@@ -116,95 +149,159 @@ void Connection::_updateActivityTimer()
 	_lastActivity = time(NULL);
 }
 
+bool Connection::_shouldKeepAlive() const
+{
+	if (!_serverConf || _serverConf->getKeepAliveTimeout() == 0)
+		return false;
+	if (_requestsServed + 1 >= _serverConf->getKeepAliveRequests())
+		return false;
+	return _request->wantsKeepAlive();
+}
+
+void Connection::_resetForNextRequest()
+{
+	++_requestsServed;
+	_request->reset();
+	_response->reset();
+	_locationConf = NULL;
+	_totalBytesRead = 0;
+	_state = READING;
+	_updateActivityTimer();
+
+	// pipelined requests already sitting in the buffer are answered next, in arrival order.
+	if (!_readBuffer.empty())
+		_parseBuffered();
+}
+
+void Connection::_beginProcessing()
+{
+	_state = PROCESSING;
+	_request->getBodyStore().resetReadPosition();
+}
+
 void Connection::_readHeaders(const char* buf, size_t n)
 {
 	_readBuffer.append(buf, n);
-	if (_readBuffer.size() > MAX_HEADER_SIZE)
-	{
-		triggerError(431); // Request header too large.
-		return;
-	}
+	_parseBuffered();
+}
 
+void Connection::_parseBuffered()
+{
 	size_t headerEnd = _request->parseHeaders(_readBuffer);
 	if (_request->getReqState() == REQ_ERROR)
 	{
 		triggerError(std::atoi(_request->getStatusCode().c_str()));
 		return;
 	}
+	if (headerEnd > MAX_HEADER_SIZE
+		|| (_request->getReqState() == REQ_HEADERS && _readBuffer.size() > MAX_HEADER_SIZE))
+	{
+		triggerError(431); // Request header too large.
+		return;
+	}
 	if (_request->getReqState() == REQ_HEADERS)
 		return;
 
-	//saving body data that made its way into the buffer.
-	std::string leftover = _readBuffer.substr(headerEnd);
-	_readBuffer.clear();
+	// Everything past this request's headers stays queued in _readBuffer:
+	// its body first, then whatever pipelined requests the client sent behind it.
+	_readBuffer.erase(0, headerEnd);
 
 	ReqState rState = _request->getReqState();
-
 	if (rState == REQ_DONE)
 	{
-		_state = PROCESSING;
+		_beginProcessing();
 		return;
 	}
-
-	if (!leftover.empty())
+	if (rState == REQ_BODY && _serverConf)
 	{
-		_request->getBodyStore().append(leftover);
-		if (rState == REQ_CHUNKED && _request->isChunkedDone(leftover))
-		{
-			_state = PROCESSING;
-			return;
-		}
-		if (rState == REQ_BODY && _request->getBodyStore().getSize() >= static_cast<size_t>(_request->getContentLength()))
-		{
-			_state = PROCESSING;
-			return;
-		}
+		// a CGI gets its body while it arrives, rather than once it is all stored.
+		_response->setKeepAlive(_shouldKeepAlive());
+		_response->startCgiUpload(*_request, *_serverConf);
 	}
+	if (_readBuffer.empty())
+		return;
+
+	std::string pending;
+	pending.swap(_readBuffer);
+	if (rState == REQ_BODY)
+		_readBody(pending.data(), pending.size());
+	else if (rState == REQ_CHUNKED)
+		_readChunked(pending.data(), pending.size());
 }
 
 void Connection::_readBody(const char* buf, size_t n)
 {
-	_request->getBodyStore().append(buf, n);
-	if (_request->getBodyStore().getSize() >= static_cast<size_t>(_request->getContentLength()))
-		_state = PROCESSING;
+	if (_response->isCgiUpload())
+	{
+		size_t fed = _response->feedCgiInput(buf, n);
+		if (fed < n)
+			_readBuffer.append(buf + fed, n - fed);
+		if (_response->getCgiInputLeft() == 0)
+			_beginProcessing();
+		return;
+	}
+
+	DataStore& body = _request->getBodyStore();
+	size_t expected = static_cast<size_t>(_request->getContentLength());
+	size_t take = std::min(n, expected - body.getSize());
+
+	body.append(buf, take);
+	if (take < n)
+		_readBuffer.append(buf + take, n - take);
+	if (body.getSize() >= expected)
+		_beginProcessing();
 }
 
 void Connection::_readChunked(const char* buf, size_t n)
 {
-	std::string chunk(buf, n);
-	_request->getBodyStore().append(chunk);
-	if (_request->isChunkedDone(chunk))
-		_state = PROCESSING;
+	size_t used = _request->feedChunked(buf, n);
+	if (_request->getReqState() == REQ_ERROR)
+	{
+		triggerError(std::atoi(_request->getStatusCode().c_str()));
+		return;
+	}
+	if (_request->getReqState() != REQ_DONE)
+		return;
+	if (used < n)
+		_readBuffer.append(buf + used, n - used);
+	_beginProcessing();
 }
+
 // --- State Machine Actions ---
-void Connection::handleRead()
+void Connection::handleRead(bool drain)
 {
-	if (_state != READING)
-		return;
-
 	char buf[MAX_HEADER_SIZE];
-	ssize_t n = recv(_acceptFD, buf, sizeof(buf), 0);
-	if (n <= 0)
+	while (_state == READING && !isUploadStalled())
 	{
-		if (n < 0)
-			std::cerr << "recv error on client " << req_utils::ipv4ToString(_IPA) <<
-					": " << strerror(errno) << std::endl;
-		_state = FINISHED;
-		return;
-	}
+		ssize_t n = recv(_acceptFD, buf, sizeof(buf), 0);
+		if (n < 0 && drain && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return; // drained: the next edge reports new data.
+		if (n <= 0)
+		{
+			if (n < 0)
+				std::cerr << "recv error on client " << req_utils::ipv4ToString(_IPA) <<
+						": " << strerror(errno) << std::endl;
+			_state = FINISHED;
+			return;
+		}
 
-	_updateActivityTimer();
-	_totalBytesRead += static_cast<size_t>(n);
+		_updateActivityTimer();
+		_totalBytesRead += static_cast<size_t>(n);
 
-	ReqState rState = _request->getReqState();
-	size_t len = static_cast<size_t>(n);
+		ReqState rState = _request->getReqState();
+		size_t len = static_cast<size_t>(n);
 
-	if (rState == REQ_HEADERS)
-		_readHeaders(buf, len);
-	else if (rState == REQ_BODY)
-		_readBody(buf, len);
-	else if (rState == REQ_CHUNKED)
-		_readChunked(buf, len);
+		if (rState == REQ_HEADERS)
+			_readHeaders(buf, len);
+		else if (rState == REQ_BODY)
+			_readBody(buf, len);
+		else if (rState == REQ_CHUNKED)
+			_readChunked(buf, len);
+
+		// a short read emptied the socket, and anything arriving later raises a new edge.
+		if (!drain || len < sizeof(buf))
+			return;
+	}
 }
 
 void Connection::process()
@@ -216,11 +313,6 @@ void Connection::process()
 
 	try
 	{
-		if (_request->getReqState() == REQ_CHUNKED)
-		{
-			if (!_request->processBodySlice())
-				return; // still decoding chunked encoding.
-		}
 		//if anything went wrong at all;recheck that 200 is indeed the default in yaman's implemenation.
 		if (_request->getStatusCode() != "200")
 		{
@@ -230,12 +322,15 @@ void Connection::process()
 
 		if (_serverConf)
 		{
+			if (_response->getBuildPhase() == BUILD_IDLE)
+				_response->setKeepAlive(_shouldKeepAlive());
 			if (!_response->buildResponse(*_request, *_serverConf))
 			{
 				// Check if this is a CGI request that needs pipe monitoring
 				if (_response->getBuildPhase() == BUILD_CGI_RUNNING)
 				{
-					_state = WAITING_FOR_CGI;
+					// a script fed while the body arrived may have started answering already.
+					_state = _response->isCgiStreaming() ? WRITING : WAITING_FOR_CGI;
 					return;
 				}
 				return; // still in round-robin (e.g. POST writing)
@@ -265,13 +360,28 @@ void Connection::process()
 	}
 }
 
-void Connection::handleWrite()
+void Connection::handleWrite(bool drain)
+{
+	while (_state == WRITING)
+	{
+		_updateActivityTimer();
+		if (!_response->sendSlice(_acceptFD))
+		{
+			if (!drain || _response->wouldBlock() || _response->isWaitingOnCgi())
+				return;
+			continue;
+		}
+		if (_response->isKeepAlive())
+			_resetForNextRequest();
+		else
+			_state = FINISHED;
+	}
+}
+
+bool Connection::readCgiOutput()
 {
-	if (_state != WRITING)
-		return;
 	_updateActivityTimer();
-	if (_response->sendSlice(_acceptFD))
-		_state = FINISHED;
+	return _response->readCgiOutput();
 }
 
 // --- Error & Timeout Management ---
@@ -281,11 +391,56 @@ bool Connection::hasTimedOut(int timeoutSeconds) const
 	return (time(NULL) - _lastActivity) >= timeoutSeconds;
 }
 
+bool Connection::isIdleKeepAlive() const
+{
+	return _state == READING && _requestsServed > 0
+		&& _readBuffer.empty() && _request->getReqState() == REQ_HEADERS;
+}
+
+bool Connection::isUploadStalled() const
+{
+	return _state == READING && _request->getReqState() == REQ_BODY
+		&& _response->isCgiUpload() && _response->isCgiInputFull();
+}
+
+time_t Connection::getDeadline() const
+{
+	const ServerConf* conf = _serverConf;
+	size_t timeout;
+	switch (_state)
+	{
+		case READING:
+			if (isUploadStalled())
+				return 0; // the script isn't reading: the CGI timeout runs instead.
+			if (isIdleKeepAlive())
+				timeout = conf ? conf->getKeepAliveTimeout() : DEFAULT_KEEPALIVE_TIMEOUT_S;
+			else if (_request->getReqState() == REQ_HEADERS)
+				timeout = conf ? conf->getClientHeaderTimeout() : DEFAULT_CLIENT_HEADER_TIMEOUT_S;
+			else
+				timeout = conf ? conf->getClientBodyTimeout() : DEFAULT_CLIENT_BODY_TIMEOUT_S;
+			break;
+		case WRITING:
+			if (_response->isWaitingOnCgi())
+				return 0;
+			timeout = conf ? conf->getSendTimeout() : DEFAULT_SEND_TIMEOUT_S;
+			break;
+		case PROCESSING:
+			timeout = PROCESSING_TIMEOUT_S;
+			break;
+		default:
+			return 0;
+	}
+	return _lastActivity + static_cast<time_t>(timeout);
+}
+
 void Connection::triggerError(int statusCode)
 {
 	std::ostringstream oss;
 	oss << statusCode;
 
+	// whatever is left of this request on the wire can't be trusted to frame the next one.
+	_response->setKeepAlive(false);
+
 	if (_serverConf)
 		_response->buildErrorPage(oss.str(), *_serverConf);
 	else
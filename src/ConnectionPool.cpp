@@ -0,0 +1,105 @@
+#include "../includes/ConnectionPool.hpp"
+
+// Canonical Form
+
+ConnectionPool::ConnectionPool() : _idle(), _maxIdle(0), _hits(0), _misses(0) {}
+
+ConnectionPool::ConnectionPool(size_t maxIdle) : _idle(), _maxIdle(0), _hits(0), _misses(0)
+{
+	warm(maxIdle);
+}
+
+// idle connections are owned by exactly one pool, so a copy only takes the size and warms its own.
+ConnectionPool::ConnectionPool(const ConnectionPool& other) : _idle(), _maxIdle(0), _hits(0), _misses(0)
+{
+	warm(other._maxIdle);
+}
+
+ConnectionPool& ConnectionPool::operator=(const ConnectionPool& other)
+{
+	if (this != &other)
+	{
+		_clear();
+		_hits = 0;
+		_misses = 0;
+		warm(other._maxIdle);
+	}
+	return *this;
+}
+
+ConnectionPool::~ConnectionPool()
+{
+	_clear();
+}
+
+// Behavior
+
+void ConnectionPool::warm(size_t maxIdle)
+{
+	_maxIdle = maxIdle;
+	while (_idle.size() > _maxIdle)
+	{
+		delete _idle.back();
+		_idle.pop_back();
+	}
+	_idle.reserve(_maxIdle);
+	while (_idle.size() < _maxIdle)
+		_idle.push_back(new Connection());
+}
+
+Connection* ConnectionPool::acquire(int fd, const struct sockaddr_in& ipa, const ServerConf* defaultConfig)
+{
+	if (_idle.empty())
+	{
+		++_misses;
+		return new Connection(fd, ipa, defaultConfig);
+	}
+	++_hits;
+	Connection* conn = _idle.back();
+	_idle.pop_back();
+	conn->reopen(fd, ipa, defaultConfig);
+	return conn;
+}
+
+void ConnectionPool::release(Connection* conn)
+{
+	if (!conn)
+		return;
+	if (_idle.size() >= _maxIdle)
+	{
+		delete conn;
+		return;
+	}
+	// recycled now rather than on reuse, so temp files and descriptors don't wait in the pool.
+	conn->recycle();
+	_idle.push_back(conn);
+}
+
+size_t ConnectionPool::getIdle() const
+{
+	return _idle.size();
+}
+
+size_t ConnectionPool::getMaxIdle() const
+{
+	return _maxIdle;
+}
+
+size_t ConnectionPool::getHits() const
+{
+	return _hits;
+}
+
+size_t ConnectionPool::getMisses() const
+{
+	return _misses;
+}
+
+// Private Helpers
+
+void ConnectionPool::_clear()
+{
+	for (size_t i = 0; i < _idle.size(); ++i)
+		delete _idle[i];
+	_idle.clear();
+}
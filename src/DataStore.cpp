@@ -6,6 +6,8 @@
 
 #include "../includes/DataStore.hpp"
 #include <cstdio>
+#include <sys/socket.h>
+#include <sys/sendfile.h>
 
 
 /**
@@ -30,7 +32,7 @@ void DataStore::write_all(int fd, const char* data, size_t length) {
  * @brief Copies data directly from one FD to another using a buffer. Throws on error.
  */
 void DataStore::copy_fd_contents(const std::string& srcPath, int dstFd, size_t totalBytes) {
-	int srcFd = ::open(srcPath.c_str(), O_RDONLY);
+	int srcFd = ::open(srcPath.c_str(), O_RDONLY | O_CLOEXEC);
 	if (srcFd < 0) {
 		throw std::runtime_error(std::string("DataStore: open failed during copy - ") + std::strerror(errno));
 	}
@@ -164,6 +166,12 @@ void DataStore::clear() {
 	_absolutePath.clear();
 }
 
+void DataStore::shrink(size_t keepBytes) {
+	clear();
+	if (_dataBuffer.capacity() > keepBytes)
+		std::vector<char>().swap(_dataBuffer);
+}
+
 // Getters
 
 BufferMode DataStore::getMode() const {
@@ -225,6 +233,23 @@ size_t DataStore::read(char* buffer, size_t length) {
 	}
 }
 
+/**
+ * @brief Sends stored bytes straight to a socket, without touching the read position.
+ * FILE_MODE goes through sendfile() with an explicit offset, so the O_APPEND write position is unaffected.
+ */
+ssize_t DataStore::sendTo(int sockFd, size_t offset, size_t length) const {
+	if (offset >= _currentSize || length == 0) {
+		return 0;
+	}
+	size_t toSend = std::min(length, _currentSize - offset);
+
+	if (_mode == RAM) {
+		return ::send(sockFd, &_dataBuffer[offset], toSend, MSG_DONTWAIT);
+	}
+	off_t fileOffset = static_cast<off_t>(offset);
+	return ::sendfile(sockFd, _fileFd, &fileOffset, toSend);
+}
+
 /**
  * @brief Resets the internal read position to the beginning of the data.
  */
@@ -232,7 +257,7 @@ void DataStore::resetReadPosition() {
 	_readOffset = 0;
 	if (_mode == FILE_MODE && _fileFd != -1) {
 		::close(_fileFd);
-		_fileFd = ::open(_absolutePath.c_str(), O_RDWR | O_APPEND, 0600);
+		_fileFd = ::open(_absolutePath.c_str(), O_RDWR | O_APPEND | O_CLOEXEC, 0600);
 		if (_fileFd == -1) {
 			throw std::runtime_error("DataStore: Failed to reopen for reset");
 		}
@@ -284,7 +309,7 @@ void DataStore::_generateTempFileName() {
 		ss << FILEPREFIX << file_counter++;
 		currentName = ss.str();
 
-		fd = ::open(currentName.c_str(), O_CREAT | O_EXCL | O_RDWR | O_APPEND, 0600);
+		fd = ::open(currentName.c_str(), O_CREAT | O_EXCL | O_RDWR | O_APPEND | O_CLOEXEC, 0600);
 
 		if (fd == -1) {
 			if (errno == EEXIST) {
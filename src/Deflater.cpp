@@ -0,0 +1,715 @@
+#include "../includes/Deflater.hpp"
+
+#include <algorithm>
+
+#define WINDOW_SIZE			32768
+#define WINDOW_MASK			(WINDOW_SIZE - 1)
+#define MIN_MATCH			3
+#define MAX_MATCH			258
+#define HASH_BITS			15
+#define HASH_SIZE			(1 << HASH_BITS)
+#define BLOCK_SYMBOLS		16384	// symbols buffered before a block is emitted
+#define MAX_STORED			65535	// largest stored block payload
+#define LIT_CODES			286
+#define DIST_CODES			30
+#define CL_CODES			19
+#define END_OF_BLOCK		256
+
+namespace
+{
+	const unsigned short LENGTH_BASE[29] = {
+		3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+		35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	const unsigned char LENGTH_EXTRA[29] = {
+		0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+		3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	const unsigned short DIST_BASE[DIST_CODES] = {
+		1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+		257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+	const unsigned char DIST_EXTRA[DIST_CODES] = {
+		0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+		7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+	// order in which the code length code lengths are sent (RFC 1951 3.2.7).
+	const unsigned char CL_ORDER[CL_CODES] = {
+		16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+	// {max chain, nice length, lazy} per level, the same effort curve zlib uses.
+	struct LevelConfig
+	{
+		size_t	chain;
+		size_t	nice;
+		bool	lazy;
+	};
+	const LevelConfig LEVELS[10] = {
+		{ 0, 0, false },
+		{ 4, 8, false }, { 8, 16, false }, { 32, 32, false },
+		{ 16, 32, true }, { 32, 64, true }, { 128, 128, true },
+		{ 256, 128, true }, { 1024, MAX_MATCH, true }, { 4096, MAX_MATCH, true } };
+
+	const unsigned long* crcTable()
+	{
+		static unsigned long table[256];
+		static bool built = false;
+		if (!built)
+		{
+			for (unsigned long n = 0; n < 256; ++n)
+			{
+				unsigned long c = n;
+				for (int k = 0; k < 8; ++k)
+					c = (c & 1) ? 0xEDB88320UL ^ (c >> 1) : c >> 1;
+				table[n] = c;
+			}
+			built = true;
+		}
+		return table;
+	}
+
+	unsigned char lengthCode(size_t length)
+	{
+		static unsigned char table[MAX_MATCH + 1];
+		static bool built = false;
+		if (!built)
+		{
+			for (unsigned char code = 0; code < 29; ++code)
+			{
+				size_t top = (code == 28) ? MAX_MATCH : static_cast<size_t>(LENGTH_BASE[code + 1]) - 1;
+				for (size_t len = LENGTH_BASE[code]; len <= top; ++len)
+					table[len] = code;
+			}
+			table[MAX_MATCH] = 28;	// 258 has its own code; 227 + 31 would otherwise claim it
+			built = true;
+		}
+		return table[length];
+	}
+
+	unsigned char distCode(size_t dist)
+	{
+		return static_cast<unsigned char>(std::upper_bound(DIST_BASE, DIST_BASE + DIST_CODES, dist) - DIST_BASE - 1);
+	}
+
+	size_t hashAt(const char* p)
+	{
+		const unsigned char* u = reinterpret_cast<const unsigned char*>(p);
+		return ((static_cast<size_t>(u[0]) << 10) ^ (static_cast<size_t>(u[1]) << 5) ^ u[2]) & (HASH_SIZE - 1);
+	}
+
+	/**
+	 * Huffman code lengths for freq, none longer than maxBits. Trees that come out too deep are rebuilt
+	 * from flattened frequencies (f/2, rounded up), which converges quickly and costs little ratio.
+	 * Symbols with a zero frequency get length 0.
+	 */
+	void buildLengths(const std::vector<unsigned long>& freq, int maxBits, std::vector<unsigned char>& lens)
+	{
+		lens.assign(freq.size(), 0);
+		std::vector<std::pair<unsigned long, size_t> > leaves;
+		for (size_t i = 0; i < freq.size(); ++i)
+			if (freq[i])
+				leaves.push_back(std::make_pair(freq[i], i));
+		if (leaves.empty())
+			return;
+		if (leaves.size() == 1)
+		{
+			lens[leaves[0].second] = 1;
+			return;
+		}
+		const size_t count = leaves.size();
+		std::vector<unsigned long> weight(2 * count - 1);
+		std::vector<size_t> parent(2 * count - 1, 0);
+		std::vector<int> depth(2 * count - 1, 0);
+		for (;;)
+		{
+			std::sort(leaves.begin(), leaves.end());
+			for (size_t i = 0; i < count; ++i)
+				weight[i] = leaves[i].first;
+			// two-queue merge: sorted leaves, and internal nodes which are created in increasing weight.
+			size_t leaf = 0, node = count, next = count;
+			for (; next < 2 * count - 1; ++next)
+			{
+				size_t pick[2];
+				for (int k = 0; k < 2; ++k)
+				{
+					if (leaf < count && (node >= next || weight[leaf] <= weight[node]))
+						pick[k] = leaf++;
+					else
+						pick[k] = node++;
+				}
+				weight[next] = weight[pick[0]] + weight[pick[1]];
+				parent[pick[0]] = next;
+				parent[pick[1]] = next;
+			}
+			depth[2 * count - 2] = 0;
+			int deepest = 0;
+			for (size_t i = 2 * count - 2; i-- > 0; )
+			{
+				depth[i] = depth[parent[i]] + 1;
+				if (i < count && depth[i] > deepest)
+					deepest = depth[i];
+			}
+			if (deepest <= maxBits)
+				break;
+			for (size_t i = 0; i < count; ++i)
+				leaves[i].first = (leaves[i].first + 1) / 2;
+		}
+		for (size_t i = 0; i < count; ++i)
+			lens[leaves[i].second] = depth[i];
+	}
+
+	// canonical codes for lens, bit-reversed because deflate packs Huffman codes starting at their MSB.
+	void buildCodes(const std::vector<unsigned char>& lens, std::vector<unsigned short>& codes)
+	{
+		unsigned short blCount[16] = { 0 };
+		unsigned short nextCode[16] = { 0 };
+		for (size_t i = 0; i < lens.size(); ++i)
+			blCount[lens[i]]++;
+		blCount[0] = 0;
+		unsigned short code = 0;
+		for (int bits = 1; bits < 16; ++bits)
+		{
+			code = static_cast<unsigned short>((code + blCount[bits - 1]) << 1);
+			nextCode[bits] = code;
+		}
+		codes.assign(lens.size(), 0);
+		for (size_t i = 0; i < lens.size(); ++i)
+		{
+			if (!lens[i])
+				continue;
+			unsigned short c = nextCode[lens[i]]++;
+			unsigned short reversed = 0;
+			for (int b = 0; b < lens[i]; ++b)
+				reversed = static_cast<unsigned short>((reversed << 1) | ((c >> b) & 1));
+			codes[i] = reversed;
+		}
+	}
+
+	// a decoder rejects an incomplete code of one symbol in some trees, so every tree gets two.
+	std::vector<unsigned long> withTwoSymbols(std::vector<unsigned long> freq)
+	{
+		size_t used = 0, only = 0;
+		for (size_t i = 0; i < freq.size(); ++i)
+			if (freq[i])
+			{
+				++used;
+				only = i;
+			}
+		if (used == 0)
+			freq[0] = freq[1] = 1;
+		else if (used == 1)
+			freq[only == 0 ? 1 : 0] = 1;
+		return freq;
+	}
+
+	unsigned long cost(const std::vector<unsigned long>& freq, const std::vector<unsigned char>& lens)
+	{
+		unsigned long bits = 0;
+		for (size_t i = 0; i < freq.size(); ++i)
+			bits += freq[i] * lens[i];
+		return bits;
+	}
+
+	struct ClSymbol
+	{
+		unsigned char	sym;
+		unsigned char	extra;
+		unsigned char	extraBits;
+	};
+
+	// run-length code of the literal/length and distance code lengths (RFC 1951 3.2.7).
+	void encodeLengths(const std::vector<unsigned char>& lens, std::vector<ClSymbol>& out)
+	{
+		size_t i = 0;
+		while (i < lens.size())
+		{
+			const unsigned char cur = lens[i];
+			size_t run = 1;
+			while (i + run < lens.size() && lens[i + run] == cur)
+				++run;
+			i += run;
+			if (cur == 0)
+			{
+				while (run >= 11)
+				{
+					size_t r = std::min<size_t>(run, 138);
+					ClSymbol s = { 18, static_cast<unsigned char>(r - 11), 7 };
+					out.push_back(s);
+					run -= r;
+				}
+				if (run >= 3)
+				{
+					ClSymbol s = { 17, static_cast<unsigned char>(run - 3), 3 };
+					out.push_back(s);
+					run = 0;
+				}
+			}
+			else
+			{
+				ClSymbol lit = { cur, 0, 0 };
+				out.push_back(lit);
+				--run;
+				while (run >= 3)
+				{
+					size_t r = std::min<size_t>(run, 6);
+					ClSymbol s = { 16, static_cast<unsigned char>(r - 3), 2 };
+					out.push_back(s);
+					run -= r;
+				}
+			}
+			for (; run > 0; --run)
+			{
+				ClSymbol s = { cur, 0, 0 };
+				out.push_back(s);
+			}
+		}
+	}
+}
+
+// Canonical Form
+
+Deflater::Deflater()
+	: _format(DEFLATE_GZIP), _level(6), _maxChain(0), _niceLength(0), _lazy(false), _started(false), _finished(false),
+	  _base(0), _pos(0), _blockStart(0), _crc(0), _adler(1), _inSize(0), _bitBuf(0), _bitCount(0)
+{
+	start(DEFLATE_GZIP, 6);
+}
+
+Deflater::Deflater(const Deflater& other)
+	: _format(other._format), _level(other._level), _maxChain(other._maxChain), _niceLength(other._niceLength), _lazy(other._lazy),
+	  _started(other._started), _finished(other._finished), _window(other._window), _base(other._base),
+	  _pos(other._pos), _blockStart(other._blockStart), _head(other._head), _prev(other._prev),
+	  _symbols(other._symbols), _crc(other._crc), _adler(other._adler), _inSize(other._inSize),
+	  _bitBuf(other._bitBuf), _bitCount(other._bitCount) {}
+
+Deflater& Deflater::operator=(const Deflater& other)
+{
+	if (this != &other)
+	{
+		_format		= other._format;
+		_level		= other._level;
+		_maxChain	= other._maxChain;
+		_niceLength	= other._niceLength;
+		_lazy		= other._lazy;
+		_started	= other._started;
+		_finished	= other._finished;
+		_window		= other._window;
+		_base		= other._base;
+		_pos		= other._pos;
+		_blockStart	= other._blockStart;
+		_head		= other._head;
+		_prev		= other._prev;
+		_symbols	= other._symbols;
+		_crc		= other._crc;
+		_adler		= other._adler;
+		_inSize		= other._inSize;
+		_bitBuf		= other._bitBuf;
+		_bitCount	= other._bitCount;
+	}
+	return *this;
+}
+
+Deflater::~Deflater() {}
+
+// Behavior
+
+void Deflater::start(DeflateFormat format, int level)
+{
+	level = std::max(1, std::min(9, level));
+	_format		= format;
+	_level		= level;
+	_maxChain	= LEVELS[level].chain;
+	_niceLength	= LEVELS[level].nice;
+	_lazy		= LEVELS[level].lazy;
+	_started	= false;
+	_finished	= false;
+	_window.clear();
+	_base		= 0;
+	_pos		= 0;
+	_blockStart	= 0;
+	_head.assign(HASH_SIZE, 0);
+	_prev.assign(WINDOW_SIZE, 0);
+	_symbols.clear();
+	_symbols.reserve(BLOCK_SYMBOLS);
+	_crc		= 0xFFFFFFFFUL;
+	_adler		= 1;
+	_inSize		= 0;
+	_bitBuf		= 0;
+	_bitCount	= 0;
+}
+
+void Deflater::write(const char* data, size_t n, std::string& out)
+{
+	if (_finished || n == 0)
+		return;
+	if (!_started)
+		_writeHeader(out);
+
+	const unsigned char* u = reinterpret_cast<const unsigned char*>(data);
+	if (_format == DEFLATE_GZIP)
+	{
+		const unsigned long* table = crcTable();
+		for (size_t i = 0; i < n; ++i)
+			_crc = table[(_crc ^ u[i]) & 0xFF] ^ (_crc >> 8);
+	}
+	else if (_format == DEFLATE_ZLIB)
+	{
+		unsigned long a = _adler & 0xFFFF, b = (_adler >> 16) & 0xFFFF;
+		// 5552 bytes is the most the sums take before they could overflow 32 bits (as in zlib).
+		for (size_t i = 0; i < n; )
+		{
+			const size_t stop = std::min(n, i + 5552);
+			for (; i < stop; ++i)
+			{
+				a += u[i];
+				b += a;
+			}
+			a %= 65521;
+			b %= 65521;
+		}
+		_adler = (b << 16) | a;
+	}
+	_inSize += n;
+
+	_window.append(data, n);
+	_encode(out, false);
+}
+
+void Deflater::finish(std::string& out)
+{
+	if (_finished)
+		return;
+	if (!_started)
+		_writeHeader(out);
+	_encode(out, true);
+	_flushBlock(out, true);
+	_alignToByte(out);
+
+	if (_format == DEFLATE_GZIP)
+	{
+		unsigned long crc = _crc ^ 0xFFFFFFFFUL;
+		for (int i = 0; i < 4; ++i)
+			out += static_cast<char>((crc >> (8 * i)) & 0xFF);
+		for (int i = 0; i < 4; ++i)
+			out += static_cast<char>((_inSize >> (8 * i)) & 0xFF);
+	}
+	else if (_format == DEFLATE_ZLIB)
+	{
+		for (int i = 3; i >= 0; --i)
+			out += static_cast<char>((_adler >> (8 * i)) & 0xFF);
+	}
+	_finished = true;
+	_window.clear();
+	_symbols.clear();
+}
+
+bool Deflater::isFinished() const
+{
+	return _finished;
+}
+
+std::string Deflater::compress(DeflateFormat format, int level, const char* data, size_t n)
+{
+	Deflater deflater;
+	std::string out;
+	deflater.start(format, level);
+	out.reserve(n / 3 + 64);
+	deflater.write(data, n, out);
+	deflater.finish(out);
+	return out;
+}
+
+// Internals
+
+void Deflater::_writeHeader(std::string& out)
+{
+	_started = true;
+	if (_format == DEFLATE_GZIP)
+	{
+		// magic, CM=deflate, no flags, no mtime, XFL (2 = best, 4 = fastest), OS = Unix.
+		const char header[10] = { '\x1f', '\x8b', 8, 0, 0, 0, 0, 0,
+								  static_cast<char>(_level == 9 ? 2 : (_level == 1 ? 4 : 0)), 3 };
+		out.append(header, sizeof(header));
+	}
+	else if (_format == DEFLATE_ZLIB)
+	{
+		// CM=8 with a 32 KB window, FLEVEL as a hint, and FCHECK making the pair a multiple of 31.
+		unsigned int cmf = 0x78;
+		unsigned int flg = static_cast<unsigned int>(_level < 2 ? 0 : (_level < 6 ? 1 : (_level == 6 ? 2 : 3))) << 6;
+		flg += 31 - ((cmf << 8) + flg) % 31;
+		out += static_cast<char>(cmf);
+		out += static_cast<char>(flg);
+	}
+}
+
+/**
+ * Greedy or lazy LZ77 over the window, one symbol per literal or match. Without flush only positions
+ * with a full MAX_MATCH of lookahead are encoded, so a match never stops short at a write() boundary.
+ */
+void Deflater::_encode(std::string& out, bool flush)
+{
+	const size_t end = _base + _window.size();
+	while (_pos < end && (flush || _pos + MAX_MATCH <= end))
+	{
+		size_t dist = 0;
+		size_t len = _longestMatch(_pos, end, dist);
+		if (len && _lazy && len < _niceLength && _pos + 1 < end)
+		{
+			size_t nextDist = 0;
+			_insert(_pos, end);
+			if (_longestMatch(_pos + 1, end, nextDist) > len)
+			{
+				Symbol literal = { static_cast<unsigned char>(_window[_pos - _base]), 0 };
+				_symbols.push_back(literal);
+				++_pos;
+			}
+			else
+			{
+				for (size_t k = 1; k < len; ++k)
+					_insert(_pos + k, end);
+				Symbol match = { static_cast<unsigned short>(len), static_cast<unsigned short>(dist) };
+				_symbols.push_back(match);
+				_pos += len;
+			}
+		}
+		else if (len)
+		{
+			for (size_t k = 0; k < len; ++k)
+				_insert(_pos + k, end);
+			Symbol match = { static_cast<unsigned short>(len), static_cast<unsigned short>(dist) };
+			_symbols.push_back(match);
+			_pos += len;
+		}
+		else
+		{
+			_insert(_pos, end);
+			Symbol literal = { static_cast<unsigned char>(_window[_pos - _base]), 0 };
+			_symbols.push_back(literal);
+			++_pos;
+		}
+		if (_symbols.size() >= BLOCK_SYMBOLS)
+			_flushBlock(out, false);
+	}
+
+	// slide: keep one window behind _pos, plus the current block's input while a stored block could use it.
+	if (_pos - _base > 2 * WINDOW_SIZE)
+	{
+		size_t keep = _pos - WINDOW_SIZE;
+		if (_blockStart >= _base && _blockStart < keep && _pos - _blockStart <= 2 * MAX_STORED)
+			keep = _blockStart;
+		_window.erase(0, keep - _base);
+		_base = keep;
+	}
+}
+
+size_t Deflater::_longestMatch(size_t pos, size_t limit, size_t& dist) const
+{
+	if (pos + MIN_MATCH > limit)
+		return 0;
+	const char* w = _window.data();
+	const size_t at = pos - _base;
+	const size_t maxLen = std::min<size_t>(MAX_MATCH, limit - pos);
+	size_t best = 0;
+	size_t chain = _maxChain;
+
+	// chain entries are offsets mod 2^32; a stale one only yields a candidate whose bytes get compared.
+	unsigned int candidate = _head[hashAt(w + at)];
+	while (candidate && chain--)
+	{
+		const unsigned int back = static_cast<unsigned int>(pos) - (candidate - 1);
+		if (back == 0 || back > WINDOW_SIZE || back > pos - _base)
+			break;
+		const size_t from = at - back;
+		if (w[from + best] == w[at + best] && w[from] == w[at])
+		{
+			size_t len = 0;
+			while (len < maxLen && w[from + len] == w[at + len])
+				++len;
+			if (len > best)
+			{
+				best = len;
+				dist = back;
+				if (len >= _niceLength || len == maxLen)
+					break;
+			}
+		}
+		const unsigned int older = _prev[(pos - back) & WINDOW_MASK];
+		if (static_cast<unsigned int>(pos) - (older - 1) <= back)
+			break;	// not older than the current candidate: the slot was reused
+		candidate = older;
+	}
+	return best >= MIN_MATCH ? best : 0;
+}
+
+void Deflater::_insert(size_t pos, size_t end)
+{
+	if (pos + MIN_MATCH > end)
+		return;
+	const size_t h = hashAt(_window.data() + (pos - _base));
+	_prev[pos & WINDOW_MASK] = _head[h];
+	_head[h] = static_cast<unsigned int>(pos + 1);
+}
+
+/**
+ * Emits the buffered symbols as one block, in whichever encoding is smallest: a dynamic Huffman block
+ * pays for its code table, a fixed one doesn't, and a stored one is raw input (only possible while
+ * the block's input is still in the window).
+ */
+void Deflater::_flushBlock(std::string& out, bool last)
+{
+	std::vector<unsigned long> litFreq(LIT_CODES, 0);
+	std::vector<unsigned long> distFreq(DIST_CODES, 0);
+	unsigned long extraBits = 0;
+	for (size_t i = 0; i < _symbols.size(); ++i)
+	{
+		if (_symbols[i].dist == 0)
+		{
+			litFreq[_symbols[i].litLen]++;
+			continue;
+		}
+		unsigned char lc = lengthCode(_symbols[i].litLen);
+		unsigned char dc = distCode(_symbols[i].dist);
+		litFreq[257 + lc]++;
+		distFreq[dc]++;
+		extraBits += LENGTH_EXTRA[lc] + DIST_EXTRA[dc];
+	}
+	litFreq[END_OF_BLOCK] = 1;
+
+	// dynamic
+	std::vector<unsigned char> litLens, distLens, clLens;
+	buildLengths(withTwoSymbols(litFreq), 15, litLens);
+	buildLengths(withTwoSymbols(distFreq), 15, distLens);
+	size_t hlit = LIT_CODES;
+	while (hlit > 257 && litLens[hlit - 1] == 0)
+		--hlit;
+	size_t hdist = DIST_CODES;
+	while (hdist > 1 && distLens[hdist - 1] == 0)
+		--hdist;
+	std::vector<unsigned char> allLens(litLens.begin(), litLens.begin() + hlit);
+	allLens.insert(allLens.end(), distLens.begin(), distLens.begin() + hdist);
+	std::vector<ClSymbol> clSymbols;
+	encodeLengths(allLens, clSymbols);
+	std::vector<unsigned long> clFreq(CL_CODES, 0);
+	unsigned long clExtra = 0;
+	for (size_t i = 0; i < clSymbols.size(); ++i)
+	{
+		clFreq[clSymbols[i].sym]++;
+		clExtra += clSymbols[i].extraBits;
+	}
+	buildLengths(withTwoSymbols(clFreq), 7, clLens);
+	size_t hclen = CL_CODES;
+	while (hclen > 4 && clLens[CL_ORDER[hclen - 1]] == 0)
+		--hclen;
+	const unsigned long dynamicBits = 3 + 14 + 3 * hclen + cost(clFreq, clLens) + clExtra
+		+ cost(litFreq, litLens) + cost(distFreq, distLens) + extraBits;
+
+	// fixed (RFC 1951 3.2.6)
+	std::vector<unsigned char> fixedLit(288, 8), fixedDist(DIST_CODES, 5);
+	std::fill(fixedLit.begin() + 144, fixedLit.begin() + 256, 9);
+	std::fill(fixedLit.begin() + 256, fixedLit.begin() + 280, 7);
+	std::vector<unsigned long> litFreq288(litFreq);
+	litFreq288.resize(288, 0);
+	const unsigned long fixedBits = 3 + cost(litFreq288, fixedLit) + cost(distFreq, fixedDist) + extraBits;
+
+	// stored
+	const size_t raw = _pos - _blockStart;
+	const bool storable = _blockStart >= _base;
+	const unsigned long storedBits = 8 * (raw + 5 * (raw / MAX_STORED + 1)) + 8;
+
+	if (storable && storedBits <= dynamicBits && storedBits <= fixedBits)
+		_writeStored(out, last);
+	else if (fixedBits <= dynamicBits)
+	{
+		_putBits(out, last ? 1 : 0, 1);
+		_putBits(out, 1, 2);
+		// canonical codes over all 288 fixed lengths: 286 and 287 never occur, but they shape the 8-bit codes.
+		std::vector<unsigned short> litCodes, distCodes;
+		buildCodes(fixedLit, litCodes);
+		buildCodes(fixedDist, distCodes);
+		_writeSymbols(out, fixedLit, litCodes, fixedDist, distCodes);
+	}
+	else
+	{
+		_putBits(out, last ? 1 : 0, 1);
+		_putBits(out, 2, 2);
+		_putBits(out, hlit - 257, 5);
+		_putBits(out, hdist - 1, 5);
+		_putBits(out, hclen - 4, 4);
+		for (size_t i = 0; i < hclen; ++i)
+			_putBits(out, clLens[CL_ORDER[i]], 3);
+		std::vector<unsigned short> clCodes, litCodes, distCodes;
+		buildCodes(clLens, clCodes);
+		for (size_t i = 0; i < clSymbols.size(); ++i)
+		{
+			_putBits(out, clCodes[clSymbols[i].sym], clLens[clSymbols[i].sym]);
+			if (clSymbols[i].extraBits)
+				_putBits(out, clSymbols[i].extra, clSymbols[i].extraBits);
+		}
+		buildCodes(litLens, litCodes);
+		buildCodes(distLens, distCodes);
+		_writeSymbols(out, litLens, litCodes, distLens, distCodes);
+	}
+	_symbols.clear();
+	_blockStart = _pos;
+}
+
+void Deflater::_writeStored(std::string& out, bool last)
+{
+	size_t left = _pos - _blockStart;
+	size_t at = _blockStart - _base;
+	do
+	{
+		const size_t n = std::min<size_t>(left, MAX_STORED);
+		left -= n;
+		_putBits(out, (last && left == 0) ? 1 : 0, 1);
+		_putBits(out, 0, 2);
+		_alignToByte(out);
+		out += static_cast<char>(n & 0xFF);
+		out += static_cast<char>(n >> 8);
+		out += static_cast<char>(~n & 0xFF);
+		out += static_cast<char>((~n >> 8) & 0xFF);
+		out.append(_window, at, n);
+		at += n;
+	} while (left > 0);
+}
+
+void Deflater::_writeSymbols(std::string& out, const std::vector<unsigned char>& litLens,
+							 const std::vector<unsigned short>& litCodes,
+							 const std::vector<unsigned char>& distLens,
+							 const std::vector<unsigned short>& distCodes)
+{
+	for (size_t i = 0; i < _symbols.size(); ++i)
+	{
+		const Symbol& s = _symbols[i];
+		if (s.dist == 0)
+		{
+			_putBits(out, litCodes[s.litLen], litLens[s.litLen]);
+			continue;
+		}
+		unsigned char lc = lengthCode(s.litLen);
+		_putBits(out, litCodes[257 + lc], litLens[257 + lc]);
+		if (LENGTH_EXTRA[lc])
+			_putBits(out, s.litLen - LENGTH_BASE[lc], LENGTH_EXTRA[lc]);
+		unsigned char dc = distCode(s.dist);
+		_putBits(out, distCodes[dc], distLens[dc]);
+		if (DIST_EXTRA[dc])
+			_putBits(out, s.dist - DIST_BASE[dc], DIST_EXTRA[dc]);
+	}
+	_putBits(out, litCodes[END_OF_BLOCK], litLens[END_OF_BLOCK]);
+}
+
+void Deflater::_putBits(std::string& out, unsigned long bits, int count)
+{
+	_bitBuf |= bits << _bitCount;
+	_bitCount += count;
+	while (_bitCount >= 8)
+	{
+		out += static_cast<char>(_bitBuf & 0xFF);
+		_bitBuf >>= 8;
+		_bitCount -= 8;
+	}
+}
+
+void Deflater::_alignToByte(std::string& out)
+{
+	if (_bitCount > 0)
+		out += static_cast<char>(_bitBuf & 0xFF);
+	_bitBuf = 0;
+	_bitCount = 0;
+}
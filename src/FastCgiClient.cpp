@@ -0,0 +1,370 @@
+#include "../includes/FastCgiClient.hpp"
+#include "../includes/CGIManager.hpp"
+#include "../includes/Request.hpp"
+#include "../includes/DataStore.hpp"
+#include "../includes/FatalExceptions.hpp"
+
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+// Record types and constants of the FastCGI 1.0 specification.
+#define FCGI_VERSION_1			1
+#define FCGI_BEGIN_REQUEST		1
+#define FCGI_END_REQUEST		3
+#define FCGI_PARAMS				4
+#define FCGI_STDIN				5
+#define FCGI_STDOUT				6
+#define FCGI_STDERR				7
+#define FCGI_RESPONDER			1
+#define FCGI_KEEP_CONN			1
+#define FCGI_HEADER_LEN			8
+#define FCGI_REQUEST_ID			1		// one request per connection at a time
+#define FCGI_MAX_CONTENT		65535
+
+std::map<std::string, std::vector<int> > FastCgiClient::_idle;
+
+// Canonical Form
+
+FastCgiClient::FastCgiClient()
+	: _fd(-1), _outPos(0), _body(NULL), _bodyLeft(0), _stdinSent(false), _ended(false), _attached(false) {}
+
+// a connection carries one request of one client: a copy only keeps the backend address.
+FastCgiClient::FastCgiClient(const FastCgiClient& other)
+	: _fd(-1), _address(other._address), _outPos(0), _body(NULL), _bodyLeft(0),
+	  _stdinSent(false), _ended(false), _attached(false) {}
+
+FastCgiClient& FastCgiClient::operator=(const FastCgiClient& other)
+{
+	if (this != &other)
+	{
+		_close();
+		_address   = other._address;
+		_out.clear();
+		_outPos	   = 0;
+		_body	   = NULL;
+		_bodyLeft  = 0;
+		_stdinSent = false;
+		_in.clear();
+		_ended	   = false;
+		_attached  = false;
+	}
+	return *this;
+}
+
+FastCgiClient::~FastCgiClient()
+{
+	// a request the backend didn't finish leaves the connection mid-stream: it can't be reused.
+	_close();
+}
+
+// Behavior
+
+void FastCgiClient::start(Request& request, const std::string& scriptPath, const std::string& address)
+{
+	_close();
+	_attached = false;
+	_address = address;
+	_acquire();
+	_queueRequest(request, scriptPath);
+}
+
+void FastCgiClient::attach(int fd, Request& request, const std::string& scriptPath)
+{
+	_close();
+	_attached = true;
+	_address = "cgi_pool";
+	_fd = fd;
+	_queueRequest(request, scriptPath);
+}
+
+bool FastCgiClient::flush()
+{
+	while (_fd >= 0)
+	{
+		if (_outPos == _out.size())
+		{
+			_out.clear();
+			_outPos = 0;
+			_fillStdin();
+			if (_out.empty())
+				return true;
+		}
+		ssize_t n = ::send(_fd, _out.data() + _outPos, _out.size() - _outPos, MSG_NOSIGNAL);
+		if (n > 0)
+		{
+			_outPos += static_cast<size_t>(n);
+			continue;
+		}
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return false;
+		std::string reason = n < 0 ? strerror(errno) : "nothing written";
+		_close();
+		throw ClientException(502, "FastCgiClient::flush: send(): " + reason);
+	}
+	return true;
+}
+
+bool FastCgiClient::receive(std::string& out)
+{
+	if (_fd < 0)
+		return true;
+
+	char buf[16384];
+	ssize_t n = ::recv(_fd, buf, sizeof(buf), 0);
+	if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+		return false;
+	if (n <= 0)
+	{
+		// the answer ends here all the same; whatever came so far is judged like CGI output.
+		if (n < 0)
+			std::cerr << "FastCGI backend " << _address << ": recv(): " << strerror(errno) << std::endl;
+		_close();
+		return true;
+	}
+	_in.append(buf, static_cast<size_t>(n));
+
+	size_t pos = 0;
+	while (_in.size() - pos >= FCGI_HEADER_LEN)
+	{
+		const unsigned char* h = reinterpret_cast<const unsigned char*>(_in.data() + pos);
+		size_t contentLength = (static_cast<size_t>(h[4]) << 8) | h[5];
+		size_t recordLength = FCGI_HEADER_LEN + contentLength + h[6];
+		if (_in.size() - pos < recordLength)
+			break;
+
+		int requestId = (h[2] << 8) | h[3];
+		const char* content = _in.data() + pos + FCGI_HEADER_LEN;
+		if (requestId == FCGI_REQUEST_ID)
+		{
+			if (h[1] == FCGI_STDOUT)
+				out.append(content, contentLength);
+			else if (h[1] == FCGI_STDERR && contentLength > 0)
+				std::cerr << "FastCGI backend " << _address << ": " << std::string(content, contentLength);
+			else if (h[1] == FCGI_END_REQUEST)
+				_ended = true;
+		}
+		pos += recordLength;
+		if (_ended)
+			break;
+	}
+	_in.erase(0, pos);
+
+	if (!_ended)
+		return false;
+	_release();
+	return true;
+}
+
+int FastCgiClient::getFd() const
+{
+	return _fd;
+}
+
+bool FastCgiClient::wantsWrite() const
+{
+	return _fd >= 0 && !_ended && (_outPos < _out.size() || !_stdinSent);
+}
+
+bool FastCgiClient::isReusable() const
+{
+	return _ended && _in.empty() && _stdinSent && _outPos == _out.size();
+}
+
+size_t FastCgiClient::getIdleCount(const std::string& address)
+{
+	std::map<std::string, std::vector<int> >::const_iterator it = _idle.find(address);
+	return it == _idle.end() ? 0 : it->second.size();
+}
+
+void FastCgiClient::closeIdleConnections()
+{
+	for (std::map<std::string, std::vector<int> >::iterator it = _idle.begin(); it != _idle.end(); ++it)
+	{
+		for (size_t i = 0; i < it->second.size(); ++i)
+			close(it->second[i]);
+	}
+	_idle.clear();
+}
+
+// Private Helpers
+
+void FastCgiClient::_queueRequest(Request& request, const std::string& scriptPath)
+{
+	_out.clear();
+	_outPos = 0;
+	_in.clear();
+	_ended = false;
+
+	char begin[8] = { 0, FCGI_RESPONDER, FCGI_KEEP_CONN, 0, 0, 0, 0, 0 };
+	_appendRecord(_out, FCGI_BEGIN_REQUEST, begin, sizeof(begin));
+
+	std::map<std::string, std::string> env;
+	CGIManager::buildEnvironment(request, scriptPath, env);
+	std::string params;
+	for (std::map<std::string, std::string>::const_iterator it = env.begin(); it != env.end(); ++it)
+		_appendParam(params, it->first, it->second);
+	for (size_t pos = 0; pos < params.size(); pos += FCGI_MAX_CONTENT)
+		_appendRecord(_out, FCGI_PARAMS, params.data() + pos, std::min(params.size() - pos, static_cast<size_t>(FCGI_MAX_CONTENT)));
+	_appendRecord(_out, FCGI_PARAMS, NULL, 0);
+
+	_body = &request.getBodyStore();
+	_body->resetReadPosition();
+	_bodyLeft = _body->getSize();
+	_stdinSent = false;
+	_fillStdin();
+}
+
+void FastCgiClient::_acquire()
+{
+	std::vector<int>& idle = _idle[_address];
+	while (!idle.empty())
+	{
+		int fd = idle.back();
+		idle.pop_back();
+		// a backend that closed the connection meanwhile left an EOF to read; a live one left nothing.
+		char probe;
+		if (::recv(fd, &probe, 1, MSG_PEEK | MSG_DONTWAIT) < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+		{
+			_fd = fd;
+			return;
+		}
+		close(fd);
+	}
+	_connect();
+}
+
+void FastCgiClient::_connect()
+{
+	struct sockaddr_un	unixAddr;
+	struct sockaddr_in	inetAddr;
+	struct sockaddr*	addr;
+	socklen_t			addrLen;
+	int					family;
+
+	if (_address.compare(0, 5, "unix:") == 0)
+	{
+		std::memset(&unixAddr, 0, sizeof(unixAddr));
+		unixAddr.sun_family = AF_UNIX;
+		std::strncpy(unixAddr.sun_path, _address.c_str() + 5, sizeof(unixAddr.sun_path) - 1);
+		addr = reinterpret_cast<struct sockaddr*>(&unixAddr);
+		addrLen = sizeof(unixAddr);
+		family = AF_UNIX;
+	}
+	else
+	{
+		// already numeric: the config parser resolved the host once, at startup.
+		size_t colon = _address.rfind(':');
+		std::memset(&inetAddr, 0, sizeof(inetAddr));
+		inetAddr.sin_family = AF_INET;
+		if (colon == std::string::npos
+			|| inet_pton(AF_INET, _address.substr(0, colon).c_str(), &inetAddr.sin_addr) != 1)
+			throw ClientException(502, "FastCgiClient: bad backend address '" + _address + "'");
+		inetAddr.sin_port = htons(static_cast<uint16_t>(std::atoi(_address.c_str() + colon + 1)));
+		addr = reinterpret_cast<struct sockaddr*>(&inetAddr);
+		addrLen = sizeof(inetAddr);
+		family = AF_INET;
+	}
+
+	_fd = socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (_fd < 0)
+		throw ClientException(502, std::string("FastCgiClient: socket(): ") + strerror(errno));
+	if (connect(_fd, addr, addrLen) < 0 && errno != EINPROGRESS)
+	{
+		std::string reason = strerror(errno);
+		_close();
+		throw ClientException(502, "FastCgiClient: connect(" + _address + "): " + reason);
+	}
+}
+
+void FastCgiClient::_fillStdin()
+{
+	if (_stdinSent || (_outPos < _out.size() && _out.size() - _outPos >= FCGI_STDIN_RECORD_SIZE))
+		return;
+	if (_bodyLeft > 0 && _body)
+	{
+		char buf[FCGI_STDIN_RECORD_SIZE];
+		size_t n = _body->read(buf, std::min(_bodyLeft, sizeof(buf)));
+		if (n > 0)
+		{
+			_appendRecord(_out, FCGI_STDIN, buf, n);
+			_bodyLeft -= n;
+			return;
+		}
+		_bodyLeft = 0; // the store ran short of its own size: end the stream with what was sent.
+	}
+	_appendRecord(_out, FCGI_STDIN, NULL, 0);
+	_stdinSent = true;
+	_body = NULL;
+}
+
+void FastCgiClient::_release()
+{
+	if (_attached)
+	{
+		_fd = -1; // the owner gets the socket back through isReusable().
+		_body = NULL;
+		return;
+	}
+	// only a connection with nothing in flight either way can carry the next request.
+	std::vector<int>& idle = _idle[_address];
+	if (_fd >= 0 && _in.empty() && _stdinSent && _outPos == _out.size()
+		&& idle.size() < FCGI_MAX_IDLE_PER_BACKEND)
+	{
+		idle.push_back(_fd);
+		_fd = -1;
+	}
+	_close();
+}
+
+void FastCgiClient::_close()
+{
+	if (_fd >= 0 && !_attached)
+		close(_fd);
+	_fd = -1;
+	_body = NULL;
+}
+
+void FastCgiClient::_appendRecord(std::string& out, unsigned char type, const char* data, size_t n)
+{
+	// content is padded to a multiple of 8 bytes, as the specification recommends.
+	unsigned char padding = static_cast<unsigned char>((8 - n % 8) % 8);
+	char header[FCGI_HEADER_LEN] = {
+		FCGI_VERSION_1, static_cast<char>(type), 0, FCGI_REQUEST_ID,
+		static_cast<char>((n >> 8) & 0xff), static_cast<char>(n & 0xff), static_cast<char>(padding), 0
+	};
+	out.append(header, sizeof(header));
+	if (n > 0)
+		out.append(data, n);
+	out.append(padding, '\0');
+}
+
+void FastCgiClient::_appendParam(std::string& out, const std::string& name, const std::string& value)
+{
+	const std::string* parts[2] = { &name, &value };
+	for (int i = 0; i < 2; ++i)
+	{
+		size_t len = parts[i]->size();
+		if (len < 128)
+			out += static_cast<char>(len);
+		else
+		{
+			out += static_cast<char>(((len >> 24) & 0x7f) | 0x80);
+			out += static_cast<char>((len >> 16) & 0xff);
+			out += static_cast<char>((len >> 8) & 0xff);
+			out += static_cast<char>(len & 0xff);
+		}
+	}
+	out += name;
+	out += value;
+}
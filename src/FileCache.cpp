@@ -0,0 +1,116 @@
+#include "../includes/FileCache.hpp"
+
+#include <sstream>
+
+// Canonical Form
+
+FileCache::FileCache() : _entries(), _lru() {}
+
+FileCache::FileCache(const FileCache& other) : _entries(), _lru()
+{
+	*this = other;
+}
+
+FileCache& FileCache::operator=(const FileCache& other)
+{
+	if (this != &other)
+	{
+		// the stored list iterators belong to other._lru, so rebuild the index in LRU order.
+		clear();
+		for (std::list<std::string>::const_iterator it = other._lru.begin(); it != other._lru.end(); ++it)
+		{
+			Entry& e = _entries[*it];
+			e.file   = other._entries.find(*it)->second.file;
+			e.lruPos = _lru.insert(_lru.end(), *it);
+		}
+	}
+	return *this;
+}
+
+FileCache::~FileCache() {}
+
+FileCache& FileCache::shared()
+{
+	static FileCache instance;
+	return instance;
+}
+
+// Behavior
+
+const CachedFile* FileCache::lookup(const std::string& path, size_t validSeconds, time_t now)
+{
+	std::map<std::string, Entry>::iterator it = _entries.find(path);
+	if (it == _entries.end())
+		return NULL;
+
+	CachedFile& file = it->second.file;
+	if (now - file.validatedAt >= static_cast<time_t>(validSeconds))
+	{
+		struct stat st;
+		if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode) || st.st_mtime != file.mtime
+			|| st.st_size != file.size || st.st_ino != file.inode)
+		{
+			_erase(it);
+			return NULL;
+		}
+		file.validatedAt = now;
+	}
+	_lru.splice(_lru.begin(), _lru, it->second.lruPos);
+	return &file;
+}
+
+const CachedFile* FileCache::store(const std::string& path, const struct stat& st, std::string& body,
+									const std::string& contentType, const std::string& lastModified,
+									size_t maxEntries, time_t now)
+{
+	if (maxEntries == 0)
+		return NULL;
+
+	std::map<std::string, Entry>::iterator it = _entries.find(path);
+	if (it != _entries.end())
+		_erase(it);
+	while (_entries.size() >= maxEntries && !_lru.empty())
+		_erase(_entries.find(_lru.back()));
+
+	Entry& e = _entries[path];
+	e.file.body.swap(body);
+	e.file.contentType = contentType;
+	std::ostringstream len;
+	len << e.file.body.size();
+	e.file.contentLength = len.str();
+	e.file.lastModified  = lastModified;
+	e.file.mtime		 = st.st_mtime;
+	e.file.size		  = st.st_size;
+	e.file.inode		 = st.st_ino;
+	e.file.validatedAt   = now;
+	e.file.gzipBody.clear();
+	e.file.gzipLevel	 = 0;
+	e.lruPos = _lru.insert(_lru.begin(), path);
+	return &e.file;
+}
+
+void FileCache::invalidate(const std::string& path)
+{
+	std::map<std::string, Entry>::iterator it = _entries.find(path);
+	if (it != _entries.end())
+		_erase(it);
+}
+
+void FileCache::clear()
+{
+	_entries.clear();
+	_lru.clear();
+}
+
+size_t FileCache::size() const
+{
+	return _entries.size();
+}
+
+// Private Helpers
+
+void FileCache::_erase(std::map<std::string, Entry>::iterator it)
+{
+	_lru.erase(it->second.lruPos);
+	_entries.erase(it);
+}
@@ -0,0 +1,140 @@
+#include "../includes/FileMapCache.hpp"
+#include "../includes/Deflater.hpp"
+
+#include <sys/mman.h>
+#include <csignal>
+#include <csetjmp>
+#include <cstring>
+
+namespace
+{
+	sigjmp_buf				g_faultJump;
+	volatile sig_atomic_t	g_copying = 0;
+
+	void onBusError(int sig)
+	{
+		if (g_copying)
+		{
+			g_copying = 0;
+			siglongjmp(g_faultJump, 1);
+		}
+		// not ours: returning re-runs the faulting access under the default action.
+		signal(sig, SIG_DFL);
+	}
+
+	void installBusHandler()
+	{
+		static bool installed = false;
+		if (installed)
+			return;
+		struct sigaction sa;
+		std::memset(&sa, 0, sizeof(sa));
+		sa.sa_handler = onBusError;
+		sigemptyset(&sa.sa_mask);
+		// not blocked inside the handler, so leaving it by siglongjmp() needs no mask restore.
+		sa.sa_flags = SA_NODEFER;
+		sigaction(SIGBUS, &sa, NULL);
+		installed = true;
+	}
+}
+
+// Canonical Form
+
+FileMapCache::FileMapCache() : _maps(), _byData() {}
+
+// mappings are owned by exactly one cache, so a copy starts out empty.
+FileMapCache::FileMapCache(const FileMapCache&) : _maps(), _byData() {}
+
+FileMapCache& FileMapCache::operator=(const FileMapCache&)
+{
+	return *this;
+}
+
+FileMapCache::~FileMapCache()
+{
+	for (std::map<const char*, Mapping>::iterator it = _byData.begin(); it != _byData.end(); ++it)
+		munmap(const_cast<char*>(it->first), it->second.length);
+}
+
+FileMapCache& FileMapCache::shared()
+{
+	static FileMapCache instance;
+	return instance;
+}
+
+bool FileMapCache::Key::operator<(const Key& other) const
+{
+	if (ino != other.ino)
+		return ino < other.ino;
+	if (dev != other.dev)
+		return dev < other.dev;
+	if (size != other.size)
+		return size < other.size;
+	return mtime < other.mtime;
+}
+
+// Behavior
+
+const char* FileMapCache::acquire(int fd, const struct stat& st)
+{
+	if (!S_ISREG(st.st_mode) || st.st_size <= 0)
+		return NULL;
+	Key key;
+	key.dev   = st.st_dev;
+	key.ino   = st.st_ino;
+	key.size  = st.st_size;
+	key.mtime = st.st_mtime;
+
+	KeyMap::iterator it = _maps.find(key);
+	if (it != _maps.end())
+	{
+		++_byData[it->second].refs;
+		return it->second;
+	}
+
+	const size_t length = static_cast<size_t>(st.st_size);
+	void* data = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+	if (data == MAP_FAILED)
+		return NULL;
+	installBusHandler();
+	// read front to back, once: aggressive readahead, and pages may go as soon as they are sent.
+	madvise(data, length, MADV_SEQUENTIAL);
+	madvise(data, length, MADV_WILLNEED);
+
+	it = _maps.insert(std::make_pair(key, static_cast<const char*>(data))).first;
+	Mapping& m = _byData[it->second];
+	m.pos	 = it;
+	m.length = length;
+	m.refs	 = 1;
+	return it->second;
+}
+
+void FileMapCache::release(const char* data)
+{
+	std::map<const char*, Mapping>::iterator it = _byData.find(data);
+	if (it == _byData.end())
+		return;
+	if (--it->second.refs > 0)
+		return;
+	_maps.erase(it->second.pos);
+	munmap(const_cast<char*>(data), it->second.length);
+	_byData.erase(it);
+}
+
+bool FileMapCache::feed(Deflater& deflater, const char* src, size_t n, std::string& out)
+{
+	// savemask 0: no sigprocmask() per slice.
+	if (sigsetjmp(g_faultJump, 0))
+		return false;
+	// write() only reads src in its checksum loop and its append to the window, before any local with a
+	// destructor exists, so jumping out of a fault there unwinds nothing.
+	g_copying = 1;
+	deflater.write(src, n, out);
+	g_copying = 0;
+	return true;
+}
+
+size_t FileMapCache::size() const
+{
+	return _byData.size();
+}
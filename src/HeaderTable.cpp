@@ -0,0 +1,118 @@
+#include "../includes/HeaderTable.hpp"
+#include <cstring>
+
+std::string HeaderField::getName() const
+{
+	return std::string(name, nameLen);
+}
+
+std::string HeaderField::getValue() const
+{
+	return std::string(value, valueLen);
+}
+
+// Canonical Form
+
+HeaderTable::HeaderTable() : _fields() {}
+
+HeaderTable::HeaderTable(const HeaderTable& other) : _fields(other._fields) {}
+
+HeaderTable& HeaderTable::operator=(const HeaderTable& other)
+{
+	if (this != &other)
+		_fields = other._fields;
+	return *this;
+}
+
+HeaderTable::~HeaderTable() {}
+
+// Behavior
+
+unsigned HeaderTable::hashName(const char* name, size_t nameLen)
+{
+	unsigned hash = 2166136261u;
+	for (size_t i = 0; i < nameLen; ++i)
+	{
+		hash ^= static_cast<unsigned char>(name[i]);
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+size_t HeaderTable::set(const char* name, size_t nameLen, const char* value, size_t valueLen)
+{
+	return set(name, nameLen, hashName(name, nameLen), value, valueLen);
+}
+
+size_t HeaderTable::set(const char* name, size_t nameLen, unsigned hash, const char* value, size_t valueLen)
+{
+	const HeaderField* existing = find(name, nameLen, hash);
+	if (existing)
+	{
+		size_t index = existing - &_fields[0];
+		_fields[index].value = value;
+		_fields[index].valueLen = valueLen;
+		return index;
+	}
+	HeaderField f = { name, nameLen, value, valueLen, hash };
+	_fields.push_back(f);
+	return _fields.size() - 1;
+}
+
+const HeaderField* HeaderTable::find(const char* name, size_t nameLen) const
+{
+	return find(name, nameLen, hashName(name, nameLen));
+}
+
+const HeaderField* HeaderTable::find(const char* name, size_t nameLen, unsigned hash) const
+{
+	for (size_t i = 0; i < _fields.size(); ++i)
+	{
+		const HeaderField& f = _fields[i];
+		if (f.hash == hash && f.nameLen == nameLen && std::memcmp(f.name, name, nameLen) == 0)
+			return &f;
+	}
+	return NULL;
+}
+
+const HeaderField* HeaderTable::find(const std::string& name) const
+{
+	return find(name.data(), name.size());
+}
+
+void HeaderTable::copyFrom(const HeaderTable& other, Arena& arena)
+{
+	if (this == &other)
+		return;
+	_fields.resize(other._fields.size());
+	for (size_t i = 0; i < other._fields.size(); ++i)
+	{
+		const HeaderField& src = other._fields[i];
+		HeaderField& dst = _fields[i];
+		dst.name = arena.copy(src.name, src.nameLen);
+		dst.nameLen = src.nameLen;
+		dst.value = arena.copy(src.value, src.valueLen);
+		dst.valueLen = src.valueLen;
+		dst.hash = src.hash;
+	}
+}
+
+void HeaderTable::clear()
+{
+	_fields.clear();
+}
+
+size_t HeaderTable::size() const
+{
+	return _fields.size();
+}
+
+bool HeaderTable::empty() const
+{
+	return _fields.empty();
+}
+
+const HeaderField& HeaderTable::operator[](size_t index) const
+{
+	return _fields[index];
+}
@@ -1,6 +1,16 @@
 #include "../includes/LocationConf.hpp"
 
-LocationConf::LocationConf() : _autoIndex(false) {}
+LocationConf::LocationConf()
+	: _autoIndex(false),
+	  _cgiPoolSize(0),
+	  _cgiPoolMaxRequests(DEFAULT_CGI_POOL_MAX_REQUESTS),
+	  _cgiPoolTimeout(DEFAULT_CGI_POOL_TIMEOUT_S),
+	  _gzip(false),
+	  _gzipCompLevel(DEFAULT_GZIP_COMP_LEVEL),
+	  _gzipMinLength(DEFAULT_GZIP_MIN_LENGTH),
+	  _gzipStatic(false),
+	  _expires(EXPIRES_OFF)
+{}
 
 LocationConf::LocationConf(const LocationConf& other)
 	: _path(other._path),
@@ -11,7 +21,18 @@ LocationConf::LocationConf(const LocationConf& other)
 	  _autoIndex(other._autoIndex),
 	  _defaultPage(other._defaultPage),
 	  _storageLocation(other._storageLocation),
-	  _cgiInterpreters(other._cgiInterpreters)
+	  _cgiInterpreters(other._cgiInterpreters),
+	  _fastCgiPass(other._fastCgiPass),
+	  _cgiPoolSize(other._cgiPoolSize),
+	  _cgiPoolMaxRequests(other._cgiPoolMaxRequests),
+	  _cgiPoolTimeout(other._cgiPoolTimeout),
+	  _gzip(other._gzip),
+	  _gzipCompLevel(other._gzipCompLevel),
+	  _gzipMinLength(other._gzipMinLength),
+	  _gzipTypes(other._gzipTypes),
+	  _gzipStatic(other._gzipStatic),
+	  _expires(other._expires),
+	  _cacheControl(other._cacheControl)
 {}
 
 LocationConf& LocationConf::operator=(const LocationConf& other)
@@ -27,6 +48,17 @@ LocationConf& LocationConf::operator=(const LocationConf& other)
 		_defaultPage     = other._defaultPage;
 		_storageLocation = other._storageLocation;
 		_cgiInterpreters = other._cgiInterpreters;
+		_fastCgiPass     = other._fastCgiPass;
+		_cgiPoolSize     = other._cgiPoolSize;
+		_cgiPoolMaxRequests = other._cgiPoolMaxRequests;
+		_cgiPoolTimeout  = other._cgiPoolTimeout;
+		_gzip            = other._gzip;
+		_gzipCompLevel   = other._gzipCompLevel;
+		_gzipMinLength   = other._gzipMinLength;
+		_gzipTypes       = other._gzipTypes;
+		_gzipStatic      = other._gzipStatic;
+		_expires         = other._expires;
+		_cacheControl    = other._cacheControl;
 	}
 	return *this;
 }
@@ -119,7 +151,120 @@ void LocationConf::addCgiInterpreter(const std::string& ext, const std::string&
 	_cgiInterpreters[ext] = interpreterPath;
 }
 
+const std::string& LocationConf::getFastCgiPass() const
+{
+	return _fastCgiPass;
+}
+
+void LocationConf::setFastCgiPass(const std::string& address)
+{
+	_fastCgiPass = address;
+}
+
 bool LocationConf::isCgiExtension(const std::string& ext) const
 {
 	return _cgiInterpreters.find(ext) != _cgiInterpreters.end();
 }
+
+size_t LocationConf::getCgiPoolSize() const
+{
+	return _cgiPoolSize;
+}
+
+size_t LocationConf::getCgiPoolMaxRequests() const
+{
+	return _cgiPoolMaxRequests;
+}
+
+size_t LocationConf::getCgiPoolTimeout() const
+{
+	return _cgiPoolTimeout;
+}
+
+void LocationConf::setCgiPoolSize(size_t workers)
+{
+	_cgiPoolSize = workers;
+}
+
+void LocationConf::setCgiPoolMaxRequests(size_t requests)
+{
+	_cgiPoolMaxRequests = requests;
+}
+
+void LocationConf::setCgiPoolTimeout(size_t seconds)
+{
+	_cgiPoolTimeout = seconds;
+}
+
+bool LocationConf::getGzip() const
+{
+	return _gzip;
+}
+
+int LocationConf::getGzipCompLevel() const
+{
+	return _gzipCompLevel;
+}
+
+size_t LocationConf::getGzipMinLength() const
+{
+	return _gzipMinLength;
+}
+
+bool LocationConf::getGzipStatic() const
+{
+	return _gzipStatic;
+}
+
+void LocationConf::setGzip(bool gzip)
+{
+	_gzip = gzip;
+}
+
+void LocationConf::setGzipCompLevel(int level)
+{
+	_gzipCompLevel = level;
+}
+
+void LocationConf::setGzipMinLength(size_t length)
+{
+	_gzipMinLength = length;
+}
+
+void LocationConf::addGzipType(const std::string& mimeType)
+{
+	_gzipTypes.insert(mimeType);
+}
+
+void LocationConf::setGzipStatic(bool gzipStatic)
+{
+	_gzipStatic = gzipStatic;
+}
+
+bool LocationConf::isGzipType(const std::string& mimeType) const
+{
+	const std::string type = mimeType.substr(0, mimeType.find(';'));
+	if (type == "text/html")
+		return true;
+	return _gzipTypes.count("*") || _gzipTypes.count(type);
+}
+
+long LocationConf::getExpires() const
+{
+	return _expires;
+}
+
+const std::string& LocationConf::getCacheControl() const
+{
+	return _cacheControl;
+}
+
+void LocationConf::setExpires(long seconds)
+{
+	_expires = seconds;
+}
+
+void LocationConf::setCacheControl(const std::string& value)
+{
+	_cacheControl = value;
+}
@@ -0,0 +1,178 @@
+#include "../includes/OpenFileCache.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+
+// Canonical Form
+
+OpenFileCache::OpenFileCache() : _entries(), _lru(), _refs(), _orphans() {}
+
+// descriptors are owned by exactly one cache, so a copy starts out empty.
+OpenFileCache::OpenFileCache(const OpenFileCache&) : _entries(), _lru(), _refs(), _orphans() {}
+
+OpenFileCache& OpenFileCache::operator=(const OpenFileCache& other)
+{
+	if (this != &other)
+		clear();
+	return *this;
+}
+
+OpenFileCache::~OpenFileCache()
+{
+	clear();
+	for (std::set<int>::iterator it = _orphans.begin(); it != _orphans.end(); ++it)
+		close(*it);
+}
+
+OpenFileCache& OpenFileCache::shared()
+{
+	static OpenFileCache instance;
+	return instance;
+}
+
+// Behavior
+
+bool OpenFileCache::stat(const std::string& path, struct stat& st, size_t maxEntries,
+						 size_t validSeconds, size_t inactiveSeconds, time_t now)
+{
+	if (maxEntries == 0)
+		return ::stat(path.c_str(), &st) == 0;
+	Entry* e = _lookup(path, maxEntries, validSeconds, inactiveSeconds, now);
+	if (!e)
+		return false;
+	st = e->st;
+	return true;
+}
+
+int OpenFileCache::acquire(const std::string& path, struct stat& st, size_t maxEntries,
+						   size_t validSeconds, size_t inactiveSeconds, time_t now)
+{
+	Entry* e = _lookup(path, maxEntries, validSeconds, inactiveSeconds, now);
+	if (!e || e->fd < 0)
+	{
+		if (e)
+			errno = EISDIR;
+		return -1;
+	}
+	st = e->st;
+	++_refs[e->fd];
+	return e->fd;
+}
+
+void OpenFileCache::release(int fd)
+{
+	std::map<int, size_t>::iterator ref = _refs.find(fd);
+	if (ref == _refs.end())
+		return;
+	if (--ref->second > 0)
+		return;
+	_refs.erase(ref);
+	if (_orphans.erase(fd))
+		close(fd);
+}
+
+void OpenFileCache::invalidate(const std::string& path)
+{
+	std::map<std::string, Entry>::iterator it = _entries.find(path);
+	if (it != _entries.end())
+		_erase(it);
+}
+
+void OpenFileCache::sweep(time_t now)
+{
+	// the LRU tail holds the least recently used entries, so stop at the first one still active.
+	while (!_lru.empty())
+	{
+		std::map<std::string, Entry>::iterator it = _entries.find(_lru.back());
+		if (now - it->second.lastUsed < static_cast<time_t>(it->second.inactive))
+			break;
+		_erase(it);
+	}
+}
+
+void OpenFileCache::clear()
+{
+	while (!_entries.empty())
+		_erase(_entries.begin());
+}
+
+size_t OpenFileCache::size() const
+{
+	return _entries.size();
+}
+
+// Private Helpers
+
+OpenFileCache::Entry* OpenFileCache::_lookup(const std::string& path, size_t maxEntries,
+											  size_t validSeconds, size_t inactiveSeconds, time_t now)
+{
+	std::map<std::string, Entry>::iterator it = _entries.find(path);
+	if (it != _entries.end())
+	{
+		Entry& e = it->second;
+		if (now - e.validatedAt < static_cast<time_t>(validSeconds))
+		{
+			e.lastUsed = now;
+			_lru.splice(_lru.begin(), _lru, e.lruPos);
+			return &e;
+		}
+		struct stat st;
+		if (::stat(path.c_str(), &st) == 0 && st.st_ino == e.st.st_ino && st.st_dev == e.st.st_dev
+			&& st.st_mtime == e.st.st_mtime && st.st_size == e.st.st_size)
+		{
+			e.validatedAt = now;
+			e.lastUsed	= now;
+			_lru.splice(_lru.begin(), _lru, e.lruPos);
+			return &e;
+		}
+		_erase(it);
+	}
+
+	struct stat st;
+	if (::stat(path.c_str(), &st) != 0)
+		return NULL;
+	int fd = -1;
+	if (S_ISREG(st.st_mode))
+	{
+		fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+			return NULL;
+	}
+	if (maxEntries == 0)
+	{
+		if (fd >= 0)
+			close(fd);
+		errno = ENOSPC;
+		return NULL;
+	}
+	while (_entries.size() >= maxEntries && !_lru.empty())
+		_erase(_entries.find(_lru.back()));
+
+	Entry& e	  = _entries[path];
+	e.fd		  = fd;
+	e.st		  = st;
+	e.validatedAt = now;
+	e.lastUsed	= now;
+	e.inactive	= inactiveSeconds;
+	e.lruPos	  = _lru.insert(_lru.begin(), path);
+	return &e;
+}
+
+void OpenFileCache::_erase(std::map<std::string, Entry>::iterator it)
+{
+	_closeFd(it->second.fd);
+	_lru.erase(it->second.lruPos);
+	_entries.erase(it);
+}
+
+void OpenFileCache::_closeFd(int fd)
+{
+	if (fd < 0)
+		return;
+	// a Response may still be streaming from it; the last release() closes it instead.
+	if (_refs.count(fd))
+		_orphans.insert(fd);
+	else
+		close(fd);
+}
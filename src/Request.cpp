@@ -4,12 +4,23 @@
  */
 
 #include "../includes/Request.hpp"
+#include "../includes/ByteScan.hpp"
 #include <sstream>
+#include <algorithm>
+#include <cstring>
 #include <arpa/inet.h>
 #include <sys/socket.h>
 namespace req_utils
 {//sorry, this is ugly but first time creating a namespace, bear with me ;p
 
+	void trimSlice(const char*& start, const char*& end)
+	{
+		while (start < end && std::isspace(static_cast<unsigned char>(*start)))
+			++start;
+		while (end > start && std::isspace(static_cast<unsigned char>(end[-1])))
+			--end;
+	}
+
 	std::string trim(const std::string& s)
 	{
 		int start = 0;
@@ -37,16 +48,54 @@ namespace req_utils
 		return oss.str();
 	}
 }
+namespace
+{
+	struct WellKnownName
+	{
+		const char*	name;
+		size_t		len;
+	};
+
+	// indexed by WellKnownHeader
+	const WellKnownName kWellKnownNames[HDR_WELL_KNOWN_COUNT] = {
+		{ "host", 4 },
+		{ "content-length", 14 },
+		{ "transfer-encoding", 17 },
+		{ "cookie", 6 },
+		{ "connection", 10 }
+	};
+
+	const unsigned* wellKnownHashes()
+	{
+		static unsigned hashes[HDR_WELL_KNOWN_COUNT];
+		static bool ready = false;
+		if (!ready)
+		{
+			for (int id = 0; id < HDR_WELL_KNOWN_COUNT; ++id)
+				hashes[id] = HeaderTable::hashName(kWellKnownNames[id].name, kWellKnownNames[id].len);
+			ready = true;
+		}
+		return hashes;
+	}
+}
+
 // Canonical Form
 
-Request::Request(): _methodName(UNKNOWN_METHOD), _contentLength(-1), _reqState(REQ_HEADERS), _statusCode("200"), _maxBodySize(0), _totalBytesRead(0), _chunkSize(0), _chunkDecodeOffset(0), _isBodyProcessed(false), _ramParsePos(0)
-{}
+Request::Request(): _methodName(UNKNOWN_METHOD), _contentLength(-1), _headerScanPos(0), _reqState(REQ_HEADERS), _statusCode("200"), _maxBodySize(0), _totalBytesRead(0), _chunkState(CHUNK_SIZE), _chunkSize(0), _chunkLineLen(0), _chunkHasDigits(false)
+{
+	_clearWellKnown();
+}
 
-Request::Request(long long maxBodySize): _methodName(UNKNOWN_METHOD), _contentLength(-1), _reqState(REQ_HEADERS), _statusCode("200"), _maxBodySize(static_cast<size_t>(maxBodySize)), _totalBytesRead(0), _chunkSize(0), _chunkDecodeOffset(0), _isBodyProcessed(false), _ramParsePos(0)
-{}
+Request::Request(long long maxBodySize): _methodName(UNKNOWN_METHOD), _contentLength(-1), _headerScanPos(0), _reqState(REQ_HEADERS), _statusCode("200"), _maxBodySize(static_cast<size_t>(maxBodySize)), _totalBytesRead(0), _chunkState(CHUNK_SIZE), _chunkSize(0), _chunkLineLen(0), _chunkHasDigits(false)
+{
+	_clearWellKnown();
+}
 
-Request::Request(const Request& other): _methodName(other._methodName), _URL(other._URL), _protocol(other._protocol), _query(other._query), _contentLength(other._contentLength), _body(other._body), _decodedBody(other._decodedBody), _headers(other._headers), _cookies(other._cookies), _reqState(other._reqState), _statusCode(other._statusCode), _maxBodySize(other._maxBodySize), _totalBytesRead(other._totalBytesRead), _chunkSize(other._chunkSize), _chunkDecodeOffset(other._chunkDecodeOffset), _isBodyProcessed(other._isBodyProcessed), _chunkBuffer(other._chunkBuffer), _ramParsePos(other._ramParsePos)
+Request::Request(const Request& other): _methodName(other._methodName), _URL(other._URL), _protocol(other._protocol), _query(other._query), _contentLength(other._contentLength), _body(other._body), _arena(), _headers(), _cookies(), _headerScanPos(other._headerScanPos), _lines(), _reqState(other._reqState), _statusCode(other._statusCode), _maxBodySize(other._maxBodySize), _totalBytesRead(other._totalBytesRead), _chunkState(other._chunkState), _chunkSize(other._chunkSize), _chunkLineLen(other._chunkLineLen), _chunkHasDigits(other._chunkHasDigits)
 {
+	_headers.copyFrom(other._headers, _arena);
+	_cookies.copyFrom(other._cookies, _arena);
+	std::copy(other._wellKnown, other._wellKnown + HDR_WELL_KNOWN_COUNT, _wellKnown);
 }
 
 Request& Request::operator=(const Request& other)
@@ -59,24 +108,73 @@ Request& Request::operator=(const Request& other)
 		_query = other._query;
 		_contentLength = other._contentLength;
 		_body = other._body;
-		_decodedBody = other._decodedBody;
-		_headers = other._headers;
-		_cookies = other._cookies;
+		_arena.reset();
+		_headers.copyFrom(other._headers, _arena);
+		_cookies.copyFrom(other._cookies, _arena);
+		std::copy(other._wellKnown, other._wellKnown + HDR_WELL_KNOWN_COUNT, _wellKnown);
+		_headerScanPos = other._headerScanPos;
 		_reqState = other._reqState;
 		_statusCode = other._statusCode;
 		_maxBodySize = other._maxBodySize;
 		_totalBytesRead = other._totalBytesRead;
+		_chunkState = other._chunkState;
 		_chunkSize = other._chunkSize;
-		_chunkDecodeOffset = other._chunkDecodeOffset;
-		_isBodyProcessed = other._isBodyProcessed;
-		_chunkBuffer = other._chunkBuffer;
-		_ramParsePos = other._ramParsePos;
+		_chunkLineLen = other._chunkLineLen;
+		_chunkHasDigits = other._chunkHasDigits;
 	}
 	return *this;
 }
 
 Request::~Request() {}
 
+void Request::reset()
+{
+	_methodName = UNKNOWN_METHOD;
+	_URL.clear();
+	_protocol.clear();
+	_query.clear();
+	_contentLength = -1;
+	_body.clear();
+	_headers.clear();
+	_cookies.clear();
+	_arena.reset();
+	_clearWellKnown();
+	_headerScanPos = 0;
+	_reqState = REQ_HEADERS;
+	_statusCode = "200";
+	_totalBytesRead = 0;
+	_chunkState = CHUNK_SIZE;
+	_chunkSize = 0;
+	_chunkLineLen = 0;
+	_chunkHasDigits = false;
+}
+
+void Request::recycle(size_t keepBytes)
+{
+	reset();
+	_arena.release();
+	_body.shrink(keepBytes);
+}
+
+void Request::setMaxBodySize(long long maxBodySize)
+{
+	_maxBodySize = static_cast<size_t>(maxBodySize);
+}
+
+bool Request::wantsKeepAlive() const
+{
+	const HeaderField* field = getWellKnownHeader(HDR_CONNECTION);
+	std::string connection = field ? field->getValue() : "";
+	for (size_t i = 0; i < connection.size(); ++i)
+		connection[i] = std::tolower(static_cast<unsigned char>(connection[i]));
+
+	if (_protocol == "HTTP/1.1")
+		return connection.find("close") == std::string::npos;
+	if (_protocol == "HTTP/1.0")
+		return connection.find("keep-alive") != std::string::npos;
+	return false;
+}
+
 // Getters
 
 HTTPMethod Request::getMethod() const {
@@ -95,37 +193,37 @@ const std::string& Request::getQuery() const {
 	return _query;
 }
 
-const std::map<std::string, std::string>& Request::getHeaders() const {
+const HeaderTable& Request::getHeaders() const {
 	return _headers;
 }
 
-const std::map<std::string, std::string>& Request::getCookies() const {
+const HeaderTable& Request::getCookies() const {
 	return _cookies;
 }
 
 //  Core Parsing Behavior
-void Request::_parseRequestLine(const std::string& line)
+void Request::_parseRequestLine(const char* line, size_t len)
 {
-	size_t firstSpace = line.find(' ');
-	if (firstSpace == std::string::npos)
+	const char* end = line + len;
+	const char* firstSpace = byte_scan::findByte(line, end, ' ');
+	if (firstSpace == end)
 	{
 		_reqState = REQ_ERROR;
 		_statusCode = "400"; // Bad Request
 		return;
 	}
-	std::string methodStr = line.substr(0, firstSpace);
-	_methodName = AllowedMethods::stringToMethod(methodStr);
+	_methodName = AllowedMethods::stringToMethod(std::string(line, firstSpace));
 	if (_methodName == UNKNOWN_METHOD)
 	{
 		_reqState = REQ_ERROR;
 		_statusCode = "501"; // Not Implemented
 		return;
 	}
-	size_t secondSpace = line.find(' ', firstSpace + 1);
-	if (secondSpace == std::string::npos)
+	const char* secondSpace = byte_scan::findByte(firstSpace + 1, end, ' ');
+	if (secondSpace == end)
 	{
 		// HTTP/0.9: "GET /path"
-		_URL = line.substr(firstSpace + 1);
+		_URL.assign(firstSpace + 1, end);
 		if (_URL.empty() || _URL[0] != '/')
 		{
 			_reqState = REQ_ERROR;
@@ -137,8 +235,8 @@ void Request::_parseRequestLine(const std::string& line)
 		_reqState = REQ_DONE;
 		return;
 	}
-	_URL = line.substr(firstSpace + 1, secondSpace - firstSpace - 1);
-	_protocol = line.substr(secondSpace + 1);
+	_URL.assign(firstSpace + 1, secondSpace);
+	_protocol.assign(secondSpace + 1, end);
 	if (_protocol != "HTTP/1.0" && _protocol != "HTTP/1.1")
 	{
 		_reqState = REQ_ERROR;
@@ -167,68 +265,77 @@ void Request::_extractQueryFromURL()
 
 size_t Request::parseHeaders(const std::string& rawBuffer)
 {
-	size_t headerEnd = rawBuffer.find("\r\n\r\n");
-	if (headerEnd == std::string::npos)
+	// resume where the last call stopped; the terminator may straddle the previous recv().
+	size_t from = _headerScanPos > 3 ? _headerScanPos - 3 : 0;
+	const char* data = rawBuffer.data();
+	const char* found = byte_scan::findHeaderEnd(data + from, data + rawBuffer.size());
+	if (found == data + rawBuffer.size())
+	{
+		_headerScanPos = rawBuffer.size();
 		return 0;
+	}
+	size_t headerEnd = found - data;
+	_headerScanPos = 0;
 	_cookies.clear();
 
-	std::string headerSection = rawBuffer.substr(0, headerEnd);
-	size_t lineStart = 0;
+	// the header block is copied into the arena once; names and values are views into that copy.
+	char* block = _arena.copy(rawBuffer.data(), headerEnd);
+	// one vector pass over the block finds every line, its first colon and any control byte.
+	byte_scan::splitLines(block, block + headerEnd, _lines);
 	bool firstLine = true;
 
-	while (lineStart < headerSection.size())
+	for (size_t i = 0; i < _lines.size(); ++i)
 	{
-		size_t lineEnd = headerSection.find("\r\n", lineStart);
-		if (lineEnd == std::string::npos)
-			lineEnd = headerSection.size();
-
-		std::string line = headerSection.substr(lineStart, lineEnd - lineStart);
-		if (!line.empty())
+		const byte_scan::Line& line = _lines[i];
+		if (line.end == line.start)
+			continue;
+		if (firstLine)
 		{
-			if (firstLine)
-			{
-				_parseRequestLine(line);
-				firstLine = false;
-			}
-			else
-				_parseHeaderLine(line);
+			_parseRequestLine(block + line.start, line.end - line.start);
+			firstLine = false;
 		}
-		lineStart = lineEnd + 2;
+		else
+			_parseHeaderLine(block, line);
 	}
 	if (_reqState != REQ_ERROR)
 		_typeOfReq();
-	if (_headers.count("cookie"))
-		_parseCookies(_headers["cookie"]);
+	const HeaderField* cookie = getWellKnownHeader(HDR_COOKIE);
+	if (cookie)
+		_parseCookies(*cookie);
 	return headerEnd + 4;
 }
 
-void Request::_parseCookies(const std::string& cookieHeader)
+void Request::_parseCookies(const HeaderField& cookieHeader)
 {
-	size_t pos = 0;
-	while (pos < cookieHeader.size())
+	// cookie slices point into the header's value, which already lives in the arena.
+	const char* pos = cookieHeader.value;
+	const char* end = cookieHeader.value + cookieHeader.valueLen;
+	while (pos < end)
 	{
-		size_t semicolonPos = cookieHeader.find(';', pos);
-		if (semicolonPos == std::string::npos)
-			semicolonPos = cookieHeader.size();
-
-		std::string token = req_utils::trim(cookieHeader.substr(pos, semicolonPos - pos));
-		size_t eqPos = token.find('=');
-		if (eqPos != std::string::npos)
+		const char* semicolon = byte_scan::findByte(pos, end, ';');
+		const char* eq = byte_scan::findByte(pos, semicolon, '=');
+		if (eq != semicolon)
 		{
-			std::string key = req_utils::trim(token.substr(0, eqPos));
-			std::string value = req_utils::trim(token.substr(eqPos + 1));
-			if (!key.empty())
-				_cookies[key] = value;
+			const char* keyStart = pos;
+			const char* keyEnd = eq;
+			const char* valueStart = eq + 1;
+			const char* valueEnd = semicolon;
+			req_utils::trimSlice(keyStart, keyEnd);
+			req_utils::trimSlice(valueStart, valueEnd);
+			if (keyEnd > keyStart)
+				_cookies.set(keyStart, keyEnd - keyStart, valueStart, valueEnd - valueStart);
 		}
-		pos = semicolonPos + 1;
+		pos = semicolon + 1;
 	}
 }
 
 void Request::_typeOfReq()
 {
 	// determine body transfer mode from the parsed headers
-	std::string transferEncoding = getHeader("Transfer-Encoding");
-	std::string contentLengthStr = getHeader("Content-Length");
+	const HeaderField* teField = getWellKnownHeader(HDR_TRANSFER_ENCODING);
+	const HeaderField* clField = getWellKnownHeader(HDR_CONTENT_LENGTH);
+	std::string transferEncoding = teField ? teField->getValue() : "";
+	std::string contentLengthStr = clField ? clField->getValue() : "";
 
 	std::string toLower = transferEncoding;
 	for (size_t i = 0; i < toLower.size(); ++i)
@@ -271,96 +378,206 @@ std::string Request::getHeader(const std::string& key) const
 	{
 		keyCopy[i] = std::tolower(static_cast<unsigned char>(keyCopy[i]));
 	}
-	if (_headers.count(keyCopy))
-		return _headers.find(keyCopy)->second;
+	const HeaderField* field = _headers.find(keyCopy);
+	if (field)
+		return field->getValue();
 	return "";
 }
 
+const HeaderField* Request::getWellKnownHeader(WellKnownHeader id) const
+{
+	return _wellKnown[id] < 0 ? NULL : &_headers[_wellKnown[id]];
+}
+
 std::string Request::getCookie(const std::string& key) const
 {
-	std::map<std::string, std::string>::const_iterator it = _cookies.find(key);
-	if (it == _cookies.end())
+	const HeaderField* field = _cookies.find(key);
+	if (!field)
 		return "";
-	return it->second;
+	return field->getValue();
 }
 
-void Request::_parseHeaderLine(const std::string& line)
+void Request::_parseHeaderLine(char* block, const byte_scan::Line& span)
 {
-	size_t colonPos = line.find(':');
-	if (colonPos == std::string::npos)
+	// a bare CR, NUL or other control byte in a field is a smuggling vector, not a typo.
+	if (span.control)
+	{
+		_reqState = REQ_ERROR;
+		_statusCode = "400"; // Bad Request
+		return;
+	}
+	char* line = block + span.start;
+	char* end = block + span.end;
+	char* colon = block + span.colon;
+	if (colon == end)
 		return;
 
-	std::string key = req_utils::trim(line.substr(0, colonPos));
-	std::string value = req_utils::trim(line.substr(colonPos + 1));
+	const char* keyStart = line;
+	const char* keyEnd = colon;
+	const char* valueStart = colon + 1;
+	const char* valueEnd = end;
+	req_utils::trimSlice(keyStart, keyEnd);
+	req_utils::trimSlice(valueStart, valueEnd);
+	if (keyEnd == keyStart)
+		return;
 
-	for (size_t i = 0; i < key.size(); ++i)
+	// lowercase in place (the block is our own copy) and hash in the same pass.
+	char* key = line + (keyStart - line);
+	size_t keyLen = keyEnd - keyStart;
+	unsigned hash = 2166136261u;
+	for (size_t i = 0; i < keyLen; ++i)
+	{
 		key[i] = std::tolower(static_cast<unsigned char>(key[i]));
-	if (!key.empty())
-		_headers[key] = value;
-}
+		hash = (hash ^ static_cast<unsigned char>(key[i])) * 16777619u;
+	}
+	size_t index = _headers.set(key, keyLen, hash, valueStart, valueEnd - valueStart);
 
-bool Request::processBodySlice()
-{
-	if (_contentLength >= 0 || _isBodyProcessed || _reqState == REQ_ERROR)
-		return true;
-
-	std::vector<char> tempBuffer(PARSE_BYTE_SLICE);
-	size_t ReadBaytes = _body.read(&tempBuffer[0], tempBuffer.size());
-	_totalBytesRead += ReadBaytes;
-	_chunkBuffer += std::string(&tempBuffer[0], ReadBaytes);
-	while (true)
+	const unsigned* known = wellKnownHashes();
+	for (int id = 0; id < HDR_WELL_KNOWN_COUNT; ++id)
 	{
-		size_t crlfPos = _chunkBuffer.find("\r\n");
-		if (crlfPos == std::string::npos)
-			break;
-		std::string hexStr = _chunkBuffer.substr(0, crlfPos);
-		size_t semi = hexStr.find(';');
-		if (semi != std::string::npos)
-			hexStr = hexStr.substr(0, semi);
-
-		unsigned long chunkSize = strtoul(hexStr.c_str(), NULL, 16);
-		size_t totalBytesNeeded = crlfPos + 2 + chunkSize + 2;
-
-		if (_chunkBuffer.size() < totalBytesNeeded)
-			break;
-		if (_chunkBuffer.substr(crlfPos + 2 + chunkSize, 2) != "\r\n") {
-			_reqState = REQ_ERROR;
-			_statusCode = "400"; // Malformed chunk formatting
-			return true;
-		}
-		if (chunkSize == 0) {
-			_chunkBuffer.erase(0, totalBytesNeeded);
-			_isBodyProcessed = true;
+		if (known[id] == hash && keyLen == kWellKnownNames[id].len
+			&& std::memcmp(key, kWellKnownNames[id].name, keyLen) == 0)
+		{
+			_wellKnown[id] = static_cast<int>(index);
 			break;
 		}
-
-		_decodedBody.append(_chunkBuffer.substr(crlfPos + 2, chunkSize));
-		if (_maxBodySize > 0 && _decodedBody.getSize() > _maxBodySize) {
-			_reqState = REQ_ERROR;
-			_statusCode = "413"; // Payload Too Large
-			return true;
-		}
-		_chunkBuffer.erase(0, totalBytesNeeded);
 	}
+}
 
-	if (_isBodyProcessed) {
-		_body = _decodedBody;
-		_chunkBuffer.clear();
-		_body.resetReadPosition();
-		std::stringstream ss;
-		ss << _body.getSize();
-		std::string str = ss.str();
-		_headers["content-length"] = str;
-		return true;
-	}
-	return false;
+void Request::_clearWellKnown()
+{
+	std::fill(_wellKnown, _wellKnown + HDR_WELL_KNOWN_COUNT, -1);
+}
+
+void Request::_chunkError(const char* statusCode)
+{
+	_reqState = REQ_ERROR;
+	_statusCode = statusCode;
 }
 
-bool Request::isChunkedDone(const std::string& newData) const
+void Request::_finishChunked()
 {
-	return newData.find("0\r\n\r\n") != std::string::npos;
+	_reqState = REQ_DONE;
+	_body.resetReadPosition();
+	std::stringstream ss;
+	ss << _body.getSize();
+	std::string str = ss.str();
+	size_t index = _headers.set("content-length", 14, _arena.copy(str.data(), str.size()), str.size());
+	_wellKnown[HDR_CONTENT_LENGTH] = static_cast<int>(index);
 }
 
+size_t Request::feedChunked(const char* buf, size_t n)
+{
+	const char* p = buf;
+	const char* end = buf + n;
+
+	while (p < end && _reqState == REQ_CHUNKED)
+	{
+		if (_chunkState == CHUNK_DATA)
+		{
+			// payload goes from the recv() buffer to the store in one append, whatever the split.
+			size_t take = std::min(static_cast<size_t>(end - p), _chunkSize);
+			if (_maxBodySize > 0 && _body.getSize() + take > _maxBodySize)
+			{
+				_chunkError("413"); // Payload Too Large
+				break;
+			}
+			_body.append(p, take);
+			p += take;
+			_chunkSize -= take;
+			if (_chunkSize == 0)
+				_chunkState = CHUNK_DATA_CR;
+			continue;
+		}
+		if (_chunkState == CHUNK_EXT || _chunkState == CHUNK_TRAILER_LINE)
+		{
+			// nothing in an extension or a trailer is used, so skip straight to its CR.
+			const char* cr = byte_scan::findByte(p, end, '\r');
+			_chunkLineLen += cr - p;
+			if (_chunkLineLen > MAX_CHUNK_LINE_SIZE)
+			{
+				_chunkError("400");
+				break;
+			}
+			p = cr;
+			if (p == end)
+				break;
+			++p;
+			_chunkState = (_chunkState == CHUNK_EXT) ? CHUNK_SIZE_LF : CHUNK_TRAILER_LF;
+			continue;
+		}
+
+		char c = *p++;
+		if (++_chunkLineLen > MAX_CHUNK_LINE_SIZE)
+		{
+			_chunkError("400");
+			break;
+		}
+		switch (_chunkState)
+		{
+			case CHUNK_SIZE:
+			{
+				int digit = (c >= '0' && c <= '9') ? c - '0'
+					: (c >= 'a' && c <= 'f') ? c - 'a' + 10
+					: (c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+				if (digit >= 0)
+				{
+					if (_chunkSize > (static_cast<size_t>(-1) >> 4))
+						_chunkError("400"); // size overflows
+					_chunkSize = (_chunkSize << 4) | static_cast<size_t>(digit);
+					_chunkHasDigits = true;
+				}
+				else if (!_chunkHasDigits)
+					_chunkError("400");
+				else if (c == ';' || c == ' ' || c == '\t')
+					_chunkState = CHUNK_EXT;
+				else if (c == '\r')
+					_chunkState = CHUNK_SIZE_LF;
+				else
+					_chunkError("400");
+				break;
+			}
+			case CHUNK_SIZE_LF:
+				if (c != '\n')
+					_chunkError("400");
+				else
+					_chunkState = _chunkSize ? CHUNK_DATA : CHUNK_TRAILER;
+				_chunkLineLen = 0;
+				break;
+			case CHUNK_DATA_CR:
+				if (c != '\r')
+					_chunkError("400"); // Malformed chunk formatting
+				_chunkState = CHUNK_DATA_LF;
+				break;
+			case CHUNK_DATA_LF:
+				if (c != '\n')
+					_chunkError("400");
+				_chunkState = CHUNK_SIZE;
+				_chunkHasDigits = false;
+				_chunkLineLen = 0;
+				break;
+			case CHUNK_TRAILER:
+				_chunkState = (c == '\r') ? CHUNK_END_LF : CHUNK_TRAILER_LINE;
+				break;
+			case CHUNK_TRAILER_LF:
+				if (c != '\n')
+					_chunkError("400");
+				_chunkState = CHUNK_TRAILER;
+				break;
+			case CHUNK_END_LF:
+				if (c != '\n')
+					_chunkError("400");
+				else
+					_finishChunked();
+				break;
+			default:
+				break;
+		}
+	}
+	size_t used = p - buf;
+	_totalBytesRead += used;
+	return used;
+}
 
 //  State Management Getters
 
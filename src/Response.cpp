@@ -1,10 +1,17 @@
 #include "../includes/Response.hpp"
 #include "../includes/LocationConf.hpp"
 #include "../includes/CGIManager.hpp"
+#include "../includes/CgiWorkerPool.hpp"
 #include "../includes/FatalExceptions.hpp"
+#include "../includes/FileCache.hpp"
+#include "../includes/OpenFileCache.hpp"
+#include "../includes/FileMapCache.hpp"
+#include "../includes/ByteScan.hpp"
 
 #include <sys/stat.h>
 #include <sys/socket.h>
+#include <sys/sendfile.h>
+#include <sys/uio.h>
 #include <fcntl.h>
 #include <dirent.h>
 #include <unistd.h>
@@ -12,9 +19,11 @@
 #include <cstring>
 #include <ctime>
 #include <sstream>
+#include <iomanip>
 #include <cctype>
 #include <algorithm>
 #include <cstdio>
+#include <cstdlib>
 #include <csignal>
 #include <sys/wait.h>
 
@@ -119,14 +128,35 @@ std::string sizeToString(size_t n) {
 	return ss.str();
 }
 
-std::string currentHttpDate() {
-	time_t now = time(NULL);
-	struct tm* gmt = gmtime(&now);
+std::string httpDate(time_t t) {
+	struct tm* gmt = gmtime(&t);
 	char buf[64];
 	strftime(buf, sizeof(buf), "%a, %d %b %Y %H:%M:%S GMT", gmt);
 	return std::string(buf);
 }
 
+std::string currentHttpDate() {
+	return httpDate(time(NULL));
+}
+
+/**
+ * @brief Reads a whole regular file into memory with pread(), leaving the fd's position untouched
+ * (it may be shared through the OpenFileCache); false if it could not be read in full.
+ */
+bool slurpFile(int fd, size_t size, std::string& out)
+{
+	out.resize(size);
+	size_t got = 0;
+	while (got < size)
+	{
+		ssize_t n = pread(fd, &out[got], size - got, static_cast<off_t>(got));
+		if (n <= 0)
+			break;
+		got += static_cast<size_t>(n);
+	}
+	return got == size;
+}
+
 std::string buildAutoIndexPage(const std::string& url, const std::string& dirPath)
 {
 	DIR* dir = opendir(dirPath.c_str());
@@ -198,6 +228,238 @@ std::string extractFilenameFromUrl(const std::string& url)
 	return url.substr(pos + 1);
 }
 
+/**
+ * @brief ACCEPT_* bits of the codings an Accept-Encoding value allows: "q=0" refuses one,
+ * and "*" stands for every coding the value doesn't name (RFC 9110 12.5.3).
+ */
+int acceptedCodings(const std::string& header)
+{
+	int codings = 0;
+	int named = 0;			// listed by name, accepted or refused
+	bool wildcard = false;
+	size_t pos = 0;
+	while (pos < header.size())
+	{
+		size_t end = header.find(',', pos);
+		if (end == std::string::npos)
+			end = header.size();
+		std::string item = header.substr(pos, end - pos);
+		pos = end + 1;
+
+		std::string q;
+		size_t semi = item.find(';');
+		if (semi != std::string::npos)
+		{
+			size_t eq = item.find('=', semi);
+			if (eq != std::string::npos)
+				q = item.substr(eq + 1);
+			item.erase(semi);
+		}
+		size_t first = item.find_first_not_of(" \t");
+		size_t last  = item.find_last_not_of(" \t");
+		if (first == std::string::npos)
+			continue;
+		item = item.substr(first, last - first + 1);
+		for (size_t i = 0; i < item.size(); ++i)
+			item[i] = static_cast<char>(tolower(static_cast<unsigned char>(item[i])));
+		q.erase(0, std::min(q.size(), q.find_first_not_of(" \t")));
+		const bool refused = !q.empty() && std::strtod(q.c_str(), NULL) <= 0.0;
+
+		int coding = 0;
+		if (item == "gzip" || item == "x-gzip")
+			coding = ACCEPT_GZIP;
+		else if (item == "deflate")
+			coding = ACCEPT_DEFLATE;
+		else if (item == "*")
+			wildcard = !refused;
+		named |= coding;
+		if (!refused)
+			codings |= coding;
+	}
+	if (wildcard)
+		codings |= (ACCEPT_GZIP | ACCEPT_DEFLATE) & ~named;
+	return codings;
+}
+
+const char* codingName(DeflateFormat format)
+{
+	return format == DEFLATE_GZIP ? "gzip" : "deflate";
+}
+
+/**
+ * @brief Validator of one version of a file: inode, size and mtime in hex. An encoded body gets the
+ * weak form, since its bytes differ from the file's while it still means the same version.
+ */
+std::string makeEtag(ino_t inode, off_t size, time_t mtime, bool weak)
+{
+	std::ostringstream oss;
+	if (weak)
+		oss << "W/";
+	oss << '"' << std::hex << static_cast<unsigned long>(inode) << '-' << static_cast<unsigned long long>(size)
+		<< '-' << static_cast<long long>(mtime) << '"';
+	return oss.str();
+}
+
+/**
+ * @brief Weak comparison (RFC 9110 8.8.3.2) of etag against an If-None-Match list; "*" matches anything.
+ */
+bool etagListMatches(const std::string& list, const std::string& etag)
+{
+	const std::string opaque = etag.compare(0, 2, "W/") == 0 ? etag.substr(2) : etag;
+	size_t pos = 0;
+	while (pos < list.size())
+	{
+		size_t end = list.find(',', pos);
+		if (end == std::string::npos)
+			end = list.size();
+		size_t first = list.find_first_not_of(" \t", pos);
+		size_t last  = list.find_last_not_of(" \t", end - 1);
+		pos = end + 1;
+		if (first == std::string::npos || first >= end)
+			continue;
+		std::string tag = list.substr(first, last - first + 1);
+		if (tag == "*")
+			return true;
+		if (tag.compare(0, 2, "W/") == 0)
+			tag.erase(0, 2);
+		if (tag == opaque)
+			return true;
+	}
+	return false;
+}
+
+/**
+ * @brief Parses an IMF-fixdate ("Sun, 06 Nov 1994 08:49:37 GMT"), the only form httpDate() emits.
+ */
+bool parseHttpDate(const std::string& value, time_t& out)
+{
+	struct tm tm;
+	std::memset(&tm, 0, sizeof(tm));
+	const char* end = strptime(value.c_str(), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+	if (!end || *end != '\0')
+		return false;
+	out = timegm(&tm);
+	return out != static_cast<time_t>(-1);
+}
+
+enum RangeVerdict
+{
+	RANGE_WHOLE,		// no usable Range: the whole body, 200
+	RANGE_PARTS,		// 206
+	RANGE_UNSATISFIABLE	// 416
+};
+
+bool parseOffset(const std::string& digits, size_t& out)
+{
+	// 18 digits always fit; files are never that large anyway.
+	if (digits.empty() || digits.size() > 18 || digits.find_first_not_of("0123456789") != std::string::npos)
+		return false;
+	out = static_cast<size_t>(std::strtoull(digits.c_str(), NULL, 10));
+	return true;
+}
+
+/**
+ * @brief Resolves a "bytes=" Range (RFC 9110 14.1.2) against a body of size bytes. Unsatisfiable parts
+ * are dropped; the rest come back sorted, with overlapping or adjacent parts merged.
+ * A header that doesn't parse, or asks for more than MAX_BYTE_RANGES parts, is ignored.
+ */
+RangeVerdict parseRanges(const std::string& header, size_t size, std::vector<ByteRange>& out)
+{
+	out.clear();
+	if (header.compare(0, 6, "bytes=") != 0)
+		return RANGE_WHOLE;
+	size_t pos = 6;
+	size_t parts = 0;
+	while (pos <= header.size())
+	{
+		size_t end = header.find(',', pos);
+		if (end == std::string::npos)
+			end = header.size();
+		std::string spec = header.substr(pos, end - pos);
+		pos = end + 1;
+		size_t first = spec.find_first_not_of(" \t");
+		if (first == std::string::npos)
+			continue;
+		spec = spec.substr(first, spec.find_last_not_of(" \t") - first + 1);
+		if (++parts > MAX_BYTE_RANGES)
+			return RANGE_WHOLE;
+
+		size_t dash = spec.find('-');
+		if (dash == std::string::npos)
+			return RANGE_WHOLE;
+		ByteRange range;
+		if (dash == 0)
+		{
+			size_t suffix;
+			if (!parseOffset(spec.substr(1), suffix))
+				return RANGE_WHOLE;
+			if (suffix == 0 || size == 0)
+				continue;
+			range.first = size > suffix ? size - suffix : 0;
+			range.last  = size - 1;
+		}
+		else
+		{
+			size_t last = 0;
+			if (!parseOffset(spec.substr(0, dash), range.first))
+				return RANGE_WHOLE;
+			const bool open = dash + 1 == spec.size();
+			if (!open && (!parseOffset(spec.substr(dash + 1), last) || last < range.first))
+				return RANGE_WHOLE;
+			if (range.first >= size)
+				continue;
+			range.last = open ? size - 1 : std::min(last, size - 1);
+		}
+		out.push_back(range);
+	}
+	if (parts == 0)
+		return RANGE_WHOLE;
+	if (out.empty())
+		return RANGE_UNSATISFIABLE;
+
+	for (size_t i = 1; i < out.size(); ++i)
+		for (size_t k = i; k > 0 && out[k].first < out[k - 1].first; --k)
+			std::swap(out[k], out[k - 1]);
+	size_t kept = 0;
+	for (size_t i = 1; i < out.size(); ++i)
+	{
+		if (out[i].first <= out[kept].last + 1)
+			out[kept].last = std::max(out[kept].last, out[i].last);
+		else
+			out[++kept] = out[i];
+	}
+	out.resize(kept + 1);
+	return RANGE_PARTS;
+}
+
+std::string contentRange(const ByteRange& range, size_t size)
+{
+	std::ostringstream oss;
+	oss << "bytes " << range.first << '-' << range.last << '/' << size;
+	return oss.str();
+}
+
+// delimiter and headers that open one part of a multipart/byteranges body.
+std::string rangePartHead(const std::string& boundary, const std::string& contentType,
+						  const ByteRange& range, size_t size)
+{
+	return "\r\n--" + boundary + "\r\nContent-Type: " + contentType + "\r\nContent-Range: "
+		+ contentRange(range, size) + "\r\n\r\n";
+}
+
+std::string rangeClosing(const std::string& boundary)
+{
+	return "\r\n--" + boundary + "--\r\n";
+}
+
+std::string newBoundary()
+{
+	static unsigned long counter = 0;
+	std::ostringstream oss;
+	oss << std::setfill('0') << std::setw(10) << static_cast<unsigned long>(time(NULL)) << std::setw(10) << ++counter;
+	return oss.str();
+}
+
 }
 
 Response::Response()
@@ -210,17 +472,45 @@ Response::Response()
 	  _headers(),
 	  _setCookies(),
 	  _fileFd(-1),
+	  _fileFdShared(false),
 	  _fileSize(0),
-	  _streamBuf(),
-	  _streamBufLen(0),
-	  _streamBufSent(0),
+	  _fileOffset(0),
+	  _fileEnd(0),
+	  _ranges(),
+	  _rangeIndex(0),
+	  _boundary(),
+	  _rangeType(),
+	  _deflater(NULL),
+	  _fileMap(NULL),
+	  _location(NULL),
+	  _etag(),
+	  _lastModified(),
+	  _range(),
+	  _acceptCodings(0),
+	  _acceptsChunked(false),
 	  _cgiInstance(NULL),
-	  _currentChunkSize(0),
+	  _fastCgi(NULL),
+	  _cgiWorkerFd(-1),
+	  _cgiTimeout(0),
+	  _cgiHead(),
+	  _relay(),
+	  _relayPos(0),
+	  _cgiBodyLeft(-1),
+	  _cgiChunked(false),
+	  _cgiStreaming(false),
+	  _cgiEof(false),
+	  _cgiInput(),
+	  _cgiInputPos(0),
+	  _cgiInputLeft(0),
+	  _cgiUpload(false),
+	  _cgiInputClosed(false),
 	  _buildPhase(BUILD_IDLE),
 	  _cachedConfig(NULL),
 	  _postOutFd(-1),
 	  _postWritePos(0),
 	  _responseState(SENDING_RES_HEAD),
+	  _keepAlive(false),
+	  _wouldBlock(false),
 	  _headerBuffer()
 {}
 
@@ -234,18 +524,46 @@ Response::Response(const Response& other)
 	  _headers(other._headers),
 	  _setCookies(other._setCookies),
 	  _fileFd(-1),
+	  _fileFdShared(false),
 	  _fileSize(other._fileSize),
-	  _streamBuf(other._streamBuf),
-	  _streamBufLen(other._streamBufLen),
-	  _streamBufSent(other._streamBufSent),
+	  _fileOffset(other._fileOffset),
+	  _fileEnd(other._fileEnd),
+	  _ranges(other._ranges),
+	  _rangeIndex(other._rangeIndex),
+	  _boundary(other._boundary),
+	  _rangeType(other._rangeType),
+	  _deflater(NULL),
+	  _fileMap(NULL),
+	  _location(other._location),
+	  _etag(other._etag),
+	  _lastModified(other._lastModified),
+	  _range(other._range),
+	  _acceptCodings(other._acceptCodings),
+	  _acceptsChunked(other._acceptsChunked),
 	  _cgiInstance(NULL),
-	  _currentChunkSize(other._currentChunkSize),
+	  _fastCgi(NULL),
+	  _cgiWorkerFd(-1),
+	  _cgiTimeout(other._cgiTimeout),
+	  _cgiHead(other._cgiHead),
+	  _relay(other._relay),
+	  _relayPos(other._relayPos),
+	  _cgiBodyLeft(other._cgiBodyLeft),
+	  _cgiChunked(other._cgiChunked),
+	  _cgiStreaming(other._cgiStreaming),
+	  _cgiEof(other._cgiEof),
+	  _cgiInput(other._cgiInput),
+	  _cgiInputPos(other._cgiInputPos),
+	  _cgiInputLeft(other._cgiInputLeft),
+	  _cgiUpload(other._cgiUpload),
+	  _cgiInputClosed(other._cgiInputClosed),
 	  _buildPhase(other._buildPhase),
 	  _cachedConfig(other._cachedConfig),
 	  _postOutFd(-1),
 	  _postWritePos(other._postWritePos),
 	  _postFilename(other._postFilename),
 	  _responseState(other._responseState),
+	  _keepAlive(other._keepAlive),
+	  _wouldBlock(other._wouldBlock),
 	  _headerBuffer(other._headerBuffer)
 {}
 
@@ -259,16 +577,33 @@ Response& Response::operator=(const Response& other) {
 		_totalBytesSent	= other._totalBytesSent;
 		_headers		   = other._headers;
 		_setCookies	   = other._setCookies;
-		if (_fileFd != -1)
-		{
-			close(_fileFd);
-			_fileFd = -1;
-		}
+		_closeFile();
 		_fileSize	  = other._fileSize;
-		_streamBuf	 = other._streamBuf;
-		_streamBufLen  = other._streamBufLen;
-		_streamBufSent = other._streamBufSent;
-		_currentChunkSize = other._currentChunkSize;
+		_fileOffset	= other._fileOffset;
+		_fileEnd	   = other._fileEnd;
+		_ranges		   = other._ranges;
+		_rangeIndex	   = other._rangeIndex;
+		_boundary	   = other._boundary;
+		_rangeType	   = other._rangeType;
+		_location	   = other._location;
+		_etag		   = other._etag;
+		_lastModified  = other._lastModified;
+		_range		   = other._range;
+		_acceptCodings = other._acceptCodings;
+		_acceptsChunked = other._acceptsChunked;
+		_cgiTimeout	   = other._cgiTimeout;
+		_cgiHead	   = other._cgiHead;
+		_relay		   = other._relay;
+		_relayPos	   = other._relayPos;
+		_cgiBodyLeft   = other._cgiBodyLeft;
+		_cgiChunked	   = other._cgiChunked;
+		_cgiStreaming  = other._cgiStreaming;
+		_cgiEof		   = other._cgiEof;
+		_cgiInput	   = other._cgiInput;
+		_cgiInputPos   = other._cgiInputPos;
+		_cgiInputLeft  = other._cgiInputLeft;
+		_cgiUpload	   = other._cgiUpload;
+		_cgiInputClosed = other._cgiInputClosed;
 		_buildPhase	   = other._buildPhase;
 		_cachedConfig  = other._cachedConfig;
 		if (_postOutFd != -1)
@@ -279,21 +614,75 @@ Response& Response::operator=(const Response& other) {
 		_postWritePos  = other._postWritePos;
 		_postFilename  = other._postFilename;
 		_responseState	= other._responseState;
+		_keepAlive	   = other._keepAlive;
+		_wouldBlock	   = other._wouldBlock;
 		_headerBuffer	 = other._headerBuffer;
-		delete _cgiInstance;
-		_cgiInstance = NULL;
+		_releaseCgi();
 	}
 	return *this;
 }
 
 Response::~Response() {
-	if (_fileFd != -1)
-		close(_fileFd);
+	_closeFile();
 	if (_postOutFd != -1)
 		close(_postOutFd);
-	delete _cgiInstance;
+	_releaseCgi();
+}
+
+void Response::reset()
+{
+	_closeFile();
+	if (_postOutFd != -1)
+	{
+		close(_postOutFd);
+		_postOutFd = -1;
+	}
+	_releaseCgi();
+
+	_statusCode		 = "200";
+	_response_phrase = "OK";
+	_responseDataStore.clear();
+	_totalBytesSent	 = 0;
+	_headers.clear();
+	_setCookies.clear();
+	_fileSize		 = 0;
+	_fileOffset		 = 0;
+	_fileEnd		 = 0;
+	_ranges.clear();
+	_rangeIndex		 = 0;
+	_boundary.clear();
+	_rangeType.clear();
+	_location		 = NULL;
+	_etag.clear();
+	_lastModified.clear();
+	_range.clear();
+	_acceptCodings	 = 0;
+	_acceptsChunked	 = false;
+	_clearCgiStream();
+	_clearCgiInput();
+	_buildPhase		 = BUILD_IDLE;
+	_cachedConfig	 = NULL;
+	_postWritePos	 = 0;
+	_postFilename.clear();
+	_responseState	 = SENDING_RES_HEAD;
+	_keepAlive		 = false;
+	_wouldBlock		 = false;
+	_headerBuffer.clear();
 }
 
+void Response::recycle(size_t keepBytes)
+{
+	reset();
+	_responseDataStore.shrink(keepBytes);
+	if (_headerBuffer.capacity() > keepBytes)
+		std::string().swap(_headerBuffer);
+	if (_relay.capacity() > keepBytes)
+		std::string().swap(_relay);
+	if (_cgiHead.capacity() > keepBytes)
+		std::string().swap(_cgiHead);
+	if (_cgiInput.capacity() > keepBytes)
+		std::string().swap(_cgiInput);
+}
 
 bool Response::buildResponse(Request& req, const ServerConf& config)
 {
@@ -305,6 +694,10 @@ bool Response::buildResponse(Request& req, const ServerConf& config)
 	if (_buildPhase == BUILD_CGI_RUNNING)
 		return false;
 
+	// a CGI fed while the body was arriving can be done before the request is.
+	if (_buildPhase == BUILD_DONE)
+		return true;
+
 	_cachedConfig = &config;
 
 	if (req.getStatusCode() != "200")
@@ -334,12 +727,15 @@ bool Response::buildResponse(Request& req, const ServerConf& config)
 			addHeader("Location", loc->getReturnURL());
 		addHeader("Content-Length", "0");
 		addHeader("Date", currentHttpDate());
-		addHeader("Connection", "close");
+		_addConnectionHeader();
 		_headerBuffer  = _generateHeaderString();
 		_responseState = SENDING_RES_HEAD;
 		return true;
 	}
 
+	if (!loc->getFastCgiPass().empty())
+		return _handleFastCgi(req, *loc, config);
+
 	// CGI detection: check if the URL's file extension has a mapped interpreter
 	std::string ext = getFileExtension(req.getURL());
 	if (!ext.empty() && loc->isCgiExtension(ext))
@@ -368,19 +764,24 @@ void Response::buildErrorPage(const std::string& code, const ServerConf& config)
 	_headers.clear();
 	_setCookies.clear();
 	_headerBuffer.clear();
-	if (_fileFd != -1)
-	{
-		close(_fileFd);
-		_fileFd = -1;
-	}
+	_closeFile();
 	_fileSize	 = 0;
-	_streamBufLen = 0;
-	_streamBufSent = 0;
+	_fileOffset	 = 0;
+	_fileEnd	 = 0;
+	_ranges.clear();
 	if (_postOutFd != -1)
 	{
 		close(_postOutFd);
 		_postOutFd = -1;
 	}
+	_clearCgiStream();
+	if (_cgiUpload)
+	{
+		// the script won't get the rest; the pipe itself is closed by whoever polls it.
+		_cgiInput.clear();
+		_cgiInputPos = 0;
+		_cgiInputClosed = true;
+	}
 	_buildPhase = BUILD_DONE;
 
 	_statusCode	  = code;
@@ -389,7 +790,7 @@ void Response::buildErrorPage(const std::string& code, const ServerConf& config)
 	std::string customPath = config.getErrorPagePath(code);
 	if (!customPath.empty())
 	{
-		int fd = open(customPath.c_str(), O_RDONLY);
+		int fd = open(customPath.c_str(), O_RDONLY | O_CLOEXEC);
 		if (fd >= 0)
 		{
 			char buf[4096];
@@ -408,10 +809,13 @@ void Response::buildErrorPage(const std::string& code, const ServerConf& config)
 
 bool Response::sendSlice(int fd)
 {
+	_wouldBlock = false;
 	if (_responseState == SENDING_RES_HEAD)
 		return _sendHeader(fd);
 	if (_responseState == SENDING_BODY_STATIC)
 		return _sendBodyStatic(fd);
+	if (_responseState == SENDING_BODY_CHUNKED)
+		return _sendBodyChunked(fd);
 	return false;
 }
 
@@ -422,28 +826,90 @@ bool Response::_sendHeader(int fd)
 	size_t headerSize = _headerBuffer.size();
 	size_t remaining  = headerSize - _totalBytesSent;
 	size_t toSend	 = std::min(remaining, _writeBufferSize);
+	size_t bodySize   = _responseDataStore.getSize();
+
+	// body bytes already in memory, which can ride along with the header's last slice.
+	const char* early	= NULL;
+	size_t		earlyLen = 0;
+	if (_cgiStreaming)
+	{
+		early	 = _relay.data() + _relayPos;
+		earlyLen = _relay.size() - _relayPos;
+	}
+	else if (_fileFd == -1 && bodySize > 0 && _responseDataStore.getMode() == RAM)
+	{
+		early	 = &_responseDataStore.getVector()[0];
+		earlyLen = bodySize;
+	}
 
-	ssize_t sent = send(fd, _headerBuffer.c_str() + _totalBytesSent, toSend, MSG_DONTWAIT);
+	ssize_t sent;
+	if (earlyLen > 0 && toSend == remaining)
+	{
+		// header and the first body slice leave in one syscall, and usually one segment.
+		struct iovec iov[2];
+		iov[0].iov_base = const_cast<char*>(_headerBuffer.data() + _totalBytesSent);
+		iov[0].iov_len  = toSend;
+		iov[1].iov_base = const_cast<char*>(early);
+		iov[1].iov_len  = std::min(earlyLen, _writeBufferSize);
+		sent = writev(fd, iov, 2);
+	}
+	else
+	{
+		// a body follows from a file: MSG_MORE holds the header back so it shares a segment with it.
+		int flags = MSG_DONTWAIT;
+		if (_fileFd != -1 || bodySize > 0 || earlyLen > 0)
+			flags |= MSG_MORE;
+		sent = send(fd, _headerBuffer.c_str() + _totalBytesSent, toSend, flags);
+	}
 	throwIfSigpipe("sending response header");
 	if (sent <= 0)
-		return true;
+		return _sendFailed(sent);
 	_totalBytesSent += static_cast<size_t>(sent);
 
 	if (_totalBytesSent < headerSize)
 		return false;
 
-	if (_responseDataStore.getSize() == 0 && _fileFd == -1)
+	if (_cgiStreaming)
+	{
+		_relayPos += _totalBytesSent - headerSize; // what the writev() took from the relay
+		_responseState = SENDING_BODY_CHUNKED;
+		return _sendBodyChunked(fd);
+	}
+
+	if (_fileFd == -1 && _totalBytesSent == headerSize + bodySize)
 		return true;
 
 	_responseState = SENDING_BODY_STATIC;
 	return _sendBodyStatic(fd);
 }
 
+bool Response::_abortSend()
+{
+	// the client only got part of this response, so the stream can't carry another one.
+	_keepAlive = false;
+	_closeFile();
+	return true;
+}
+
+bool Response::_sendFailed(ssize_t sent)
+{
+	// a full socket buffer is not an error: the slice is retried on the next writable event.
+	if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+	{
+		_wouldBlock = true;
+		return false;
+	}
+	return _abortSend();
+}
+
 bool Response::_sendBodyStatic(int fd)
 {
+	if (_deflater)
+		return _sendBodyCompressed(fd);
+	if (!_ranges.empty())
+		return _sendBodyRanges(fd);
 	if (_fileFd != -1)
 		return _sendBodyFile(fd);
-	_responseDataStore.resetReadPosition();
 	return _sendBodyDataStore(fd);
 }
 
@@ -451,91 +917,175 @@ bool Response::_sendBodyFile(int fd)
 {
 	throwIfSigpipe("sending response body file chunk");
 
-	if (_streamBufLen == 0)
-	{
-		_streamBuf.resize(_writeBufferSize);
-		ssize_t bytesRead = read(_fileFd, &_streamBuf[0], _streamBuf.size());
-		if (bytesRead <= 0)
-		{
-			close(_fileFd);
-			_fileFd = -1;
-			return true;
-		}
-		_streamBufLen  = static_cast<size_t>(bytesRead);
-		_streamBufSent = 0;
-	}
-
-	ssize_t sent = send(fd, &_streamBuf[0] + _streamBufSent,
-						_streamBufLen - _streamBufSent, MSG_DONTWAIT);
+	// sendfile() moves the bytes from the page cache to the socket without a userspace copy;
+	// the explicit offset leaves the fd's own file position untouched.
+	size_t remaining = _fileEnd - static_cast<size_t>(_fileOffset);
+	ssize_t sent = sendfile(fd, _fileFd, &_fileOffset, std::min(remaining, _writeBufferSize));
 	throwIfSigpipe("sending response body file chunk");
 	if (sent <= 0)
-	{
-		close(_fileFd);
-		_fileFd = -1;
-		return true;
-	}
-	_streamBufSent  += static_cast<size_t>(sent);
+		return _sendFailed(sent);
 	_totalBytesSent += static_cast<size_t>(sent);
 
-	if (_streamBufSent == _streamBufLen)
-		_streamBufLen = 0;
-
-	if (_totalBytesSent - _headerBuffer.size() >= _fileSize)
+	if (static_cast<size_t>(_fileOffset) >= _fileEnd)
 	{
-		close(_fileFd);
-		_fileFd = -1;
+		_closeFile();
 		return true;
 	}
 	return false;
 }
 
-bool Response::_sendBodyDataStore(int fd)
+/**
+ * multipart/byteranges from _fileFd: each part's head goes out of _relay, then its bytes by sendfile()
+ * from the part's offset, one syscall per call like the other senders.
+ */
+bool Response::_sendBodyRanges(int fd)
 {
-	throwIfSigpipe("sending response body datastore chunk");
-
-	size_t bodySize = _responseDataStore.getSize();
+	throwIfSigpipe("sending response body ranges");
 
-	if (_responseDataStore.getMode() == RAM)
+	if (_relayPos == _relay.size() && static_cast<size_t>(_fileOffset) >= _fileEnd)
 	{
-		size_t bodyOffset	= _totalBytesSent - _headerBuffer.size();
-		size_t bodyRemaining = bodySize - bodyOffset;
-		if (bodyRemaining == 0)
-			return true;
-
-		size_t toSend = std::min(bodyRemaining, _writeBufferSize);
-		const std::vector<char>& vec = _responseDataStore.getVector();
-		ssize_t sent = send(fd, &vec[0] + bodyOffset, toSend, MSG_DONTWAIT);
-		throwIfSigpipe("sending response body datastore chunk");
-		if (sent <= 0)
-			return true;
-		_totalBytesSent += static_cast<size_t>(sent);
-		return (_totalBytesSent == _headerBuffer.size() + bodySize);
+		_relay.clear();
+		_relayPos = 0;
+		if (_rangeIndex < _ranges.size())
+		{
+			const ByteRange& range = _ranges[_rangeIndex];
+			_relay		= rangePartHead(_boundary, _rangeType, range, _fileSize);
+			_fileOffset	= static_cast<off_t>(range.first);
+			_fileEnd	= range.last + 1;
+		}
+		else
+			_relay = rangeClosing(_boundary);
+		++_rangeIndex;
 	}
 
-	if (_streamBufLen == 0)
+	ssize_t sent;
+	if (_relayPos < _relay.size())
 	{
-		_streamBuf.resize(_writeBufferSize);
-		size_t bytesRead = _responseDataStore.read(&_streamBuf[0], _writeBufferSize);
-		if (bytesRead == 0)
-			return true;
-		_streamBufLen  = bytesRead;
-		_streamBufSent = 0;
+		sent = send(fd, _relay.data() + _relayPos, _relay.size() - _relayPos, MSG_DONTWAIT | MSG_MORE);
+		if (sent > 0)
+			_relayPos += static_cast<size_t>(sent);
+	}
+	else
+	{
+		size_t remaining = _fileEnd - static_cast<size_t>(_fileOffset);
+		sent = sendfile(fd, _fileFd, &_fileOffset, std::min(remaining, _writeBufferSize));
 	}
+	throwIfSigpipe("sending response body ranges");
+	if (sent <= 0)
+		return _sendFailed(sent);
+	_totalBytesSent += static_cast<size_t>(sent);
+
+	if (_rangeIndex <= _ranges.size() || _relayPos < _relay.size())
+		return false;
+	_relay.clear();
+	_relayPos = 0;
+	_closeFile();
+	return true;
+}
 
-	ssize_t sent = send(fd, &_streamBuf[0] + _streamBufSent,
-						_streamBufLen - _streamBufSent, MSG_DONTWAIT);
+bool Response::_sendBodyDataStore(int fd)
+{
 	throwIfSigpipe("sending response body datastore chunk");
-	if (sent <= 0)
+
+	size_t bodySize	  = _responseDataStore.getSize();
+	size_t bodyOffset	= _totalBytesSent - _headerBuffer.size();
+	size_t bodyRemaining = bodySize - bodyOffset;
+	if (bodyRemaining == 0)
 		return true;
-	_streamBufSent  += static_cast<size_t>(sent);
+
+	ssize_t sent = _responseDataStore.sendTo(fd, bodyOffset, std::min(bodyRemaining, _writeBufferSize));
+	throwIfSigpipe("sending response body datastore chunk");
+	if (sent <= 0)
+		return _sendFailed(sent);
 	_totalBytesSent += static_cast<size_t>(sent);
+	return (_totalBytesSent == _headerBuffer.size() + bodySize);
+}
+
+bool Response::_sendBodyChunked(int fd)
+{
+	throwIfSigpipe("sending CGI output");
 
-	if (_streamBufSent == _streamBufLen)
-		_streamBufLen = 0;
+	size_t pending = _relay.size() - _relayPos;
+	if (pending == 0)
+		return _cgiEof;
 
-	return (_totalBytesSent == _headerBuffer.size() + bodySize);
+	ssize_t sent = send(fd, _relay.data() + _relayPos, std::min(pending, _writeBufferSize), MSG_DONTWAIT);
+	throwIfSigpipe("sending CGI output");
+	if (sent <= 0)
+		return _sendFailed(sent);
+	_totalBytesSent += static_cast<size_t>(sent);
+	_relayPos += static_cast<size_t>(sent);
+	if (_relayPos < _relay.size())
+		return false;
+	_relay.clear();
+	_relayPos = 0;
+	return _cgiEof;
 }
 
+/**
+ * Compressed files can't go through sendfile(): slices at _fileOffset are deflated, straight out of the
+ * shared mapping when there is one or else after a pread(), and framed as chunks into _relay, which is
+ * drained before the next slice is read.
+ */
+bool Response::_sendBodyCompressed(int fd)
+{
+	throwIfSigpipe("sending compressed response body");
+
+	if (_relayPos == _relay.size())
+	{
+		_relay.clear();
+		_relayPos = 0;
+		if (_deflater->isFinished())
+		{
+			_closeFile();
+			return true;
+		}
+		std::string out;
+		char buf[RESPONSE_SEND_CHUNK];
+		while (out.empty() && !_deflater->isFinished())
+		{
+			size_t want = std::min(sizeof(buf), _fileSize - static_cast<size_t>(_fileOffset));
+			if (want == 0)
+			{
+				_deflater->finish(out);
+				break;
+			}
+			if (_fileMap)
+			{
+				if (!FileMapCache::feed(*_deflater, _fileMap + _fileOffset, want, out))
+					return _abortSend(); // the file shrank under us
+				_fileOffset += want;
+				continue;
+			}
+			ssize_t n = pread(_fileFd, buf, want, _fileOffset);
+			if (n <= 0)
+				return _abortSend(); // the file shrank under us: the chunked body can't be completed
+			_fileOffset += n;
+			_deflater->write(buf, static_cast<size_t>(n), out);
+		}
+		std::ostringstream sizeLine;
+		sizeLine << std::hex << out.size() << "\r\n";
+		_relay.append(sizeLine.str());
+		_relay.append(out);
+		_relay.append("\r\n", 2);
+		if (_deflater->isFinished())
+			_relay.append("0\r\n\r\n", 5);
+	}
+
+	ssize_t sent = send(fd, _relay.data() + _relayPos, std::min(_relay.size() - _relayPos, _writeBufferSize),
+						MSG_DONTWAIT);
+	throwIfSigpipe("sending compressed response body");
+	if (sent <= 0)
+		return _sendFailed(sent);
+	_totalBytesSent += static_cast<size_t>(sent);
+	_relayPos += static_cast<size_t>(sent);
+	if (_relayPos < _relay.size() || !_deflater->isFinished())
+		return false;
+	_relay.clear();
+	_relayPos = 0;
+	_closeFile();
+	return true;
+}
 
 void Response::_handleGet(const Request& req, const LocationConf& loc, const ServerConf& config)
 {
@@ -543,6 +1093,10 @@ void Response::_handleGet(const Request& req, const LocationConf& loc, const Ser
 	const std::string  url  = req.getURL();
 	addCookie(req);
 
+	_location		= &loc;
+	_acceptCodings	= (loc.getGzip() || loc.getGzipStatic()) ? acceptedCodings(req.getHeader("accept-encoding")) : 0;
+	_acceptsChunked	= req.getProtocol() == "HTTP/1.1";
+
 	std::string resolvedPath = root + url;
 	if (resolvedPath.size() > 1 && resolvedPath[resolvedPath.size() - 1] == '/')
 		resolvedPath = resolvedPath.substr(0, resolvedPath.size() - 1);
@@ -553,8 +1107,26 @@ void Response::_handleGet(const Request& req, const LocationConf& loc, const Ser
 		return;
 	}
 
+	// a hot file is answered from memory before any filesystem call (unless a .gz sibling may win).
+	const bool gzipStatic = loc.getGzipStatic() && (_acceptCodings & ACCEPT_GZIP);
+	if (config.getFileCacheEntries() > 0 && !gzipStatic)
+	{
+		const CachedFile* cached = FileCache::shared().lookup(resolvedPath, config.getFileCacheValid(), time(NULL));
+		if (cached)
+		{
+			DeflateFormat format;
+			const bool encoded = _negotiateEncoding(cached->contentType, cached->body.size(), format);
+			_lastModified = cached->lastModified;
+			if (_notModified(req, cached->inode, cached->size, cached->mtime, encoded))
+				return;
+			_takeRange(req, encoded);
+			_serveCached(*cached, "");
+			return;
+		}
+	}
+
 	struct stat st;
-	if (stat(resolvedPath.c_str(), &st) != 0)
+	if (!_statPath(resolvedPath, st, config))
 	{
 		buildErrorPage("404", config);
 		return;
@@ -566,9 +1138,9 @@ void Response::_handleGet(const Request& req, const LocationConf& loc, const Ser
 		{
 			std::string indexPath = resolvedPath + "/" + loc.getDefaultPage();
 			struct stat ist;
-			if (stat(indexPath.c_str(), &ist) == 0 && S_ISREG(ist.st_mode))
+			if (_statPath(indexPath, ist, config) && S_ISREG(ist.st_mode))
 			{
-				_serveFile(indexPath, config);
+				_serveFile(req, indexPath, ist, config);
 				return;
 			}
 		}
@@ -585,6 +1157,12 @@ void Response::_handleGet(const Request& req, const LocationConf& loc, const Ser
 				buildErrorPage("500", config);
 				return;
 			}
+			DeflateFormat format;
+			if (_negotiateEncoding("text/html", listing.size(), format))
+			{
+				listing = Deflater::compress(format, loc.getGzipCompLevel(), listing.data(), listing.size());
+				addHeader("Content-Encoding", codingName(format));
+			}
 			_responseDataStore.append(listing);
 			_statusCode	  = "200";
 			_response_phrase = "OK";
@@ -602,7 +1180,7 @@ void Response::_handleGet(const Request& req, const LocationConf& loc, const Ser
 		return;
 	}
 
-	_serveFile(resolvedPath, config);
+	_serveFile(req, resolvedPath, st, config);
 }
 
 bool Response::_handlePost(Request& req, const LocationConf& loc, const ServerConf& config)
@@ -627,12 +1205,14 @@ bool Response::_handlePost(Request& req, const LocationConf& loc, const ServerCo
 
 	std::string destPath = storageDir + "/" + filename;
 
-	_postOutFd = open(destPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	_postOutFd = open(destPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
 	if (_postOutFd < 0)
 	{
 		buildErrorPage("500", config);
 		return true;
 	}
+	FileCache::shared().invalidate(destPath);
+	OpenFileCache::shared().invalidate(destPath);
 
 	_postWritePos = 0;
 	_postFilename = filename;
@@ -731,19 +1311,27 @@ bool Response::_handleCGI(Request& req, const LocationConf& loc, const ServerCon
 		return true;
 	}
 
-	// !this is very important!
-	// our whole dumb implementation depends on the data store being forced into
-	// file format to simplify input redirection for CGI.
+	std::string ext = getFileExtension(url);
+	if (!_cgiUpload && ext == ".py" && loc.getCgiPoolSize() > 0)
+	{
+		int workerFd = CgiWorkerPool::shared().acquire(loc);
+		if (workerFd >= 0)
+			return _handlePooledCgi(req, workerFd, scriptPath, loc, config);
+		// every worker is busy: this request gets an interpreter of its own.
+	}
+
+	// a stored body is handed to the script as its stdin file, so a RAM body is spilled
+	// to disk first. A body streamed by startCgiUpload() goes through a pipe instead.
 	DataStore& body = req.getBodyStore();
-	if (body.getSize() > 0 && body.getMode() == RAM)
+	if (!_cgiUpload && body.getSize() > 0 && body.getMode() == RAM)
 		body.switchToFileMode();
 
 	if (body.getMode() == FILE_MODE)
 		body.resetReadPosition();
 
-	std::string ext = getFileExtension(url);
 	_cgiInstance = new CGIManager();
 	_cgiInstance->prepare(req, scriptPath, loc.getCgiInterpreter(ext));
+	_cgiChunked = req.getProtocol() == "HTTP/1.1";
 
 	int inputFd = -1;
 	if (body.getSize() > 0 && body.getMode() == FILE_MODE)
@@ -751,7 +1339,10 @@ bool Response::_handleCGI(Request& req, const LocationConf& loc, const ServerCon
 
 	try
 	{
-		_cgiInstance->execute(inputFd);
+		if (_cgiUpload)
+			_cgiInstance->executePiped();
+		else
+			_cgiInstance->execute(inputFd);
 	}
 	catch (const ClientException& e)
 	{
@@ -763,6 +1354,11 @@ bool Response::_handleCGI(Request& req, const LocationConf& loc, const ServerCon
 			addHeader("Retry-After", "5");
 			return true;
 		}
+		if (e.getStatusCode() == 502)
+		{
+			buildErrorPage("502", config);
+			return true;
+		}
 		throw;
 	}
 	_buildPhase = BUILD_CGI_RUNNING;
@@ -770,33 +1366,86 @@ bool Response::_handleCGI(Request& req, const LocationConf& loc, const ServerCon
 	return false;
 }
 
-void Response::_handleDelete(const Request& req, const LocationConf& loc, const ServerConf& config)
+bool Response::_handlePooledCgi(Request& req, int workerFd, const std::string& scriptPath,
+							   const LocationConf& loc, const ServerConf& config)
+{
+	// the worker speaks FastCGI: the stored body is framed from memory, nothing is spilled.
+	_fastCgi = new FastCgiClient();
+	_cgiWorkerFd = workerFd;
+	try
+	{
+		_fastCgi->attach(workerFd, req, scriptPath);
+		_fastCgi->flush();
+	}
+	catch (const ClientException&)
+	{
+		_releaseCgi();
+		throw;
+	}
+	_cgiTimeout = loc.getCgiPoolTimeout();
+	_cgiChunked = req.getProtocol() == "HTTP/1.1";
+	_buildPhase = BUILD_CGI_RUNNING;
+	_cachedConfig = &config;
+	return false;
+}
+
+bool Response::_handleFastCgi(Request& req, const LocationConf& loc, const ServerConf& config)
 {
 	const std::string& root = loc.getRoot();
-	const std::string  url  = req.getURL();
+	std::string scriptPath = root + req.getURL();
 	addCookie(req);
 
-	std::string resolvedPath = root + url;
-	if (resolvedPath.size() > 1 && resolvedPath[resolvedPath.size() - 1] == '/')
-		resolvedPath = resolvedPath.substr(0, resolvedPath.size() - 1);
-
-	if (!isPathSafe(root, resolvedPath))
+	// the script lives on the backend's side: its path is passed on, not checked here.
+	if (!isPathSafe(root, scriptPath))
 	{
 		buildErrorPage("400", config);
-		return;
+		return true;
 	}
 
-	struct stat st;
-	if (stat(resolvedPath.c_str(), &st) != 0)
+	_fastCgi = new FastCgiClient();
+	try
 	{
-		buildErrorPage("404", config);
-		return;
+		_fastCgi->start(req, scriptPath, loc.getFastCgiPass());
+		_fastCgi->flush();
 	}
-
-	if (!S_ISREG(st.st_mode))
+	catch (const ClientException&)
 	{
-		buildErrorPage("403", config);
-		return;
+		_releaseCgi();
+		throw;
+	}
+	_cgiChunked = req.getProtocol() == "HTTP/1.1";
+	_buildPhase = BUILD_CGI_RUNNING;
+	_cachedConfig = &config;
+	return false;
+}
+
+void Response::_handleDelete(const Request& req, const LocationConf& loc, const ServerConf& config)
+{
+	const std::string& root = loc.getRoot();
+	const std::string  url  = req.getURL();
+	addCookie(req);
+
+	std::string resolvedPath = root + url;
+	if (resolvedPath.size() > 1 && resolvedPath[resolvedPath.size() - 1] == '/')
+		resolvedPath = resolvedPath.substr(0, resolvedPath.size() - 1);
+
+	if (!isPathSafe(root, resolvedPath))
+	{
+		buildErrorPage("400", config);
+		return;
+	}
+
+	struct stat st;
+	if (!_statPath(resolvedPath, st, config))
+	{
+		buildErrorPage("404", config);
+		return;
+	}
+
+	if (!S_ISREG(st.st_mode))
+	{
+		buildErrorPage("403", config);
+		return;
 	}
 
 	if (std::remove(resolvedPath.c_str()) != 0)
@@ -807,58 +1456,395 @@ void Response::_handleDelete(const Request& req, const LocationConf& loc, const
 			buildErrorPage("500", config);
 		return;
 	}
+	FileCache::shared().invalidate(resolvedPath);
+	OpenFileCache::shared().invalidate(resolvedPath);
 
 	_statusCode	  = "204";
 	_response_phrase = "No Content";
 	addHeader("Content-Length", "0");
 	addHeader("Date", currentHttpDate());
-	addHeader("Connection", "close");
+	_addConnectionHeader();
 	_headerBuffer  = _generateHeaderString();
 	_responseState = SENDING_RES_HEAD;
 }
 
+bool Response::_statPath(const std::string& path, struct stat& st, const ServerConf& config)
+{
+	if (config.getOpenFileCacheEntries() == 0)
+		return stat(path.c_str(), &st) == 0;
+	return OpenFileCache::shared().stat(path, st, config.getOpenFileCacheEntries(),
+										config.getOpenFileCacheValid(), config.getOpenFileCacheInactive(), time(NULL));
+}
+
+void Response::_closeFile()
+{
+	delete _deflater;
+	_deflater = NULL;
+	if (_fileMap)
+		FileMapCache::shared().release(_fileMap);
+	_fileMap = NULL;
+	if (_fileFd == -1)
+		return;
+	if (_fileFdShared)
+		OpenFileCache::shared().release(_fileFd);
+	else
+		close(_fileFd);
+	_fileFd	   = -1;
+	_fileFdShared = false;
+}
+
+void Response::_addConnectionHeader()
+{
+	addHeader("Connection", _keepAlive ? "keep-alive" : "close");
+}
+
 void Response::_finalizeSuccess(const std::string& contentType)
 {
 	addHeader("Content-Type", contentType);
 	addHeader("Content-Length", sizeToString(_responseDataStore.getSize()));
 	addHeader("Date", currentHttpDate());
-	addHeader("Connection", "close");
+	_addConnectionHeader();
 	_headerBuffer  = _generateHeaderString();
 	_responseState = SENDING_RES_HEAD;
 }
 
-void Response::_serveFile(const std::string& path, const ServerConf& config)
+void Response::_serveFile(const Request& req, const std::string& path, const struct stat& fileStat,
+						  const ServerConf& config)
 {
-	struct stat st;
-	if (stat(path.c_str(), &st) != 0)
+	const size_t cacheEntries = config.getFileCacheEntries();
+	const time_t now = time(NULL);
+	const std::string contentType = detectContentType(path);
+
+	// gzip_static: a precompressed sibling is sent as is, with the original's type.
+	std::string source = path;
+	std::string encoding;
+	if (_location && _location->getGzipStatic() && (_acceptCodings & ACCEPT_GZIP))
 	{
-		buildErrorPage("404", config);
+		struct stat gst;
+		if (_statPath(path + ".gz", gst, config) && S_ISREG(gst.st_mode))
+		{
+			source   = path + ".gz";
+			encoding = "gzip";
+			addHeader("Vary", "Accept-Encoding");
+		}
+	}
+
+	// a client holding this version gets a 304 before the file is even opened. A body from the
+	// file cache is compressed in memory; a streamed one only if it can go out chunked.
+	DeflateFormat format;
+	const bool inMemory = cacheEntries > 0 && S_ISREG(fileStat.st_mode)
+		&& static_cast<size_t>(fileStat.st_size) <= config.getFileCacheMaxSize();
+	const bool encoded = !encoding.empty()
+		|| (_negotiateEncoding(contentType, static_cast<size_t>(fileStat.st_size), format)
+			&& (inMemory || _acceptsChunked));
+	_lastModified = httpDate(fileStat.st_mtime);
+	if (_notModified(req, fileStat.st_ino, fileStat.st_size, fileStat.st_mtime, encoded))
 		return;
+	_takeRange(req, encoded);
+
+	if (cacheEntries > 0)
+	{
+		const CachedFile* cached = FileCache::shared().lookup(source, config.getFileCacheValid(), now);
+		if (cached)
+		{
+			_serveCached(*cached, encoding);
+			return;
+		}
 	}
 
-	int fd = open(path.c_str(), O_RDONLY);
+	// with the open file cache on, the descriptor (and its stat) is borrowed instead of opened.
+	struct stat st;
+	int fd = -1;
+	const bool shareFd = config.getOpenFileCacheEntries() > 0;
+	if (shareFd)
+		fd = OpenFileCache::shared().acquire(source, st, config.getOpenFileCacheEntries(),
+											 config.getOpenFileCacheValid(), config.getOpenFileCacheInactive(), now);
+	else if (stat(source.c_str(), &st) == 0)
+		fd = open(source.c_str(), O_RDONLY | O_CLOEXEC);
 	if (fd < 0)
 	{
 		buildErrorPage("404", config);
 		return;
 	}
 
+	if (cacheEntries > 0 && S_ISREG(st.st_mode) && static_cast<size_t>(st.st_size) <= config.getFileCacheMaxSize())
+	{
+		std::string body;
+		if (slurpFile(fd, static_cast<size_t>(st.st_size), body))
+		{
+			if (shareFd)
+				OpenFileCache::shared().release(fd);
+			else
+				close(fd);
+			const CachedFile* cached = FileCache::shared().store(source, st, body, contentType,
+																  httpDate(st.st_mtime), cacheEntries, now);
+			_serveCached(*cached, encoding);
+			return;
+		}
+	}
+
 	_fileFd		= fd;
+	_fileFdShared  = shareFd;
 	_fileSize	  = static_cast<size_t>(st.st_size);
-	_streamBufLen  = 0;
-	_streamBufSent = 0;
-	_streamBuf.resize(_writeBufferSize);
+	_fileOffset	= 0;
+	_fileEnd	   = _fileSize;
+
+	_statusCode	  = "200";
+	_response_phrase = "OK";
+	addHeader("Content-Type", contentType);
+	std::vector<ByteRange> ranges;
+	if (!encoding.empty())
+	{
+		addHeader("Content-Encoding", encoding);
+		addHeader("Content-Length", sizeToString(_fileSize));
+	}
+	else if (_negotiateEncoding(contentType, _fileSize, format) && _acceptsChunked)
+	{
+		// the compressed length isn't known up front, so the body goes out chunked.
+		_deflater = new Deflater();
+		_deflater->start(format, _location->getGzipCompLevel());
+		if (_fileSize <= config.getFileMapMaxSize())
+			_fileMap = FileMapCache::shared().acquire(_fileFd, st);
+		_version = "HTTP/1.1";
+		addHeader("Content-Encoding", codingName(format));
+		addHeader("Transfer-Encoding", "chunked");
+	}
+	else if (!_selectRanges(_fileSize, ranges))
+		return;
+	else if (ranges.size() == 1)
+	{
+		_startPartial(ranges, _fileSize, contentType);
+		_fileOffset = static_cast<off_t>(ranges[0].first);
+		_fileEnd	= ranges[0].last + 1;
+	}
+	else if (!ranges.empty())
+	{
+		// parts are sent by _sendBodyRanges(), which moves the offset window from one to the next.
+		_startPartial(ranges, _fileSize, contentType);
+		_ranges		= ranges;
+		_rangeIndex	= 0;
+		_fileOffset	= 0;
+		_fileEnd	= 0;
+	}
+	else
+	{
+		addHeader("Accept-Ranges", "bytes");
+		addHeader("Content-Length", sizeToString(_fileSize));
+	}
+	_addCacheHeaders();
+	addHeader("Date", currentHttpDate());
+	_addConnectionHeader();
+	_headerBuffer  = _generateHeaderString();
+	_responseState = SENDING_RES_HEAD;
+}
 
+void Response::_serveCached(const CachedFile& file, const std::string& encoding)
+{
 	_statusCode	  = "200";
 	_response_phrase = "OK";
-	addHeader("Content-Type", detectContentType(path));
-	addHeader("Content-Length", sizeToString(_fileSize));
+	addHeader("Content-Type", file.contentType);
+
+	DeflateFormat format;
+	std::vector<ByteRange> ranges;
+	if (!encoding.empty())
+	{
+		_responseDataStore.append(file.body);
+		addHeader("Content-Encoding", encoding);
+		addHeader("Content-Length", file.contentLength);
+	}
+	else if (_negotiateEncoding(file.contentType, file.body.size(), format))
+	{
+		// the gzip form of a cached file is kept next to it; deflate is rare enough to redo.
+		const int level = _location->getGzipCompLevel();
+		std::string deflated;
+		const std::string* body = &file.gzipBody;
+		if (format == DEFLATE_GZIP && (file.gzipBody.empty() || file.gzipLevel != level))
+		{
+			file.gzipBody  = Deflater::compress(format, level, file.body.data(), file.body.size());
+			file.gzipLevel = level;
+		}
+		else if (format != DEFLATE_GZIP)
+		{
+			deflated = Deflater::compress(format, level, file.body.data(), file.body.size());
+			body	 = &deflated;
+		}
+		_responseDataStore.append(*body);
+		addHeader("Content-Encoding", codingName(format));
+		addHeader("Content-Length", sizeToString(body->size()));
+	}
+	else if (!_selectRanges(file.body.size(), ranges))
+		return;
+	else if (!ranges.empty())
+	{
+		// the parts are cut out of the cached copy, heads and all.
+		_startPartial(ranges, file.body.size(), file.contentType);
+		for (size_t i = 0; i < ranges.size(); ++i)
+		{
+			if (ranges.size() > 1)
+				_responseDataStore.append(rangePartHead(_boundary, _rangeType, ranges[i], file.body.size()));
+			_responseDataStore.append(file.body.substr(ranges[i].first, ranges[i].last - ranges[i].first + 1));
+		}
+		if (ranges.size() > 1)
+			_responseDataStore.append(rangeClosing(_boundary));
+	}
+	else
+	{
+		_responseDataStore.append(file.body);
+		addHeader("Accept-Ranges", "bytes");
+		addHeader("Content-Length", file.contentLength);
+	}
+	_addCacheHeaders();
 	addHeader("Date", currentHttpDate());
-	addHeader("Connection", "close");
+	_addConnectionHeader();
 	_headerBuffer  = _generateHeaderString();
 	_responseState = SENDING_RES_HEAD;
 }
 
+/**
+ * Evaluates If-None-Match, or If-Modified-Since when there is none (RFC 9110 13.2.2), against the
+ * file's version. The ETag is kept for the response either way; on a match the 304 is built here.
+ */
+bool Response::_notModified(const Request& req, ino_t inode, off_t size, time_t mtime, bool encoded)
+{
+	_etag = makeEtag(inode, size, mtime, encoded);
+
+	const std::string ifNoneMatch = req.getHeader("if-none-match");
+	bool unchanged = false;
+	if (!ifNoneMatch.empty())
+		unchanged = etagListMatches(ifNoneMatch, _etag);
+	else
+	{
+		time_t since;
+		const std::string ifModifiedSince = req.getHeader("if-modified-since");
+		unchanged = !ifModifiedSince.empty() && parseHttpDate(ifModifiedSince, since) && mtime <= since;
+	}
+	if (!unchanged)
+		return false;
+
+	_statusCode		 = "304";
+	_response_phrase = _lookupReasonPhrase(_statusCode);
+	_addCacheHeaders();
+	addHeader("Date", currentHttpDate());
+	_addConnectionHeader();
+	_headerBuffer  = _generateHeaderString();
+	_responseState = SENDING_RES_HEAD;
+	return true;
+}
+
+/**
+ * Keeps the request's Range for the body about to be sent, unless the body is encoded (ranges would
+ * index the encoded bytes, which differ between requests) or an If-Range names another version.
+ * If-Range only matches exactly: a strong ETag, or the Last-Modified date as sent (RFC 9110 13.1.5).
+ */
+void Response::_takeRange(const Request& req, bool encoded)
+{
+	_range.clear();
+	const std::string range = req.getHeader("range");
+	if (range.empty() || encoded)
+		return;
+	const std::string ifRange = req.getHeader("if-range");
+	if (!ifRange.empty())
+	{
+		if (ifRange[0] == '"' || ifRange.compare(0, 2, "W/") == 0)
+		{
+			if (ifRange != _etag || _etag.compare(0, 2, "W/") == 0)
+				return;
+		}
+		else if (ifRange != _lastModified)
+			return;
+	}
+	_range = range;
+}
+
+/**
+ * Resolves the kept Range against a body of size bytes. ranges comes back empty for the whole
+ * body; false means the 416 is already built.
+ */
+bool Response::_selectRanges(size_t size, std::vector<ByteRange>& ranges)
+{
+	ranges.clear();
+	if (_range.empty())
+		return true;
+	if (parseRanges(_range, size, ranges) != RANGE_UNSATISFIABLE)
+		return true;
+	ranges.clear();
+	if (_cachedConfig)
+		buildErrorPage("416", *_cachedConfig);
+	addHeader("Content-Range", "bytes */" + sizeToString(size));
+	_headerBuffer = _generateHeaderString();
+	return false;
+}
+
+/**
+ * 206 headers for the selected ranges: one range is sent bare with its Content-Range, several as
+ * multipart/byteranges, whose length counts every part head and the closing delimiter.
+ */
+void Response::_startPartial(const std::vector<ByteRange>& ranges, size_t size, const std::string& contentType)
+{
+	_statusCode		 = "206";
+	_response_phrase = _lookupReasonPhrase(_statusCode);
+	addHeader("Accept-Ranges", "bytes");
+	if (ranges.size() == 1)
+	{
+		addHeader("Content-Range", contentRange(ranges[0], size));
+		addHeader("Content-Length", sizeToString(ranges[0].last - ranges[0].first + 1));
+		return;
+	}
+	_boundary  = newBoundary();
+	_rangeType = contentType;
+	size_t length = rangeClosing(_boundary).size();
+	for (size_t i = 0; i < ranges.size(); ++i)
+		length += rangePartHead(_boundary, _rangeType, ranges[i], size).size() + ranges[i].last - ranges[i].first + 1;
+	addHeader("Content-Type", "multipart/byteranges; boundary=" + _boundary);
+	addHeader("Content-Length", sizeToString(length));
+}
+
+/**
+ * Validators of the file being served, then the location's freshness policy: "expires" gives both
+ * Expires and a matching max-age, and "cache_control" replaces the latter.
+ */
+void Response::_addCacheHeaders()
+{
+	if (!_lastModified.empty())
+		addHeader("Last-Modified", _lastModified);
+	if (!_etag.empty())
+		addHeader("ETag", _etag);
+	if (!_location)
+		return;
+
+	std::string cacheControl;
+	const long expires = _location->getExpires();
+	if (expires == EXPIRES_EPOCH)
+	{
+		addHeader("Expires", httpDate(1));
+		cacheControl = "no-cache";
+	}
+	else if (expires >= 0)
+	{
+		addHeader("Expires", httpDate(time(NULL) + expires));
+		cacheControl = "max-age=" + sizeToString(static_cast<size_t>(expires));
+	}
+	if (!_location->getCacheControl().empty())
+		cacheControl = _location->getCacheControl();
+	if (!cacheControl.empty())
+		addHeader("Cache-Control", cacheControl);
+}
+
+/**
+ * Whether a body of this type and size is compressed for this client, and in which format
+ * (gzip over deflate). A body that could be compressed varies on Accept-Encoding even when this
+ * client gets it as is, so shared caches keep the two apart.
+ */
+bool Response::_negotiateEncoding(const std::string& contentType, size_t size, DeflateFormat& format)
+{
+	if (!_location || !_location->getGzip() || !_location->isGzipType(contentType))
+		return false;
+	addHeader("Vary", "Accept-Encoding");
+	if (size < _location->getGzipMinLength() || !_acceptCodings)
+		return false;
+	format = (_acceptCodings & ACCEPT_GZIP) ? DEFLATE_GZIP : DEFLATE_ZLIB;
+	return true;
+}
 
 const std::string& Response::getStatusCode() const	  { return _statusCode; }
 const std::string& Response::getVersion() const		 { return _version; }
@@ -869,13 +1855,39 @@ CGIManager*		  Response::getCgiInstance() const	   { return _cgiInstance; }
 
 int Response::getCgiOutputFd() const
 {
+	if (_fastCgi)
+		return _fastCgi->getFd();
 	if (_cgiInstance)
 		return _cgiInstance->getOutputFd();
 	return -1;
 }
 
+void Response::writeCgiRequest()
+{
+	if (_fastCgi)
+		_fastCgi->flush();
+}
+
+bool Response::wantsCgiWrite() const
+{
+	return _fastCgi && _fastCgi->wantsWrite();
+}
+
+size_t Response::getCgiTimeout() const
+{
+	return _cgiTimeout;
+}
+
 bool Response::readCgiOutput()
 {
+	if (_fastCgi)
+	{
+		std::string out;
+		bool ended = _fastCgi->receive(out);
+		if (!out.empty())
+			_takeCgiOutput(out.data(), out.size());
+		return ended;
+	}
 	if (!_cgiInstance)
 		return true;
 
@@ -888,86 +1900,188 @@ bool Response::readCgiOutput()
 
 	if (n > 0)
 	{
-		_responseDataStore.append(buf, static_cast<size_t>(n));
-		if (_cgiInstance->isDone())
-			return true;
+		_takeCgiOutput(buf, static_cast<size_t>(n));
 		return false;
 	}
 
-	if (n == 0)//EOF
+	if (n < 0 && errno == EINTR)
+		return false;
+	// EOF, or a read error, which ends the output all the same. The exit is reaped by its pidfd event.
+	return true;
+}
+
+bool Response::startCgiUpload(Request& req, const ServerConf& config)
+{
+	if (req.getContentLength() <= 0 || req.getStatusCode() != "200")
+		return false;
+
+	// the same routing buildResponse() does, up to the CGI branch.
+	const LocationConf* loc = matchLocation(req.getURL(), config);
+	if (!loc || !loc->isMethodAllowed(req.getMethod()) || !loc->getReturnCode().empty()
+		|| !loc->getFastCgiPass().empty())
+		return false;
+	std::string ext = getFileExtension(req.getURL());
+	if (ext.empty() || !loc->isCgiExtension(ext))
+		return false;
+	if (ext == ".py" && loc->getCgiPoolSize() > 0)
+		return false; // a pooled worker takes the stored body as FastCGI records.
+
+	_cgiUpload = true;
+	_cgiInputLeft = static_cast<size_t>(req.getContentLength());
+	_handleCGI(req, *loc, config);
+	if (!_cgiInstance)
+		_clearCgiInput(); // an error page was built instead: the body is read the usual way.
+	return _cgiUpload;
+}
+
+size_t Response::feedCgiInput(const char* data, size_t n)
+{
+	size_t take = std::min(n, _cgiInputLeft);
+	_cgiInputLeft -= take;
+	if (_cgiInputClosed)
+		return take;
+	if (_cgiInputPos == _cgiInput.size())
 	{
-		_cgiInstance->isDone();
-		return true;
+		_cgiInput.clear();
+		_cgiInputPos = 0;
 	}
+	_cgiInput.append(data, take);
+	writeCgiInput(); // most of it usually fits in the pipe right away.
+	return take;
+}
 
-	// if (errno == EINTR) TBD
-		// return false;
-	//if it's a real error need to kill.
-	_cgiInstance->isDone();
-	return true;
+void Response::writeCgiInput()
+{
+	int fd = getCgiInputFd();
+	while (fd >= 0 && _cgiInputPos < _cgiInput.size())
+	{
+		ssize_t n = ::write(fd, _cgiInput.data() + _cgiInputPos, _cgiInput.size() - _cgiInputPos);
+		if (n > 0)
+		{
+			_cgiInputPos += static_cast<size_t>(n);
+			continue;
+		}
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return;
+		// EPIPE: the script is done with its stdin. That is its call, not an error on the client.
+		g_sigpipe = 0;
+		_cgiInput.clear();
+		_cgiInputPos = 0;
+		_cgiInputClosed = true;
+		return;
+	}
+}
+
+void Response::closeCgiInput()
+{
+	if (_cgiInstance)
+		_cgiInstance->closeInput();
+	_cgiInput.clear();
+	_cgiInputPos = 0;
+	_cgiInputClosed = true;
+}
+
+int Response::getCgiInputFd() const
+{
+	return _cgiInstance ? _cgiInstance->getInputFd() : -1;
+}
+
+int Response::getCgiPidFd() const
+{
+	return _cgiInstance ? _cgiInstance->getPidFd() : -1;
+}
+
+bool Response::isCgiUpload() const
+{
+	return _cgiUpload;
+}
+
+size_t Response::getCgiInputLeft() const
+{
+	return _cgiInputLeft;
+}
+
+bool Response::hasCgiInput() const
+{
+	return _cgiInputPos < _cgiInput.size();
+}
+
+bool Response::isCgiInputFull() const
+{
+	return _cgiInput.size() - _cgiInputPos >= CGI_STDIN_HIGH_WATER;
+}
+
+bool Response::isCgiInputDone() const
+{
+	return _cgiInputClosed || (_cgiInputLeft == 0 && !hasCgiInput());
+}
+
+bool Response::isCgiStreaming() const
+{
+	return _cgiStreaming;
+}
+
+bool Response::wantsCgiOutput() const
+{
+	return (_cgiInstance || _fastCgi) && _relay.size() - _relayPos < CGI_RELAY_HIGH_WATER;
+}
+
+bool Response::isWaitingOnCgi() const
+{
+	return _cgiStreaming && !_cgiEof && _responseState == SENDING_BODY_CHUNKED
+		&& _relayPos == _relay.size();
 }
 
 void Response::cgiTimeout(const ServerConf& config)
 {
+	if (_cgiUpload)
+		closeCgiInput();
 	if (_cgiInstance)
 	{
+		// no waiting here: the killed script is reaped once its pidfd reports the exit.
 		pid_t pid = _cgiInstance->getPid();
 		if (pid > 0)
-		{
 			kill(pid, SIGKILL);
-			int status;
-			waitpid(pid, &status, 0);
-			// isDone() will reap the CGI process and close the pipe
-			_cgiInstance->isDone();
-		}
-		delete _cgiInstance;
-		_cgiInstance = NULL;
 	}
+	_releaseCgi(); // a FastCGI request cut off mid-answer takes its connection down with it.
 	_buildPhase = BUILD_DONE;
+	if (_cgiStreaming)
+	{
+		// the head is already out: cut the body short, and the closed connection tells the client.
+		_cgiEof = true;
+		_keepAlive = false;
+		return;
+	}
 	buildErrorPage("504", config);
 }
 
 void Response::finalizeCgiResponse()
 {
 	_buildPhase = BUILD_DONE;
+	if (_cgiUpload)
+		closeCgiInput(); // whatever the client still sends is counted and dropped.
 
-	std::string cgiOutput = _drainDataStore();
-	const ServerConf* config = _cachedConfig;
-
-	if (cgiOutput.empty())
+	if (_cgiStreaming)
 	{
-		if (config)
-			buildErrorPage("502", *config);
-		else
-		{
-			setStatusCode("502");
-			setResponsePhrase("Bad Gateway");
-		}
-		delete _cgiInstance;
-		_cgiInstance = NULL;
+		_cgiEof = true;
+		if (_cgiBodyLeft > 0)
+			_keepAlive = false; // shorter than announced: only closing can tell the client.
+		else if (_cgiBodyLeft < 0 && _cgiChunked)
+			_relay.append("0\r\n\r\n");
+		_releaseCgi();
 		return;
 	}
 
+	const ServerConf* config = _cachedConfig;
 	std::string cgiHeaders;
 	std::string cgiBody;
-	_splitCgiOutput(cgiOutput, cgiHeaders, cgiBody);
-
-	if (cgiHeaders.empty())
-	{
-		if (config)
-			buildErrorPage("502", *config);
-		else
-		{
-			setStatusCode("502");
-			setResponsePhrase("Bad Gateway");
-		}
-		delete _cgiInstance;
-		_cgiInstance = NULL;
-		return;
-	}
+	_splitCgiOutput(_cgiHead, cgiHeaders, cgiBody);
+	_cgiHead.clear();
 
 	std::string contentType = "text/html";
-	if (!_parseCgiHeaders(cgiHeaders, contentType))
+	if (cgiHeaders.empty() || !_parseCgiHeaders(cgiHeaders, contentType))
 	{
 		if (config)
 			buildErrorPage("502", *config);
@@ -976,36 +2090,138 @@ void Response::finalizeCgiResponse()
 			setStatusCode("502");
 			setResponsePhrase("Bad Gateway");
 		}
-		delete _cgiInstance;
-		_cgiInstance = NULL;
+		_releaseCgi();
 		return;
 	}
 
+	// nothing was relayed yet, so the whole output goes out with a Content-Length.
 	_responseDataStore.clear();
 	if (!cgiBody.empty())
 		_responseDataStore.append(cgiBody);
 
 	_finalizeSuccess(contentType);
 
+	_releaseCgi();
+}
+
+void Response::_releaseCgi()
+{
+	if (_cgiWorkerFd >= 0)
+		CgiWorkerPool::shared().release(_cgiWorkerFd, _fastCgi && _fastCgi->isReusable());
+	_cgiWorkerFd = -1;
 	delete _cgiInstance;
 	_cgiInstance = NULL;
+	delete _fastCgi;
+	_fastCgi = NULL;
+}
+
+void Response::_takeCgiOutput(const char* data, size_t n)
+{
+	if (_cgiStreaming)
+		_relayCgiBody(data, n);
+	else
+		_collectCgiHead(data, n);
 }
 
-std::string Response::_drainDataStore()
+void Response::_collectCgiHead(const char* data, size_t n)
 {
-	_responseDataStore.resetReadPosition();
+	_cgiHead.append(data, n);
 
-	std::string result;
-	char buf[RESPONSE_SEND_CHUNK];
-	size_t n;
-	while ((n = _responseDataStore.read(buf, sizeof(buf))) > 0)
-		result.append(buf, n);
-	return result;
+	std::string headers;
+	std::string body;
+	_splitCgiOutput(_cgiHead, headers, body);
+	if (headers.empty())
+	{
+		if (_cgiHead.size() > CGI_MAX_HEADER_SIZE)
+			throw ClientException(502, "CGI header block too large");
+		return;
+	}
+	_startCgiStream(headers, body);
+	std::string().swap(_cgiHead);
+}
+
+void Response::_startCgiStream(const std::string& headerBlock, const std::string& body)
+{
+	std::string contentType;
+	if (!_parseCgiHeaders(headerBlock, contentType))
+		throw ClientException(502, "malformed CGI header block");
+
+	addHeader("Content-Type", contentType);
+	if (_cgiBodyLeft >= 0)
+		addHeader("Content-Length", sizeToString(static_cast<size_t>(_cgiBodyLeft)));
+	else if (_cgiChunked)
+	{
+		_version = "HTTP/1.1"; // chunked framing only exists from 1.1 on.
+		addHeader("Transfer-Encoding", "chunked");
+	}
+	else
+		_keepAlive = false; // an HTTP/1.0 client reads the body until the connection closes.
+	addHeader("Date", currentHttpDate());
+	_addConnectionHeader();
+	_headerBuffer  = _generateHeaderString();
+	_responseState = SENDING_RES_HEAD;
+	_cgiStreaming  = true;
+
+	if (!body.empty())
+		_relayCgiBody(body.data(), body.size());
+}
+
+void Response::_relayCgiBody(const char* data, size_t n)
+{
+	if (_relayPos == _relay.size())
+	{
+		_relay.clear();
+		_relayPos = 0;
+	}
+	if (_cgiBodyLeft >= 0)
+	{
+		// anything past the announced length has no place in the response.
+		n = std::min(n, static_cast<size_t>(_cgiBodyLeft));
+		_cgiBodyLeft -= static_cast<long long>(n);
+		_relay.append(data, n);
+		return;
+	}
+	if (n == 0)
+		return;
+	if (_cgiChunked)
+	{
+		std::ostringstream sizeLine;
+		sizeLine << std::hex << n << "\r\n";
+		_relay.append(sizeLine.str());
+		_relay.append(data, n);
+		_relay.append("\r\n", 2);
+		return;
+	}
+	_relay.append(data, n);
+}
+
+void Response::_clearCgiInput()
+{
+	_cgiInput.clear();
+	_cgiInputPos	= 0;
+	_cgiInputLeft	= 0;
+	_cgiUpload		= false;
+	_cgiInputClosed = false;
+}
+
+void Response::_clearCgiStream()
+{
+	_version = "HTTP/1.0";
+	_cgiHead.clear();
+	_relay.clear();
+	_relayPos	  = 0;
+	_cgiBodyLeft  = -1;
+	_cgiChunked	  = false;
+	_cgiStreaming = false;
+	_cgiEof		  = false;
+	_cgiTimeout	  = 0;
 }
 
 void Response::_splitCgiOutput(const std::string& raw, std::string& headers, std::string& body)
 {
-	size_t headerEnd = raw.find("\r\n\r\n");
+	const char* end = raw.data() + raw.size();
+	const char* found = byte_scan::findHeaderEnd(raw.data(), end);
+	size_t headerEnd = found == end ? std::string::npos : static_cast<size_t>(found - raw.data());
 	if (headerEnd != std::string::npos)
 	{
 		headers = raw.substr(0, headerEnd);
@@ -1077,6 +2293,15 @@ bool Response::_parseCgiHeaders(const std::string& headerBlock, std::string& con
 				|| _statusCode.find_first_not_of("0123456789") != std::string::npos)
 				return false;
 		}
+		else if (lowerKey == "content-length")
+		{
+			if (value.empty() || value.size() > 18
+				|| value.find_first_not_of("0123456789") != std::string::npos)
+				return false;
+			_cgiBodyLeft = 0;
+			for (size_t i = 0; i < value.size(); ++i)
+				_cgiBodyLeft = _cgiBodyLeft * 10 + (value[i] - '0');
+		}
 		else if (lowerKey == "location")
 			addHeader("Location", value);
 		else if (lowerKey == "set-cookie")
@@ -1096,6 +2321,21 @@ void Response::setResponsePhrase(const std::string& phrase)
 	_response_phrase = phrase;
 }
 
+void Response::setKeepAlive(bool keepAlive)
+{
+	_keepAlive = keepAlive;
+}
+
+bool Response::wouldBlock() const
+{
+	return _wouldBlock;
+}
+
+bool Response::isKeepAlive() const
+{
+	return _keepAlive;
+}
+
 void Response::addHeader(const std::string& key, const std::string& value)
 {
 	if (isSetCookieHeader(key))
@@ -1156,12 +2396,16 @@ std::string Response::_lookupReasonPhrase(const std::string& code) {
 		return "Created";
 	if (code == "204")
 		return "No Content";
+	if (code == "206")
+		return "Partial Content";
 	if (code == "301")
 		return "Moved Permanently";
 	if (code == "302")
 		return "Found";
 	if (code == "303")
 		return "See Other";
+	if (code == "304")
+		return "Not Modified";
 	if (code == "307")
 		return "Temporary Redirect";
 	if (code == "308")
@@ -1182,6 +2426,8 @@ std::string Response::_lookupReasonPhrase(const std::string& code) {
 		return "Content Too Large";
 	if (code == "414")
 		return "URI Too Long";
+	if (code == "416")
+		return "Range Not Satisfiable";
 	if (code == "500")
 		return "Internal Server Error";
 	if (code == "501")
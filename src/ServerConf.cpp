@@ -2,7 +2,20 @@
 #include "../includes/ServerConf.hpp"
 
 
-ServerConf::ServerConf() : _maxBodySize(0)
+ServerConf::ServerConf()
+	: _maxBodySize(0),
+	  _keepAliveTimeout(DEFAULT_KEEPALIVE_TIMEOUT_S),
+	  _keepAliveRequests(DEFAULT_KEEPALIVE_REQUESTS),
+	  _fileCacheEntries(DEFAULT_FILE_CACHE_ENTRIES),
+	  _fileCacheMaxSize(DEFAULT_FILE_CACHE_MAX_SIZE),
+	  _fileCacheValid(DEFAULT_FILE_CACHE_VALID_S),
+	  _openFileCacheEntries(DEFAULT_OPEN_FILE_CACHE_ENTRIES),
+	  _openFileCacheValid(DEFAULT_OPEN_FILE_CACHE_VALID_S),
+	  _openFileCacheInactive(DEFAULT_OPEN_FILE_CACHE_INACTIVE_S),
+	  _fileMapMaxSize(DEFAULT_FILE_MAP_MAX_SIZE),
+	  _clientHeaderTimeout(DEFAULT_CLIENT_HEADER_TIMEOUT_S),
+	  _clientBodyTimeout(DEFAULT_CLIENT_BODY_TIMEOUT_S),
+	  _sendTimeout(DEFAULT_SEND_TIMEOUT_S)
 {
 	std::memset(&_interfacePortPair, 0, sizeof(_interfacePortPair));
 }
@@ -13,7 +26,19 @@ ServerConf::ServerConf(const ServerConf& other)
 	  _interfacePortPair(other._interfacePortPair),
 	  _maxBodySize(other._maxBodySize),
 	  _locations(other._locations),
-	  _errorPages(other._errorPages)
+	  _errorPages(other._errorPages),
+	  _keepAliveTimeout(other._keepAliveTimeout),
+	  _keepAliveRequests(other._keepAliveRequests),
+	  _fileCacheEntries(other._fileCacheEntries),
+	  _fileCacheMaxSize(other._fileCacheMaxSize),
+	  _fileCacheValid(other._fileCacheValid),
+	  _openFileCacheEntries(other._openFileCacheEntries),
+	  _openFileCacheValid(other._openFileCacheValid),
+	  _openFileCacheInactive(other._openFileCacheInactive),
+	  _fileMapMaxSize(other._fileMapMaxSize),
+	  _clientHeaderTimeout(other._clientHeaderTimeout),
+	  _clientBodyTimeout(other._clientBodyTimeout),
+	  _sendTimeout(other._sendTimeout)
 {}
 
 ServerConf& ServerConf::operator=(const ServerConf& other)
@@ -25,6 +50,18 @@ ServerConf& ServerConf::operator=(const ServerConf& other)
 		_maxBodySize        = other._maxBodySize;
 		_locations          = other._locations;
 		_errorPages         = other._errorPages;
+		_keepAliveTimeout   = other._keepAliveTimeout;
+		_keepAliveRequests  = other._keepAliveRequests;
+		_fileCacheEntries   = other._fileCacheEntries;
+		_fileCacheMaxSize   = other._fileCacheMaxSize;
+		_fileCacheValid     = other._fileCacheValid;
+		_openFileCacheEntries  = other._openFileCacheEntries;
+		_openFileCacheValid    = other._openFileCacheValid;
+		_openFileCacheInactive = other._openFileCacheInactive;
+		_fileMapMaxSize        = other._fileMapMaxSize;
+		_clientHeaderTimeout   = other._clientHeaderTimeout;
+		_clientBodyTimeout     = other._clientBodyTimeout;
+		_sendTimeout           = other._sendTimeout;
 	}
 	return *this;
 }
@@ -57,6 +94,66 @@ const std::map<std::string, std::string>& ServerConf::getErrorPages() const
 	return _errorPages;
 }
 
+size_t ServerConf::getKeepAliveTimeout() const
+{
+	return _keepAliveTimeout;
+}
+
+size_t ServerConf::getKeepAliveRequests() const
+{
+	return _keepAliveRequests;
+}
+
+size_t ServerConf::getFileCacheEntries() const
+{
+	return _fileCacheEntries;
+}
+
+size_t ServerConf::getFileCacheMaxSize() const
+{
+	return _fileCacheMaxSize;
+}
+
+size_t ServerConf::getFileCacheValid() const
+{
+	return _fileCacheValid;
+}
+
+size_t ServerConf::getOpenFileCacheEntries() const
+{
+	return _openFileCacheEntries;
+}
+
+size_t ServerConf::getOpenFileCacheValid() const
+{
+	return _openFileCacheValid;
+}
+
+size_t ServerConf::getOpenFileCacheInactive() const
+{
+	return _openFileCacheInactive;
+}
+
+size_t ServerConf::getFileMapMaxSize() const
+{
+	return _fileMapMaxSize;
+}
+
+size_t ServerConf::getClientHeaderTimeout() const
+{
+	return _clientHeaderTimeout;
+}
+
+size_t ServerConf::getClientBodyTimeout() const
+{
+	return _clientBodyTimeout;
+}
+
+size_t ServerConf::getSendTimeout() const
+{
+	return _sendTimeout;
+}
+
 void ServerConf::setServerName(const std::string& name)
 {
 	_serverName = name;
@@ -72,6 +169,66 @@ void ServerConf::setMaxBodySize(size_t size)
 	_maxBodySize = size;
 }
 
+void ServerConf::setKeepAliveTimeout(size_t seconds)
+{
+	_keepAliveTimeout = seconds;
+}
+
+void ServerConf::setKeepAliveRequests(size_t count)
+{
+	_keepAliveRequests = count;
+}
+
+void ServerConf::setFileCacheEntries(size_t entries)
+{
+	_fileCacheEntries = entries;
+}
+
+void ServerConf::setFileCacheMaxSize(size_t bytes)
+{
+	_fileCacheMaxSize = bytes;
+}
+
+void ServerConf::setFileCacheValid(size_t seconds)
+{
+	_fileCacheValid = seconds;
+}
+
+void ServerConf::setOpenFileCacheEntries(size_t entries)
+{
+	_openFileCacheEntries = entries;
+}
+
+void ServerConf::setOpenFileCacheValid(size_t seconds)
+{
+	_openFileCacheValid = seconds;
+}
+
+void ServerConf::setOpenFileCacheInactive(size_t seconds)
+{
+	_openFileCacheInactive = seconds;
+}
+
+void ServerConf::setFileMapMaxSize(size_t bytes)
+{
+	_fileMapMaxSize = bytes;
+}
+
+void ServerConf::setClientHeaderTimeout(size_t seconds)
+{
+	_clientHeaderTimeout = seconds;
+}
+
+void ServerConf::setClientBodyTimeout(size_t seconds)
+{
+	_clientBodyTimeout = seconds;
+}
+
+void ServerConf::setSendTimeout(size_t seconds)
+{
+	_sendTimeout = seconds;
+}
+
 void ServerConf::addLocation(const LocationConf& location)
 {
 	_locations.push_back(location);
@@ -1,32 +1,50 @@
 #include "../includes/ServerManager.hpp"
 #include "../includes/FatalExceptions.hpp"
 #include "../includes/CGIManager.hpp"
+#include "../includes/FastCgiClient.hpp"
+#include "../includes/CgiWorkerPool.hpp"
+#include "../includes/OpenFileCache.hpp"
 
 #include <iostream>
+#include <algorithm>
 #include <cstring>
 #include <cerrno>
 #include <csignal>
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/time.h>
 
 // Defined in main.cpp — temp implementation.
 extern volatile sig_atomic_t g_running;
 
 // --- Canonical Form ---
-ServerManager::ServerManager() : _epollFd(-1)
+ServerManager::ServerManager()
+	: _epollFd(-1), _reusePort(false), _edgeTriggered(false)
 {
-	_epollFd = epoll_create(1);
+	_epollFd = epoll_create1(EPOLL_CLOEXEC);
 	if (_epollFd < 0)
-		throw FatalException(std::string("epoll_create(): ") + strerror(errno));
+		throw FatalException(std::string("epoll_create1(): ") + strerror(errno));
 	_eventBuffer.resize(64);
 }
 
-ServerManager::ServerManager(std::vector<ServerConf> confsCopy) : _epollFd(-1)
+ServerManager::ServerManager(std::vector<ServerConf> confsCopy)
+	: _epollFd(-1), _reusePort(false), _edgeTriggered(false)
 {
-	_epollFd = epoll_create(1);
+	_init(confsCopy);
+}
+
+ServerManager::ServerManager(std::vector<ServerConf> confsCopy, bool reusePort)
+	: _epollFd(-1), _reusePort(reusePort), _edgeTriggered(false)
+{
+	_init(confsCopy);
+}
+
+void ServerManager::_init(const std::vector<ServerConf>& confsCopy)
+{
+	_epollFd = epoll_create1(EPOLL_CLOEXEC);
 	if (_epollFd < 0)
-		throw FatalException(std::string("epoll_create(): ") + strerror(errno));
+		throw FatalException(std::string("epoll_create1(): ") + strerror(errno));
 	_eventBuffer.resize(64);
 
 	try
@@ -49,22 +67,19 @@ ServerManager::ServerManager(std::vector<ServerConf> confsCopy) : _epollFd(-1)
 
 ServerManager::ServerManager(const ServerManager& other)
 	: _interfacePortPairs(other._interfacePortPairs),
+	  _pool(other._pool),
 	  _epollFd(-1),
 	  _eventBuffer(other._eventBuffer),
-	  _fdEvents(),
-	  _listenFds(other._listenFds),
-	  _listenFdToServerConf(other._listenFdToServerConf)
+	  _slots(),
+	  _reusePort(other._reusePort),
+	  _edgeTriggered(other._edgeTriggered)
 {
-	_epollFd = epoll_create(1);
+	_epollFd = epoll_create1(EPOLL_CLOEXEC);
 	if (_epollFd < 0)
-		throw FatalException(std::string("epoll_create(): ") + strerror(errno));
+		throw FatalException(std::string("epoll_create1(): ") + strerror(errno));
 	try
 	{
-		for (std::map<int, uint32_t>::const_iterator it = other._fdEvents.begin();
-			 it != other._fdEvents.end(); ++it)
-		{
-			addPollFd(it->first, it->second);
-		}
+		_copyListeners(other);
 	}
 	catch (...)
 	{
@@ -79,17 +94,14 @@ ServerManager& ServerManager::operator=(const ServerManager& other)
 	{
 		_closeAllFds();
 		_interfacePortPairs = other._interfacePortPairs;
-		_listenFds = other._listenFds;
-		_listenFdToServerConf = other._listenFdToServerConf;
+		_reusePort = other._reusePort;
+		_edgeTriggered = other._edgeTriggered;
+		_pool = other._pool;
 		_eventBuffer = other._eventBuffer;
-		_epollFd = epoll_create(1);
+		_epollFd = epoll_create1(EPOLL_CLOEXEC);
 		if (_epollFd < 0)
-			throw FatalException(std::string("epoll_create(): ") + strerror(errno));
-		for (std::map<int, uint32_t>::const_iterator it = other._fdEvents.begin();
-			 it != other._fdEvents.end(); ++it)
-		{
-			addPollFd(it->first, it->second);
-		}
+			throw FatalException(std::string("epoll_create1(): ") + strerror(errno));
+		_copyListeners(other);
 	}
 	return *this;
 }
@@ -100,6 +112,8 @@ ServerManager::~ServerManager()
 		delete _serverConfs[i];
 	_closeAllFds();
 	CGIManager::cleanupAllProcesses();
+	FastCgiClient::closeIdleConnections();
+	CgiWorkerPool::shared().shutdown();
 }
 
 // --- Public Interface ---
@@ -110,10 +124,16 @@ void ServerManager::addServer(const ServerConf* conf)
 	int fd = _createListeningSocket(addr);
 
 	_interfacePortPairs[addr] = conf;
-	_listenFds.insert(fd);
-	_listenFdToServerConf[fd] = conf;
+	FdSlot& slot = _slot(fd);
+	slot.kind = FD_LISTEN;
+	slot.conf = conf;
 	addPollFd(fd, EPOLLIN);
 
+	// spawned here, in the process that serves the block: each worker process gets its own pool.
+	const std::vector<LocationConf>& locations = conf->getLocations();
+	for (size_t i = 0; i < locations.size(); ++i)
+		CgiWorkerPool::shared().start(locations[i]);
+
 	std::cout << "Server "<< conf->getServerName() << " Listening on "
 			  << req_utils::ipv4ToString(addr) << ":"
 			  << ntohs(addr.sin_port) << std::endl;
@@ -132,24 +152,34 @@ void ServerManager::addListenPort(int port)
 	addr.sin_port = htons(port);
 
 	int fd = _createListeningSocket(addr);
-	_listenFds.insert(fd);
-	_listenFdToServerConf[fd] = NULL;
+	FdSlot& slot = _slot(fd);
+	slot.kind = FD_LISTEN;
+	slot.conf = NULL;
 	addPollFd(fd, EPOLLIN);
 
 
 	std::cout << "Listening on 0.0.0.0:" << port << std::endl;
 }
 
+void ServerManager::setEdgeTriggered(bool edgeTriggered)
+{
+	_edgeTriggered = edgeTriggered;
+}
+
+void ServerManager::setConnectionPoolSize(size_t poolSize)
+{
+	_pool.warm(poolSize);
+}
+
 void ServerManager::run()
 {
 	while (g_running)
 	{
 		_runRoundRobin();
-		_sweepTimeouts();
-		_sweepCgiTimeouts();
+		_expireTimers();
 
-		// Use a finite timeout so periodic tasks like _sweepTimeouts() still run when idle.
-		int ePollTimeOut = _processingQueue.empty() ? 1000 : 0; // ms; 0 = non-blocking when there is work.
+		// sleep until the next timer is due, capped so the cache sweep still runs when idle.
+		int ePollTimeOut = _epollTimeout();
 		int ready = epoll_wait(_epollFd, &_eventBuffer[0],
 			static_cast<int>(_eventBuffer.size()), ePollTimeOut);
 		if (ready <= 0)
@@ -164,46 +194,99 @@ void ServerManager::run()
 			int			fd = _eventBuffer[i].data.fd;
 			uint32_t	events = _eventBuffer[i].events;
 
-			if (_cgiPipeToConn.count(fd))
-			{
-				_handleCgiPipeEvent(fd, events);
-				continue;
-			}
-			if (events & (EPOLLHUP | EPOLLERR))
-			{
-				if (!_listenFds.count(fd))
-					_dropConnection(fd);
-				continue;
-			}
-			if (_listenFds.count(fd))
+			// an earlier event in this batch may have closed the fd: its slot is FD_NONE by now.
+			switch (_slot(fd).kind)
 			{
-				_acceptNewConnections(fd);
-				continue;
+				case FD_CGI_PIPE:
+					_handleCgiPipeEvent(fd, events);
+					break;
+				case FD_CGI_INPUT:
+					_handleCgiInputEvent(fd, events);
+					break;
+				case FD_CGI_CHILD:
+					_handleCgiExit(fd);
+					break;
+				case FD_LISTEN:
+					if (!(events & (EPOLLHUP | EPOLLERR)))
+						_acceptNewConnections(fd);
+					break;
+				case FD_CLIENT:
+					if (events & (EPOLLHUP | EPOLLERR))
+						_dropConnection(fd);
+					else
+						_handleConnection(_slots[fd].conn, events);
+					break;
+				case FD_NONE:
+					break;
 			}
-			std::map<int, Connection*>::iterator it = _connections.find(fd);
-			if (it == _connections.end())
-				continue;
-			_handleConnection(it->second, events);
 		}
 	}
+	if (_pool.getMaxIdle() > 0)
+		std::cout << "\nConnection pool: " << _pool.getHits() << " hits, "
+				  << _pool.getMisses() << " misses";
 	std::cout << "\nServer shut down.\n";
 }
 
 void ServerManager::_handleConnection(Connection* conn, uint32_t events)
+{
+	// edge-triggered: no new edge comes for data that was already there when the state
+	// changed (e.g. WRITING -> READING on a keep-alive), so keep driving until it settles.
+	ConnectionState before;
+	do
+	{
+		before = conn->getState();
+		_dispatchIo(conn, events);
+	} while (_edgeTriggered && conn->getState() != before
+			 && (conn->getState() == READING || conn->getState() == WRITING));
+
+	int fd = conn->getFd();
+	//epoll based on final state for next iteration
+	switch (conn->getState())
+	{
+		case READING:
+			// a stalled upload is woken by its stdin pipe draining, not by the socket.
+			_setInterest(fd, conn->isUploadStalled() ? 0u : static_cast<uint32_t>(EPOLLIN));
+			break;
+		case PROCESSING:
+			// reached from a read, or from a write that left a pipelined request buffered.
+			_setInterest(fd, 0);
+			_enqueueProcessing(conn);
+			break;
+		case WRITING:
+			// a CGI relay with nothing left to send is woken by its pipe, not by the socket. Nothing is
+			// read while writing: a pipelined request waiting in the socket would wake every wait.
+			_setInterest(fd, conn->getResponse()->isWaitingOnCgi() ? 0u : static_cast<uint32_t>(EPOLLOUT));
+			break;
+		case WAITING_FOR_CGI:
+			// Client fd is idle while CGI runs; pipe fd handles I/O
+			_setInterest(fd, 0);
+			break;
+		case FINISHED:
+			_dropConnection(fd);
+			return;
+	}
+	_syncCgiInput(conn);
+	_syncCgiPipe(conn);
+	_armTimer(conn);
+}
+
+void ServerManager::_dispatchIo(Connection* conn, uint32_t events)
 {
 	int fd = conn->getFd();
 
 	try
 	{
-		if (events & EPOLLIN)
+		if (_edgeTriggered)
 		{
-			conn->handleRead();
-			if (conn->getState() == PROCESSING)
-			{
-				conn->getRequest()->getBodyStore().resetReadPosition();
-				_enqueueProcessing(conn);
-			}
+			// the edge only says "something changed": drain whichever side the state needs.
+			if (conn->getState() == READING)
+				conn->handleRead(true);
+			else if (conn->getState() == WRITING)
+				conn->handleWrite(true);
+			return;
 		}
+		if (events & EPOLLIN)
+			conn->handleRead();
 		if ((events & EPOLLOUT) && conn->getState() == WRITING)
 			conn->handleWrite();
 	}
@@ -221,26 +304,36 @@ void ServerManager::_handleConnection(Connection* conn, uint32_t events)
 		std::cerr << "unexpected runtime error on fd " << fd << ": " << e.what() << std::endl;
 		conn->triggerError(500);
 	}
+}
 
-	//epoll based on final state for next iteration
-	switch (conn->getState())
+void ServerManager::_setInterest(int fd, uint32_t events)
+{
+	// edge-triggered clients keep the mask they were registered with for their whole life.
+	if (!_edgeTriggered)
+		addPollFd(fd, events);
+}
+
+void ServerManager::_resumeWriting(Connection* conn)
+{
+	if (_edgeTriggered)
+		_handleConnection(conn, EPOLLOUT); // the socket is most likely writable already: no edge will come.
+	else
 	{
-		case READING:
-			addPollFd(fd, EPOLLIN);
-			break;
-		case PROCESSING:
-			addPollFd(fd, 0);
-			break;
-		case WRITING:
-			addPollFd(fd, EPOLLIN | EPOLLOUT);
-			break;
-		case WAITING_FOR_CGI:
-			// Client fd is idle while CGI runs; pipe fd handles I/O
-			addPollFd(fd, 0);
-			break;
-		case FINISHED:
-			_dropConnection(fd);
-			break;
+		addPollFd(conn->getFd(), EPOLLOUT);
+		_syncCgiInput(conn);
+		_syncCgiPipe(conn);
+		_armTimer(conn);
+	}
+}
+
+void ServerManager::_resumeReading(Connection* conn)
+{
+	if (_edgeTriggered)
+		_handleConnection(conn, EPOLLIN); // what arrived while paused raised no edge of its own.
+	else
+	{
+		addPollFd(conn->getFd(), EPOLLIN);
+		_armTimer(conn);
 	}
 }
 
@@ -251,18 +344,21 @@ void ServerManager::addPollFd(int fd, uint32_t events)
 	ev.events = events;
 	ev.data.fd = fd;
 
-	std::map<int, uint32_t>::iterator it = _fdEvents.find(fd);
-	if (it != _fdEvents.end())
+	FdSlot& slot = _slot(fd);
+	if (slot.registered)
 	{
-		it->second = events;
+		if (slot.events == events)
+			return; // already armed that way: skip the syscall.
 		if (epoll_ctl(_epollFd, EPOLL_CTL_MOD, fd, &ev) < 0)
 			throw FatalException(std::string("epoll_ctl(MOD): ") + strerror(errno));
+		slot.events = events;
 		return;
 	}
 
 	if (epoll_ctl(_epollFd, EPOLL_CTL_ADD, fd, &ev) < 0)
 		throw FatalException(std::string("epoll_ctl(ADD): ") + strerror(errno));
-	_fdEvents[fd] = events;
+	slot.registered = true;
+	slot.events = events;
 }
 
 const ServerConf* ServerManager::getServerConfForFd(int clientFd) const
@@ -281,9 +377,30 @@ const ServerConf* ServerManager::getServerConfForFd(int clientFd) const
 
 // --- Private Helpers ---
 
+FdSlot& ServerManager::_slot(int fd)
+{
+	size_t index = static_cast<size_t>(fd);
+	if (index >= _slots.size())
+		_slots.resize(std::max(index + 1, _slots.size() * 2));
+	return _slots[index];
+}
+
+void ServerManager::_copyListeners(const ServerManager& other)
+{
+	for (size_t fd = 0; fd < other._slots.size(); ++fd)
+	{
+		if (other._slots[fd].kind != FD_LISTEN)
+			continue;
+		FdSlot& slot = _slot(static_cast<int>(fd));
+		slot.kind = FD_LISTEN;
+		slot.conf = other._slots[fd].conf;
+		addPollFd(static_cast<int>(fd), other._slots[fd].events);
+	}
+}
+
 int ServerManager::_createListeningSocket(const struct sockaddr_in& addr)
 {
-	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
 	if (fd < 0)
 		throw FatalException(std::string("socket(): ") + strerror(errno));
 
@@ -293,6 +410,12 @@ int ServerManager::_createListeningSocket(const struct sockaddr_in& addr)
 		close(fd);
 		throw FatalException(std::string("setsockopt(): ") + strerror(errno));
 	}
+	// every worker binds its own socket; the kernel load-balances accept() across them.
+	if (_reusePort && setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &yes, sizeof yes) < 0)
+	{
+		close(fd);
+		throw FatalException(std::string("setsockopt(SO_REUSEPORT): ") + strerror(errno));
+	}
 
 	if (bind(fd, reinterpret_cast<const struct sockaddr*>(&addr), sizeof(addr)) < 0)
 	{
@@ -306,12 +429,6 @@ int ServerManager::_createListeningSocket(const struct sockaddr_in& addr)
 		throw FatalException(std::string("listen(): ") + strerror(errno));
 	}
 
-	if (fcntl(fd, F_SETFL, O_NONBLOCK) < 0)
-	{
-		close(fd);
-		throw FatalException(std::string("fcntl(): ") + strerror(errno));
-	}
-
 	return fd;
 }
 
@@ -321,30 +438,24 @@ void ServerManager::_acceptNewConnections(int listenFd)
 	{
 		struct sockaddr_in clientAddr;
 		socklen_t clientLen = sizeof(clientAddr);
-		int clientFd = accept(listenFd,
-			reinterpret_cast<struct sockaddr*>(&clientAddr), &clientLen);
+		// close-on-exec, so a spawned CGI script never holds another client's socket open.
+		int clientFd = accept4(listenFd,
+			reinterpret_cast<struct sockaddr*>(&clientAddr), &clientLen, SOCK_NONBLOCK | SOCK_CLOEXEC);
 		if (clientFd < 0)
 		{
 			if (errno == EAGAIN || errno == EWOULDBLOCK)
 				break;
-			std::cerr << "accept(): " << strerror(errno) << std::endl;
+			std::cerr << "accept4(): " << strerror(errno) << std::endl;
 			break;
 		}
 
-		if (fcntl(clientFd, F_SETFL, O_NONBLOCK) < 0)
-		{
-			std::cerr << "fcntl(client): " << strerror(errno) << std::endl;
-			close(clientFd);
-			continue;
-		}
-
-		const ServerConf* conf = NULL;
-		std::map<int, const ServerConf*>::const_iterator confIt = _listenFdToServerConf.find(listenFd);
-		if (confIt != _listenFdToServerConf.end())
-			conf = confIt->second;
-		Connection* conn = new Connection(clientFd, clientAddr, conf);
-		_connections[clientFd] = conn;
-		addPollFd(clientFd, EPOLLIN);
+		Connection* conn = _pool.acquire(clientFd, clientAddr, _slots[listenFd].conf);
+		FdSlot& slot = _slot(clientFd);
+		slot.kind = FD_CLIENT;
+		slot.conn = conn;
+		_armTimer(conn);
+		// edge-triggered clients are registered once for both directions; the state decides what to drain.
+		addPollFd(clientFd, _edgeTriggered ? (EPOLLIN | EPOLLOUT | EPOLLET) : EPOLLIN);
 
 		std::cout << "New connection from "
 				  << req_utils::ipv4ToString(clientAddr) << ":"
@@ -373,22 +484,25 @@ bool ServerManager::_readAndPrint(int fd)
 
 void ServerManager::_dropConnection(int fd)
 {
-	std::map<int, Connection*>::iterator it = _connections.find(fd);
-	if (it != _connections.end())
+	if (_slot(fd).kind == FD_CLIENT)
 	{
-		// Clean up any associated CGI pipe
-		int pipeFd = it->second->getCgiPipeFd();
+		Connection* conn = _slots[fd].conn;
+		// Clean up any associated CGI pipes
+		_closeCgiInput(conn);
+		int pipeFd = conn->getCgiPipeFd();
 		if (pipeFd >= 0)
 			_unregisterCgiPipe(pipeFd);
+		// a script spawned in the same drain that saw the client leave has no pipe registered yet.
+		_watchCgiChild(conn);
 
-		_dequeueProcessing(it->second);
-		delete it->second;
-		_connections.erase(it);
+		_dequeueProcessing(conn);
+		_pool.release(conn);
 	}
 
 	epoll_ctl(_epollFd, EPOLL_CTL_DEL, fd, NULL);
 	close(fd);
-	_fdEvents.erase(fd);
+	_slots[fd] = FdSlot();
+	_timers.cancel(fd);
 }
 
 void ServerManager::_enqueueProcessing(Connection* conn)
@@ -452,13 +566,15 @@ void ServerManager::_finalizeProcessed(Connection* conn)
 	switch (conn->getState())
 	{
 		case WRITING:
-			addPollFd(fd, EPOLLIN | EPOLLOUT);
+			_resumeWriting(conn);
 			break;
 		case WAITING_FOR_CGI:
 			// Unsubscribe client fd from epoll (it's idle during CGI)
-			addPollFd(fd, 0);
+			_setInterest(fd, 0);
 			// Register the CGI pipe fd in epoll for reading
 			_registerCgiPipe(conn);
+			_syncCgiInput(conn);
+			_armTimer(conn); // the pipe's CGI timeout takes over from the client's.
 			break;
 		case FINISHED:
 			_dropConnection(fd);
@@ -473,9 +589,33 @@ void ServerManager::_registerCgiPipe(Connection* conn)
 	int pipeFd = conn->getCgiPipeFd();
 	if (pipeFd < 0)
 		return;
-	_cgiPipeToConn[pipeFd] = conn;
-	_cgiStartTimes[pipeFd] = time(NULL);
-	addPollFd(pipeFd, EPOLLIN);
+	FdSlot& slot = _slot(pipeFd);
+	slot.kind = FD_CGI_PIPE;
+	slot.conn = conn;
+	_timers.arm(pipeFd, _cgiDeadline(conn));
+	// a FastCGI socket also takes the rest of the request while the answer comes in.
+	addPollFd(pipeFd, conn->getResponse()->wantsCgiWrite()
+		? static_cast<uint32_t>(EPOLLIN | EPOLLOUT) : static_cast<uint32_t>(EPOLLIN));
+
+	// the script's exit comes as an event of its own, whatever becomes of the pipe.
+	_watchCgiChild(conn);
+}
+
+void ServerManager::_watchCgiChild(Connection* conn)
+{
+	int pidFd = conn->getResponse()->getCgiPidFd();
+	if (pidFd < 0 || _slot(pidFd).kind != FD_NONE)
+		return;
+	_slot(pidFd).kind = FD_CGI_CHILD;
+	addPollFd(pidFd, EPOLLIN);
+	CGIManager::watchChild(pidFd);
+}
+
+void ServerManager::_handleCgiExit(int pidFd)
+{
+	epoll_ctl(_epollFd, EPOLL_CTL_DEL, pidFd, NULL);
+	_slots[pidFd] = FdSlot();
+	CGIManager::reapChild(pidFd);
 }
 
 void ServerManager::_unregisterCgiPipe(int pipeFd)
@@ -483,34 +623,36 @@ void ServerManager::_unregisterCgiPipe(int pipeFd)
 	if (pipeFd < 0)
 		return;
 	epoll_ctl(_epollFd, EPOLL_CTL_DEL, pipeFd, NULL);
-	_fdEvents.erase(pipeFd);
-	_cgiPipeToConn.erase(pipeFd);
-	_cgiStartTimes.erase(pipeFd);
+	_slot(pipeFd) = FdSlot();
+	_timers.cancel(pipeFd);
 }
 
 void ServerManager::_handleCgiPipeEvent(int pipeFd, uint32_t events)
 {
-	std::map<int, Connection*>::iterator it = _cgiPipeToConn.find(pipeFd);
-	if (it == _cgiPipeToConn.end())
+	if (_slot(pipeFd).kind != FD_CGI_PIPE)
 		return;
 
-	Connection* conn = it->second;
+	Connection* conn = _slots[pipeFd].conn;
 	Response* resp = conn->getResponse();
 
 	bool done = false;
 	try
 	{
-		if (events & (EPOLLHUP | EPOLLERR))
+		if (events & EPOLLOUT)
+			resp->writeCgiRequest();
+		// a script that already exited can still have output in the pipe: HUP only ends it once read dry.
+		if (events & EPOLLIN)
+			done = conn->readCgiOutput();
+		else if (events & (EPOLLHUP | EPOLLERR))
 			done = true;
-		else if (events & EPOLLIN)
-			done = resp->readCgiOutput();
 	}
 	catch (const ClientException& e)
 	{
 		std::cerr << "client CGI runtime error on fd " << conn->getFd() << ": " << e.what() << std::endl;
+		_closeCgiInput(conn);
 		conn->triggerError(e.getStatusCode());
 		_unregisterCgiPipe(pipeFd);
-		addPollFd(conn->getFd(), EPOLLIN | EPOLLOUT);
+		_resumeWriting(conn);
 		return;
 	}
 	catch (const FatalException&)
@@ -520,111 +662,265 @@ void ServerManager::_handleCgiPipeEvent(int pipeFd, uint32_t events)
 	catch (const std::exception& e)
 	{
 		std::cerr << "unexpected CGI runtime error on fd " << conn->getFd() << ": " << e.what() << std::endl;
+		_closeCgiInput(conn);
 		conn->triggerError(500);
 		_unregisterCgiPipe(pipeFd);
-		addPollFd(conn->getFd(), EPOLLIN | EPOLLOUT);
+		_resumeWriting(conn);
 		return;
 	}
 
 	if (done)
 	{
+		_closeCgiInput(conn);
 		_unregisterCgiPipe(pipeFd);
 		resp->finalizeCgiResponse();
+	}
+	else
+		_timers.arm(pipeFd, _cgiDeadline(conn)); // a script only times out once it goes quiet.
+
+	if (conn->getState() == READING)
+	{
+		// the body is still coming in: the response goes out once the request is complete.
+		_syncCgiPipe(conn);
+		return;
+	}
+	if (conn->getState() == WAITING_FOR_CGI)
+	{
+		if (!done && !resp->isCgiStreaming())
+		{
+			_syncCgiPipe(conn); // header block still incomplete.
+			return;
+		}
 		conn->setState(WRITING);
-		addPollFd(conn->getFd(), EPOLLIN | EPOLLOUT);
 	}
+	_syncCgiPipe(conn);
+	_resumeWriting(conn);
 }
 
-void ServerManager::_sweepCgiTimeouts()
+void ServerManager::_syncCgiPipe(Connection* conn)
 {
-	if (_cgiPipeToConn.empty())
+	int pipeFd = conn->getCgiPipeFd();
+	if (pipeFd < 0 || _slot(pipeFd).kind != FD_CGI_PIPE)
 		return;
 
-	time_t now = time(NULL);
-	std::vector<int> toKill;
-
-	for (std::map<int, time_t>::iterator it = _cgiStartTimes.begin();
-		 it != _cgiStartTimes.end(); ++it)
+	FdSlot& slot = _slots[pipeFd];
+	Response* resp = conn->getResponse();
+	uint32_t events = 0;
+	if (resp->wantsCgiOutput())
+		events |= EPOLLIN;
+	if (resp->wantsCgiWrite())
+		events |= EPOLLOUT;
+	if (events)
+	{
+		if (!slot.registered)
+			_timers.arm(pipeFd, _cgiDeadline(conn));
+		addPollFd(pipeFd, events);
+		return;
+	}
+	// removed rather than masked: a hung-up pipe would keep reporting EPOLLHUP regardless.
+	if (slot.registered)
 	{
-		if (now - it->second >= CGI_TIMEOUT_S)
-			toKill.push_back(it->first);
+		epoll_ctl(_epollFd, EPOLL_CTL_DEL, pipeFd, NULL);
+		slot.registered = false;
+		slot.events = 0;
 	}
+	// while it waits on the client, the client's send_timeout is the one that runs. A client still
+	// sending its body has none, so the CGI timeout keeps watching the script meanwhile.
+	if (conn->getState() != READING)
+		_timers.cancel(pipeFd);
+}
 
-	for (size_t i = 0; i < toKill.size(); ++i)
-	{
-		int pipeFd = toKill[i];
-		std::map<int, Connection*>::iterator it = _cgiPipeToConn.find(pipeFd);
-		if (it == _cgiPipeToConn.end())
-			continue;
+void ServerManager::_handleCgiInputEvent(int inputFd, uint32_t events)
+{
+	if (_slot(inputFd).kind != FD_CGI_INPUT)
+		return;
 
-		Connection* conn = it->second;
-		Response* resp = conn->getResponse();
-		const ServerConf* conf = conn->getServerConf();
+	Connection* conn = _slots[inputFd].conn;
+	Response* resp = conn->getResponse();
+	bool stalled = conn->isUploadStalled();
+
+	if (events & EPOLLOUT)
+		resp->writeCgiInput();
+	else if (events & (EPOLLHUP | EPOLLERR))
+		_closeCgiInput(conn); // the script closed its stdin: the rest of the body is dropped.
+	_touchCgiTimer(conn);
+	_syncCgiInput(conn);
+	if (stalled && !conn->isUploadStalled())
+		_resumeReading(conn);
+}
 
-		_unregisterCgiPipe(pipeFd);
+void ServerManager::_syncCgiInput(Connection* conn)
+{
+	Response* resp = conn->getResponse();
+	int inputFd = resp->getCgiInputFd();
+	if (!resp->isCgiUpload() || inputFd < 0)
+		return;
 
-		if (conf)
-			resp->cgiTimeout(*conf);
-		else
-		{
-			resp->setStatusCode("504");
-			resp->setResponsePhrase("Gateway Timeout");
-		}
-		conn->setState(WRITING);
-		addPollFd(conn->getFd(), EPOLLIN | EPOLLOUT);
+	int pipeFd = conn->getCgiPipeFd();
+	if (pipeFd >= 0 && _slot(pipeFd).kind == FD_NONE)
+		_registerCgiPipe(conn);
+	if (conn->getState() == READING)
+		_touchCgiTimer(conn);
+
+	if (resp->isCgiInputDone())
+	{
+		_closeCgiInput(conn);
+		return;
+	}
+	FdSlot& slot = _slot(inputFd);
+	if (resp->hasCgiInput())
+	{
+		slot.kind = FD_CGI_INPUT;
+		slot.conn = conn;
+		addPollFd(inputFd, EPOLLOUT);
+	}
+	else if (slot.registered)
+	{
+		// an empty pipe would report EPOLLOUT on every wait: out of epoll until there is more to write.
+		epoll_ctl(_epollFd, EPOLL_CTL_DEL, inputFd, NULL);
+		slot.registered = false;
+		slot.events = 0;
 	}
 }
 
-void ServerManager::_sweepTimeouts()
+void ServerManager::_closeCgiInput(Connection* conn)
 {
-	static time_t lastSweep = 0;
-	time_t now = time(NULL);
-	if (now - lastSweep < 5) // sweep every 5 seconds at most.
+	Response* resp = conn->getResponse();
+	int inputFd = resp->getCgiInputFd();
+	if (inputFd < 0)
 		return;
-	lastSweep = now;
+	if (_slot(inputFd).registered)
+		epoll_ctl(_epollFd, EPOLL_CTL_DEL, inputFd, NULL);
+	_slots[inputFd] = FdSlot();
+	resp->closeCgiInput();
+}
 
-	std::vector<int> toDrop;
-	for (std::map<int, Connection*>::iterator it = _connections.begin();
-		 it != _connections.end(); ++it)
+void ServerManager::_touchCgiTimer(Connection* conn)
+{
+	int pipeFd = conn->getCgiPipeFd();
+	if (pipeFd >= 0 && _slot(pipeFd).kind == FD_CGI_PIPE)
+		_timers.arm(pipeFd, _cgiDeadline(conn));
+}
+
+time_t ServerManager::_cgiDeadline(Connection* conn) const
+{
+	size_t timeout = conn->getResponse()->getCgiTimeout();
+	return time(NULL) + static_cast<time_t>(timeout ? timeout : CGI_TIMEOUT_S);
+}
+
+void ServerManager::_expireTimers()
+{
+	time_t now = time(NULL);
+
+	static time_t lastCacheSweep = 0;
+	if (now - lastCacheSweep >= 5) // sweep every 5 seconds at most.
 	{
-		if (it->second->hasTimedOut(CONNECTION_TIMEOUT_S))
-			toDrop.push_back(it->first);
+		lastCacheSweep = now;
+		OpenFileCache::shared().sweep(now);
 	}
-	for (size_t i = 0; i < toDrop.size(); ++i)
+
+	std::vector<int> expired;
+	_timers.expire(now, expired);
+	for (size_t i = 0; i < expired.size(); ++i)
 	{
-		std::map<int, Connection*>::iterator it = _connections.find(toDrop[i]);
-		if (it != _connections.end())
-		{
-			it->second->triggerError(408); // Request Timeout
-			_dequeueProcessing(it->second);
-			//sets state as WRITING and mods epoll.
-			_finalizeProcessed(it->second);
-		}
+		int fd = expired[i];
+		FdSlot& slot = _slot(fd);
+		if (slot.kind == FD_CGI_PIPE)
+			_expireCgi(fd);
+		else if (slot.kind == FD_CLIENT)
+			_expireConnection(slot.conn, now);
+	}
+}
+
+void ServerManager::_expireConnection(Connection* conn, time_t now)
+{
+	// timers are armed on state changes only; activity since then just pushes the deadline back.
+	time_t deadline = conn->getDeadline();
+	if (deadline == 0)
+		return;
+	if (deadline > now)
+	{
+		_timers.arm(conn->getFd(), deadline);
+		return;
+	}
+	// nothing is owed to an idle persistent client, and a stalled reader can't take a 408 either.
+	if (conn->isIdleKeepAlive() || conn->getState() == WRITING)
+	{
+		_dropConnection(conn->getFd());
+		return;
 	}
+	conn->triggerError(408); // Request Timeout
+	_dequeueProcessing(conn);
+	//sets state as WRITING and mods epoll.
+	_finalizeProcessed(conn);
+}
+
+void ServerManager::_expireCgi(int pipeFd)
+{
+	Connection* conn = _slots[pipeFd].conn;
+	Response* resp = conn->getResponse();
+	const ServerConf* conf = conn->getServerConf();
+
+	_unregisterCgiPipe(pipeFd);
+	if (conn->getState() == READING)
+		resp->setKeepAlive(false); // the rest of the body is never read: it can't frame a next request.
+	_closeCgiInput(conn);
+
+	if (conf)
+		resp->cgiTimeout(*conf);
+	else
+	{
+		resp->setStatusCode("504");
+		resp->setResponsePhrase("Gateway Timeout");
+	}
+	conn->setState(WRITING);
+	_resumeWriting(conn);
+}
+
+void ServerManager::_armTimer(Connection* conn)
+{
+	time_t deadline = conn->getDeadline();
+	if (deadline != 0)
+		_timers.arm(conn->getFd(), deadline);
+	else
+		_timers.cancel(conn->getFd());
+}
+
+int ServerManager::_epollTimeout() const
+{
+	if (!_processingQueue.empty())
+		return 0; // non-blocking when there is work.
+	time_t next = _timers.nextDeadline(time(NULL));
+	if (next == 0)
+		return EPOLL_TIMEOUT_MS;
+
+	// deadlines are whole seconds: wake up right as that second starts.
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	long ms = (static_cast<long>(next) - tv.tv_sec) * 1000 - tv.tv_usec / 1000;
+	if (ms < 0)
+		return 0;
+	return ms < EPOLL_TIMEOUT_MS ? static_cast<int>(ms) : EPOLL_TIMEOUT_MS;
 }
 
 void ServerManager::_closeAllFds()
 {
 	_processingQueue.clear();
 	_processingSet.clear();
-	_cgiPipeToConn.clear();
-	_cgiStartTimes.clear();
+	_timers = TimerWheel();
 
-	for(std::map<int, Connection*>::iterator it = _connections.begin();
-		it != _connections.end(); ++it)
+	for (size_t fd = 0; fd < _slots.size(); ++fd)
 	{
-		delete it->second;
+		if (_slots[fd].kind == FD_CLIENT)
+			delete _slots[fd].conn;
 	}
-	_connections.clear();
-
-	for (std::map<int, uint32_t>::iterator it = _fdEvents.begin();
-		 it != _fdEvents.end(); ++it)
+	for (size_t fd = 0; fd < _slots.size(); ++fd)
 	{
-		close(it->first);
+		// pidfds stay open: cleanupAllProcesses() waits on them.
+		if (_slots[fd].registered && _slots[fd].kind != FD_CGI_CHILD)
+			close(static_cast<int>(fd));
 	}
-	_fdEvents.clear();
-	_listenFds.clear();
-	_listenFdToServerConf.clear();
+	_slots.clear();
 	_eventBuffer.clear();
 	if (_epollFd >= 0)
 		close(_epollFd);
@@ -0,0 +1,147 @@
+#include "../includes/TimerWheel.hpp"
+
+// Canonical Form
+
+TimerWheel::TimerWheel()
+	: _nodes(), _heads(TIMER_WHEEL_SLOTS, -1), _cursor(0), _count(0) {}
+
+TimerWheel::TimerWheel(size_t slots)
+	: _nodes(), _heads(slots ? slots : 1, -1), _cursor(0), _count(0) {}
+
+TimerWheel::TimerWheel(const TimerWheel& other)
+	: _nodes(other._nodes), _heads(other._heads), _cursor(other._cursor), _count(other._count) {}
+
+TimerWheel& TimerWheel::operator=(const TimerWheel& other)
+{
+	if (this != &other)
+	{
+		_nodes  = other._nodes;
+		_heads  = other._heads;
+		_cursor = other._cursor;
+		_count  = other._count;
+	}
+	return *this;
+}
+
+TimerWheel::~TimerWheel() {}
+
+// Behavior
+
+void TimerWheel::arm(int fd, time_t deadline)
+{
+	if (fd < 0)
+		return;
+	size_t index = static_cast<size_t>(fd);
+	if (index >= _nodes.size())
+	{
+		Node empty = { 0, 0, -1, -1, false };
+		_nodes.resize(index + 1 > _nodes.size() * 2 ? index + 1 : _nodes.size() * 2, empty);
+	}
+	if (_nodes[index].armed)
+		_unlink(fd);
+
+	// a deadline in a second expire() already went past is filed under the next one instead.
+	time_t placed = (_cursor != 0 && deadline <= _cursor) ? _cursor + 1 : deadline;
+	size_t slot = _slotOf(placed);
+
+	Node& n	= _nodes[index];
+	n.deadline = deadline;
+	n.slot	 = slot;
+	n.prev	 = -1;
+	n.next	 = _heads[slot];
+	n.armed	= true;
+	if (n.next >= 0)
+		_nodes[n.next].prev = fd;
+	_heads[slot] = fd;
+	++_count;
+}
+
+void TimerWheel::cancel(int fd)
+{
+	if (isArmed(fd))
+		_unlink(fd);
+}
+
+bool TimerWheel::isArmed(int fd) const
+{
+	return fd >= 0 && static_cast<size_t>(fd) < _nodes.size() && _nodes[fd].armed;
+}
+
+time_t TimerWheel::deadlineOf(int fd) const
+{
+	return isArmed(fd) ? _nodes[fd].deadline : 0;
+}
+
+size_t TimerWheel::size() const
+{
+	return _count;
+}
+
+void TimerWheel::expire(time_t now, std::vector<int>& expired)
+{
+	if (_count == 0 || now <= _cursor)
+	{
+		if (now > _cursor)
+			_cursor = now;
+		return;
+	}
+	// one full turn visits every slot, so a long gap never costs more than that.
+	time_t turn = static_cast<time_t>(_heads.size());
+	time_t from = (_cursor == 0 || now - _cursor > turn) ? now - turn + 1 : _cursor + 1;
+
+	for (time_t t = from; t <= now; ++t)
+	{
+		int fd = _heads[_slotOf(t)];
+		while (fd >= 0)
+		{
+			int next = _nodes[fd].next;
+			if (_nodes[fd].deadline <= now)
+			{
+				_unlink(fd);
+				expired.push_back(fd);
+			}
+			fd = next;
+		}
+	}
+	_cursor = now;
+}
+
+time_t TimerWheel::nextDeadline(time_t now) const
+{
+	if (_count == 0)
+		return 0;
+	time_t start = (_cursor == 0 || _cursor >= now) ? now : _cursor + 1;
+	time_t turn  = static_cast<time_t>(_heads.size());
+	for (time_t t = start; t < start + turn; ++t)
+	{
+		// entries of later rounds share the slot; only one due by t counts.
+		for (int fd = _heads[_slotOf(t)]; fd >= 0; fd = _nodes[fd].next)
+		{
+			if (_nodes[fd].deadline <= t)
+				return t;
+		}
+	}
+	return 0;
+}
+
+// Private Helpers
+
+size_t TimerWheel::_slotOf(time_t deadline) const
+{
+	return static_cast<size_t>(deadline) % _heads.size();
+}
+
+void TimerWheel::_unlink(int fd)
+{
+	Node& n = _nodes[fd];
+	if (n.prev >= 0)
+		_nodes[n.prev].next = n.next;
+	else
+		_heads[n.slot] = n.next;
+	if (n.next >= 0)
+		_nodes[n.next].prev = n.prev;
+	n.prev  = -1;
+	n.next  = -1;
+	n.armed = false;
+	--_count;
+}
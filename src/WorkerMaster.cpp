@@ -0,0 +1,195 @@
+#include "../includes/WorkerMaster.hpp"
+#include "../includes/ServerManager.hpp"
+#include "../includes/FatalExceptions.hpp"
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <ctime>
+#include <unistd.h>
+#include <sys/wait.h>
+
+// Defined in main.cpp
+extern volatile sig_atomic_t g_running;
+
+WorkerMaster::WorkerMaster(const std::vector<ServerConf>& confs, size_t workerCount, bool edgeTriggered,
+						   size_t connectionPoolSize)
+	: _confs(confs), _workers(workerCount, -1), _startedAt(workerCount, 0), _crashes(workerCount, 0),
+	  _respawnAt(workerCount, 0), _edgeTriggered(edgeTriggered), _connectionPoolSize(connectionPoolSize)
+{}
+
+WorkerMaster::~WorkerMaster()
+{
+	_stopAll();
+}
+
+int WorkerMaster::run()
+{
+	for (size_t i = 0; i < _workers.size(); ++i)
+		_spawn(i);
+
+	int exitStatus = 0;
+	while (g_running)
+	{
+		// with a respawn pending, poll so it happens on time; otherwise sleep in waitpid().
+		const bool pending = _respawnDue();
+		int status;
+		pid_t pid = waitpid(-1, &status, pending ? WNOHANG : 0);
+		if (pid <= 0)
+		{
+			// EINTR is SIGINT/SIGTERM: the loop condition decides. ECHILD only means every slot is empty.
+			if (pid < 0 && errno != EINTR && !(errno == ECHILD && pending))
+				break;
+			if (pending)
+				usleep(WORKER_RESPAWN_POLL_US);
+			continue;
+		}
+		int slot = _slotOf(pid);
+		if (slot < 0)
+			continue;
+		_workers[slot] = -1;
+		if (!g_running)
+			break;
+
+		const time_t uptime = time(NULL) - _startedAt[slot];
+		if (WIFEXITED(status) && WEXITSTATUS(status) != 0 && uptime < WORKER_MIN_UPTIME_S)
+		{
+			std::cerr << "worker " << pid << " failed to start, shutting down" << std::endl;
+			exitStatus = 1;
+			break;
+		}
+		if (!_scheduleRespawn(static_cast<size_t>(slot), pid, status, uptime))
+		{
+			std::cerr << "worker " << pid << " keeps crashing, shutting down" << std::endl;
+			exitStatus = 1;
+			break;
+		}
+	}
+	_stopAll();
+	std::cout << "\nMaster shut down.\n";
+	return exitStatus;
+}
+
+void WorkerMaster::_spawn(size_t slot)
+{
+	pid_t pid = fork();
+	if (pid < 0)
+		throw FatalException(std::string("fork(): ") + strerror(errno));
+	if (pid == 0)
+		_runWorker();
+	_workers[slot]   = pid;
+	_startedAt[slot] = time(NULL);
+	std::cout << "Worker " << pid << " started" << std::endl;
+}
+
+bool WorkerMaster::_scheduleRespawn(size_t slot, pid_t pid, int status, time_t uptime)
+{
+	if (uptime >= WORKER_STABLE_UPTIME_S)
+		_crashes[slot] = 0;
+	if (++_crashes[slot] > WORKER_MAX_CRASHES)
+		return false;
+
+	// a worker crashing on every start would otherwise turn the master into a fork loop.
+	time_t delay = 1;
+	for (size_t i = 1; i < _crashes[slot] && delay < WORKER_RESPAWN_MAX_DELAY_S; ++i)
+		delay *= 2;
+	if (delay > WORKER_RESPAWN_MAX_DELAY_S)
+		delay = WORKER_RESPAWN_MAX_DELAY_S;
+	_respawnAt[slot] = time(NULL) + delay;
+
+	std::cerr << "worker " << pid;
+	if (WIFSIGNALED(status))
+		std::cerr << " killed by signal " << WTERMSIG(status);
+	else
+		std::cerr << " exited with status " << WEXITSTATUS(status);
+	std::cerr << ", respawning in " << delay << "s" << std::endl;
+	return true;
+}
+
+bool WorkerMaster::_respawnDue()
+{
+	const time_t now = time(NULL);
+	bool pending = false;
+	for (size_t i = 0; i < _workers.size(); ++i)
+	{
+		if (_workers[i] > 0 || _respawnAt[i] == 0)
+			continue;
+		if (now < _respawnAt[i])
+		{
+			pending = true;
+			continue;
+		}
+		_respawnAt[i] = 0;
+		_spawn(i);
+	}
+	return pending;
+}
+
+void WorkerMaster::_runWorker()
+{
+	int status = 0;
+	try
+	{
+		ServerManager manager(_confs, true);
+		manager.setEdgeTriggered(_edgeTriggered);
+		manager.setConnectionPoolSize(_connectionPoolSize);
+		manager.run();
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "Fatal (worker " << getpid() << "): " << e.what() << std::endl;
+		status = 1;
+	}
+	// the master's supervision state is a copy in this process; never fall back into it.
+	std::exit(status);
+}
+
+int WorkerMaster::_slotOf(pid_t pid) const
+{
+	for (size_t i = 0; i < _workers.size(); ++i)
+		if (_workers[i] == pid)
+			return static_cast<int>(i);
+	return -1;
+}
+
+void WorkerMaster::_stopAll()
+{
+	size_t alive = 0;
+	for (size_t i = 0; i < _workers.size(); ++i)
+	{
+		if (_workers[i] > 0)
+		{
+			kill(_workers[i], SIGTERM);
+			++alive;
+		}
+	}
+
+	time_t deadline = time(NULL) + WORKER_SHUTDOWN_GRACE_S;
+	while (alive > 0)
+	{
+		int status;
+		pid_t pid = waitpid(-1, &status, WNOHANG);
+		if (pid > 0)
+		{
+			int slot = _slotOf(pid);
+			if (slot >= 0)
+			{
+				_workers[slot] = -1;
+				--alive;
+			}
+			continue;
+		}
+		if (pid < 0 && errno != EINTR)
+			break;
+		if (time(NULL) >= deadline)
+		{
+			for (size_t i = 0; i < _workers.size(); ++i)
+				if (_workers[i] > 0)
+					kill(_workers[i], SIGKILL);
+			deadline = time(NULL) + WORKER_SHUTDOWN_GRACE_S;
+		}
+		usleep(10000);
+	}
+}
@@ -6,8 +6,10 @@
 #include <iostream>
 #include <cstdlib>
 #include <csignal>
+#include <cstring>
 
 #include "../includes/ServerManager.hpp"
+#include "../includes/WorkerMaster.hpp"
 #include "../includes/FatalExceptions.hpp"
 #include "../includes/ConfigParser.hpp"
 
@@ -30,7 +32,13 @@ static void signalPipeHandler(int sig) {
 
 int main(int argc, char** argv)
 {
-	signal(SIGINT, signalHandler);
+	// no SA_RESTART: the master's blocking waitpid() must return EINTR to notice a shutdown request.
+	struct sigaction sa;
+	std::memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = signalHandler;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
 	signal(SIGPIPE, signalPipeHandler);
 	if (argc > 2)
 	{
@@ -40,6 +48,9 @@ int main(int argc, char** argv)
 	try
 	{
 		std::vector<ServerConf> parsedConfs;
+		size_t workerProcesses = DEFAULT_WORKER_PROCESSES;
+		bool edgeTriggered = false;
+		size_t connectionPoolSize = DEFAULT_CONNECTION_POOL_SIZE;
 		if (argc == 1)
 		{
 			ServerConf defaultConf;
@@ -50,8 +61,18 @@ int main(int argc, char** argv)
 		{
 			ConfigParser parser(argv[1]);
 			parsedConfs = parser.parse();
+			workerProcesses = parser.getWorkerProcesses();
+			edgeTriggered = parser.getEdgeTriggered();
+			connectionPoolSize = parser.getConnectionPoolSize();
+		}
+		if (workerProcesses > 1)
+		{
+			WorkerMaster master(parsedConfs, workerProcesses, edgeTriggered, connectionPoolSize);
+			return master.run();
 		}
 		ServerManager manager(parsedConfs);
+		manager.setEdgeTriggered(edgeTriggered);
+		manager.setConnectionPoolSize(connectionPoolSize);
 		manager.run();
 	}
 	catch (const FatalException& e)
@@ -0,0 +1,154 @@
+/**
+ * Microbenchmark for the ByteScan kernels (`make bench`).
+ * Splits realistic 1-8 KB request header blocks into lines and finds each colon: first the way
+ * Request::parseHeaders used to (std::string::find per delimiter), then with each kernel set.
+ */
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <sys/time.h>
+#include "../includes/ByteScan.hpp"
+
+static const char* kBaseHeaders =
+	"GET /assets/app/main.bundle.js?v=20240611 HTTP/1.1\r\n"
+	"Host: www.example.org\r\n"
+	"User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:126.0) Gecko/20100101 Firefox/126.0\r\n"
+	"Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,*/*;q=0.8\r\n"
+	"Accept-Language: en-US,en;q=0.7,fr;q=0.3\r\n"
+	"Accept-Encoding: gzip, deflate, br, zstd\r\n"
+	"Referer: https://www.example.org/products/category/listing?page=3&sort=price\r\n"
+	"Connection: keep-alive\r\n"
+	"Upgrade-Insecure-Requests: 1\r\n"
+	"Sec-Fetch-Dest: document\r\n"
+	"Sec-Fetch-Mode: navigate\r\n"
+	"If-None-Match: \"5f3c-61b8e2a0d4c80\"\r\n";
+
+// pads with cookie and tracing headers, as real large header blocks are, up to ~size bytes.
+static std::string makeHeaderBlock(size_t size)
+{
+	std::string block = kBaseHeaders;
+	for (int i = 0; block.size() + 96 < size; ++i)
+	{
+		std::ostringstream line;
+		line << "Cookie: session_" << i << "=a8f3e9c1b2d4f6a8e0c2b4d6f8a0c2e4b6d8f0a2; pref_" << i << "=compact\r\n";
+		block += line.str();
+	}
+	return block + "\r\n";
+}
+
+static double nowSeconds()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+// the terminator search parseHeaders() runs on every recv() while headers are incomplete.
+static size_t endWithFind(const std::string& raw)
+{
+	return raw.find("\r\n\r\n");
+}
+
+static size_t endWithKernels(const std::string& raw)
+{
+	return byte_scan::findHeaderEnd(raw.data(), raw.data() + raw.size()) - raw.data();
+}
+
+// splitting into lines, the way the parser used to: find() for every CRLF and every colon.
+static size_t splitWithFind(const std::string& raw)
+{
+	size_t fields = 0;
+	size_t headerEnd = raw.find("\r\n\r\n");
+	size_t lineStart = 0;
+	while (lineStart < headerEnd)
+	{
+		size_t lineEnd = raw.find("\r\n", lineStart);
+		if (lineEnd > headerEnd)
+			lineEnd = headerEnd;
+		size_t colon = raw.find(':', lineStart);
+		if (colon < lineEnd)
+			++fields;
+		lineStart = lineEnd + 2;
+	}
+	return fields;
+}
+
+// the way it does now: one pass for lines, colons and control bytes (which find() never checked).
+static size_t splitWithKernels(const std::string& raw)
+{
+	static std::vector<byte_scan::Line> lines;
+	size_t fields = 0;
+	const char* p = raw.data();
+	const char* end = byte_scan::findHeaderEnd(p, p + raw.size());
+	byte_scan::splitLines(p, end, lines);
+	for (size_t i = 0; i < lines.size(); ++i)
+	{
+		if (!lines[i].control && lines[i].colon < lines[i].end)
+			++fields;
+	}
+	return fields;
+}
+
+// best of several rounds, so a busy machine skews the ratios less.
+static double run(size_t (*parse)(const std::string&), const std::string& block, size_t iterations, size_t& sink)
+{
+	double best = 0;
+	for (int round = 0; round < 5; ++round)
+	{
+		double start = nowSeconds();
+		for (size_t i = 0; i < iterations; ++i)
+			sink += parse(block);
+		double elapsed = nowSeconds() - start;
+		if (round == 0 || elapsed < best)
+			best = elapsed;
+	}
+	return best;
+}
+
+typedef size_t (*ParseFn)(const std::string&);
+
+static void compare(const char* title, ParseFn baselineFn, ParseFn kernelFn, size_t& sink)
+{
+	const size_t sizes[] = { 1024, 2048, 4096, 8192 };
+	const char* kernels[] = { "scalar", "sse2", "avx2" };
+	const size_t totalBytes = 128UL * 1024 * 1024;
+	const std::string detected = byte_scan::implementation();
+
+	std::cout << "\n" << title << "\n";
+	std::cout << std::left << std::setw(8) << "block" << std::setw(12) << "impl"
+			  << std::right << std::setw(10) << "MB/s" << std::setw(10) << "speedup" << "\n";
+	for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s)
+	{
+		std::string block = makeHeaderBlock(sizes[s]);
+		size_t iterations = totalBytes / block.size();
+		double mb = static_cast<double>(iterations) * block.size() / (1024.0 * 1024.0);
+
+		double baseline = run(baselineFn, block, iterations, sink);
+		std::cout << std::left << std::setw(8) << block.size() << std::setw(12) << "find()"
+				  << std::right << std::setw(10) << std::fixed << std::setprecision(0) << mb / baseline
+				  << std::setw(9) << std::setprecision(2) << 1.0 << "x\n";
+		for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); ++k)
+		{
+			if (!byte_scan::useImplementation(kernels[k]))
+				continue;
+			double t = run(kernelFn, block, iterations, sink);
+			std::cout << std::left << std::setw(8) << "" << std::setw(12) << kernels[k]
+					  << std::right << std::setw(10) << std::setprecision(0) << mb / t
+					  << std::setw(9) << std::setprecision(2) << baseline / t << "x\n";
+		}
+	}
+	byte_scan::useImplementation(detected);
+}
+
+int main()
+{
+	size_t sink = 0;
+
+	std::cout << "detected kernels: " << byte_scan::implementation() << "\n";
+	compare("header terminator (\\r\\n\\r\\n)", endWithFind, endWithKernels, sink);
+	compare("lines + colons", splitWithFind, splitWithKernels, sink);
+	// keeps the parses from being optimised away.
+	return sink == 0 ? 1 : 0;
+}
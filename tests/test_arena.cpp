@@ -0,0 +1,118 @@
+#include <iostream>
+#include <cstring>
+#include "../includes/Arena.hpp"
+#include "../includes/HeaderTable.hpp"
+
+// ============================================================================
+// Minimal test harness
+// ============================================================================
+
+static int  g_total  = 0;
+static int  g_passed = 0;
+
+static void check(const char* label, bool condition)
+{
+	g_total++;
+	if (condition)
+	{
+		g_passed++;
+		std::cout << "  [PASS] " << label << "\n";
+	}
+	else
+	{
+		std::cout << "  [FAIL] " << label << "\n";
+	}
+}
+
+// ============================================================================
+// Arena
+// ============================================================================
+
+static void testArenaBump()
+{
+	std::cout << "\n-- Arena bump and reset --\n";
+
+	Arena arena(64);
+	check("no block before the first allocation", arena.blockCount() == 0);
+
+	char* a = arena.copy("hello", 5);
+	char* b = arena.allocate(10);
+	check("allocations are contiguous",   b == a + 5);
+	check("copy keeps the bytes",         std::memcmp(a, "hello", 5) == 0);
+	check("used counts handed-out bytes", arena.used() == 15);
+
+	arena.allocate(60);
+	check("overflow opens a second block", arena.blockCount() == 2);
+
+	arena.reset();
+	check("reset rewinds",                arena.used() == 0 && arena.blockCount() == 2);
+	check("reset reuses the first block", arena.allocate(5) == a);
+	arena.allocate(60);
+	check("kept blocks are reused",       arena.blockCount() == 2 && arena.capacity() == 128);
+}
+
+static void testArenaOversized()
+{
+	std::cout << "\n-- Arena oversized allocations --\n";
+
+	Arena arena(16);
+	arena.allocate(8);
+	char* big = arena.allocate(100);
+	check("oversized request gets its own block", big != NULL && arena.capacity() == 116);
+
+	arena.release();
+	check("release keeps only the first block",  arena.blockCount() == 1 && arena.used() == 0);
+	arena.reset();
+	arena.allocate(100);
+	check("blocks grow again on demand",        arena.blockCount() == 2 && arena.capacity() == 116);
+}
+
+// ============================================================================
+// HeaderTable
+// ============================================================================
+
+static void testHeaderTable()
+{
+	std::cout << "\n-- HeaderTable --\n";
+
+	HeaderTable table;
+	table.set("host", 4, "a", 1);
+	table.set("accept", 6, "*/*", 3);
+	table.set("host", 4, "b", 1);
+	check("same name replaces the value", table.size() == 2 && table.find("host")->getValue() == "b");
+	check("lookup is exact",             table.find("Host") == NULL && table.find("hos", 3) == NULL);
+	check("fields keep insertion order", table[1].getName() == "accept");
+
+	Arena arena;
+	HeaderTable copy;
+	char name[] = "x-tmp";
+	table.set(name, 5, "1", 1);
+	copy.copyFrom(table, arena);
+	name[0] = 'y';
+	check("copyFrom owns its bytes",     copy.find("x-tmp") != NULL && copy.size() == 3);
+
+	check("stored hash matches hashName",
+	      table.find("accept")->hash == HeaderTable::hashName("accept", 6));
+	check("lookup by precomputed hash",
+	      table.find("accept", 6, HeaderTable::hashName("accept", 6)) == &table[1]);
+
+	table.clear();
+	check("clear empties the table",     table.empty() && table.find("host") == NULL);
+}
+
+// ============================================================================
+// Entry point
+// ============================================================================
+
+int main()
+{
+	testArenaBump();
+	testArenaOversized();
+	testHeaderTable();
+
+	std::cout << "\n===========================\n";
+	std::cout << g_passed << " / " << g_total << " tests passed\n";
+	std::cout << "===========================\n";
+
+	return (g_passed == g_total) ? 0 : 1;
+}
@@ -0,0 +1,156 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include "../includes/ByteScan.hpp"
+
+// ============================================================================
+// Minimal test harness
+// ============================================================================
+
+static int  g_total  = 0;
+static int  g_passed = 0;
+
+static void check(const char* label, bool condition)
+{
+	g_total++;
+	if (condition)
+	{
+		g_passed++;
+		std::cout << "  [PASS] " << label << "\n";
+	}
+	else
+	{
+		std::cout << "  [FAIL] " << label << "\n";
+	}
+}
+
+// Straightforward references the kernels are compared against.
+static size_t refFind(const std::string& s, size_t from, const std::string& needle)
+{
+	size_t pos = s.find(needle, from);
+	return pos == std::string::npos ? s.size() : pos;
+}
+
+static size_t refControl(const std::string& s, size_t from)
+{
+	for (size_t i = from; i < s.size(); ++i)
+	{
+		unsigned char c = static_cast<unsigned char>(s[i]);
+		if ((c < 0x20 && c != '\t') || c == 0x7f)
+			return i;
+	}
+	return s.size();
+}
+
+static bool splitMatches(const std::string& window, size_t from)
+{
+	std::vector<byte_scan::Line> lines;
+	byte_scan::splitLines(window.data() + from, window.data() + window.size(), lines);
+	std::string range = window.substr(from);
+	size_t count = 0;
+	for (size_t start = 0; start < range.size(); ++count)
+	{
+		size_t end = refFind(range, start, "\r\n");
+		std::string text = range.substr(start, end - start);
+		size_t colon = refFind(text, 0, ":");
+		if (count >= lines.size() || lines[count].start != start || lines[count].end != end
+			|| lines[count].colon != start + colon
+			|| lines[count].control != (refControl(text, 0) != text.size()))
+			return false;
+		start = end + 2;
+	}
+	return count == lines.size();
+}
+
+// Every start offset and length of a buffer with delimiters near block edges.
+static bool agreesWithReference(const std::string& s)
+{
+	const char* base = s.data();
+	for (size_t from = 0; from < s.size(); ++from)
+	{
+		for (size_t len = from; len <= s.size(); ++len)
+		{
+			std::string window = s.substr(0, len);
+			const char* end = base + len;
+			if (byte_scan::findByte(base + from, end, ':') - base != static_cast<long>(refFind(window, from, ":"))
+				|| byte_scan::findCrlf(base + from, end) - base != static_cast<long>(refFind(window, from, "\r\n"))
+				|| byte_scan::findHeaderEnd(base + from, end) - base != static_cast<long>(refFind(window, from, "\r\n\r\n"))
+				|| byte_scan::findControl(base + from, end) - base != static_cast<long>(refControl(window, from))
+				|| !splitMatches(window, from))
+				return false;
+		}
+	}
+	return true;
+}
+
+static std::string randomHeaderBytes(size_t n, unsigned seed)
+{
+	static const char alphabet[] = "ab:\r\n\t \r\n\x7f\x01\xe9";
+	std::srand(seed);
+	std::string s;
+	for (size_t i = 0; i < n; ++i)
+		s += alphabet[std::rand() % (sizeof(alphabet) - 1)];
+	return s;
+}
+
+// ============================================================================
+// Kernels
+// ============================================================================
+
+static void testImplementation(const char* name)
+{
+	std::cout << "\n-- " << name << " --\n";
+
+	if (!byte_scan::useImplementation(name))
+	{
+		std::cout << "  (not supported on this CPU, skipped)\n";
+		return;
+	}
+	check("selected",                     std::string(byte_scan::implementation()) == name);
+
+	std::string header(100, 'x');
+	header.replace(31, 2, "\r\n");		// CRLF straddling a 32-byte boundary
+	header.replace(47, 4, "\r\n\r\n");	// terminator straddling a 16-byte boundary
+	header[15] = ':';
+	header.replace(63, 3, "\r\n:");		// CR ends one 32-byte block, LF starts the next
+	header[90] = '\x01';
+	check("delimiters on block edges",    agreesWithReference(header));
+
+	std::string nearMiss(80, 'y');
+	nearMiss.replace(10, 3, "\r\n\r");
+	nearMiss.replace(40, 4, "\r\r\n\n");
+	nearMiss[79] = '\r';
+	check("partial terminators ignored",  agreesWithReference(nearMiss));
+
+	std::string high(64, '\x80');
+	high[50] = '\x1f';
+	check("bytes >= 0x80 are not control", agreesWithReference(high));
+
+	bool randomOk = true;
+	for (unsigned seed = 1; seed <= 8 && randomOk; ++seed)
+		randomOk = agreesWithReference(randomHeaderBytes(72, seed));
+	check("random buffers agree",         randomOk);
+}
+
+// ============================================================================
+// Entry point
+// ============================================================================
+
+int main()
+{
+	std::string detected = byte_scan::implementation();
+	std::cout << "Detected kernels: " << detected << "\n";
+
+	testImplementation("scalar");
+	testImplementation("sse2");
+	testImplementation("avx2");
+	check("unknown name rejected",        !byte_scan::useImplementation("neon"));
+	byte_scan::useImplementation(detected);
+
+	std::cout << "\n===========================\n";
+	std::cout << g_passed << " / " << g_total << " tests passed\n";
+	std::cout << "===========================\n";
+
+	return (g_passed == g_total) ? 0 : 1;
+}
@@ -5,7 +5,13 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <cerrno>
+#include <ctime>
+#include <vector>
+#include <dirent.h>
 #include "../includes/CGIManager.hpp"
+#include "../includes/FatalExceptions.hpp"
 #include "../includes/Request.hpp"
 
 // g++ ./test_cgi.cpp ../src/CGIManager.cpp ../src/Request.cpp ../src/DataStore.cpp ../src/AllowedMethods.cpp -o test_cgi
@@ -245,6 +251,124 @@ static void testPipeCreation()
 	}
 }
 
+static void testSpawnHygiene()
+{
+	std::cout << "\n-- CGIManager Spawn Tests --\n";
+
+	Request req = createTestRequest();
+	{
+		// cat sees EOF only if no process still holds the write end of its stdin pipe.
+		CGIManager cgi;
+		cgi.prepare(req, "/bin/cat");
+		cgi.executePiped();
+		write(cgi.getInputFd(), "ping", 4);
+		cgi.closeInput();
+
+		std::string out;
+		char buffer[64];
+		struct pollfd pfd = { cgi.getOutputFd(), POLLIN, 0 };
+		ssize_t n = 1;
+		while (n > 0 && poll(&pfd, 1, 2000) > 0)
+		{
+			n = read(cgi.getOutputFd(), buffer, sizeof(buffer));
+			if (n > 0)
+				out.append(buffer, n);
+		}
+		check("piped script sees EOF once the input is closed", n == 0 && out == "ping");
+		int status;
+		waitpid(cgi.getPid(), &status, 0);
+	}
+	{
+		CGIManager cgi;
+		cgi.prepare(req, "/tmp/test_cgi_script.py", "/tmp/no/such/interpreter");
+		int code = 0;
+		try { cgi.execute(-1); }
+		catch (const ClientException& e) { code = e.getStatusCode(); }
+		check("missing interpreter fails the spawn with 502", code == 502);
+		check("failed spawn leaves no pipe open", cgi.getOutputFd() == -1);
+	}
+}
+
+static size_t openFdCount()
+{
+	size_t count = 0;
+	DIR* dir = opendir("/proc/self/fd");
+	if (!dir)
+		return 0;
+	while (readdir(dir))
+		++count;
+	closedir(dir);
+	return count;
+}
+
+static void testChildReaping()
+{
+	std::cout << "\n-- CGIManager Child Reaping --\n";
+
+	Request req = createTestRequest();
+	{
+		CGIManager cgi;
+		cgi.prepare(req, "/bin/true");
+		cgi.execute(-1);
+		int pidFd = cgi.getPidFd();
+		pid_t pid = cgi.getPid();
+		check("spawned script has a pidfd", pidFd >= 0);
+
+		struct pollfd pfd = { pidFd, POLLIN, 0 };
+		check("pidfd turns readable when the script exits", poll(&pfd, 1, 2000) == 1);
+		CGIManager::reapChild(pidFd);
+		check("reapChild() routes the exit to its CGIManager", cgi.isDone() && cgi.getPidFd() == -1);
+		check("reapChild() leaves no zombie", waitpid(pid, NULL, WNOHANG) < 0 && errno == ECHILD);
+	}
+	{
+		int pidFd = -1;
+		pid_t pid = -1;
+		{
+			CGIManager cgi;
+			cgi.prepare(req, "/bin/true");
+			cgi.execute(-1);
+			pidFd = cgi.getPidFd();
+			pid = cgi.getPid();
+		}
+		struct pollfd pfd = { pidFd, POLLIN, 0 };
+		poll(&pfd, 1, 2000);
+		CGIManager::reapChild(pidFd);
+		check("a child outliving its CGIManager is reaped", waitpid(pid, NULL, WNOHANG) < 0 && errno == ECHILD);
+	}
+	{
+		// scripts whose connection left before their pidfd was watched get no exit event.
+		const size_t fdsBefore = openFdCount();
+		bool spawned = true;
+		for (int i = 0; i < 3 * 64 && spawned; ++i)
+		{
+			CGIManager cgi;
+			cgi.prepare(req, "/bin/true");
+			try { cgi.execute(-1); }
+			catch (const ClientException&) { spawned = false; }
+			struct pollfd pfd = { cgi.getPidFd(), POLLIN, 0 };
+			poll(&pfd, 1, 2000);
+		}
+		check("exited, unwatched scripts don't count against the spawn limit", spawned);
+		check("their pidfds are closed by later spawns", openFdCount() <= fdsBefore + 64);
+	}
+	{
+		CGIManager cgi;
+		cgi.prepare(req, "/bin/true");
+		cgi.execute(-1); // exits on its own, before the drain starts or after.
+		CGIManager sleeper;
+		sleeper.prepare(req, "/tmp/test_cgi_sleep.sh", "/bin/sh");
+		int fd = open("/tmp/test_cgi_sleep.sh", O_CREAT | O_WRONLY | O_TRUNC, 0755);
+		write(fd, "sleep 30\n", 9);
+		close(fd);
+		sleeper.execute(-1);
+		time_t start = time(NULL);
+		CGIManager::cleanupAllProcesses();
+		check("shutdown drain returns as soon as SIGTERM ends the scripts", time(NULL) - start < 3);
+		check("shutdown drain reaps every script", cgi.isDone() && sleeper.isDone());
+		unlink("/tmp/test_cgi_sleep.sh");
+	}
+}
+
 static void testMultipleCGIInstances()
 {
 	std::cout << "\n-- Multiple CGIManager Instances --\n";
@@ -285,6 +409,8 @@ int main()
 	testExecuteWithEchoScript();
 	testIsDone();
 	testPipeCreation();
+	testSpawnHygiene();
+	testChildReaping();
 	testMultipleCGIInstances();
 
 	std::cout << "\n========================================\n";
@@ -0,0 +1,247 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include "../includes/CgiWorkerPool.hpp"
+#include "../includes/Response.hpp"
+#include "../includes/Request.hpp"
+#include "../includes/ServerConf.hpp"
+#include "../includes/LocationConf.hpp"
+
+// ============================================================================
+// Minimal test harness
+// ============================================================================
+
+static int  g_total  = 0;
+static int  g_passed = 0;
+
+static void check(const char* label, bool condition)
+{
+	g_total++;
+	if (condition)
+	{
+		g_passed++;
+		std::cout << "  [PASS] " << label << "\n";
+	}
+	else
+	{
+		std::cout << "  [FAIL] " << label << "\n";
+	}
+}
+
+static const std::string TEST_ROOT = "/tmp/webserv_test_cgipool";
+
+// ============================================================================
+// Helpers
+// ============================================================================
+
+static void writeFile(const std::string& path, const std::string& content)
+{
+	int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		return;
+	write(fd, content.c_str(), content.size());
+	close(fd);
+}
+
+static void setupFixtures()
+{
+	mkdir(TEST_ROOT.c_str(), 0755);
+	writeFile(TEST_ROOT + "/pid.py",
+		"import os, sys\n"
+		"body = sys.stdin.read()\n"
+		"print('Content-Type: text/plain')\n"
+		"print()\n"
+		"print('pid=%d q=%s len=%d' % (os.getpid(), os.environ.get('QUERY_STRING', ''), len(body)))\n");
+	writeFile(TEST_ROOT + "/exit.py",
+		"import sys\n"
+		"sys.stdout.write('Content-Type: text/plain\\r\\n\\r\\nbye')\n"
+		"sys.exit(3)\n");
+	writeFile(TEST_ROOT + "/sleep.py",
+		"import time\n"
+		"time.sleep(30)\n");
+}
+
+static void cleanupFixtures()
+{
+	unlink((TEST_ROOT + "/pid.py").c_str());
+	unlink((TEST_ROOT + "/exit.py").c_str());
+	unlink((TEST_ROOT + "/sleep.py").c_str());
+	rmdir(TEST_ROOT.c_str());
+}
+
+static ServerConf makePoolConf(size_t workers, size_t maxRequests)
+{
+	ServerConf conf;
+	LocationConf loc;
+	loc.setPath("/");
+	loc.setRoot(TEST_ROOT);
+	loc.addAllowedMethod(GET);
+	loc.addAllowedMethod(POST);
+	loc.addCgiInterpreter(".py", "/usr/bin/python3");
+	loc.setCgiPoolSize(workers);
+	loc.setCgiPoolMaxRequests(maxRequests);
+	loc.setCgiPoolTimeout(4);
+	conf.addLocation(loc);
+	return conf;
+}
+
+static Request makeRequest(const std::string& raw, const std::string& body = "")
+{
+	Request r;
+	r.parseHeaders(raw);
+	if (!body.empty())
+		r.getBodyStore().append(body);
+	return r;
+}
+
+// what the event loop does while the script runs, then the bytes the client gets.
+static std::string finish(Response& r, Request& req, const ServerConf& conf)
+{
+	if (r.getBuildPhase() == BUILD_IDLE)
+		r.buildResponse(req, conf);
+	int guard = 0;
+	bool done = false;
+	while (!done && r.getCgiOutputFd() >= 0 && guard++ < 1000)
+	{
+		struct pollfd p;
+		p.fd = r.getCgiOutputFd();
+		p.events = r.wantsCgiWrite() ? (POLLIN | POLLOUT) : POLLIN;
+		p.revents = 0;
+		poll(&p, 1, 2000);
+		if (r.wantsCgiWrite())
+			r.writeCgiRequest();
+		done = r.readCgiOutput();
+	}
+	r.finalizeCgiResponse();
+
+	int sv[2];
+	socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+	while (!r.sendSlice(sv[0]) && guard++ < 2000)
+		;
+	close(sv[0]);
+	std::string wire;
+	char buf[4096];
+	ssize_t n;
+	while ((n = recv(sv[1], buf, sizeof(buf), 0)) > 0)
+		wire.append(buf, n);
+	close(sv[1]);
+	return wire;
+}
+
+static std::string pidOf(const std::string& wire)
+{
+	size_t pos = wire.find("pid=");
+	if (pos == std::string::npos)
+		return "";
+	return wire.substr(pos, wire.find(' ', pos) - pos);
+}
+
+// ============================================================================
+// Pool
+// ============================================================================
+
+static void testPool()
+{
+	std::cout << "\n-- cgi_pool location --\n";
+
+	ServerConf conf = makePoolConf(2, 3);
+	const LocationConf& loc = conf.getLocations()[0];
+	CgiWorkerPool& pool = CgiWorkerPool::shared();
+	pool.start(loc);
+	check("workers spawned at start", pool.getWorkerCount(loc) == 2 && pool.getIdleCount(loc) == 2);
+
+	std::string firstPid;
+	{
+		Request req = makeRequest("GET /pid.py?a=1 HTTP/1.0\r\nHost: x\r\n\r\n");
+		Response r;
+		bool ready = r.buildResponse(req, conf);
+		check("request goes to an idle worker", !ready && r.getBuildPhase() == BUILD_CGI_RUNNING
+			&& r.getCgiInstance() == NULL && pool.getIdleCount(loc) == 1);
+		check("pooled script uses the location's timeout", r.getCgiTimeout() == 4);
+		std::string wire = finish(r, req, conf);
+		firstPid = pidOf(wire);
+		check("script output relayed like CGI output", wire.find("HTTP/1.0 200") == 0
+			&& wire.find(" q=a=1 len=0") != std::string::npos);
+		check("worker handed back once the answer is in", pool.getIdleCount(loc) == 2);
+	}
+	{
+		std::string body(100000, 'b');
+		Request req = makeRequest("POST /pid.py HTTP/1.0\r\nHost: x\r\nContent-Length: 100000\r\n\r\n", body);
+		Response r;
+		check("no upload is streamed to a pooled script", !r.startCgiUpload(req, conf));
+		std::string wire = finish(r, req, conf);
+		check("same interpreter serves the next request", !firstPid.empty() && pidOf(wire) == firstPid);
+		check("stored body is the script's stdin, environment is the new request's",
+			wire.find(" q= len=100000") != std::string::npos);
+	}
+	{
+		Request req = makeRequest("GET /exit.py HTTP/1.0\r\nHost: x\r\n\r\n");
+		Response r;
+		std::string wire = finish(r, req, conf);
+		check("sys.exit() ends the request, not the worker", wire.find("\r\n\r\nbye") != std::string::npos
+			&& pool.getWorkerCount(loc) == 2);
+	}
+	{
+		Request req = makeRequest("GET /pid.py HTTP/1.0\r\nHost: x\r\n\r\n");
+		Response r;
+		std::string wire = finish(r, req, conf);
+		check("worker replaced after cgi_pool_max_requests", !pidOf(wire).empty() && pidOf(wire) != firstPid);
+	}
+	{
+		int a = pool.acquire(loc);
+		int b = pool.acquire(loc);
+		Request req = makeRequest("GET /exit.py HTTP/1.0\r\nHost: x\r\n\r\n");
+		Response r;
+		r.buildResponse(req, conf);
+		check("busy pool falls back to fork/exec", a >= 0 && b >= 0 && r.getCgiInstance() != NULL);
+		std::string wire = finish(r, req, conf);
+		check("fallback answers all the same", wire.find("\r\n\r\nbye") != std::string::npos);
+		pool.release(a, true);
+		pool.release(b, true);
+	}
+
+	ServerConf single = makePoolConf(1, 1000);
+	const LocationConf& singleLoc = single.getLocations()[0];
+	pool.start(singleLoc);
+	{
+		Request probe = makeRequest("GET /pid.py HTTP/1.0\r\nHost: x\r\n\r\n");
+		Response first;
+		std::string before = pidOf(finish(first, probe, single));
+
+		Request req = makeRequest("GET /sleep.py HTTP/1.0\r\nHost: x\r\n\r\n");
+		Response r;
+		r.buildResponse(req, single);
+		r.cgiTimeout(single);
+		check("timed out script answers 504", r.getStatusCode() == "504");
+
+		Request next = makeRequest("GET /pid.py HTTP/1.0\r\nHost: x\r\n\r\n");
+		Response again;
+		std::string after = pidOf(finish(again, next, single));
+		check("timed out worker is replaced", pool.getIdleCount(singleLoc) == 1 && !after.empty() && after != before);
+	}
+	pool.shutdown();
+	check("shutdown stops every worker", pool.getWorkerCount(loc) == 0 && pool.getWorkerCount(singleLoc) == 0);
+}
+
+// ============================================================================
+// Entry point
+// ============================================================================
+
+int main()
+{
+	setupFixtures();
+	testPool();
+	cleanupFixtures();
+
+	std::cout << "\n===========================\n";
+	std::cout << g_passed << " / " << g_total << " tests passed\n";
+	std::cout << "===========================\n";
+
+	return (g_passed == g_total) ? 0 : 1;
+}
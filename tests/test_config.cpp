@@ -1,6 +1,8 @@
 #include <iostream>
 #include <cassert>
 #include <cstring>
+#include <cstdio>
+#include <fstream>
 #include <arpa/inet.h>
 #include "../includes/AllowedMethods.hpp"
 #include "../includes/LocationConf.hpp"
@@ -129,6 +131,20 @@ static void testServerConf()
 	loc.setPath("/");
 	conf.addLocation(loc);
 	check("addLocation adds to vector",   conf.getLocations().size() == 1);
+
+	check("default keepalive timeout",    conf.getKeepAliveTimeout() == DEFAULT_KEEPALIVE_TIMEOUT_S);
+	check("default keepalive requests",   conf.getKeepAliveRequests() == DEFAULT_KEEPALIVE_REQUESTS);
+	conf.setKeepAliveTimeout(0);
+	check("setKeepAliveTimeout",          conf.getKeepAliveTimeout() == 0);
+	ServerConf copy(conf);
+	check("copy keeps keepalive timeout", copy.getKeepAliveTimeout() == 0);
+
+	check("file cache off by default",    conf.getFileCacheEntries() == 0);
+	conf.setFileCacheEntries(32);
+	conf.setFileCacheMaxSize(4096);
+	ServerConf cached(conf);
+	check("copy keeps file cache entries", cached.getFileCacheEntries() == 32);
+	check("copy keeps file cache max size", cached.getFileCacheMaxSize() == 4096);
 }
 
 // =============================================================================
@@ -143,6 +159,9 @@ static void testConfigParser()
 	std::vector<ServerConf> servers = parser.parse();
 
 	check("two server blocks parsed",      servers.size() == 2);
+	check("worker_processes 2",            parser.getWorkerProcesses() == 2);
+	check("epoll_edge_triggered on",       parser.getEdgeTriggered());
+	check("connection_pool_size 32",       parser.getConnectionPoolSize() == 32);
 
 	// --- First server ---
 	const ServerConf& s0 = servers[0];
@@ -185,6 +204,26 @@ static void testConfigParser()
 	check("s1 server_name",                s1.getServerName() == "api.example.com");
 	check("s1 maxBodySize (1K)",           s1.getMaxBodySize() == 1024);
 	check("s1 listen port 9090",           ntohs(s1.getInterfacePortPair().sin_port) == 9090);
+	check("s1 keepalive_timeout 30",       s1.getKeepAliveTimeout() == 30);
+	check("s1 keepalive_requests 50",      s1.getKeepAliveRequests() == 50);
+	check("s0 keepalive defaults kept",    s0.getKeepAliveRequests() == DEFAULT_KEEPALIVE_REQUESTS);
+	check("s1 file_cache_entries 256",     s1.getFileCacheEntries() == 256);
+	check("s1 file_cache_max_size 128K",   s1.getFileCacheMaxSize() == 128 * 1024);
+	check("s1 file_cache_valid 10",        s1.getFileCacheValid() == 10);
+	check("s0 file cache defaults kept",   s0.getFileCacheEntries() == DEFAULT_FILE_CACHE_ENTRIES
+	                                       && s0.getFileCacheValid() == DEFAULT_FILE_CACHE_VALID_S);
+	check("s1 open_file_cache_entries",    s1.getOpenFileCacheEntries() == 1000);
+	check("s1 open_file_cache_valid",      s1.getOpenFileCacheValid() == 30);
+	check("s1 open_file_cache_inactive",   s1.getOpenFileCacheInactive() == 60);
+	check("s1 file_map_max_size 8M",       s1.getFileMapMaxSize() == 8 * 1024 * 1024);
+	check("s0 file map off",               s0.getFileMapMaxSize() == DEFAULT_FILE_MAP_MAX_SIZE);
+	check("s1 client_header_timeout 5",    s1.getClientHeaderTimeout() == 5);
+	check("s1 client_body_timeout 7",      s1.getClientBodyTimeout() == 7);
+	check("s1 send_timeout 9",             s1.getSendTimeout() == 9);
+	check("s0 timeouts default",           s0.getClientHeaderTimeout() == DEFAULT_CLIENT_HEADER_TIMEOUT_S
+	                                       && s0.getSendTimeout() == DEFAULT_SEND_TIMEOUT_S);
+	check("s0 open file cache off",        s0.getOpenFileCacheEntries() == DEFAULT_OPEN_FILE_CACHE_ENTRIES
+	                                       && s0.getOpenFileCacheInactive() == DEFAULT_OPEN_FILE_CACHE_INACTIVE_S);
 
 	const LocationConf& api = s1.getLocations()[0];
 	check("s1 loc[0] GET",    api.isMethodAllowed(GET));
@@ -196,6 +235,12 @@ static void testConfigParser()
 // ConfigParser error tests
 // ============================================================================
 
+static void writeTopLevelConf(const char* path, const char* topLevel)
+{
+	std::ofstream out(path);
+	out << topLevel << "server { listen 127.0.0.1:8081; location / { root .; } }\n";
+}
+
 static void testConfigParserErrors()
 {
 	std::cout << "\n-- ConfigParser error handling --\n";
@@ -211,6 +256,134 @@ static void testConfigParserErrors()
 		try { p.parse(); check("throws on fatal invalid config fixture", false); }
 		catch (const ConfigParser::ConfigException&) { check("throws on fatal invalid config fixture", true); }
 	}
+
+	const char* tmpConf = "/tmp/lhr_test_workers.conf";
+	{
+		writeTopLevelConf(tmpConf, "worker_processes 0;\n");
+		ConfigParser p(tmpConf);
+		try { p.parse(); check("throws on worker_processes 0", false); }
+		catch (const ConfigParser::ConfigException&) { check("throws on worker_processes 0", true); }
+	}
+	{
+		writeTopLevelConf(tmpConf, "worker_processes auto;\n");
+		ConfigParser p(tmpConf);
+		p.parse();
+		check("worker_processes auto >= 1", p.getWorkerProcesses() >= 1);
+	}
+	{
+		writeTopLevelConf(tmpConf, "");
+		ConfigParser p(tmpConf);
+		p.parse();
+		check("worker_processes defaults to 1", p.getWorkerProcesses() == DEFAULT_WORKER_PROCESSES);
+		check("epoll_edge_triggered defaults to off", !p.getEdgeTriggered());
+		check("connection_pool_size defaults to 0", p.getConnectionPoolSize() == DEFAULT_CONNECTION_POOL_SIZE);
+	}
+	{
+		writeTopLevelConf(tmpConf, "epoll_edge_triggered yes;\n");
+		ConfigParser p(tmpConf);
+		try { p.parse(); check("throws on epoll_edge_triggered yes", false); }
+		catch (const ConfigParser::ConfigException&) { check("throws on epoll_edge_triggered yes", true); }
+	}
+	{
+		writeTopLevelConf(tmpConf, "connection_pool_size 100000;\n");
+		ConfigParser p(tmpConf);
+		try { p.parse(); check("throws on connection_pool_size above the cap", false); }
+		catch (const ConfigParser::ConfigException&) { check("throws on connection_pool_size above the cap", true); }
+	}
+	{
+		std::ofstream out(tmpConf);
+		out << "server { listen 127.0.0.1:8081;\n"
+			   "  location / { root .; fastcgi_pass localhost:9000; }\n"
+			   "  location /sock { root .; fastcgi_pass unix:/run/app.sock; } }\n";
+		out.close();
+		ConfigParser p(tmpConf);
+		std::vector<ServerConf> servers = p.parse();
+		const std::vector<LocationConf>& locs = servers[0].getLocations();
+		check("fastcgi_pass host is resolved at parse time", locs[0].getFastCgiPass() == "127.0.0.1:9000");
+		check("fastcgi_pass unix socket kept as is",          locs[1].getFastCgiPass() == "unix:/run/app.sock");
+	}
+	{
+		std::ofstream out(tmpConf);
+		out << "server { listen 127.0.0.1:8081; location / { root .; fastcgi_pass 9000; } }\n";
+		out.close();
+		ConfigParser p(tmpConf);
+		try { p.parse(); check("throws on fastcgi_pass without host", false); }
+		catch (const ConfigParser::ConfigException&) { check("throws on fastcgi_pass without host", true); }
+	}
+	{
+		std::ofstream out(tmpConf);
+		out << "server { listen 127.0.0.1:8081;\n"
+			   "  location / { root .; cgi_interpreter /usr/bin/python3 .py; cgi_pool 4;\n"
+			   "    cgi_pool_max_requests 50; cgi_pool_timeout 30; }\n"
+			   "  location /plain { root .; cgi_interpreter /usr/bin/python3 .py; } }\n";
+		out.close();
+		ConfigParser p(tmpConf);
+		std::vector<ServerConf> servers = p.parse();
+		const std::vector<LocationConf>& locs = servers[0].getLocations();
+		check("cgi_pool directives parsed", locs[0].getCgiPoolSize() == 4
+			&& locs[0].getCgiPoolMaxRequests() == 50 && locs[0].getCgiPoolTimeout() == 30);
+		check("cgi_pool is off by default", locs[1].getCgiPoolSize() == 0
+			&& locs[1].getCgiPoolMaxRequests() == DEFAULT_CGI_POOL_MAX_REQUESTS);
+	}
+	{
+		std::ofstream out(tmpConf);
+		out << "server { listen 127.0.0.1:8081; location / { root .; cgi_interpreter /bin/sh .sh; cgi_pool 2; } }\n";
+		out.close();
+		ConfigParser p(tmpConf);
+		try { p.parse(); check("throws on cgi_pool without a .py interpreter", false); }
+		catch (const ConfigParser::ConfigException&) { check("throws on cgi_pool without a .py interpreter", true); }
+	}
+	{
+		std::ofstream out(tmpConf);
+		out << "server { listen 127.0.0.1:8081;\n"
+			   "  location / { root .; gzip on; gzip_comp_level 6; gzip_min_length 1k;\n"
+			   "    gzip_types text/css application/javascript; gzip_static on; }\n"
+			   "  location /plain { root .; } }\n";
+		out.close();
+		ConfigParser p(tmpConf);
+		std::vector<ServerConf> servers = p.parse();
+		const std::vector<LocationConf>& locs = servers[0].getLocations();
+		check("gzip directives parsed", locs[0].getGzip() && locs[0].getGzipCompLevel() == 6
+			&& locs[0].getGzipMinLength() == 1024 && locs[0].getGzipStatic());
+		check("gzip_types listed and text/html implied", locs[0].isGzipType("text/css")
+			&& locs[0].isGzipType("application/javascript") && locs[0].isGzipType("text/html; charset=utf-8")
+			&& !locs[0].isGzipType("image/png"));
+		check("gzip is off by default", !locs[1].getGzip() && !locs[1].getGzipStatic()
+			&& locs[1].getGzipCompLevel() == DEFAULT_GZIP_COMP_LEVEL
+			&& locs[1].getGzipMinLength() == DEFAULT_GZIP_MIN_LENGTH);
+	}
+	{
+		std::ofstream out(tmpConf);
+		out << "server { listen 127.0.0.1:8081; location / { root .; gzip on; gzip_comp_level 10; } }\n";
+		out.close();
+		ConfigParser p(tmpConf);
+		try { p.parse(); check("throws on gzip_comp_level out of range", false); }
+		catch (const ConfigParser::ConfigException&) { check("throws on gzip_comp_level out of range", true); }
+	}
+	{
+		std::ofstream out(tmpConf);
+		out << "server { listen 127.0.0.1:8081;\n"
+			   "  location / { root .; expires 2h; cache_control public immutable; }\n"
+			   "  location /never { root .; expires epoch; }\n"
+			   "  location /plain { root .; } }\n";
+		out.close();
+		ConfigParser p(tmpConf);
+		std::vector<ServerConf> servers = p.parse();
+		const std::vector<LocationConf>& locs = servers[0].getLocations();
+		check("expires takes a unit suffix",   locs[0].getExpires() == 7200);
+		check("cache_control values joined",   locs[0].getCacheControl() == "public, immutable");
+		check("expires epoch",                 locs[1].getExpires() == EXPIRES_EPOCH);
+		check("expires is off by default",     locs[2].getExpires() == EXPIRES_OFF && locs[2].getCacheControl().empty());
+	}
+	{
+		std::ofstream out(tmpConf);
+		out << "server { listen 127.0.0.1:8081; location / { root .; expires soon; } }\n";
+		out.close();
+		ConfigParser p(tmpConf);
+		try { p.parse(); check("throws on an invalid expires", false); }
+		catch (const ConfigParser::ConfigException&) { check("throws on an invalid expires", true); }
+	}
+	std::remove(tmpConf);
 }
 
 // ============================================================================
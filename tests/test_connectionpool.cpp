@@ -0,0 +1,148 @@
+#include <iostream>
+#include <cstring>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include "../includes/ConnectionPool.hpp"
+#include "../includes/ServerConf.hpp"
+#include "../includes/Request.hpp"
+
+// ============================================================================
+// Minimal test harness
+// ============================================================================
+
+static int  g_total  = 0;
+static int  g_passed = 0;
+
+static void check(const char* label, bool condition)
+{
+	g_total++;
+	if (condition)
+	{
+		g_passed++;
+		std::cout << "  [PASS] " << label << "\n";
+	}
+	else
+	{
+		std::cout << "  [FAIL] " << label << "\n";
+	}
+}
+
+static struct sockaddr_in makeAddr()
+{
+	struct sockaddr_in addr;
+	std::memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	return addr;
+}
+
+// ============================================================================
+// Hits / misses
+// ============================================================================
+
+static void testHitsAndMisses()
+{
+	std::cout << "\n-- Hits and misses --\n";
+
+	struct sockaddr_in addr = makeAddr();
+	ConnectionPool pool(2);
+	check("warmed to its size",           pool.getIdle() == 2 && pool.getMaxIdle() == 2);
+
+	Connection* a = pool.acquire(10, addr, NULL);
+	Connection* b = pool.acquire(11, addr, NULL);
+	Connection* c = pool.acquire(12, addr, NULL);
+	check("warm objects are hits",        pool.getHits() == 2);
+	check("an empty pool allocates",      pool.getMisses() == 1 && pool.getIdle() == 0);
+	check("fd handed to the connection",  a->getFd() == 10 && c->getFd() == 12);
+
+	pool.release(a);
+	pool.release(b);
+	pool.release(c);
+	check("pool keeps at most its size",  pool.getIdle() == 2);
+
+	Connection* d = pool.acquire(13, addr, NULL);
+	check("released object is reused",    d == b && pool.getHits() == 3);
+	pool.release(d);
+}
+
+// ============================================================================
+// Recycled state
+// ============================================================================
+
+static void testRecycledState()
+{
+	std::cout << "\n-- Recycled state --\n";
+
+	struct sockaddr_in addr = makeAddr();
+	ServerConf first;
+	ServerConf second;
+	first.setDefaults();
+	second.setDefaults();
+	ConnectionPool pool(1);
+
+	int sv[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0)
+	{
+		check("socketpair()", false);
+		return;
+	}
+	Connection* conn = pool.acquire(sv[0], addr, &first);
+	Request* request = conn->getRequest();
+	const char raw[] = "GET /index.html HTTP/1.1\r\nHost: localhost\r\n";
+	if (write(sv[1], raw, sizeof(raw) - 1) < 0)
+		check("write()", false);
+	conn->handleRead();
+	check("partial request buffered",     conn->getState() == READING && !conn->isIdleKeepAlive());
+	conn->triggerError(400);
+	pool.release(conn);
+	close(sv[0]);
+	close(sv[1]);
+
+	Connection* reused = pool.acquire(42, addr, &second);
+	check("same object handed back",      reused == conn && pool.getHits() == 2);
+	check("request object kept",          reused->getRequest() == request);
+	check("new client identity",          reused->getFd() == 42 && reused->getServerConf() == &second);
+	check("state back to READING",        reused->getState() == READING);
+	check("no request left over",         reused->getRequest()->getURL().empty()
+	                                      && reused->getRequest()->getHeaders().empty());
+	check("no CGI left over",             reused->getCgiPipeFd() == -1);
+	pool.release(reused);
+}
+
+// ============================================================================
+// Disabled pool
+// ============================================================================
+
+static void testDisabled()
+{
+	std::cout << "\n-- Disabled pool --\n";
+
+	struct sockaddr_in addr = makeAddr();
+	ConnectionPool pool;
+	Connection* conn = pool.acquire(7, addr, NULL);
+	pool.release(conn);
+	check("size 0 keeps nothing",         pool.getIdle() == 0 && pool.getMisses() == 1);
+
+	pool.warm(3);
+	check("warm() grows the pool",        pool.getIdle() == 3);
+	pool.warm(1);
+	check("warm() shrinks the pool",      pool.getIdle() == 1 && pool.getMaxIdle() == 1);
+}
+
+// ============================================================================
+// Entry point
+// ============================================================================
+
+int main()
+{
+	testHitsAndMisses();
+	testRecycledState();
+	testDisabled();
+
+	std::cout << "\n===========================\n";
+	std::cout << g_passed << " / " << g_total << " tests passed\n";
+	std::cout << "===========================\n";
+
+	return (g_passed == g_total) ? 0 : 1;
+}
@@ -0,0 +1,253 @@
+#include <iostream>
+#include <string>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include "../includes/Deflater.hpp"
+
+// ============================================================================
+// Minimal test harness
+// ============================================================================
+
+static int  g_total  = 0;
+static int  g_passed = 0;
+
+static void check(const char* label, bool condition)
+{
+	g_total++;
+	if (condition)
+	{
+		g_passed++;
+		std::cout << "  [PASS] " << label << "\n";
+	}
+	else
+	{
+		std::cout << "  [FAIL] " << label << "\n";
+	}
+}
+
+static const std::string DF_IN  = "/tmp/webserv_test_deflate.in";
+static const std::string DF_OUT = "/tmp/webserv_test_deflate.out";
+
+static void writeFile(const std::string& path, const std::string& content)
+{
+	int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		return;
+	write(fd, content.data(), content.size());
+	close(fd);
+}
+
+static std::string readFile(const std::string& path)
+{
+	std::string content;
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return content;
+	char buf[65536];
+	ssize_t n;
+	while ((n = read(fd, buf, sizeof(buf))) > 0)
+		content.append(buf, n);
+	close(fd);
+	return content;
+}
+
+/**
+ * Decodes with python's zlib, an independent inflater: what a browser would see.
+ * Returns "<error>" when the stream doesn't decode.
+ */
+static std::string inflate(DeflateFormat format, const std::string& compressed)
+{
+	const char* wbits = (format == DEFLATE_GZIP) ? "31" : (format == DEFLATE_ZLIB ? "15" : "-15");
+	writeFile(DF_IN, compressed);
+	unlink(DF_OUT.c_str());
+	std::string cmd = std::string("python3 -c \"import sys, zlib; d = zlib.decompressobj(") + wbits
+		+ "); out = d.decompress(open(sys.argv[1], 'rb').read()); "
+		  "sys.exit(1) if not d.eof or d.unused_data else open(sys.argv[2], 'wb').write(out)\" "
+		+ DF_IN + " " + DF_OUT + " 2>/dev/null";
+	if (std::system(cmd.c_str()) != 0)
+		return "<error>";
+	return readFile(DF_OUT);
+}
+
+static std::string sampleHtml(size_t rows)
+{
+	std::ostringstream oss;
+	oss << "<!DOCTYPE html>\n<html><head><title>index</title></head><body>\n<table>\n";
+	for (size_t i = 0; i < rows; ++i)
+		oss << "<tr><td><a href=\"/files/item-" << i << ".txt\">item-" << i << ".txt</a></td><td>"
+			<< (i * 7919) % 100000 << " bytes</td></tr>\n";
+	oss << "</table>\n</body></html>\n";
+	return oss.str();
+}
+
+static std::string noise(size_t n)
+{
+	std::string data(n, '\0');
+	unsigned long state = 12345;
+	for (size_t i = 0; i < n; ++i)
+	{
+		state = state * 1103515245UL + 12345UL;
+		data[i] = static_cast<char>((state >> 16) & 0xFF);
+	}
+	return data;
+}
+
+// ============================================================================
+// Deflater tests
+// ============================================================================
+
+static void testRoundTrip()
+{
+	std::cout << "\n--- One-shot round trips ---\n";
+	const std::string html = sampleHtml(3000);
+
+	check("empty input is a valid gzip stream",   inflate(DEFLATE_GZIP, Deflater::compress(DEFLATE_GZIP, 6, "", 0)).empty());
+	check("one byte",                             inflate(DEFLATE_GZIP, Deflater::compress(DEFLATE_GZIP, 6, "x", 1)) == "x");
+	check("short text",                           inflate(DEFLATE_GZIP, Deflater::compress(DEFLATE_GZIP, 6, "hello, hello, hello world", 25))
+	                                              == "hello, hello, hello world");
+
+	std::string gz = Deflater::compress(DEFLATE_GZIP, 6, html.data(), html.size());
+	check("gzip header magic",                    gz.size() > 18 && gz[0] == '\x1f' && gz[1] == '\x8b' && gz[2] == 8);
+	check("html decodes identically (gzip)",      inflate(DEFLATE_GZIP, gz) == html);
+	check("html shrinks below a fifth",           gz.size() * 5 < html.size());
+
+	std::string zl = Deflater::compress(DEFLATE_ZLIB, 6, html.data(), html.size());
+	check("zlib header check bits",               zl.size() > 6 && ((static_cast<unsigned char>(zl[0]) << 8)
+	                                              | static_cast<unsigned char>(zl[1])) % 31 == 0);
+	check("html decodes identically (zlib)",      inflate(DEFLATE_ZLIB, zl) == html);
+
+	std::string raw = Deflater::compress(DEFLATE_RAW, 6, html.data(), html.size());
+	check("html decodes identically (raw)",       inflate(DEFLATE_RAW, raw) == html);
+
+	std::string runs(300000, 'a');
+	check("long runs use max-length matches",     inflate(DEFLATE_GZIP, Deflater::compress(DEFLATE_GZIP, 1, runs.data(), runs.size())) == runs);
+}
+
+static void testLevels()
+{
+	std::cout << "\n--- Compression levels ---\n";
+	const std::string html = sampleHtml(2000);
+	bool allDecode = true;
+	size_t fastest = 0, smallest = 0;
+	for (int level = 1; level <= 9; ++level)
+	{
+		std::string gz = Deflater::compress(DEFLATE_GZIP, level, html.data(), html.size());
+		if (inflate(DEFLATE_GZIP, gz) != html)
+			allDecode = false;
+		if (level == 1)
+			fastest = gz.size();
+		if (level == 9)
+			smallest = gz.size();
+	}
+	check("every level decodes",                  allDecode);
+	check("level 9 is no larger than level 1",    smallest <= fastest);
+	check("out of range levels are clamped",      inflate(DEFLATE_GZIP, Deflater::compress(DEFLATE_GZIP, 42, html.data(), html.size())) == html);
+}
+
+static void testIncompressible()
+{
+	std::cout << "\n--- Incompressible input ---\n";
+	const std::string data = noise(200000);
+	std::string gz = Deflater::compress(DEFLATE_GZIP, 6, data.data(), data.size());
+	check("random bytes decode identically",      inflate(DEFLATE_GZIP, gz) == data);
+	check("stored blocks bound the growth",       gz.size() < data.size() + data.size() / 100 + 64);
+}
+
+static void testBinary()
+{
+	std::cout << "\n--- Non-ASCII and binary input ---\n";
+	// bytes 0x90-0xFF take the 9-bit fixed Huffman codes; short inputs always pick a fixed block.
+	std::string utf8;
+	for (int i = 0; i < 40; ++i)
+		utf8 += "<p>h\xc3\xa9llo w\xc3\xb6rld \xe2\x80\x94 \xe6\x97\xa5\xe6\x9c\xac\xe8\xaa\x9e \xe2\x9c\x93</p>\n";
+	std::string highBytes = noise(4000);
+	for (size_t i = 0; i < highBytes.size(); ++i)
+		highBytes[i] = static_cast<char>(0x90 + (static_cast<unsigned char>(highBytes[i]) & 0x0F));
+	const std::string binary = noise(3000) + noise(3000);
+
+	const DeflateFormat formats[] = { DEFLATE_RAW, DEFLATE_ZLIB, DEFLATE_GZIP };
+	const char* names[] = { "raw", "zlib", "gzip" };
+	const int levels[] = { 1, 9 };
+	for (size_t f = 0; f < 3; ++f)
+	{
+		for (size_t l = 0; l < 2; ++l)
+		{
+			const DeflateFormat format = formats[f];
+			const int level = levels[l];
+			bool tinyOk = true;
+			for (size_t n = 1; n <= 16; ++n)
+			{
+				const std::string tiny = noise(n);
+				if (inflate(format, Deflater::compress(format, level, tiny.data(), tiny.size())) != tiny)
+					tinyOk = false;
+			}
+			std::ostringstream label;
+			label << " (" << names[f] << ", level " << level << ")";
+			check(("utf-8 text decodes identically" + label.str()).c_str(),
+				  inflate(format, Deflater::compress(format, level, utf8.data(), utf8.size())) == utf8);
+			check(("high bytes decode identically" + label.str()).c_str(),
+				  inflate(format, Deflater::compress(format, level, highBytes.data(), highBytes.size())) == highBytes);
+			check(("binary decodes identically" + label.str()).c_str(),
+				  inflate(format, Deflater::compress(format, level, binary.data(), binary.size())) == binary);
+			check(("1-16 random bytes decode identically" + label.str()).c_str(), tinyOk);
+		}
+	}
+}
+
+static void testStreaming()
+{
+	std::cout << "\n--- Streaming ---\n";
+	const std::string data = sampleHtml(4000) + noise(70000) + sampleHtml(500);
+
+	Deflater deflater;
+	deflater.start(DEFLATE_GZIP, 6);
+	std::string out;
+	size_t slices[] = { 1, 7, 300, 4096, 65536, 13 };
+	size_t at = 0, k = 0;
+	bool emittedEarly = false;
+	while (at < data.size())
+	{
+		size_t n = std::min(slices[k++ % 6], data.size() - at);
+		deflater.write(data.data() + at, n, out);
+		at += n;
+		if (!out.empty() && at < data.size())
+			emittedEarly = true;
+	}
+	check("output flows before finish",           emittedEarly);
+	check("not finished before finish()",         !deflater.isFinished());
+	deflater.finish(out);
+	check("finished after finish()",              deflater.isFinished());
+	check("sliced writes decode identically",     inflate(DEFLATE_GZIP, out) == data);
+
+	std::string extra;
+	deflater.write("late", 4, extra);
+	deflater.finish(extra);
+	check("a finished stream ignores more input", extra.empty());
+
+	deflater.start(DEFLATE_ZLIB, 1);
+	std::string again;
+	deflater.write(data.data(), data.size(), again);
+	deflater.finish(again);
+	check("start() begins a fresh stream",        inflate(DEFLATE_ZLIB, again) == data);
+}
+
+int main()
+{
+	testRoundTrip();
+	testLevels();
+	testIncompressible();
+	testBinary();
+	testStreaming();
+
+	unlink(DF_IN.c_str());
+	unlink(DF_OUT.c_str());
+
+	std::cout << "\n===========================\n";
+	std::cout << g_passed << " / " << g_total << " tests passed\n";
+	std::cout << "===========================\n";
+
+	return (g_passed == g_total) ? 0 : 1;
+}
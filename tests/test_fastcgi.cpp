@@ -0,0 +1,350 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <map>
+#include <cstring>
+#include <cstdlib>
+#include <csignal>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include "../includes/FastCgiClient.hpp"
+#include "../includes/Response.hpp"
+#include "../includes/Request.hpp"
+#include "../includes/ServerConf.hpp"
+#include "../includes/LocationConf.hpp"
+#include "../includes/FatalExceptions.hpp"
+
+// ============================================================================
+// Minimal test harness
+// ============================================================================
+
+static int  g_total  = 0;
+static int  g_passed = 0;
+
+static void check(const char* label, bool condition)
+{
+	g_total++;
+	if (condition)
+	{
+		g_passed++;
+		std::cout << "  [PASS] " << label << "\n";
+	}
+	else
+	{
+		std::cout << "  [FAIL] " << label << "\n";
+	}
+}
+
+static const std::string SOCK_PATH = "/tmp/lhr_fcgi_test.sock";
+static const std::string ADDRESS   = "unix:" + SOCK_PATH;
+
+// ============================================================================
+// A minimal FastCGI responder, run in a child process
+// ============================================================================
+
+static bool readRecord(int fd, std::string& in, int& type, std::string& content)
+{
+	for (;;)
+	{
+		if (in.size() >= 8)
+		{
+			const unsigned char* h = reinterpret_cast<const unsigned char*>(in.data());
+			size_t len = (static_cast<size_t>(h[4]) << 8) | h[5];
+			size_t total = 8 + len + h[6];
+			if (in.size() >= total)
+			{
+				type = h[1];
+				content = in.substr(8, len);
+				in.erase(0, total);
+				return true;
+			}
+		}
+		char buf[8192];
+		ssize_t n = read(fd, buf, sizeof(buf));
+		if (n <= 0)
+			return false;
+		in.append(buf, n);
+	}
+}
+
+static void writeRecord(int fd, int type, const std::string& content)
+{
+	unsigned char h[8] = { 1, static_cast<unsigned char>(type), 0, 1,
+		static_cast<unsigned char>(content.size() >> 8), static_cast<unsigned char>(content.size() & 0xff), 0, 0 };
+	std::string rec(reinterpret_cast<char*>(h), 8);
+	rec += content;
+	size_t off = 0;
+	while (off < rec.size())
+	{
+		ssize_t n = write(fd, rec.data() + off, rec.size() - off);
+		if (n <= 0)
+			return;
+		off += n;
+	}
+}
+
+static size_t paramLength(const std::string& s, size_t& pos)
+{
+	unsigned char b = s[pos];
+	if (b < 128)
+		return s[pos++];
+	size_t len = ((b & 0x7f) << 24) | (static_cast<unsigned char>(s[pos + 1]) << 16)
+		| (static_cast<unsigned char>(s[pos + 2]) << 8) | static_cast<unsigned char>(s[pos + 3]);
+	pos += 4;
+	return len;
+}
+
+// answers every request with its method, body length, script and the connection's number.
+static void runResponder(int listenFd)
+{
+	int connections = 0;
+	for (;;)
+	{
+		int fd = accept(listenFd, NULL, NULL);
+		if (fd < 0)
+			_exit(0);
+		++connections;
+		std::string in;
+		bool keepConn = true;
+		while (keepConn)
+		{
+			std::string params, body;
+			int type;
+			std::string content;
+			bool ok = true;
+			for (;;)
+			{
+				if (!(ok = readRecord(fd, in, type, content)))
+					break;
+				if (type == 1)
+					keepConn = content.size() > 2 && (content[2] & 1);
+				else if (type == 4)
+					params += content;
+				else if (type == 5 && content.empty())
+					break;
+				else if (type == 5)
+					body += content;
+			}
+			if (!ok)
+				break;
+
+			std::map<std::string, std::string> env;
+			for (size_t pos = 0; pos < params.size(); )
+			{
+				size_t nameLen = paramLength(params, pos);
+				size_t valueLen = paramLength(params, pos);
+				env[params.substr(pos, nameLen)] = params.substr(pos + nameLen, valueLen);
+				pos += nameLen + valueLen;
+			}
+			std::ostringstream answer;
+			answer << "Content-Type: text/plain\r\n\r\n" << env["REQUEST_METHOD"] << " " << body.size()
+				   << " conn=" << connections << " script=" << env["SCRIPT_FILENAME"];
+			std::string text = answer.str();
+			for (size_t off = 0; off < text.size(); off += 1000)
+				writeRecord(fd, 6, text.substr(off, 1000));
+			writeRecord(fd, 6, "");
+			writeRecord(fd, 3, std::string(8, '\0'));
+		}
+		close(fd);
+	}
+}
+
+static pid_t startResponder()
+{
+	unlink(SOCK_PATH.c_str());
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	struct sockaddr_un addr;
+	std::memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	std::strncpy(addr.sun_path, SOCK_PATH.c_str(), sizeof(addr.sun_path) - 1);
+	bind(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr));
+	listen(fd, 8);
+	pid_t pid = fork();
+	if (pid == 0)
+		runResponder(fd);
+	close(fd);
+	return pid;
+}
+
+static void stopResponder(pid_t pid)
+{
+	kill(pid, SIGKILL);
+	waitpid(pid, NULL, 0);
+	unlink(SOCK_PATH.c_str());
+}
+
+// ============================================================================
+// Helpers
+// ============================================================================
+
+static Request makeRequest(const std::string& raw, const std::string& body = "")
+{
+	Request r;
+	r.parseHeaders(raw);
+	if (!body.empty())
+		r.getBodyStore().append(body);
+	return r;
+}
+
+static bool waitFd(int fd, short events)
+{
+	struct pollfd p;
+	p.fd = fd;
+	p.events = events;
+	p.revents = 0;
+	return poll(&p, 1, 2000) > 0;
+}
+
+// what the event loop does for one request: send while there's something to send, read until the end.
+static std::string exchange(FastCgiClient& client)
+{
+	std::string out;
+	int guard = 0;
+	while (guard++ < 1000)
+	{
+		int fd = client.getFd();
+		if (fd < 0)
+			break;
+		waitFd(fd, client.wantsWrite() ? (POLLIN | POLLOUT) : POLLIN);
+		if (client.wantsWrite())
+			client.flush();
+		if (client.receive(out))
+			break;
+	}
+	return out;
+}
+
+// ============================================================================
+// Client
+// ============================================================================
+
+static void testClient()
+{
+	std::cout << "\n-- FastCGI client --\n";
+
+	pid_t responder = startResponder();
+	{
+		Request req = makeRequest("GET /app/index.php?x=1 HTTP/1.1\r\nHost: x\r\n\r\n");
+		FastCgiClient client;
+		client.start(req, "/srv/app/index.php", ADDRESS);
+		check("request queued on an open socket", client.getFd() >= 0 && client.wantsWrite());
+		std::string out = exchange(client);
+		check("stdout records carry the CGI output",
+			out == "Content-Type: text/plain\r\n\r\nGET 0 conn=1 script=/srv/app/index.php");
+		check("finished connection goes back to the pool",
+			client.getFd() < 0 && FastCgiClient::getIdleCount(ADDRESS) == 1);
+	}
+	{
+		std::string body(100000, 'b');
+		Request req = makeRequest("POST /app/form.php HTTP/1.1\r\nHost: x\r\nContent-Length: 100000\r\n\r\n", body);
+		FastCgiClient client;
+		client.start(req, "/srv/app/form.php", ADDRESS);
+		check("pooled connection is taken again", FastCgiClient::getIdleCount(ADDRESS) == 0);
+		std::string out = exchange(client);
+		check("body sent as stdin records, over the same connection",
+			out.find("POST 100000 conn=1 ") != std::string::npos);
+	}
+	stopResponder(responder);
+
+	responder = startResponder();
+	{
+		Request req = makeRequest("GET /a.php HTTP/1.1\r\nHost: x\r\n\r\n");
+		FastCgiClient client;
+		client.start(req, "/srv/a.php", ADDRESS);
+		std::string out = exchange(client);
+		check("connection closed by the backend is not reused", out.find("GET 0 conn=1 ") != std::string::npos);
+	}
+	stopResponder(responder);
+	FastCgiClient::closeIdleConnections();
+
+	{
+		Request req = makeRequest("GET /a.php HTTP/1.1\r\nHost: x\r\n\r\n");
+		FastCgiClient client;
+		int status = 0;
+		try { client.start(req, "/srv/a.php", ADDRESS); }
+		catch (const ClientException& e) { status = e.getStatusCode(); }
+		check("unreachable backend is a 502", status == 502);
+	}
+}
+
+// ============================================================================
+// Response
+// ============================================================================
+
+static void testResponse()
+{
+	std::cout << "\n-- fastcgi_pass location --\n";
+
+	ServerConf conf;
+	LocationConf loc;
+	loc.setPath("/");
+	loc.setRoot("/srv/www");
+	loc.addAllowedMethod(GET);
+	loc.addAllowedMethod(POST);
+	loc.setFastCgiPass(ADDRESS);
+	conf.addLocation(loc);
+
+	pid_t responder = startResponder();
+	{
+		Request req = makeRequest("POST /index.php HTTP/1.0\r\nHost: x\r\nContent-Length: 3\r\n\r\n", "abc");
+		Response r;
+		bool ready = r.buildResponse(req, conf);
+		check("request goes to the backend", !ready && r.getBuildPhase() == BUILD_CGI_RUNNING
+			&& r.getCgiOutputFd() >= 0);
+		check("no upload is streamed to a FastCGI location", !r.isCgiUpload());
+		int guard = 0;
+		bool done = false;
+		while (!done && guard++ < 1000)
+		{
+			waitFd(r.getCgiOutputFd(), r.wantsCgiWrite() ? (POLLIN | POLLOUT) : POLLIN);
+			if (r.wantsCgiWrite())
+				r.writeCgiRequest();
+			done = r.readCgiOutput();
+		}
+		r.finalizeCgiResponse();
+
+		int sv[2];
+		socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+		while (!r.sendSlice(sv[0]) && guard++ < 2000)
+			;
+		close(sv[0]);
+		std::string wire;
+		char buf[4096];
+		ssize_t n;
+		while ((n = recv(sv[1], buf, sizeof(buf), 0)) > 0)
+			wire.append(buf, n);
+		close(sv[1]);
+		check("answer relayed like CGI output", wire.find("HTTP/1.0 200") == 0
+			&& wire.find("POST 3 conn=1 script=/srv/www/index.php") != std::string::npos);
+	}
+	stopResponder(responder);
+	FastCgiClient::closeIdleConnections();
+
+	{
+		Request req = makeRequest("GET /index.php HTTP/1.1\r\nHost: x\r\n\r\n");
+		Response r;
+		int status = 0;
+		try { r.buildResponse(req, conf); }
+		catch (const ClientException& e) { status = e.getStatusCode(); }
+		check("backend down answers 502", status == 502 && r.getCgiOutputFd() < 0);
+	}
+}
+
+// ============================================================================
+// Entry point
+// ============================================================================
+
+int main()
+{
+	testClient();
+	testResponse();
+
+	std::cout << "\n===========================\n";
+	std::cout << g_passed << " / " << g_total << " tests passed\n";
+	std::cout << "===========================\n";
+
+	return (g_passed == g_total) ? 0 : 1;
+}
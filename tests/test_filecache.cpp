@@ -0,0 +1,299 @@
+#include <iostream>
+#include <string>
+#include <sstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <utime.h>
+#include <sys/stat.h>
+#include "../includes/FileCache.hpp"
+#include "../includes/OpenFileCache.hpp"
+#include "../includes/FileMapCache.hpp"
+#include "../includes/Deflater.hpp"
+
+// ============================================================================
+// Minimal test harness
+// ============================================================================
+
+static int  g_total  = 0;
+static int  g_passed = 0;
+
+static void check(const char* label, bool condition)
+{
+	g_total++;
+	if (condition)
+	{
+		g_passed++;
+		std::cout << "  [PASS] " << label << "\n";
+	}
+	else
+	{
+		std::cout << "  [FAIL] " << label << "\n";
+	}
+}
+
+static const std::string FC_DIR = "/tmp/webserv_test_filecache";
+
+static void writeFile(const std::string& path, const std::string& content)
+{
+	int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		return;
+	write(fd, content.c_str(), content.size());
+	close(fd);
+}
+
+static std::string sizeToStr(size_t n)
+{
+	std::ostringstream oss;
+	oss << n;
+	return oss.str();
+}
+
+static const CachedFile* storePath(FileCache& cache, const std::string& path, size_t maxEntries, time_t now)
+{
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0)
+		return NULL;
+	std::string body = "cached:" + path;
+	return cache.store(path, st, body, "text/plain", "Thu, 01 Jan 1970 00:00:00 GMT", maxEntries, now);
+}
+
+// ============================================================================
+// FileCache tests
+// ============================================================================
+
+static void testStoreAndLookup()
+{
+	std::cout << "\n-- FileCache store / lookup --\n";
+
+	FileCache cache;
+	const std::string a = FC_DIR + "/a.txt";
+	writeFile(a, "alpha");
+
+	check("lookup misses on an empty cache", cache.lookup(a, 5, 100) == NULL);
+
+	const CachedFile* stored = storePath(cache, a, 4, 100);
+	check("store returns the entry",          stored != NULL && stored->body == "cached:" + a);
+	check("Content-Length is precomputed",    stored && stored->contentLength == sizeToStr(stored->body.size()));
+	check("store with 0 entries is a no-op",  storePath(cache, a, 0, 100) == NULL);
+
+	const CachedFile* hit = cache.lookup(a, 5, 102);
+	check("lookup hits inside the validity window", hit != NULL && hit->contentType == "text/plain");
+	check("cache holds one entry",            cache.size() == 1);
+
+	cache.invalidate(a);
+	check("invalidate drops the entry",       cache.lookup(a, 5, 102) == NULL && cache.size() == 0);
+}
+
+static void testRevalidation()
+{
+	std::cout << "\n-- FileCache revalidation --\n";
+
+	FileCache cache;
+	const std::string b = FC_DIR + "/b.txt";
+	writeFile(b, "bravo");
+	storePath(cache, b, 4, 100);
+
+	// same size, new mtime: only caught once the window expires.
+	writeFile(b, "BRAVO");
+	struct utimbuf times;
+	times.actime  = 12345;
+	times.modtime = 12345;
+	utime(b.c_str(), &times);
+
+	check("changed file still trusted inside the window", cache.lookup(b, 5, 104) != NULL);
+	check("changed file dropped once the window expires", cache.lookup(b, 5, 105) == NULL);
+
+	storePath(cache, b, 4, 200);
+	check("unchanged file survives revalidation", cache.lookup(b, 0, 300) != NULL);
+
+	unlink(b.c_str());
+	check("deleted file dropped on revalidation", cache.lookup(b, 0, 300) == NULL);
+}
+
+static void testLruEviction()
+{
+	std::cout << "\n-- FileCache LRU eviction --\n";
+
+	FileCache cache;
+	const std::string p1 = FC_DIR + "/1.txt";
+	const std::string p2 = FC_DIR + "/2.txt";
+	const std::string p3 = FC_DIR + "/3.txt";
+	writeFile(p1, "1");
+	writeFile(p2, "2");
+	writeFile(p3, "3");
+
+	storePath(cache, p1, 2, 100);
+	storePath(cache, p2, 2, 100);
+	cache.lookup(p1, 5, 100); // p1 becomes most recently used
+	storePath(cache, p3, 2, 100);
+
+	check("capacity is respected",            cache.size() == 2);
+	check("least recently used entry evicted", cache.lookup(p2, 5, 100) == NULL);
+	check("recently used entry kept",         cache.lookup(p1, 5, 100) != NULL);
+	check("new entry kept",                   cache.lookup(p3, 5, 100) != NULL);
+
+	FileCache copy(cache);
+	check("copy keeps the entries",           copy.size() == 2 && copy.lookup(p1, 5, 100) != NULL);
+	copy.clear();
+	check("clearing a copy leaves the original", copy.size() == 0 && cache.size() == 2);
+}
+
+// ============================================================================
+// OpenFileCache tests
+// ============================================================================
+
+static bool fdIsOpen(int fd)
+{
+	return fcntl(fd, F_GETFD) != -1;
+}
+
+static void testOpenFileCacheShare()
+{
+	std::cout << "\n-- OpenFileCache shared descriptors --\n";
+
+	OpenFileCache cache;
+	const std::string f = FC_DIR + "/open.txt";
+	writeFile(f, "open me");
+
+	struct stat st;
+	int fd1 = cache.acquire(f, st, 4, 5, 20, 100);
+	int fd2 = cache.acquire(f, st, 4, 5, 20, 101);
+	check("acquire opens a regular file",     fd1 >= 0 && st.st_size == 7);
+	check("second acquire shares the fd",     fd2 == fd1 && cache.size() == 1);
+
+	check("stat served from the cache",       cache.stat(f, st, 4, 5, 20, 102) && S_ISREG(st.st_mode));
+	check("directories are stat-only",        cache.stat(FC_DIR, st, 4, 5, 20, 102)
+	                                          && cache.acquire(FC_DIR, st, 4, 5, 20, 102) == -1);
+	check("missing path is not cached",       !cache.stat(FC_DIR + "/nope", st, 4, 5, 20, 102) && cache.size() == 2);
+
+	cache.invalidate(f);
+	check("evicted fd stays open while in use", fdIsOpen(fd1));
+	cache.release(fd1);
+	check("fd still open with one reference",   fdIsOpen(fd1));
+	cache.release(fd2);
+	check("last release closes the evicted fd", !fdIsOpen(fd1));
+	unlink(f.c_str());
+}
+
+static void testOpenFileCacheRevalidate()
+{
+	std::cout << "\n-- OpenFileCache revalidation & sweep --\n";
+
+	OpenFileCache cache;
+	const std::string f = FC_DIR + "/reval.txt";
+	writeFile(f, "v1");
+
+	struct stat st;
+	int fd = cache.acquire(f, st, 4, 5, 20, 100);
+	cache.release(fd);
+	ino_t firstInode = st.st_ino;
+
+	// replaced by a new inode, as an editor or deploy would do.
+	unlink(f.c_str());
+	writeFile(f, "version2");
+	check("stale entry trusted inside the window", cache.stat(f, st, 4, 5, 20, 104) && st.st_size == 2);
+	check("entry refreshed once the window expires", cache.stat(f, st, 4, 5, 20, 105) && st.st_size == 8
+	                                               && st.st_ino != firstInode);
+
+	cache.sweep(110);
+	check("sweep keeps recently used entries",     cache.size() == 1);
+	cache.sweep(200);
+	check("sweep closes inactive entries",         cache.size() == 0);
+
+	check("0 entries falls back to a plain stat",  cache.stat(f, st, 0, 5, 20, 200) && cache.size() == 0);
+	unlink(f.c_str());
+}
+
+// ============================================================================
+// FileMapCache tests
+// ============================================================================
+
+static void testFileMapCache()
+{
+	std::cout << "\n-- FileMapCache shared mappings --\n";
+
+	FileMapCache cache;
+	const std::string f = FC_DIR + "/mapped.txt";
+	writeFile(f, "mapped bytes");
+
+	struct stat st;
+	stat(f.c_str(), &st);
+	int fd1 = open(f.c_str(), O_RDONLY);
+	int fd2 = open(f.c_str(), O_RDONLY);
+	const char* m1 = cache.acquire(fd1, st);
+	const char* m2 = cache.acquire(fd2, st);
+	check("acquire maps the file",            m1 && std::string(m1, 12) == "mapped bytes");
+	check("same version shares one mapping",  m2 == m1 && cache.size() == 1);
+	close(fd2);
+	check("mapping outlives the descriptor",  std::string(m1, 6) == "mapped");
+
+	// a rewrite changes size and mtime: new readers get their own mapping.
+	writeFile(f, "mapped bytes, v2");
+	struct stat st2;
+	stat(f.c_str(), &st2);
+	st2.st_mtime = st.st_mtime + 1;
+	int fd3 = open(f.c_str(), O_RDONLY);
+	const char* m3 = cache.acquire(fd3, st2);
+	check("new version gets a new mapping",   m3 && m3 != m1 && cache.size() == 2);
+
+	cache.release(m1);
+	check("mapping kept while referenced",    cache.size() == 2);
+	cache.release(m2);
+	check("last release unmaps",              cache.size() == 1);
+	cache.release(m3);
+	check("every mapping released",           cache.size() == 0);
+
+	struct stat dir;
+	stat(FC_DIR.c_str(), &dir);
+	check("directories are not mapped",       cache.acquire(fd3, dir) == NULL);
+	writeFile(f, "");
+	stat(f.c_str(), &st);
+	check("empty files are not mapped",       cache.acquire(fd3, st) == NULL && cache.size() == 0);
+	close(fd1);
+	close(fd3);
+
+	// truncated under a live mapping: the feed fails instead of the process taking SIGBUS.
+	writeFile(f, std::string(3 * 4096, 't'));
+	stat(f.c_str(), &st);
+	int fd4 = open(f.c_str(), O_RDONLY);
+	const char* m4 = cache.acquire(fd4, st);
+	Deflater deflater;
+	deflater.start(DEFLATE_RAW, 1);
+	std::string out;
+	bool fed = m4 && FileMapCache::feed(deflater, m4 + 4096, 4096, out);
+	deflater.finish(out);
+	check("feed deflates mapped bytes",       fed && Deflater::compress(DEFLATE_RAW, 1, m4 + 4096, 4096) == out);
+	truncate(f.c_str(), 0);
+	deflater.start(DEFLATE_RAW, 1);
+	check("feed fails past a truncation",     !FileMapCache::feed(deflater, m4 + 4096, 4096, out));
+	deflater.start(DEFLATE_RAW, 1);
+	check("and keeps failing safely",         !FileMapCache::feed(deflater, m4, 16, out));
+	cache.release(m4);
+	close(fd4);
+	unlink(f.c_str());
+}
+
+int main()
+{
+	mkdir(FC_DIR.c_str(), 0755);
+
+	testStoreAndLookup();
+	testRevalidation();
+	testLruEviction();
+	testOpenFileCacheShare();
+	testOpenFileCacheRevalidate();
+	testFileMapCache();
+
+	unlink((FC_DIR + "/a.txt").c_str());
+	unlink((FC_DIR + "/1.txt").c_str());
+	unlink((FC_DIR + "/2.txt").c_str());
+	unlink((FC_DIR + "/3.txt").c_str());
+	rmdir(FC_DIR.c_str());
+
+	std::cout << "\n===========================\n";
+	std::cout << g_passed << " / " << g_total << " tests passed\n";
+	std::cout << "===========================\n";
+
+	return (g_passed == g_total) ? 0 : 1;
+}
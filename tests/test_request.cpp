@@ -125,27 +125,25 @@ static void testRequestErrors()
 }
 
 // ============================================================================
-// Request Chunked Utility Tests
+// Request Chunked Decoding Tests (feedChunked)
 // ============================================================================
 
-static void testRequestChunkedDone()
+static std::string bodyOf(Request& req)
 {
-    std::cout << "\n-- Request::isChunkedDone --\n";
-
-    Request req;
-    check("Finds end marker perfectly", req.isChunkedDone("some data\r\n0\r\n\r\n"));
-    check("Fails on partial marker",    !req.isChunkedDone("some data\r\n0\r\n"));
-    check("Fails on empty string",      !req.isChunkedDone(""));
-    check("Finds exact marker",         req.isChunkedDone("0\r\n\r\n"));
+    const std::vector<char>& vec = req.getBodyStore().getVector();
+    return std::string(vec.begin(), vec.end());
 }
 
-// ============================================================================
-// Request Chunked Decoding Tests (processBodySlice)
-// ============================================================================
+static Request chunkedRequest(long long maxBodySize)
+{
+    Request req(maxBodySize);
+    req.parseHeaders("POST /api HTTP/1.1\r\nHost: a\r\nTransfer-Encoding: chunked\r\n\r\n");
+    return req;
+}
 
 static void testRequestBodySlice()
 {
-    std::cout << "\n-- Request::processBodySlice (Chunked Decoding) --\n";
+    std::cout << "\n-- Request::feedChunked (Chunked Decoding) --\n";
 
     Request req;
     // 1. Send the headers to put the Request into REQ_CHUNKED state
@@ -155,26 +153,72 @@ static void testRequestBodySlice()
     cout << "State after parsing headers: " << req.getReqState() << endl;
     check("State is correctly REQ_CHUNKED", req.getReqState() == REQ_CHUNKED);
 
-    // 2. Simulate the socket receiving chunked data and pushing it to the DataStore
+    // 2. Feed the chunks as if recv() returned them in one go
     // Format: 4 bytes ("Wiki"), 5 bytes ("pedia"), End Marker
     std::string rawChunkedPayload = "4\r\nWiki\r\n5\r\npedia\r\n0\r\n\r\n";
+    size_t used = req.feedChunked(rawChunkedPayload.data(), rawChunkedPayload.size());
 
-    // Force DataStore to RAM mode for the test
-    req.getBodyStore().append(rawChunkedPayload.c_str(), rawChunkedPayload.size());
-
-    // 3. Trigger the parser
-    bool result = req.processBodySlice();
-
-    // 4. Validate
-    check("processBodySlice returns true (finished)", result == true);
-    check("isBodyProcessed is flagged",               req.isComplete() || req.getReqState() == REQ_CHUNKED); // Depending on how you transition state
+    // 3. Validate
+    check("whole payload consumed",             used == rawChunkedPayload.size());
+    check("request complete after last chunk",  req.isComplete());
+    check("Payload correctly unchunked",        bodyOf(req) == "Wikipedia");
+    check("content-length set to decoded size", req.getHeader("content-length") == "9");
+}
 
-    // Check if the body was successfully unchunked into "Wikipedia"
-    std::string decodedString;
-    const std::vector<char>& vec = req.getBodyStore().getVector();
-    decodedString.assign(vec.begin(), vec.end());
+static void testRequestChunkedSplits()
+{
+    std::cout << "\n-- Request::feedChunked (split reads) --\n";
+
+    // extensions and trailers, fed one byte per "read"
+    const std::string payload = "4;name=\"a;b\"\r\nWiki\r\n5 ; x\r\npedia\r\n"
+                                "0;last\r\nX-Checksum: 1\r\nX-Other: 2\r\n\r\n";
+    Request req = chunkedRequest(0);
+    size_t used = 0;
+    for (size_t i = 0; i < payload.size() && req.getReqState() == REQ_CHUNKED; ++i)
+        used += req.feedChunked(payload.data() + i, 1);
+    check("byte-at-a-time decode completes",     req.isComplete() && used == payload.size());
+    check("extensions and trailers skipped",     bodyOf(req) == "Wikipedia");
+
+    Request incomplete = chunkedRequest(0);
+    std::string noEnd = "3\r\nabc\r\n0\r\nX-Trailer: 1\r\n";
+    incomplete.feedChunked(noEnd.data(), noEnd.size());
+    check("waits for the empty line after trailers", incomplete.getReqState() == REQ_CHUNKED);
+
+    // bytes after the terminator belong to the next pipelined request
+    Request piped = chunkedRequest(0);
+    std::string withNext = "A\r\n0123456789\r\n0\r\n\r\nGET / HTTP/1.1\r\n";
+    used = piped.feedChunked(withNext.data(), withNext.size());
+    check("hex size decoded",                    bodyOf(piped) == "0123456789");
+    check("stops at the end of the body",        withNext.substr(used) == "GET / HTTP/1.1\r\n");
+}
 
-    check("Payload correctly unchunked", decodedString == "Wikipedia");
+static void testRequestChunkedErrors()
+{
+    std::cout << "\n-- Request::feedChunked (errors) --\n";
+
+    Request badSize = chunkedRequest(0);
+    badSize.feedChunked("zz\r\n", 4);
+    check("non-hex size is 400",         badSize.getReqState() == REQ_ERROR && badSize.getStatusCode() == "400");
+
+    Request badCrlf = chunkedRequest(0);
+    std::string s = "3\r\nabcX\r\n";
+    badCrlf.feedChunked(s.data(), s.size());
+    check("missing CRLF after data is 400", badCrlf.getReqState() == REQ_ERROR && badCrlf.getStatusCode() == "400");
+
+    Request overflow = chunkedRequest(0);
+    s = "fffffffffffffffffffff\r\n";
+    overflow.feedChunked(s.data(), s.size());
+    check("oversized chunk size is 400", overflow.getStatusCode() == "400");
+
+    Request tooBig = chunkedRequest(8);
+    s = "5\r\nhello\r\n5\r\nworld\r\n0\r\n\r\n";
+    tooBig.feedChunked(s.data(), s.size());
+    check("decoded body over the limit is 413", tooBig.getReqState() == REQ_ERROR && tooBig.getStatusCode() == "413");
+
+    Request longExt = chunkedRequest(0);
+    s = "1;" + std::string(MAX_CHUNK_LINE_SIZE, 'e');
+    longExt.feedChunked(s.data(), s.size());
+    check("unbounded extension is 400",  longExt.getStatusCode() == "400");
 }
 
 // ============================================================================
@@ -200,6 +244,36 @@ static void testRequestHeaderEdgeCases()
     check("State resolves to REQ_DONE (Length 0)", req.getReqState() == REQ_DONE);
 }
 
+static void testRequestIncremental()
+{
+    std::cout << "\n-- Request incremental header scan --\n";
+
+    const std::string raw = "GET /slow HTTP/1.1\r\nHost: trickle\r\nConnection: close\r\n\r\nBODY";
+    Request req;
+    std::string buffer;
+    size_t headerEnd = 0;
+    size_t calls = 0;
+    for (size_t i = 0; i < raw.size() && headerEnd == 0; ++i)
+    {
+        buffer += raw[i];
+        headerEnd = req.parseHeaders(buffer);
+        ++calls;
+    }
+    check("Terminator found across byte-sized reads", headerEnd == raw.size() - 4);
+    check("Not found one byte early",                 calls == raw.size() - 4);
+    check("Trickled request line parsed",             req.getURL() == "/slow");
+    check("Trickled header parsed",                   req.getHeader("HOST") == "trickle");
+
+    const HeaderField* conn = req.getWellKnownHeader(HDR_CONNECTION);
+    check("Well-known header indexed",                conn && conn->getValue() == "close");
+    check("Absent well-known header is NULL",         req.getWellKnownHeader(HDR_COOKIE) == NULL);
+
+    Request smuggled;
+    smuggled.parseHeaders("GET / HTTP/1.1\r\nHost: a\rX-Evil: 1\r\n\r\n");
+    check("Bare CR inside a header is rejected",      smuggled.getReqState() == REQ_ERROR
+                                                      && smuggled.getStatusCode() == "400");
+}
+
 static void testRequestCookies()
 {
     std::cout << "\n-- Request Cookies --\n";
@@ -225,6 +299,76 @@ static void testRequestCookies()
         check("Malformed cookie token skipped", req.getCookie("badtoken").empty());
         check("Valid cookie still parsed", req.getCookie("real") == "ok");
     }
+
+    {
+        Request req;
+        req.parseHeaders("GET / HTTP/1.1\r\nHost: a\r\nCookie: sid=42\r\n\r\n");
+        Request copy(req);
+        req.reset();
+        req.parseHeaders("GET / HTTP/1.1\r\nHost: bbbbbbbb\r\nCookie: sid=xxxxxxx\r\n\r\n");
+        check("Copy owns its header bytes", copy.getHeader("host") == "a");
+        check("Copy owns its cookie bytes", copy.getCookie("sid") == "42");
+    }
+}
+
+static void testRequestKeepAlive()
+{
+    std::cout << "\n-- Request keep-alive & reset --\n";
+
+    {
+        Request req;
+        req.parseHeaders("GET / HTTP/1.1\r\nHost: x\r\n\r\n");
+        check("HTTP/1.1 is persistent by default", req.wantsKeepAlive());
+    }
+    {
+        Request req;
+        req.parseHeaders("GET / HTTP/1.1\r\nConnection: Close\r\n\r\n");
+        check("HTTP/1.1 Connection: close is honoured", !req.wantsKeepAlive());
+    }
+    {
+        Request req;
+        req.parseHeaders("GET / HTTP/1.0\r\n\r\n");
+        check("HTTP/1.0 closes by default", !req.wantsKeepAlive());
+    }
+    {
+        Request req;
+        req.parseHeaders("GET / HTTP/1.0\r\nConnection: Keep-Alive\r\n\r\n");
+        check("HTTP/1.0 Connection: keep-alive is honoured", req.wantsKeepAlive());
+    }
+    {
+        Request req(100);
+        req.parseHeaders("POST /a?x=1 HTTP/1.1\r\nContent-Length: 3\r\nCookie: a=b\r\n\r\n");
+        req.getBodyStore().append("abc");
+        req.reset();
+        check("reset returns to REQ_HEADERS", req.getReqState() == REQ_HEADERS);
+        check("reset clears headers",        req.getHeaders().empty());
+        check("reset clears cookies",        req.getCookies().empty());
+        check("reset clears body",           req.getBodyStore().getSize() == 0);
+        check("reset clears query",          req.getQuery().empty());
+        check("reset keeps max body size",   req.getMaxBytesToRead() == 100);
+
+        req.parseHeaders("GET /b HTTP/1.1\r\nHost: y\r\n\r\n");
+        check("reset request parses the next one", req.getURL() == "/b" && req.getReqState() == REQ_DONE);
+    }
+}
+
+static void testRequestPipelined()
+{
+    std::cout << "\n-- Request pipelined buffer --\n";
+
+    Request req;
+    std::string buf = "GET /first HTTP/1.1\r\nHost: a\r\n\r\n"
+                      "GET /second HTTP/1.1\r\nHost: a\r\n\r\n";
+
+    size_t consumed = req.parseHeaders(buf);
+    check("First request parsed",              req.getURL() == "/first");
+    check("Only the first header block consumed", buf.substr(consumed).compare(0, 11, "GET /second") == 0);
+
+    buf.erase(0, consumed);
+    req.reset();
+    consumed = req.parseHeaders(buf);
+    check("Second request parsed after reset", req.getURL() == "/second" && req.getReqState() == REQ_DONE);
+    check("Buffer fully consumed",             consumed == buf.size());
 }
 
 int main()
@@ -232,9 +376,13 @@ int main()
     testRequestValid();
     testRequestErrors();
     testRequestHeaderEdgeCases();
+    testRequestIncremental();
     testRequestCookies();
-    testRequestChunkedDone();
     testRequestBodySlice();
+    testRequestChunkedSplits();
+    testRequestChunkedErrors();
+    testRequestKeepAlive();
+    testRequestPipelined();
 
 	std::cout << "\n===========================\n";
 	std::cout << g_passed << " / " << g_total << " tests passed\n";
@@ -3,6 +3,8 @@
 #include <cstring>
 #include <cstdlib>
 #include <cassert>
+#include <csignal>
+#include <algorithm>
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -13,6 +15,7 @@
 #include "../includes/Request.hpp"
 #include "../includes/ServerConf.hpp"
 #include "../includes/LocationConf.hpp"
+#include "../includes/OpenFileCache.hpp"
 
 static int g_total  = 0;
 static int g_passed = 0;
@@ -33,6 +36,10 @@ static const std::string CGI_PY_GOOD = TEST_ROOT + "/good.py";
 static const std::string CGI_PY_BODY_ECHO = TEST_ROOT + "/echo_body.py";
 static const std::string CGI_PY_INVALID = TEST_ROOT + "/invalid.py";
 static const std::string CGI_CGI_NOEXEC = TEST_ROOT + "/noexec.cgi";
+static const std::string CGI_PY_STREAM = TEST_ROOT + "/stream.py";
+static const std::string CGI_PY_SIZED = TEST_ROOT + "/sized.py";
+static const std::string CGI_PY_FLOOD = TEST_ROOT + "/flood.py";
+static const std::string CGI_PY_LAZY = TEST_ROOT + "/lazy.py";
 
 static std::string drainResponse(Response& r);
 
@@ -242,6 +249,35 @@ static void setupFixtures() {
         "echo\n"
         "echo 'SHOULD_NOT_RUN_WITHOUT_EXEC_BIT'\n");
     chmod(CGI_CGI_NOEXEC.c_str(), 0644);
+
+    writeFile(CGI_PY_STREAM,
+        "#!/usr/bin/env python3\n"
+        "import sys\n"
+        "sys.stdout.write('Content-Type: text/plain\\r\\n\\r\\n')\n"
+        "sys.stdout.flush()\n"
+        "sys.stdout.write('part1\\n')\n"
+        "sys.stdout.flush()\n"
+        "sys.stdout.write('part2\\n')\n");
+    chmod(CGI_PY_STREAM.c_str(), 0755);
+
+    writeFile(CGI_PY_SIZED,
+        "#!/usr/bin/env python3\n"
+        "import sys\n"
+        "sys.stdout.write('Content-Type: text/plain\\r\\nContent-Length: 5\\r\\n\\r\\nhello world')\n");
+    chmod(CGI_PY_SIZED.c_str(), 0755);
+
+    writeFile(CGI_PY_FLOOD,
+        "#!/usr/bin/env python3\n"
+        "import sys\n"
+        "sys.stdout.write('Content-Type: text/plain\\r\\n\\r\\n' + 'F' * 400000)\n");
+    chmod(CGI_PY_FLOOD.c_str(), 0755);
+
+    writeFile(CGI_PY_LAZY,
+        "#!/usr/bin/env python3\n"
+        "import sys, time\n"
+        "time.sleep(0.2)\n"
+        "sys.stdout.write('Content-Type: text/plain\\r\\n\\r\\nhello')\n");
+    chmod(CGI_PY_LAZY.c_str(), 0755);
 }
 
 static void cleanFixtures() {
@@ -254,6 +290,10 @@ static void cleanFixtures() {
 	removeFile(CGI_PY_BODY_ECHO);
 	removeFile(CGI_PY_INVALID);
 	removeFile(CGI_CGI_NOEXEC);
+	removeFile(CGI_PY_STREAM);
+	removeFile(CGI_PY_SIZED);
+	removeFile(CGI_PY_FLOOD);
+	removeFile(CGI_PY_LAZY);
     rmdir((TEST_ROOT + "/subdir").c_str());
     rmdir(TEST_ROOT.c_str());
     rmdir(UPLOAD_DIR.c_str());
@@ -536,6 +576,81 @@ static void testLargeFileStreaming() {
           body == std::string(64 * 1024, 'A'));
 }
 
+static void testDataStoreSendTo() {
+    std::cout << "\n-- DataStore::sendTo --\n";
+
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) {
+        check("socketpair created", false);
+        return;
+    }
+
+    DataStore ram;
+    ram.append("hello world");
+    ssize_t n = ram.sendTo(sv[0], 6, 100);
+    char buf[64] = {0};
+    ssize_t got = recv(sv[1], buf, sizeof(buf), 0);
+    check("RAM sendTo sends from the offset", n == 5 && got == 5 && std::string(buf, 5) == "world");
+
+    DataStore disk;
+    std::string big(BUFFERLIMIT, 'x');
+    disk.append(big);
+    disk.append("TAIL");
+    check("store spilled to FILE_MODE", disk.getMode() == FILE_MODE);
+    n = disk.sendTo(sv[0], BUFFERLIMIT, 64);
+    got = recv(sv[1], buf, sizeof(buf), 0);
+    check("FILE_MODE sendTo sends from the offset", n == 4 && got == 4 && std::string(buf, 4) == "TAIL");
+    check("sendTo past the end sends nothing", disk.sendTo(sv[0], disk.getSize(), 64) == 0);
+
+    close(sv[0]);
+    close(sv[1]);
+}
+
+static void testSendWouldBlock() {
+    std::cout << "\n-- Full socket buffer (EAGAIN) --\n";
+
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) {
+        check("socketpair created", false);
+        return;
+    }
+    int small = 4096;
+    setsockopt(sv[0], SOL_SOCKET, SO_SNDBUF, &small, sizeof(small));
+    fcntl(sv[0], F_SETFL, O_NONBLOCK);
+
+    ServerConf conf = makeConf(TEST_ROOT, GET);
+    Request req = makeRequest("GET /large.bin HTTP/1.1\r\nHost: x\r\n\r\n");
+    Response r;
+    r.setKeepAlive(true);
+    r.buildResponse(req, conf);
+
+    bool done = false;
+    int guard = 0;
+    while (!done && !r.wouldBlock() && guard++ < 10000)
+        done = r.sendSlice(sv[0]);
+    check("send stops on a full buffer", !done && r.wouldBlock());
+    check("EAGAIN does not abort keep-alive", r.isKeepAlive());
+
+    std::string out;
+    char buf[4096];
+    guard = 0;
+    while (!done && guard++ < 100000) {
+        ssize_t n = recv(sv[1], buf, sizeof(buf), MSG_DONTWAIT);
+        if (n > 0)
+            out.append(buf, n);
+        done = r.sendSlice(sv[0]);
+    }
+    ssize_t n;
+    while ((n = recv(sv[1], buf, sizeof(buf), MSG_DONTWAIT)) > 0)
+        out.append(buf, n);
+    check("response completes after the reader catches up",
+          done && bodyOf(out) == std::string(64 * 1024, 'A'));
+    check("keep-alive kept after a blocked send", r.isKeepAlive());
+
+    close(sv[0]);
+    close(sv[1]);
+}
+
 static void testPostUpload() {
     std::cout << "\n-- POST upload --\n";
 
@@ -653,6 +768,405 @@ static void testWireFormat() {
     check("Content-Length == actual body bytes",  clValue == bodyLen);
     check("total wire = header + CRLF + body",
           wire.size() == heads.size() + 4 + bodyLen);
+
+    // a header longer than one send slice: the in-memory body may only follow its last slice.
+    Request missing = makeRequest("GET /missing.html HTTP/1.1\r\nHost: x\r\n\r\n");
+    Response big;
+    big.buildResponse(missing, conf);
+    const std::string padding(64 * 1024, 'p');
+    big.addHeader("X-Padding", padding);
+    std::string bigWire = drainResponse(big);
+    std::string bigHeads = headerOf(bigWire);
+    check("oversized header arrives whole",      headerValue(bigHeads, "X-Padding").substr(0, padding.size()) == padding
+                                                 && bigHeads.find("Content-Length: ") != std::string::npos);
+    check("body follows the oversized header",   bodyOf(bigWire).size() == toSizeT(headerValue(bigHeads, "Content-Length"))
+                                                 && bodyOf(bigWire).find("404") != std::string::npos);
+}
+
+static void testKeepAlive() {
+    std::cout << "\n-- Keep-alive --\n";
+
+    {
+        ServerConf conf = makeConf(TEST_ROOT, GET);
+        Request req = makeRequest("GET /index.html HTTP/1.1\r\nHost: x\r\n\r\n");
+        Response r;
+        r.setKeepAlive(true);
+        r.buildResponse(req, conf);
+        std::string wire = drainResponse(r);
+        check("keep-alive file response advertises it",
+              headerValue(headerOf(wire), "Connection") == "keep-alive");
+        check("keep-alive survives a complete send", r.isKeepAlive());
+
+        r.reset();
+        check("reset clears keep-alive",      !r.isKeepAlive());
+        check("reset returns to BUILD_IDLE",  r.getBuildPhase() == BUILD_IDLE);
+
+        Request next = makeRequest("GET /style.css HTTP/1.1\r\nHost: x\r\n\r\n");
+        r.buildResponse(next, conf);
+        std::string wire2 = drainResponse(r);
+        check("reused response serves the next request",
+              bodyOf(wire2) == readFile(TEST_ROOT + "/style.css"));
+        check("reused response defaults back to close",
+              headerValue(headerOf(wire2), "Connection") == "close");
+    }
+
+    {
+        ServerConf conf = makeConf(TEST_ROOT, GET);
+        Response r;
+        r.setKeepAlive(true);
+        r.buildErrorPage("404", conf);
+        std::string wire = drainResponse(r);
+        check("error page honours keep-alive",
+              headerValue(headerOf(wire), "Connection") == "keep-alive");
+    }
+}
+
+static void testFileCache() {
+    std::cout << "\n-- In-memory file cache --\n";
+
+    const std::string path = TEST_ROOT + "/cached.txt";
+    writeFile(path, "first");
+    ServerConf conf = makeConf(TEST_ROOT, GET);
+    conf.setFileCacheEntries(8);
+    conf.setFileCacheValid(60);
+
+    {
+        Request req = makeRequest("GET /cached.txt HTTP/1.1\r\nHost: x\r\n\r\n");
+        Response r;
+        r.buildResponse(req, conf);
+        std::string wire = drainResponse(r);
+        check("cache miss serves the file",     bodyOf(wire) == "first");
+        check("cached file carries Last-Modified",
+              !headerValue(headerOf(wire), "Last-Modified").empty());
+        check("file was cached",                FileCache::shared().size() == 1);
+    }
+
+    // rewritten behind the server's back: the cached copy is trusted until revalidation.
+    writeFile(path, "other");
+    {
+        Request req = makeRequest("GET /cached.txt HTTP/1.1\r\nHost: x\r\n\r\n");
+        Response r;
+        r.buildResponse(req, conf);
+        check("cache hit served from memory",   bodyOf(drainResponse(r)) == "first");
+    }
+
+    {
+        ServerConf del = makeConf(TEST_ROOT, GET, DELETE);
+        Request req = makeRequest("DELETE /cached.txt HTTP/1.1\r\nHost: x\r\n\r\n");
+        Response r;
+        r.buildResponse(req, del);
+        check("DELETE invalidates the cached entry", FileCache::shared().size() == 0);
+    }
+
+    {
+        Request req = makeRequest("GET /cached.txt HTTP/1.1\r\nHost: x\r\n\r\n");
+        Response r;
+        r.buildResponse(req, conf);
+        check("deleted file is not served from cache", r.getStatusCode() == "404");
+    }
+
+    writeFileBytes(path, 128 * 1024, 'B');
+    conf.setFileCacheMaxSize(64 * 1024);
+    {
+        Request req = makeRequest("GET /cached.txt HTTP/1.1\r\nHost: x\r\n\r\n");
+        Response r;
+        r.buildResponse(req, conf);
+        check("oversized file is streamed",     bodyOf(drainResponse(r)).size() == 128 * 1024);
+        check("oversized file is not cached",   FileCache::shared().size() == 0);
+    }
+    unlink(path.c_str());
+    FileCache::shared().clear();
+}
+
+static void testOpenFileCache() {
+    std::cout << "\n-- Open file cache --\n";
+
+    ServerConf conf = makeConf(TEST_ROOT, GET, DELETE);
+    conf.setOpenFileCacheEntries(8);
+
+    {
+        Request req1 = makeRequest("GET /large.bin HTTP/1.1\r\nHost: x\r\n\r\n");
+        Request req2 = makeRequest("GET /large.bin HTTP/1.1\r\nHost: x\r\n\r\n");
+        Response r1;
+        Response r2;
+        r1.buildResponse(req1, conf);
+        r2.buildResponse(req2, conf);
+        check("concurrent responses share one cached fd", OpenFileCache::shared().size() == 1);
+        std::string body1 = bodyOf(drainResponse(r1));
+        std::string body2 = bodyOf(drainResponse(r2));
+        check("both responses stream the whole file",
+              body1.size() == 64 * 1024 && body1 == body2);
+    }
+
+    {
+        Request req = makeRequest("GET /large.bin HTTP/1.1\r\nHost: x\r\n\r\n");
+        Response r;
+        r.buildResponse(req, conf);
+        check("cached fd survives the responses that used it",
+              bodyOf(drainResponse(r)).size() == 64 * 1024);
+    }
+
+    const std::string path = TEST_ROOT + "/doomed.txt";
+    writeFile(path, "bye");
+    {
+        Request get = makeRequest("GET /doomed.txt HTTP/1.1\r\nHost: x\r\n\r\n");
+        Response r;
+        r.buildResponse(get, conf);
+        drainResponse(r);
+        Request del = makeRequest("DELETE /doomed.txt HTTP/1.1\r\nHost: x\r\n\r\n");
+        Response d;
+        d.buildResponse(del, conf);
+        check("DELETE through the cache succeeds", d.getStatusCode() == "204");
+        Request again = makeRequest("GET /doomed.txt HTTP/1.1\r\nHost: x\r\n\r\n");
+        Response g;
+        g.buildResponse(again, conf);
+        check("deleted path is not served from a cached fd", g.getStatusCode() == "404");
+    }
+    OpenFileCache::shared().clear();
+}
+
+static void testConditionalGet() {
+    std::cout << "\n-- Conditional GET --\n";
+
+    const std::string path = TEST_ROOT + "/versioned.txt";
+    writeFile(path, "version one");
+    ServerConf conf;
+    conf.setServerName("test");
+    LocationConf loc;
+    loc.setPath("/");
+    loc.setRoot(TEST_ROOT);
+    loc.addAllowedMethod(GET);
+    loc.setExpires(3600);
+    conf.addLocation(loc);
+
+    std::string etag;
+    std::string lastModified;
+    {
+        Request req = makeRequest("GET /versioned.txt HTTP/1.1\r\nHost: x\r\n\r\n");
+        Response r;
+        r.buildResponse(req, conf);
+        std::string head = headerOf(drainResponse(r));
+        etag         = headerValue(head, "ETag");
+        lastModified = headerValue(head, "Last-Modified");
+        check("200 carries a strong ETag",        etag.size() > 2 && etag[0] == '"');
+        check("200 carries Last-Modified",        !lastModified.empty());
+        check("expires sets max-age",             headerValue(head, "Cache-Control") == "max-age=3600");
+        check("expires sets Expires",             !headerValue(head, "Expires").empty());
+    }
+    {
+        Request req = makeRequest("GET /versioned.txt HTTP/1.1\r\nHost: x\r\nIf-None-Match: \"old\", " + etag + "\r\n\r\n");
+        Response r;
+        r.buildResponse(req, conf);
+        std::string wire = drainResponse(r);
+        check("matching If-None-Match is a 304",  r.getStatusCode() == "304");
+        check("304 has no body",                  bodyOf(wire).empty() && headerValue(headerOf(wire), "Content-Length").empty());
+        check("304 repeats the validators",       headerValue(headerOf(wire), "ETag") == etag
+                                                  && headerValue(headerOf(wire), "Cache-Control") == "max-age=3600");
+    }
+    {
+        Request req = makeRequest("GET /versioned.txt HTTP/1.1\r\nHost: x\r\nIf-None-Match: W/" + etag + "\r\n\r\n");
+        Response r;
+        r.buildResponse(req, conf);
+        check("If-None-Match compares weakly",    r.getStatusCode() == "304");
+    }
+    {
+        Request req = makeRequest("GET /versioned.txt HTTP/1.1\r\nHost: x\r\nIf-Modified-Since: " + lastModified + "\r\n\r\n");
+        Response r;
+        r.buildResponse(req, conf);
+        check("If-Modified-Since at mtime is a 304", r.getStatusCode() == "304");
+    }
+    {
+        Request req = makeRequest("GET /versioned.txt HTTP/1.1\r\nHost: x\r\n"
+                                  "If-None-Match: \"old\"\r\nIf-Modified-Since: " + lastModified + "\r\n\r\n");
+        Response r;
+        r.buildResponse(req, conf);
+        check("If-None-Match overrides If-Modified-Since", r.getStatusCode() == "200");
+    }
+    {
+        Request req = makeRequest("GET /versioned.txt HTTP/1.1\r\nHost: x\r\n"
+                                  "If-Modified-Since: Thu, 01 Jan 1970 00:00:00 GMT\r\n\r\n");
+        Response r;
+        r.buildResponse(req, conf);
+        check("older If-Modified-Since gets the file", r.getStatusCode() == "200"
+                                                      && bodyOf(drainResponse(r)) == "version one");
+    }
+
+    // a new version changes the ETag, so the old one no longer matches.
+    writeFile(path, "version two, longer");
+    {
+        Request req = makeRequest("GET /versioned.txt HTTP/1.1\r\nHost: x\r\nIf-None-Match: " + etag + "\r\n\r\n");
+        Response r;
+        r.buildResponse(req, conf);
+        std::string wire = drainResponse(r);
+        check("stale ETag gets the new version",  r.getStatusCode() == "200" && bodyOf(wire) == "version two, longer"
+                                                  && headerValue(headerOf(wire), "ETag") != etag);
+    }
+
+    conf.setFileCacheEntries(8);
+    conf.setFileCacheValid(60);
+    {
+        Request warm = makeRequest("GET /versioned.txt HTTP/1.1\r\nHost: x\r\n\r\n");
+        Response w;
+        w.buildResponse(warm, conf);
+        etag = headerValue(headerOf(drainResponse(w)), "ETag");
+
+        Request req = makeRequest("GET /versioned.txt HTTP/1.1\r\nHost: x\r\nIf-None-Match: " + etag + "\r\n\r\n");
+        Response r;
+        r.buildResponse(req, conf);
+        check("a cached file is revalidated too", r.getStatusCode() == "304");
+    }
+    unlink(path.c_str());
+    FileCache::shared().clear();
+}
+
+static void testContentEncoding() {
+    std::cout << "\n-- Content-Encoding negotiation --\n";
+
+    const std::string path = TEST_ROOT + "/negotiated.html";
+    writeFile(path, "<html>" + std::string(4096, 'n') + "</html>");
+    ServerConf conf;
+    conf.setServerName("test");
+    LocationConf loc;
+    loc.setPath("/");
+    loc.setRoot(TEST_ROOT);
+    loc.addAllowedMethod(GET);
+    loc.setGzip(true);
+    conf.addLocation(loc);
+
+    const char* accepts[][2] = {
+        { "gzip, deflate",      "gzip" },
+        { "*",                  "gzip" },
+        { "gzip;q=0, *",        "deflate" },
+        { "gzip;q=0",           "" },
+        { "*;q=0, deflate",     "deflate" },
+        { "GZIP;q=0.5",         "gzip" },
+    };
+    for (size_t i = 0; i < sizeof(accepts) / sizeof(accepts[0]); ++i) {
+        Request req = makeRequest(std::string("GET /negotiated.html HTTP/1.1\r\nHost: x\r\nAccept-Encoding: ")
+                                  + accepts[i][0] + "\r\n\r\n");
+        Response r;
+        r.buildResponse(req, conf);
+        std::string label = std::string("Accept-Encoding: ") + accepts[i][0];
+        check(label.c_str(), headerValue(headerOf(drainResponse(r)), "Content-Encoding") == accepts[i][1]);
+    }
+    {
+        // a streamed body is only compressed chunked: HTTP/1.0 gets it as is, with what that allows.
+        Request req = makeRequest("GET /negotiated.html HTTP/1.0\r\nAccept-Encoding: gzip\r\nRange: bytes=0-5\r\n\r\n");
+        Response r;
+        r.buildResponse(req, conf);
+        std::string wire = drainResponse(r);
+        check("HTTP/1.0 gets the file unencoded",       headerValue(headerOf(wire), "Content-Encoding").empty());
+        check("its ETag stays strong",                  headerValue(headerOf(wire), "ETag").compare(0, 2, "W/") != 0);
+        check("and its Range is honoured",              r.getStatusCode() == "206" && bodyOf(wire) == "<html>");
+    }
+    unlink(path.c_str());
+}
+
+static void testRangeRequests() {
+    std::cout << "\n-- Range requests --\n";
+
+    std::string content;
+    for (int i = 0; i < 100; ++i)
+        content += static_cast<char>('a' + i % 26);
+    const std::string path = TEST_ROOT + "/ranged.txt";
+    writeFile(path, content);
+    ServerConf conf;
+    conf.setServerName("test");
+    LocationConf loc;
+    loc.setPath("/");
+    loc.setRoot(TEST_ROOT);
+    loc.addAllowedMethod(GET);
+    conf.addLocation(loc);
+
+    // the same answers whether the body comes from the file or from the file cache.
+    for (int pass = 0; pass < 2; ++pass) {
+        const std::string from = pass ? " (cached)" : "";
+        if (pass) {
+            conf.setFileCacheEntries(8);
+            conf.setFileCacheValid(60);
+        }
+        std::string etag;
+        {
+            Request req = makeRequest("GET /ranged.txt HTTP/1.1\r\nHost: x\r\n\r\n");
+            Response r;
+            r.buildResponse(req, conf);
+            std::string head = headerOf(drainResponse(r));
+            etag = headerValue(head, "ETag");
+            check(("200 advertises byte ranges" + from).c_str(), headerValue(head, "Accept-Ranges") == "bytes");
+        }
+        {
+            Request req = makeRequest("GET /ranged.txt HTTP/1.1\r\nHost: x\r\nRange: bytes=10-19\r\n\r\n");
+            Response r;
+            r.buildResponse(req, conf);
+            std::string wire = drainResponse(r);
+            check(("single range is a 206" + from).c_str(), r.getStatusCode() == "206"
+                                                     && bodyOf(wire) == content.substr(10, 10));
+            check(("206 carries Content-Range" + from).c_str(), headerValue(headerOf(wire), "Content-Range") == "bytes 10-19/100"
+                                                         && headerValue(headerOf(wire), "Content-Length") == "10");
+        }
+        {
+            Request req = makeRequest("GET /ranged.txt HTTP/1.1\r\nHost: x\r\nRange: bytes=-7\r\n\r\n");
+            Response r;
+            r.buildResponse(req, conf);
+            check(("suffix range is the tail" + from).c_str(), bodyOf(drainResponse(r)) == content.substr(93));
+        }
+        {
+            Request req = makeRequest("GET /ranged.txt HTTP/1.1\r\nHost: x\r\nRange: bytes=95-500\r\n\r\n");
+            Response r;
+            r.buildResponse(req, conf);
+            std::string wire = drainResponse(r);
+            check(("range end is clamped" + from).c_str(), bodyOf(wire) == content.substr(95)
+                                                    && headerValue(headerOf(wire), "Content-Range") == "bytes 95-99/100");
+        }
+        {
+            Request req = makeRequest("GET /ranged.txt HTTP/1.1\r\nHost: x\r\nRange: bytes=50-53, 0-1,2-3\r\n\r\n");
+            Response r;
+            r.buildResponse(req, conf);
+            std::string wire = drainResponse(r);
+            std::string type = headerValue(headerOf(wire), "Content-Type");
+            std::string boundary = type.substr(type.find("boundary=") + 9);
+            std::string expected = "\r\n--" + boundary + "\r\nContent-Type: text/plain\r\nContent-Range: bytes 0-3/100\r\n\r\n"
+                                 + content.substr(0, 4)
+                                 + "\r\n--" + boundary + "\r\nContent-Type: text/plain\r\nContent-Range: bytes 50-53/100\r\n\r\n"
+                                 + content.substr(50, 4) + "\r\n--" + boundary + "--\r\n";
+            std::ostringstream length;
+            length << expected.size();
+            check(("several ranges are multipart" + from).c_str(), r.getStatusCode() == "206"
+                                                            && type.find("multipart/byteranges; boundary=") == 0);
+            check(("parts are sorted and merged" + from).c_str(), bodyOf(wire) == expected);
+            check(("multipart length is exact" + from).c_str(), headerValue(headerOf(wire), "Content-Length") == length.str());
+        }
+        {
+            Request req = makeRequest("GET /ranged.txt HTTP/1.1\r\nHost: x\r\nRange: bytes=100-\r\n\r\n");
+            Response r;
+            r.buildResponse(req, conf);
+            std::string wire = drainResponse(r);
+            check(("range past the end is a 416" + from).c_str(), r.getStatusCode() == "416"
+                                                           && headerValue(headerOf(wire), "Content-Range") == "bytes */100");
+        }
+        {
+            Request req = makeRequest("GET /ranged.txt HTTP/1.1\r\nHost: x\r\nRange: bytes=9-2\r\n\r\n");
+            Response r;
+            r.buildResponse(req, conf);
+            check(("malformed Range is ignored" + from).c_str(), r.getStatusCode() == "200"
+                                                          && bodyOf(drainResponse(r)) == content);
+        }
+        {
+            Request req = makeRequest("GET /ranged.txt HTTP/1.1\r\nHost: x\r\nRange: bytes=0-1\r\nIf-Range: " + etag + "\r\n\r\n");
+            Response r;
+            r.buildResponse(req, conf);
+            check(("If-Range with the ETag keeps the range" + from).c_str(), r.getStatusCode() == "206");
+        }
+        {
+            Request req = makeRequest("GET /ranged.txt HTTP/1.1\r\nHost: x\r\nRange: bytes=0-1\r\nIf-Range: \"old\"\r\n\r\n");
+            Response r;
+            r.buildResponse(req, conf);
+            check(("stale If-Range gets the whole file" + from).c_str(), r.getStatusCode() == "200"
+                                                                  && bodyOf(drainResponse(r)) == content);
+        }
+    }
+    unlink(path.c_str());
+    FileCache::shared().clear();
 }
 
 static void testSetCookieHeaders() {
@@ -752,6 +1266,149 @@ static void testCgiScenarios() {
     }
 }
 
+static std::string dechunk(const std::string& body) {
+    std::string out;
+    size_t pos = 0;
+    while (pos < body.size()) {
+        size_t lineEnd = body.find("\r\n", pos);
+        if (lineEnd == std::string::npos) return "<bad framing>";
+        size_t size = std::strtoul(body.substr(pos, lineEnd - pos).c_str(), NULL, 16);
+        if (size == 0) return out;
+        out += body.substr(lineEnd + 2, size);
+        pos = lineEnd + 2 + size + 2;
+    }
+    return "<no last chunk>";
+}
+
+static void testCgiStreaming() {
+    std::cout << "\n-- CGI output streaming --\n";
+
+    ServerConf conf = makeCgiConf(TEST_ROOT, ".py", "/usr/bin/python3", false);
+    {
+        Request req = makeRequest("GET /stream.py HTTP/1.1\r\nHost: x\r\n\r\n");
+        Response r;
+        r.setKeepAlive(true);
+        r.buildResponse(req, conf);
+        int guard = 0;
+        bool done = false;
+        while (!r.isCgiStreaming() && !done && guard++ < 20000)
+            done = r.readCgiOutput();
+        check("head is built before the script ends", r.isCgiStreaming() && !done);
+
+        int sv[2];
+        socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+        bool sent = r.sendSlice(sv[0]);
+        check("relay waits on the pipe once drained", !sent && r.isWaitingOnCgi());
+        while (!r.readCgiOutput() && guard++ < 20000)
+            ;
+        r.finalizeCgiResponse();
+        while (!r.sendSlice(sv[0]) && guard++ < 20000)
+            ;
+        close(sv[0]);
+        std::string wire;
+        char buf[4096];
+        ssize_t n;
+        while ((n = recv(sv[1], buf, sizeof(buf), 0)) > 0)
+            wire.append(buf, n);
+        close(sv[1]);
+
+        std::string heads = headerOf(wire);
+        check("HTTP/1.1 client gets a chunked body",
+            heads.find("HTTP/1.1 200") == 0 && headerValue(heads, "Transfer-Encoding") == "chunked"
+            && headerValue(heads, "Content-Length").empty());
+        check("chunks carry the whole output", dechunk(bodyOf(wire)) == "part1\npart2\n");
+        check("chunked relay keeps the connection", r.isKeepAlive());
+    }
+    {
+        Request req = makeRequest("GET /stream.py HTTP/1.0\r\nHost: x\r\n\r\n");
+        Response r;
+        r.setKeepAlive(true);
+        std::string wire = executeCgiResponse(r, req, conf);
+        check("HTTP/1.0 client gets the raw body",
+            headerValue(headerOf(wire), "Transfer-Encoding").empty() && bodyOf(wire) == "part1\npart2\n");
+        check("and the connection close ends it", !r.isKeepAlive());
+    }
+    {
+        Request req = makeRequest("GET /sized.py HTTP/1.1\r\nHost: x\r\n\r\n");
+        Response r;
+        std::string wire = executeCgiResponse(r, req, conf);
+        check("script Content-Length is relayed unchunked",
+            headerValue(headerOf(wire), "Content-Length") == "5" && bodyOf(wire) == "hello");
+    }
+    {
+        Request req = makeRequest("GET /flood.py HTTP/1.1\r\nHost: x\r\n\r\n");
+        Response r;
+        r.buildResponse(req, conf);
+        int guard = 0;
+        bool done = false;
+        while (r.wantsCgiOutput() && !done && guard++ < 20000)
+            done = r.readCgiOutput();
+        check("pipe reads pause at the relay high-water mark", !done && !r.wantsCgiOutput());
+    }
+}
+
+// feeds a streamed body the way Connection does, writing to the pipe as it drains.
+static void feedUpload(Response& r, const std::string& body, bool* sawFull) {
+    size_t pos = 0;
+    int guard = 0;
+    while ((pos < body.size() || !r.isCgiInputDone()) && guard++ < 20000)
+    {
+        if (pos < body.size() && !r.isCgiInputFull())
+        {
+            size_t n = std::min(body.size() - pos, static_cast<size_t>(8192));
+            pos += r.feedCgiInput(body.data() + pos, n);
+            continue;
+        }
+        if (sawFull && r.isCgiInputFull())
+            *sawFull = true;
+        usleep(1000);
+        r.writeCgiInput();
+    }
+    r.closeCgiInput();
+}
+
+static void testCgiUpload() {
+    std::cout << "\n-- CGI request body streaming --\n";
+
+    ServerConf conf = makeCgiConf(TEST_ROOT, ".py", "/usr/bin/python3", true);
+    {
+        std::string body(100000, 'B');
+        Request req = makeRequest("POST /echo_body.py HTTP/1.1\r\nHost: x\r\nContent-Length: 100000\r\n\r\n");
+        Response r;
+        check("script starts before the body is in", r.startCgiUpload(req, conf)
+            && r.isCgiUpload() && r.getCgiInputFd() >= 0 && r.getCgiInputLeft() == 100000);
+        feedUpload(r, body, NULL);
+        check("stdin pipe closed once the body is through", r.getCgiInputFd() < 0 && r.getCgiInputLeft() == 0);
+        std::string wire = executeCgiResponse(r, req, conf);
+        check("script read the whole body from its stdin", dechunk(bodyOf(wire)) == body + "\n");
+    }
+    {
+        void (*previous)(int) = signal(SIGPIPE, SIG_IGN);
+        std::string body(300000, 'C');
+        Request req = makeRequest("POST /lazy.py HTTP/1.1\r\nHost: x\r\nContent-Length: 300000\r\n\r\n");
+        Response r;
+        r.startCgiUpload(req, conf);
+        bool sawFull = false;
+        feedUpload(r, body, &sawFull);
+        signal(SIGPIPE, previous);
+        check("queue reports backpressure while the script isn't reading", sawFull);
+        check("body a script doesn't read is drained and dropped",
+            r.getCgiInputLeft() == 0 && r.isCgiInputDone());
+        std::string wire = executeCgiResponse(r, req, conf);
+        check("its answer still goes out", dechunk(bodyOf(wire)) == "hello");
+    }
+    {
+        Request req = makeRequest("POST /index.html HTTP/1.1\r\nHost: x\r\nContent-Length: 10\r\n\r\n");
+        Response r;
+        check("non-CGI bodies are stored as before", !r.startCgiUpload(req, conf) && !r.isCgiUpload());
+        Request post = makeRequest("POST /missing.py HTTP/1.1\r\nHost: x\r\nContent-Length: 10\r\n\r\n");
+        Response missing;
+        check("a missing script answers without an upload",
+            !missing.startCgiUpload(post, conf) && missing.getBuildPhase() == BUILD_DONE
+            && missing.getStatusCode() == "404");
+    }
+}
+
 int main() {
     setupFixtures();
 
@@ -760,11 +1417,21 @@ int main() {
     testRouting();
     testGetServing();
     testLargeFileStreaming();
+    testDataStoreSendTo();
+    testSendWouldBlock();
     testPostUpload();
     testDelete();
     testWireFormat();
+    testKeepAlive();
+    testFileCache();
+    testOpenFileCache();
+    testConditionalGet();
+    testContentEncoding();
+    testRangeRequests();
     testSetCookieHeaders();
 	testCgiScenarios();
+	testCgiStreaming();
+	testCgiUpload();
 
     cleanFixtures();
 
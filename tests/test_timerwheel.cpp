@@ -0,0 +1,143 @@
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include "../includes/TimerWheel.hpp"
+
+// ============================================================================
+// Minimal test harness
+// ============================================================================
+
+static int  g_total  = 0;
+static int  g_passed = 0;
+
+static void check(const char* label, bool condition)
+{
+	g_total++;
+	if (condition)
+	{
+		g_passed++;
+		std::cout << "  [PASS] " << label << "\n";
+	}
+	else
+	{
+		std::cout << "  [FAIL] " << label << "\n";
+	}
+}
+
+static bool contains(const std::vector<int>& v, int fd)
+{
+	return std::find(v.begin(), v.end(), fd) != v.end();
+}
+
+// ============================================================================
+// Arm / expire
+// ============================================================================
+
+static void testArmAndExpire()
+{
+	std::cout << "\n-- Arm and expire --\n";
+
+	TimerWheel wheel(16);
+	const time_t now = 1000;
+	std::vector<int> expired;
+
+	wheel.expire(now, expired);
+	wheel.arm(5, now + 3);
+	wheel.arm(7, now + 1);
+	wheel.arm(9, now + 3);
+	check("three timers armed",           wheel.size() == 3);
+	check("deadline recorded",            wheel.deadlineOf(5) == now + 3);
+	check("next deadline is the earliest", wheel.nextDeadline(now) == now + 1);
+
+	wheel.expire(now + 1, expired);
+	check("only the due timer fires",     expired.size() == 1 && expired[0] == 7);
+	check("fired timer is disarmed",      !wheel.isArmed(7) && wheel.size() == 2);
+
+	expired.clear();
+	wheel.expire(now + 5, expired);
+	check("skipped seconds are still visited",
+	      expired.size() == 2 && contains(expired, 5) && contains(expired, 9));
+	check("wheel empty afterwards",       wheel.size() == 0 && wheel.nextDeadline(now + 5) == 0);
+}
+
+// ============================================================================
+// Re-arm / cancel
+// ============================================================================
+
+static void testRearmAndCancel()
+{
+	std::cout << "\n-- Re-arm and cancel --\n";
+
+	TimerWheel wheel(16);
+	const time_t now = 2000;
+	std::vector<int> expired;
+
+	wheel.expire(now, expired);
+	wheel.arm(3, now + 2);
+	wheel.arm(3, now + 6);
+	check("re-arm keeps one timer",       wheel.size() == 1 && wheel.deadlineOf(3) == now + 6);
+
+	wheel.expire(now + 2, expired);
+	check("old deadline no longer fires", expired.empty());
+
+	wheel.arm(4, now + 4);
+	wheel.cancel(4);
+	wheel.cancel(42); // never armed
+	wheel.expire(now + 4, expired);
+	check("cancelled timer never fires",  expired.empty() && !wheel.isArmed(4));
+
+	wheel.expire(now + 6, expired);
+	check("moved timer fires at its new deadline", expired.size() == 1 && expired[0] == 3);
+
+	expired.clear();
+	wheel.arm(8, now + 1); // already in the past
+	wheel.expire(now + 7, expired);
+	check("past deadline fires on the next expire", expired.size() == 1 && expired[0] == 8);
+}
+
+// ============================================================================
+// Deadlines beyond one turn
+// ============================================================================
+
+static void testRounds()
+{
+	std::cout << "\n-- Deadlines beyond one turn --\n";
+
+	TimerWheel wheel(8);
+	const time_t now = 3000;
+	std::vector<int> expired;
+
+	wheel.expire(now, expired);
+	wheel.arm(1, now + 20);
+	wheel.arm(2, now + 4);
+	wheel.expire(now + 12, expired);
+	check("long deadline survives earlier turns", expired.size() == 1 && expired[0] == 2
+	                                              && wheel.isArmed(1));
+	expired.clear();
+	wheel.expire(now + 19, expired);
+	check("not fired one second early",   expired.empty());
+	wheel.expire(now + 20, expired);
+	check("fires on its own round",       expired.size() == 1 && expired[0] == 1);
+
+	expired.clear();
+	wheel.arm(6, now + 25);
+	wheel.expire(now + 1000, expired);
+	check("a long gap still expires everything due", expired.size() == 1 && expired[0] == 6);
+}
+
+// ============================================================================
+// Entry point
+// ============================================================================
+
+int main()
+{
+	testArmAndExpire();
+	testRearmAndCancel();
+	testRounds();
+
+	std::cout << "\n===========================\n";
+	std::cout << g_passed << " / " << g_total << " tests passed\n";
+	std::cout << "===========================\n";
+
+	return (g_passed == g_total) ? 0 : 1;
+}